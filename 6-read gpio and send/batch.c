@@ -0,0 +1,103 @@
+/*
+ * Sample batching
+ *
+ * batch_add()  -> hold a sample, BATCH_DUE once a flush trigger fired
+ * batch_pack() -> envelope with as many held samples as fit, oldest first
+ * batch_drop() -> release the packed samples after they were published
+ */
+
+#include <string.h>
+
+#include "batch.h"
+
+void batch_init(batch_t* b, int max_samples, uint32_t max_age_ms, size_t max_payload,
+        const wire_config_t* wire, batch_item_fn pack_item)
+{
+    memset(b, 0, sizeof(*b));
+    if (max_samples < 1) {
+        max_samples = 1;
+    } else if (max_samples > BATCH_MAX_SAMPLES) {
+        max_samples = BATCH_MAX_SAMPLES;
+    }
+    b->max_samples = max_samples;
+    b->max_age_ms = max_age_ms;
+    b->max_payload = max_payload;
+    b->wire = wire;
+    b->pack_item = pack_item;
+}
+
+/*
+ * return BATCH_DUE if the batch should be flushed now, BATCH_HELD if not.
+ * A full batch refuses the sample with BATCH_FULL, nothing held is
+ * overwritten; the caller flushes or stores and adds it again.
+ */
+int batch_add(batch_t* b, const sample_t* s, int64_t now_us)
+{
+    if (b->count == BATCH_MAX_SAMPLES) {
+        return BATCH_FULL;
+    }
+    if (b->count == 0) {
+        b->first_us = now_us;
+    }
+    b->samples[b->count++] = *s;
+
+    return batch_due(b, now_us) ? BATCH_DUE : BATCH_HELD;
+}
+
+int batch_due(const batch_t* b, int64_t now_us)
+{
+    if (b->count == 0) {
+        return 0;
+    }
+    if (b->count >= b->max_samples) {
+        return 1;
+    }
+    return (now_us - b->first_us) >= (int64_t) b->max_age_ms * 1000;
+}
+
+/*
+ * Pack the oldest samples into buf, stopping before the envelope would
+ * exceed max_payload (or cap).
+ * return envelope length, -1 if not even one sample fits.
+ */
+int batch_pack(const batch_t* b, char* buf, size_t cap, int* packed)
+{
+    wire_writer_t w;
+    int with_ts = (b->count > 1);
+    int n = 0;
+    // JSON is NUL terminated on top of max_payload
+    size_t limit = b->max_payload + ((b->wire->format == WIRE_JSON) ? 1 : 0);
+
+    if ((b->max_payload > 0) && (limit < cap)) {
+        cap = limit;
+    }
+    wire_init(&w, b->wire, buf, cap);
+    wire_payload_begin(&w);
+
+    for (; n < b->count; n++) {
+        size_t mark = wire_mark(&w);
+
+        b->pack_item(&w, &b->samples[n], n == 0, with_ts);
+        // room must be left to close the envelope
+        if (wire_full(&w)) {
+            wire_rewind(&w, mark);
+            break;
+        }
+    }
+
+    *packed = n;
+    if (n == 0) {
+        return -1;
+    }
+    return wire_payload_end(&w);
+}
+
+void batch_drop(batch_t* b, int n)
+{
+    if (n >= b->count) {
+        b->count = 0;
+        return;
+    }
+    memmove(&b->samples[0], &b->samples[n], (b->count - n) * sizeof(sample_t));
+    b->count -= n;
+}
@@ -0,0 +1,50 @@
+#ifndef __BATCH_H
+#define __BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sample.h"
+#include "wire.h"
+
+/*
+ * Sample batching
+ *
+ * Collects samples between sampling and publishing and releases them as one
+ * Iotera envelope when either trigger fires:
+ *   max_samples -> number of samples held
+ *   max_age_ms  -> age of the oldest sample held
+ * The packed envelope never exceeds max_payload; samples that do not fit stay
+ * in the batch for the next publish. The envelope is written in the batch's
+ * wire format (JSON or CBOR), see wire.h.
+ */
+
+#define BATCH_MAX_SAMPLES   16
+
+// batch_add() results
+#define BATCH_HELD          0       // held, no trigger fired yet
+#define BATCH_DUE           1       // held, flush now
+#define BATCH_FULL          (-1)    // not held, flush or store the batch first
+
+// writes the items of one sample, with_ts adds the sample timestamp to each item
+typedef void (*batch_item_fn)(wire_writer_t* w, const sample_t* s, int first, int with_ts);
+
+typedef struct {
+    sample_t samples[BATCH_MAX_SAMPLES];
+    int count;
+    int max_samples;
+    uint32_t max_age_ms;
+    size_t max_payload;
+    int64_t first_us;       // time the oldest held sample was added
+    const wire_config_t* wire;
+    batch_item_fn pack_item;
+} batch_t;
+
+void batch_init(batch_t* b, int max_samples, uint32_t max_age_ms, size_t max_payload,
+        const wire_config_t* wire, batch_item_fn pack_item);
+int batch_add(batch_t* b, const sample_t* s, int64_t now_us);
+int batch_due(const batch_t* b, int64_t now_us);
+int batch_pack(const batch_t* b, char* buf, size_t cap, int* packed);
+void batch_drop(batch_t* b, int n);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Pipeline benchmarks
+ *
+ * bench_begin()  -> start the wall clock
+ * bench_record() -> one iteration, latencies past BENCH_SAMPLES_MAX only
+ *                   count towards throughput
+ * bench_end()    -> sort the latencies, nearest rank percentiles
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+static int bench_cmp_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*) a;
+    uint32_t y = *(const uint32_t*) b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t bench_rate(uint64_t n, int64_t us)
+{
+    return (us > 0) ? (uint32_t) (n * 1000000ULL / (uint64_t) us) : 0;
+}
+
+void bench_begin(bench_t* b, const char* name, int64_t now_us)
+{
+    memset(b, 0, sizeof(*b));
+    b->name = name;
+    b->start_us = now_us;
+}
+
+void bench_record(bench_t* b, uint32_t lat_us, uint32_t items, size_t bytes)
+{
+    if (b->count < BENCH_SAMPLES_MAX) {
+        b->lat_us[b->count++] = lat_us;
+    }
+    b->items += items;
+    b->bytes += bytes;
+}
+
+void bench_end(bench_t* b, int64_t now_us, bench_result_t* r)
+{
+    int64_t elapsed = now_us - b->start_us;
+
+    memset(r, 0, sizeof(*r));
+    r->name = b->name;
+    r->count = b->count;
+    if (b->count > 0) {
+        qsort(b->lat_us, b->count, sizeof(b->lat_us[0]), bench_cmp_u32);
+        r->p50_us = b->lat_us[(b->count - 1) * 50 / 100];
+        r->p99_us = b->lat_us[(b->count - 1) * 99 / 100];
+        r->max_us = b->lat_us[b->count - 1];
+    }
+    r->msgs_per_s = bench_rate(b->items, elapsed);
+    r->bytes_per_s = bench_rate(b->bytes, elapsed);
+}
+
+void bench_print_csv_header(void)
+{
+    printf("bench,count,p50_us,p99_us,max_us,msgs_per_s,bytes_per_s,heap_min\r\n");
+}
+
+void bench_print_csv(const bench_result_t* r)
+{
+    printf("%s,%u,%u,%u,%u,%u,%u,%u\r\n", r->name, r->count, r->p50_us, r->p99_us,
+            r->max_us, r->msgs_per_s, r->bytes_per_s, r->heap_min);
+}
+
+/*
+ * return 0 if r is within its baseline (or has none), -1 on a regression.
+ * A bench that recorded nothing is not a regression, it was skipped.
+ */
+int bench_check(const bench_result_t* r, const bench_baseline_t* baselines, int count)
+{
+    for (int i = 0; i < count; i++) {
+        const bench_baseline_t* base = &baselines[i];
+        if (strcmp(base->name, r->name) != 0) {
+            continue;
+        }
+        if (r->count == 0) {
+            return 0;
+        }
+        if ((base->p99_max_us != 0) && (r->p99_us > base->p99_max_us)) {
+            printf("bench %s: p99 %u us over baseline %u us\r\n", r->name, r->p99_us, base->p99_max_us);
+            return -1;
+        }
+        if ((base->msgs_min_per_s != 0) && (r->msgs_per_s < base->msgs_min_per_s)) {
+            printf("bench %s: %u msgs/s under baseline %u msgs/s\r\n", r->name, r->msgs_per_s, base->msgs_min_per_s);
+            return -1;
+        }
+        return 0;
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Pipeline benchmarks
+ *
+ * A bench records one latency per iteration plus the items and bytes it
+ * moved; bench_end() turns that into p50/p99/max, messages/s and bytes/s.
+ * Results print as CSV (one header, one row per bench) so runs can be
+ * collected from the console and compared. bench_check() compares results
+ * against committed baselines and reports regressions.
+ *
+ * Timestamps come from the caller, nothing here depends on the platform.
+ */
+
+#define BENCH_SAMPLES_MAX   256     // latencies kept per bench
+
+typedef struct {
+    const char* name;
+    uint32_t count;         // iterations recorded
+    uint32_t items;
+    uint64_t bytes;
+    int64_t start_us;
+    uint32_t lat_us[BENCH_SAMPLES_MAX];
+} bench_t;
+
+typedef struct {
+    const char* name;
+    uint32_t count;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    uint32_t msgs_per_s;    // items per second of wall time
+    uint32_t bytes_per_s;
+    uint32_t heap_min;      // lowest free heap seen, filled in by the caller
+} bench_result_t;
+
+// a 0 limit is not checked
+typedef struct {
+    const char* name;
+    uint32_t p99_max_us;
+    uint32_t msgs_min_per_s;
+} bench_baseline_t;
+
+void bench_begin(bench_t* b, const char* name, int64_t now_us);
+void bench_record(bench_t* b, uint32_t lat_us, uint32_t items, size_t bytes);
+void bench_end(bench_t* b, int64_t now_us, bench_result_t* r);
+void bench_print_csv_header(void);
+void bench_print_csv(const bench_result_t* r);
+int bench_check(const bench_result_t* r, const bench_baseline_t* baselines, int count);
+
+#endif
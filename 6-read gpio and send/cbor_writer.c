@@ -0,0 +1,126 @@
+/*
+ * Streaming CBOR writer
+ *
+ * Heads use the shortest argument encoding, floats are always 32 bit.
+ */
+
+#include <string.h>
+
+#include "cbor_writer.h"
+
+#define CBOR_MAJOR_UINT     0
+#define CBOR_MAJOR_NINT     1
+#define CBOR_MAJOR_TEXT     3
+#define CBOR_MAJOR_ARRAY    4
+#define CBOR_MAJOR_MAP      5
+#define CBOR_FLOAT32        0xfa
+#define CBOR_INDEF          31
+
+void cbor_init(cbor_writer_t* w, void* buf, size_t cap)
+{
+    w->buf = (uint8_t*) buf;
+    w->cap = cap;
+    w->len = 0;
+    w->overflow = 0;
+}
+
+static void cbor_raw(cbor_writer_t* w, const void* src, size_t n)
+{
+    if (w->overflow || (n > w->cap - w->len)) {
+        w->overflow = 1;
+        return;
+    }
+    memcpy(&w->buf[w->len], src, n);
+    w->len += n;
+}
+
+void cbor_byte(cbor_writer_t* w, uint8_t b)
+{
+    cbor_raw(w, &b, 1);
+}
+
+static void cbor_head(cbor_writer_t* w, uint8_t major, uint64_t v)
+{
+    uint8_t tmp[9];
+    int n;
+
+    major <<= 5;
+    if (v < 24) {
+        tmp[0] = major | (uint8_t) v;
+        n = 0;
+    } else if (v <= UINT8_MAX) {
+        tmp[0] = major | 24;
+        n = 1;
+    } else if (v <= UINT16_MAX) {
+        tmp[0] = major | 25;
+        n = 2;
+    } else if (v <= UINT32_MAX) {
+        tmp[0] = major | 26;
+        n = 4;
+    } else {
+        tmp[0] = major | 27;
+        n = 8;
+    }
+    // argument in network byte order
+    for (int i = n; i > 0; i--) {
+        tmp[i] = (uint8_t) v;
+        v >>= 8;
+    }
+    cbor_raw(w, tmp, n + 1);
+}
+
+void cbor_uint(cbor_writer_t* w, uint64_t v)
+{
+    cbor_head(w, CBOR_MAJOR_UINT, v);
+}
+
+void cbor_int(cbor_writer_t* w, int64_t v)
+{
+    if (v < 0) {
+        cbor_head(w, CBOR_MAJOR_NINT, (uint64_t) (-1 - v));
+    } else {
+        cbor_head(w, CBOR_MAJOR_UINT, (uint64_t) v);
+    }
+}
+
+void cbor_float(cbor_writer_t* w, float v)
+{
+    uint8_t tmp[5];
+    uint32_t bits;
+
+    memcpy(&bits, &v, sizeof(bits));
+    tmp[0] = CBOR_FLOAT32;
+    tmp[1] = (uint8_t) (bits >> 24);
+    tmp[2] = (uint8_t) (bits >> 16);
+    tmp[3] = (uint8_t) (bits >> 8);
+    tmp[4] = (uint8_t) bits;
+    cbor_raw(w, tmp, sizeof(tmp));
+}
+
+void cbor_text(cbor_writer_t* w, const char* s)
+{
+    size_t n = strlen(s);
+
+    cbor_head(w, CBOR_MAJOR_TEXT, n);
+    cbor_raw(w, s, n);
+}
+
+void cbor_array(cbor_writer_t* w, uint32_t n)
+{
+    cbor_head(w, CBOR_MAJOR_ARRAY, n);
+}
+
+void cbor_array_indef(cbor_writer_t* w)
+{
+    cbor_byte(w, (CBOR_MAJOR_ARRAY << 5) | CBOR_INDEF);
+}
+
+void cbor_map(cbor_writer_t* w, uint32_t n)
+{
+    cbor_head(w, CBOR_MAJOR_MAP, n);
+}
+
+int cbor_finish(cbor_writer_t* w)
+{
+    return w->overflow ? -1 : (int) w->len;
+}
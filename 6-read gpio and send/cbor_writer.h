@@ -0,0 +1,35 @@
+#ifndef __CBOR_WRITER_H
+#define __CBOR_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Streaming CBOR writer (RFC 8949)
+ *
+ * Same contract as the JSON writer: caller owned buffer, no heap, every put
+ * is bounds checked and latches overflow, cbor_finish() returns the exact
+ * length or -1. The output is binary, always pass the length along.
+ */
+
+typedef struct {
+    uint8_t* buf;
+    size_t cap;
+    size_t len;
+    uint8_t overflow;
+} cbor_writer_t;
+
+#define CBOR_BREAK          0xff    // ends an indefinite length item
+
+void cbor_init(cbor_writer_t* w, void* buf, size_t cap);
+void cbor_byte(cbor_writer_t* w, uint8_t b);
+void cbor_uint(cbor_writer_t* w, uint64_t v);
+void cbor_int(cbor_writer_t* w, int64_t v);
+void cbor_float(cbor_writer_t* w, float v);
+void cbor_text(cbor_writer_t* w, const char* s);
+void cbor_array(cbor_writer_t* w, uint32_t n);
+void cbor_array_indef(cbor_writer_t* w);
+void cbor_map(cbor_writer_t* w, uint32_t n);
+int cbor_finish(cbor_writer_t* w);
+
+#endif
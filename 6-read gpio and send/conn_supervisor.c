@@ -0,0 +1,195 @@
+/*
+ * Connectivity supervisor
+ *
+ * Backoff is "equal jitter": half of the exponential delay is fixed, the
+ * other half random, so nodes that lost the same AP do not retry in step
+ * while every node still waits at least half the nominal delay.
+ */
+
+#include "conn_supervisor.h"
+
+#define CONN_BACKOFF_MAX_SHIFT  16
+
+void conn_backoff_reset(conn_backoff_t* b)
+{
+    b->attempt = 0;
+}
+
+uint32_t conn_backoff_next(conn_backoff_t* b, uint32_t rnd)
+{
+    uint32_t shift = (b->attempt < CONN_BACKOFF_MAX_SHIFT) ? b->attempt : CONN_BACKOFF_MAX_SHIFT;
+    uint64_t delay = (uint64_t) b->base_ms << shift;
+
+    if (delay > b->max_ms) {
+        delay = b->max_ms;
+    }
+    b->attempt++;
+
+    return (uint32_t) (delay / 2 + rnd % (delay / 2 + 1));
+}
+
+static void conn_set_bits(conn_sup_t* sup, uint32_t bits)
+{
+    if (bits != sup->bits) {
+        sup->bits = bits;
+        sup->ops.publish_bits(sup->ops.ctx, bits);
+    }
+}
+
+static void conn_schedule_link(conn_sup_t* sup, int64_t now_ms)
+{
+    sup->link_retry_ms = now_ms + conn_backoff_next(&sup->link, sup->ops.random(sup->ops.ctx));
+}
+
+static void conn_schedule_broker(conn_sup_t* sup, int64_t now_ms)
+{
+    sup->broker_retry_ms = now_ms + conn_backoff_next(&sup->broker, sup->ops.random(sup->ops.ctx));
+}
+
+static void conn_broker_lost(conn_sup_t* sup, int64_t now_ms)
+{
+    if (sup->bits & CONN_BIT_BROKER) {
+        sup->broker_drops++;
+        if (now_ms - sup->broker_up_ms >= sup->stable_ms) {
+            conn_backoff_reset(&sup->broker);
+        }
+    }
+}
+
+// the layer below went away, the client must not keep its session
+static void conn_broker_reset(conn_sup_t* sup, int64_t now_ms)
+{
+    int had_ip = (sup->bits & CONN_BIT_IP) != 0;
+
+    conn_broker_lost(sup, now_ms);
+    sup->broker_retry_ms = -1;
+    if (had_ip) {
+        sup->ops.broker_reset(sup->ops.ctx);
+    }
+}
+
+void conn_sup_init(conn_sup_t* sup, const conn_config_t* cfg, const conn_ops_t* ops)
+{
+    sup->ops = *ops;
+    sup->ip_timeout_ms = cfg->ip_timeout_ms;
+    sup->stable_ms = cfg->stable_ms;
+    sup->bits = 0;
+    sup->link.base_ms = cfg->link_base_ms;
+    sup->link.max_ms = cfg->link_max_ms;
+    sup->broker.base_ms = cfg->broker_base_ms;
+    sup->broker.max_ms = cfg->broker_max_ms;
+    conn_backoff_reset(&sup->link);
+    conn_backoff_reset(&sup->broker);
+    sup->link_retry_ms = -1;
+    sup->broker_retry_ms = -1;
+    sup->ip_deadline_ms = -1;
+    sup->ip_up_ms = 0;
+    sup->broker_up_ms = 0;
+    sup->link_attempts = 0;
+    sup->broker_attempts = 0;
+    sup->link_drops = 0;
+    sup->broker_drops = 0;
+}
+
+void conn_sup_post(conn_sup_t* sup, conn_event_t ev, int64_t now_ms)
+{
+    switch (ev) {
+        case CONN_EV_LINK_START:
+            sup->link_retry_ms = now_ms;
+            break;
+        case CONN_EV_LINK_UP:
+            sup->ip_deadline_ms = now_ms + sup->ip_timeout_ms;
+            conn_set_bits(sup, sup->bits | CONN_BIT_LINK);
+            break;
+        case CONN_EV_LINK_DOWN:
+            if (sup->bits & CONN_BIT_LINK) {
+                sup->link_drops++;
+            }
+            if ((sup->bits & CONN_BIT_IP) && (now_ms - sup->ip_up_ms >= sup->stable_ms)) {
+                conn_backoff_reset(&sup->link);
+            }
+            conn_broker_reset(sup, now_ms);
+            sup->ip_deadline_ms = -1;
+            conn_schedule_link(sup, now_ms);
+            conn_set_bits(sup, 0);
+            break;
+        case CONN_EV_IP_UP:
+            sup->ip_up_ms = now_ms;
+            sup->ip_deadline_ms = -1;
+            if (!(sup->bits & CONN_BIT_BROKER)) {
+                sup->broker_retry_ms = now_ms;
+            }
+            conn_set_bits(sup, sup->bits | CONN_BIT_LINK | CONN_BIT_IP);
+            break;
+        case CONN_EV_IP_DOWN:
+            conn_broker_reset(sup, now_ms);
+            if (sup->bits & CONN_BIT_LINK) {
+                sup->ip_deadline_ms = now_ms + sup->ip_timeout_ms;
+            }
+            conn_set_bits(sup, sup->bits & CONN_BIT_LINK);
+            break;
+        case CONN_EV_BROKER_UP:
+            sup->broker_up_ms = now_ms;
+            sup->broker_retry_ms = -1;
+            if (sup->bits & CONN_BIT_IP) {
+                conn_set_bits(sup, sup->bits | CONN_BIT_BROKER);
+            }
+            else {
+                sup->ops.broker_reset(sup->ops.ctx); // connected over a lease that is gone
+            }
+            break;
+        case CONN_EV_BROKER_DOWN:
+            conn_broker_lost(sup, now_ms);
+            if (sup->bits & CONN_BIT_IP) {
+                conn_schedule_broker(sup, now_ms);
+            }
+            conn_set_bits(sup, sup->bits & ~CONN_BIT_BROKER);
+            break;
+        default:
+            break;
+    }
+}
+
+static int32_t conn_until(int64_t deadline, int64_t now_ms, int32_t wait)
+{
+    if (deadline < 0) {
+        return wait;
+    }
+    int64_t left = (deadline > now_ms) ? deadline - now_ms : 0;
+    if ((wait < 0) || (left < wait)) {
+        wait = (int32_t) left;
+    }
+    return wait;
+}
+
+int32_t conn_sup_step(conn_sup_t* sup, int64_t now_ms)
+{
+    if ((sup->link_retry_ms >= 0) && (now_ms >= sup->link_retry_ms)) {
+        sup->link_retry_ms = -1;
+        sup->link_attempts++;
+        if (sup->ops.link_connect(sup->ops.ctx) != 0) {
+            conn_schedule_link(sup, now_ms);
+        }
+    }
+
+    if ((sup->ip_deadline_ms >= 0) && (now_ms >= sup->ip_deadline_ms)) {
+        sup->ip_deadline_ms = -1;
+        if (!(sup->bits & CONN_BIT_IP)) {
+            sup->ops.link_reset(sup->ops.ctx);
+        }
+    }
+
+    if ((sup->broker_retry_ms >= 0) && (now_ms >= sup->broker_retry_ms)) {
+        sup->broker_retry_ms = -1;
+        if (sup->bits & CONN_BIT_IP) {
+            sup->broker_attempts++;
+            if (sup->ops.broker_connect(sup->ops.ctx) != 0) {
+                conn_schedule_broker(sup, now_ms);
+            }
+        }
+    }
+
+    int32_t wait = conn_until(sup->link_retry_ms, now_ms, -1);
+    wait = conn_until(sup->ip_deadline_ms, now_ms, wait);
+    return conn_until(sup->broker_retry_ms, now_ms, wait);
+}
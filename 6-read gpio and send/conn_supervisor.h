@@ -0,0 +1,95 @@
+#ifndef __CONN_SUPERVISOR_H
+#define __CONN_SUPERVISOR_H
+
+#include <stdint.h>
+
+/*
+ * Connectivity supervisor
+ *
+ * One owner for reconnect decisions, layered link -> IP -> broker:
+ *   link down   -> retry association after a jittered exponential backoff
+ *   link up     -> wait ip_timeout_ms for a lease, else reset the link
+ *   IP up       -> connect the broker, then back off on broker failures
+ *   layer down  -> every layer above it is down too; a broker session over a
+ *                  lost link or lease is torn down (broker_reset) so the
+ *                  client can not keep reporting a dead connection
+ *
+ * A layer's backoff restarts from base_ms only if the layer stayed up for
+ * stable_ms, so a flapping AP or broker keeps backing off instead of being
+ * hammered after every short-lived success.
+ *
+ * Network event handlers only post events; the supervisor decides when to
+ * call the ops. The layer state is reported as CONN_BIT_* through
+ * publish_bits (an event group on target).
+ *
+ * The clock is passed in, so flapping links can be simulated on a host.
+ */
+
+#define CONN_BIT_LINK       (1 << 0)
+#define CONN_BIT_IP         (1 << 1)
+#define CONN_BIT_BROKER     (1 << 2)
+#define CONN_BITS_ALL       (CONN_BIT_LINK | CONN_BIT_IP | CONN_BIT_BROKER)
+
+typedef enum {
+    CONN_EV_NONE = 0,
+    CONN_EV_LINK_START,     // station started, first association
+    CONN_EV_LINK_UP,
+    CONN_EV_LINK_DOWN,
+    CONN_EV_IP_UP,
+    CONN_EV_IP_DOWN,
+    CONN_EV_BROKER_UP,
+    CONN_EV_BROKER_DOWN,
+} conn_event_t;
+
+typedef struct {
+    uint32_t base_ms;
+    uint32_t max_ms;
+    uint32_t attempt;       // failures since the last success
+} conn_backoff_t;
+
+typedef struct {
+    int (*link_connect)(void* ctx);     // 0 -> attempt started
+    void (*link_reset)(void* ctx);      // must end in CONN_EV_LINK_DOWN
+    int (*broker_connect)(void* ctx);   // 0 -> attempt started
+    void (*broker_reset)(void* ctx);    // drop the session, may post CONN_EV_BROKER_DOWN
+    void (*publish_bits)(void* ctx, uint32_t bits);
+    uint32_t (*random)(void* ctx);
+    void* ctx;
+} conn_ops_t;
+
+typedef struct {
+    uint32_t link_base_ms;
+    uint32_t link_max_ms;
+    uint32_t broker_base_ms;
+    uint32_t broker_max_ms;
+    uint32_t ip_timeout_ms;
+    uint32_t stable_ms;
+} conn_config_t;
+
+typedef struct {
+    conn_ops_t ops;
+    uint32_t ip_timeout_ms;
+    uint32_t stable_ms;
+    uint32_t bits;
+    conn_backoff_t link;
+    conn_backoff_t broker;
+    int64_t link_retry_ms;      // next association attempt, -1 none
+    int64_t broker_retry_ms;    // next broker attempt, -1 none
+    int64_t ip_deadline_ms;     // link reset if still no IP, -1 none
+    int64_t ip_up_ms;           // when the IP layer came up
+    int64_t broker_up_ms;
+
+    uint32_t link_attempts;
+    uint32_t broker_attempts;
+    uint32_t link_drops;
+    uint32_t broker_drops;
+} conn_sup_t;
+
+void conn_backoff_reset(conn_backoff_t* b);
+uint32_t conn_backoff_next(conn_backoff_t* b, uint32_t rnd);
+
+void conn_sup_init(conn_sup_t* sup, const conn_config_t* cfg, const conn_ops_t* ops);
+void conn_sup_post(conn_sup_t* sup, conn_event_t ev, int64_t now_ms);
+int32_t conn_sup_step(conn_sup_t* sup, int64_t now_ms);   // ms to the next action, -1 none
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * Streaming JSON writer for the Iotera payload
+ *
+ * Numbers are formatted by hand (no libc printf), strings are escaped,
+ * constant parts of the envelope are copied as precomputed literals.
+ */
+
+#include <string.h>
+
+#include "json_writer.h"
+
+static const uint32_t json_pow10[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+void json_init(json_writer_t* w, char* buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->overflow = (cap == 0);
+}
+
+void json_raw(json_writer_t* w, const char* s, size_t n)
+{
+    // keep one byte for the terminating NUL
+    if (w->overflow || (n >= w->cap - w->len)) {
+        w->overflow = 1;
+        return;
+    }
+    memcpy(&w->buf[w->len], s, n);
+    w->len += n;
+}
+
+static void json_char(json_writer_t* w, char c)
+{
+    json_raw(w, &c, 1);
+}
+
+void json_str(json_writer_t* w, const char* s)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char* run = s;
+
+    json_char(w, '"');
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char) *s;
+        if ((c >= 0x20) && (c != '"') && (c != '\\')) {
+            continue;
+        }
+        // flush the plain run before the escaped character
+        json_raw(w, run, s - run);
+        if ((c == '"') || (c == '\\')) {
+            char esc[2] = {'\\', (char) c};
+            json_raw(w, esc, 2);
+        } else {
+            char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0f]};
+            json_raw(w, esc, 6);
+        }
+        run = s + 1;
+    }
+    json_raw(w, run, s - run);
+    json_char(w, '"');
+}
+
+void json_u64(json_writer_t* w, uint64_t v)
+{
+    char tmp[20];
+    int i = sizeof(tmp);
+
+    do {
+        tmp[--i] = (char) ('0' + (v % 10));
+        v /= 10;
+    } while (v != 0);
+    json_raw(w, &tmp[i], sizeof(tmp) - i);
+}
+
+void json_i64(json_writer_t* w, int64_t v)
+{
+    if (v < 0) {
+        json_char(w, '-');
+        json_u64(w, (uint64_t) 0 - (uint64_t) v);
+    } else {
+        json_u64(w, (uint64_t) v);
+    }
+}
+
+/*
+ * Fixed point float, decimals 0..9.
+ * The float is split into its exact binary integer and fraction parts, so
+ * the digits and the rounding (half to even on the exact value) are the
+ * same as printf("%.*f") for every float in range, with integer math only.
+ * NaN/Inf have no JSON form and are written as null, so is |v| > 1e18.
+ */
+void json_float(json_writer_t* w, float v, int decimals)
+{
+    uint32_t bits;
+    uint64_t ipart, fnum, fpart;
+    int shift;
+
+    if ((v != v) || (v > 1e18f) || (v < -1e18f)) {
+        json_lit(w, "null");
+        return;
+    }
+    if (decimals < 0) {
+        decimals = 0;
+    } else if (decimals > 9) {
+        decimals = 9;
+    }
+
+    memcpy(&bits, &v, sizeof(bits));
+    if (bits >> 31) {
+        json_char(w, '-');
+    }
+
+    // v = mant * 2^-shift
+    uint32_t exp = (bits >> 23) & 0xff;
+    uint32_t mant = bits & 0x7fffff;
+    if (exp == 0) {
+        shift = 149;
+    } else {
+        mant |= 0x800000;
+        shift = 150 - (int) exp;
+    }
+
+    if (shift <= 0) {
+        ipart = (uint64_t) mant << -shift;
+        fnum = 0;
+        shift = 0;
+    } else if (shift < 32) {
+        ipart = mant >> shift;
+        fnum = mant & ((1u << shift) - 1);
+    } else {
+        ipart = 0;
+        fnum = mant;
+    }
+
+    // fraction digits = fnum * 10^decimals / 2^shift, fnum < 2^24 so this fits 54 bits
+    uint32_t scale = json_pow10[decimals];
+    uint64_t prod = fnum * scale;
+    if (shift == 0) {
+        fpart = 0;
+    } else if (shift > 54) {
+        fpart = 0;  // below half of the last digit
+    } else {
+        uint64_t rem = prod & (((uint64_t) 1 << shift) - 1);
+        uint64_t half = (uint64_t) 1 << (shift - 1);
+        fpart = prod >> shift;
+        uint64_t last = (decimals == 0) ? ipart : fpart;
+        if ((rem > half) || ((rem == half) && (last & 1))) {
+            fpart++;
+        }
+        if (fpart >= scale) {
+            ipart++;
+            fpart -= scale;
+        }
+    }
+
+    json_u64(w, ipart);
+    if (decimals == 0) {
+        return;
+    }
+
+    char tmp[10];
+    tmp[0] = '.';
+    for (int i = decimals; i > 0; i--) {
+        tmp[i] = (char) ('0' + (fpart % 10));
+        fpart /= 10;
+    }
+    json_raw(w, tmp, decimals + 1);
+}
+
+int json_finish(json_writer_t* w)
+{
+    if (w->overflow) {
+        if (w->cap > 0) {
+            w->buf[0] = '\0';
+        }
+        return -1;
+    }
+    w->buf[w->len] = '\0';
+    return (int) w->len;
+}
+
+void iotera_payload_begin(json_writer_t* w)
+{
+    json_lit(w, "{\"payload\":[");
+}
+
+void iotera_item_begin(json_writer_t* w, const char* sensor, const char* param, int first)
+{
+    if (first) {
+        json_lit(w, "{\"sensor\":");
+    } else {
+        json_lit(w, ",{\"sensor\":");
+    }
+    json_str(w, sensor);
+    json_lit(w, ",\"param\":");
+    json_str(w, param);
+    json_lit(w, ",\"value\":");
+}
+
+void iotera_item_end(json_writer_t* w)
+{
+    json_char(w, '}');
+}
+
+int iotera_payload_end(json_writer_t* w)
+{
+    json_lit(w, "]}");
+    return json_finish(w);
+}
@@ -0,0 +1,43 @@
+#ifndef __JSON_WRITER_H
+#define __JSON_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Streaming JSON writer
+ *
+ * Writes into a caller owned buffer, no heap and no printf. Every put is
+ * bounds checked; once the buffer is full the writer latches overflow and
+ * json_finish() returns -1, otherwise it returns the exact payload length.
+ */
+
+typedef struct {
+    char* buf;
+    size_t cap;
+    size_t len;
+    uint8_t overflow;
+} json_writer_t;
+
+// literal with its length computed at compile time
+#define json_lit(w, s)  json_raw((w), (s), sizeof(s) - 1)
+
+void json_init(json_writer_t* w, char* buf, size_t cap);
+void json_raw(json_writer_t* w, const char* s, size_t n);
+void json_str(json_writer_t* w, const char* s);
+void json_u64(json_writer_t* w, uint64_t v);
+void json_i64(json_writer_t* w, int64_t v);
+void json_float(json_writer_t* w, float v, int decimals);
+int json_finish(json_writer_t* w);
+
+/*
+ * Iotera envelope
+ * {"payload":[{"sensor":"..","param":"..","value":<value>},...]}
+ * value is written by the caller between iotera_item_begin and iotera_item_end.
+ */
+void iotera_payload_begin(json_writer_t* w);
+void iotera_item_begin(json_writer_t* w, const char* sensor, const char* param, int first);
+void iotera_item_end(json_writer_t* w);
+int iotera_payload_end(json_writer_t* w);
+
+#endif
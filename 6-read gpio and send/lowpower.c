@@ -0,0 +1,95 @@
+/*
+ * Low power (deep sleep) duty cycle state machine
+ *
+ * All hardware access goes through lp_ops_t, the state lives in the caller's
+ * RTC memory, so the wake/sleep sequence can be run with stubbed sleep APIs.
+ */
+
+#include <string.h>
+
+#include "lowpower.h"
+
+static void lp_reset(lp_rtc_state_t* rtc, int64_t now)
+{
+    memset(rtc, 0, sizeof(*rtc));
+    rtc->magic = LP_RTC_MAGIC;
+    rtc->next_sample_us = now;
+}
+
+static void lp_hold_sample(lp_rtc_state_t* rtc, const lp_ops_t* ops)
+{
+    if (rtc->count == LP_RTC_SAMPLES) {
+        // keep the newest samples
+        memmove(&rtc->samples[0], &rtc->samples[1], (LP_RTC_SAMPLES - 1) * sizeof(sample_t));
+        rtc->count--;
+        rtc->dropped++;
+    }
+    ops->take_sample(&rtc->samples[rtc->count], rtc);
+    rtc->count++;
+}
+
+lp_action_t lp_step(lp_rtc_state_t* rtc, const lp_config_t* cfg, const lp_ops_t* ops)
+{
+    int64_t period = (int64_t) cfg->sample_period_ms * 1000;
+    lp_action_t action = LP_ACT_SLEEP;
+    lp_wake_t wake = ops->wake_cause();
+    int64_t now = ops->now_us();
+    int sampled = 0;
+
+    if ((wake == LP_WAKE_POWERON) || (rtc->magic != LP_RTC_MAGIC)) {
+        lp_reset(rtc, now);
+    }
+    rtc->boot_count++;
+
+    uint32_t edges = ops->pulse_edges();
+    rtc->pulse1 += edges;
+    rtc->pulses_since_report += edges;
+
+    if (now >= rtc->next_sample_us) {
+        lp_hold_sample(rtc, ops);
+        sampled = 1;
+        action = LP_ACT_SAMPLE;
+        // realign on the period, missed periods are not sampled
+        rtc->next_sample_us += ((now - rtc->next_sample_us) / period + 1) * period;
+    }
+
+    int due = (rtc->count >= cfg->burst_samples) || (rtc->count == LP_RTC_SAMPLES)
+            || ((cfg->pulse_threshold > 0) && (rtc->pulses_since_report >= cfg->pulse_threshold));
+    if ((rtc->report_fails > 0) && (wake == LP_WAKE_PULSE)) {
+        due = 0;
+    }
+
+    if (due) {
+        if (!sampled) {
+            lp_hold_sample(rtc, ops); // report carries the current count
+        }
+        int sent = ops->report(rtc->samples, rtc->count);
+        if (sent > 0) {
+            if (sent > rtc->count) {
+                sent = rtc->count;
+            }
+            memmove(&rtc->samples[0], &rtc->samples[sent], (rtc->count - sent) * sizeof(sample_t));
+            rtc->count -= sent;
+            rtc->pulses_since_report = 0;
+            rtc->report_fails = 0;
+        } else {
+            rtc->report_fails++;
+        }
+        action = LP_ACT_REPORT;
+        now = ops->now_us();
+    }
+
+    int64_t sleep_us = rtc->next_sample_us - now;
+    if (sleep_us < 0) {
+        sleep_us = 0;
+    }
+    // wake on the edges left to the threshold, not after a failed report
+    uint32_t wake_edges = 0;
+    if ((cfg->pulse_threshold > 0) && (rtc->report_fails == 0)) {
+        wake_edges = (rtc->pulses_since_report < cfg->pulse_threshold)
+                ? cfg->pulse_threshold - rtc->pulses_since_report : 1;
+    }
+    ops->deep_sleep(sleep_us, wake_edges);
+
+    return action;
+}
@@ -0,0 +1,74 @@
+#ifndef __LOWPOWER_H
+#define __LOWPOWER_H
+
+#include <stdint.h>
+
+#include "sample.h"
+
+/*
+ * Low power (deep sleep) duty cycle
+ *
+ * Every boot runs lp_step() once, which ends in deep sleep:
+ *   every wake    -> add the CH1 edges counted while asleep
+ *   wake by timer -> take a sample into RTC memory (radio stays off)
+ *   wake by pulse -> the edge count reached pulse_threshold
+ *   report due    -> connect, publish the held samples in one burst
+ *   sleep until the next sample or until the edges left to the threshold
+ *
+ * A report is due when burst_samples are held, when pulse_threshold edges
+ * were counted since the last report, or when the RTC buffer is full.
+ * Samples that could not be sent stay in RTC memory for the next report;
+ * after a failed report only timer wakes retry, so pulses can not cause a
+ * reconnect storm while the uplink is down.
+ *
+ * Edges are counted by the ULP (ulp_pulse.h), the CPU does not wake per
+ * edge. Only CH1 (GPIO4) is an RTC GPIO; CH2 (GPIO5) can not be seen in
+ * deep sleep, so its samples carry SAMPLE_NOT_MEASURED.
+ */
+
+#define LP_RTC_MAGIC        0x4c503031  // "LP01"
+#define LP_RTC_SAMPLES      32
+
+typedef enum {
+    LP_WAKE_POWERON = 0,
+    LP_WAKE_TIMER,
+    LP_WAKE_PULSE,
+} lp_wake_t;
+
+typedef enum {
+    LP_ACT_SLEEP = 0,       // only counted / nothing due
+    LP_ACT_SAMPLE,          // sample taken, no report
+    LP_ACT_REPORT,          // report attempted
+} lp_action_t;
+
+// kept in RTC slow memory across deep sleep
+typedef struct {
+    uint32_t magic;
+    uint32_t boot_count;
+    uint64_t pulse1;
+    uint32_t pulses_since_report;
+    uint32_t dropped;           // samples lost because the buffer was full
+    uint32_t report_fails;      // consecutive failed reports
+    int64_t next_sample_us;     // wall clock, survives deep sleep
+    uint16_t count;
+    sample_t samples[LP_RTC_SAMPLES];
+} lp_rtc_state_t;
+
+typedef struct {
+    uint32_t sample_period_ms;
+    uint16_t burst_samples;
+    uint32_t pulse_threshold;   // 0 -> pulses never trigger a report
+} lp_config_t;
+
+typedef struct {
+    int64_t (*now_us)(void);
+    lp_wake_t (*wake_cause)(void);
+    uint32_t (*pulse_edges)(void);                              // CH1 edges since the last call
+    void (*take_sample)(sample_t* s, const lp_rtc_state_t* rtc);
+    int (*report)(const sample_t* samples, int count);          // return samples sent
+    void (*deep_sleep)(int64_t sleep_us, uint32_t wake_edges);  // 0 edges -> timer only, no return on target
+} lp_ops_t;
+
+lp_action_t lp_step(lp_rtc_state_t* rtc, const lp_config_t* cfg, const lp_ops_t* ops);
+
+#endif
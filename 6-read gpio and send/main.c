@@ -21,20 +21,51 @@
     can be sorted based on Authentication Mode or Signal Strength. The priority
     for the Authentication mode is:  WPA2 > WPA > WEP > Open
 */
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
 #include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_system.h"
 #include "nvs_flash.h"
 
 #include "mqtt_app.h"
+#include "pulse_capture.h"
+#include "pulse_counter.h"
+#include "pulse_stats.h"
+#include "json_writer.h"
+#include "wire.h"
+#include "sample.h"
+#include "telemetry_log.h"
+#include "sample_block.h"
+#include "batch.h"
+#include "rbe.h"
+#include "sched.h"
+#include "lowpower.h"
+#include "wifi_cache.h"
+#include "conn_supervisor.h"
+#include "bench.h"
+#include "metrics.h"
+#include "profile.h"
+#include "spsc_ring.h"
+#include "topology.h"
+#include "ulp_pulse.h"
 
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_sleep.h"
+#include "driver/rtc_io.h"
 
 /* Set the SSID and Password via project configuration, or can set directly here */
 #define DEFAULT_SSID "SSID"
@@ -74,22 +105,345 @@
 #define DEFAULT_AUTHMODE WIFI_AUTH_OPEN
 #endif /*CONFIG_EXAMPLE_FAST_SCAN_THRESHOLD*/
 
+#if CONFIG_EXAMPLE_PULSE_COUNTER_ISR
+#define DEFAULT_PULSE_BACKEND PULSE_COUNTER_BACKEND_ISR
+#else
+#define DEFAULT_PULSE_BACKEND PULSE_COUNTER_BACKEND_PCNT
+#endif /*CONFIG_EXAMPLE_PULSE_COUNTER_BACKEND*/
+
+#if CONFIG_EXAMPLE_BATCH_SAMPLES
+#define DEFAULT_BATCH_SAMPLES CONFIG_EXAMPLE_BATCH_SAMPLES
+#else
+#define DEFAULT_BATCH_SAMPLES 1
+#endif
+#if CONFIG_EXAMPLE_BATCH_MAX_AGE_MS
+#define DEFAULT_BATCH_MAX_AGE_MS CONFIG_EXAMPLE_BATCH_MAX_AGE_MS
+#else
+#define DEFAULT_BATCH_MAX_AGE_MS 300000
+#endif
+#define DEFAULT_BATCH_MAX_PAYLOAD 1536
+
+#if CONFIG_EXAMPLE_WIRE_CBOR_DICT
+#define DEFAULT_WIRE_FORMAT WIRE_CBOR
+#define DEFAULT_WIRE_DICT 1
+#elif CONFIG_EXAMPLE_WIRE_CBOR
+#define DEFAULT_WIRE_FORMAT WIRE_CBOR
+#define DEFAULT_WIRE_DICT 0
+#else
+#define DEFAULT_WIRE_FORMAT WIRE_JSON
+#define DEFAULT_WIRE_DICT 0
+#endif /*CONFIG_EXAMPLE_WIRE_FORMAT*/
+
+#if CONFIG_EXAMPLE_WIFI_CACHE_STATIC_IP
+#define DEFAULT_STATIC_IP 1
+#else
+#define DEFAULT_STATIC_IP 0
+#endif
+
+#if CONFIG_EXAMPLE_REPORT_BY_EXCEPTION
+#define DEFAULT_RBE_MODE 1
+#else
+#define DEFAULT_RBE_MODE 0
+#endif
+
+#if CONFIG_EXAMPLE_TASK_PINNING
+#define DEFAULT_TASK_PINNING 1
+#else
+#define DEFAULT_TASK_PINNING 0
+#endif
+
+#if CONFIG_EXAMPLE_LOW_POWER_MODE
+#define DEFAULT_LOW_POWER_MODE 1
+#else
+#define DEFAULT_LOW_POWER_MODE 0
+#endif
+
+#if CONFIG_EXAMPLE_BENCH_MODE
+#define DEFAULT_BENCH_MODE 1
+#else
+#define DEFAULT_BENCH_MODE 0
+#endif
+
+#if CONFIG_EXAMPLE_PROFILE_MODE
+#define DEFAULT_PROFILE_MODE 1
+#else
+#define DEFAULT_PROFILE_MODE 0
+#endif
+
+#ifdef CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ
+#define DEFAULT_CPU_MHZ CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ
+#else
+#define DEFAULT_CPU_MHZ 160
+#endif
+
 static const char *TAG = "iotera";
-uint8_t wifi_global_stat;
+EventGroupHandle_t conn_events;         // CONN_BIT_* from the supervisor
+
+/*
+ * Diagnostics, published as one JSON object on the diag topic every
+ * METRICS_PERIOD_MS. Ids are METRIC_NONE until metrics_setup() ran, updates
+ * on METRIC_NONE are ignored.
+ */
+static metrics_t metrics;
+static int diag_heap_free = METRIC_NONE;
+static int diag_heap_min = METRIC_NONE;
+static int diag_heap_largest = METRIC_NONE;     // fragmentation: largest free block
+static int diag_stack_gpio = METRIC_NONE;       // stack high-water marks, bytes left
+static int diag_stack_regular = METRIC_NONE;
+static int diag_edge_ring_max = METRIC_NONE;    // deepest capture ring seen by the drain
+static int diag_edges_dropped = METRIC_NONE;
+static int diag_wifi_drops = METRIC_NONE;
+static int diag_mqtt_connects = METRIC_NONE;
+static int diag_mqtt_drops = METRIC_NONE;
+static int diag_pub_acked = METRIC_NONE;
+static int diag_pub_timeouts = METRIC_NONE;
+static int diag_pub_lat_max = METRIC_NONE;      // ms, publish -> PUBACK
+static int diag_pack_us = METRIC_NONE;
+static int diag_payload_bytes = METRIC_NONE;
+static int diag_update_ns = METRIC_NONE;        // cost of one metric update
+static int diag_rbe_suppressed = METRIC_NONE;   // samples not reported by exception
+
+/*
+ * Fast reconnect: after a wake or a drop the station first associates
+ * directly to the last good BSSID on its channel (and optionally reuses the
+ * last lease instead of DHCP). After WIFI_CACHE_MAX_TRIES failed attempts
+ * the cache is dropped and the normal scan is used.
+ */
+#define WIFI_CACHE_MAX_TRIES    2
+
+static esp_netif_t *wifi_sta_netif;
+static wifi_cache_t wifi_cache;
+static uint8_t wifi_cache_ready = 0;    // wifi_cache holds a usable entry
+static uint8_t wifi_use_cache = 0;      // current attempt is directed
+static uint8_t wifi_cache_tries = 0;
+static uint8_t wifi_had_ip = 0;         // IP seen since the last association
+static uint8_t wifi_associated = 0;     // STA_CONNECTED seen, no disconnect since
+static uint8_t wifi_static_lease = 0;   // current attempt reuses the cached lease
+static int64_t wifi_connect_start_us;
+int wifi_time_to_ip_ms = -1;            // last connect, -1 until the first IP
+
+static void wifi_apply_config(int use_cache)
+{
+    wifi_config_t wifi_config = {
+        .sta = {
+            .ssid = DEFAULT_SSID,
+            .password = DEFAULT_PWD,
+            .scan_method = DEFAULT_SCAN_METHOD,
+            .sort_method = DEFAULT_SORT_METHOD,
+            .threshold.rssi = DEFAULT_RSSI,
+            .threshold.authmode = DEFAULT_AUTHMODE,
+        },
+    };
+
+    wifi_use_cache = use_cache && wifi_cache_ready;
+    if (wifi_use_cache) {
+        // a known channel makes the driver probe only that channel
+        wifi_config.sta.bssid_set = 1;
+        memcpy(wifi_config.sta.bssid, wifi_cache.bssid, sizeof(wifi_cache.bssid));
+        wifi_config.sta.channel = wifi_cache.channel;
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+
+    // the cached lease is applied once associated, see wifi_apply_static_lease()
+    wifi_static_lease = wifi_use_cache && DEFAULT_STATIC_IP && wifi_cache.has_ip;
+    if (!wifi_static_lease) {
+        esp_netif_dhcpc_start(wifi_sta_netif);
+    }
+}
+
+/*
+ * Reuse the cached lease instead of DHCP. Only on STA_CONNECTED: before
+ * association the interface is down, and the DHCP client started by the
+ * connect would replace the address again.
+ */
+static void wifi_apply_static_lease(void)
+{
+    esp_netif_ip_info_t ip_info = {
+        .ip.addr = wifi_cache.ip,
+        .netmask.addr = wifi_cache.netmask,
+        .gw.addr = wifi_cache.gw,
+    };
+    esp_netif_dns_info_t dns = {0};
+    dns.ip.u_addr.ip4.addr = wifi_cache.dns;
+
+    esp_netif_dhcpc_stop(wifi_sta_netif);
+    if (esp_netif_set_ip_info(wifi_sta_netif, &ip_info) != ESP_OK) {
+        ESP_LOGW(TAG, "cached lease rejected, using DHCP");
+        esp_netif_dhcpc_start(wifi_sta_netif);
+        return;
+    }
+    esp_netif_set_dns_info(wifi_sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+}
+
+static void wifi_save_cache(const ip_event_got_ip_t* event)
+{
+    wifi_ap_record_t ap;
+    esp_netif_dns_info_t dns;
+    wifi_cache_t entry;
+
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    memset(&entry, 0, sizeof(entry));
+    strncpy(entry.ssid, DEFAULT_SSID, sizeof(entry.ssid) - 1);
+    memcpy(entry.bssid, ap.bssid, sizeof(entry.bssid));
+    entry.channel = ap.primary;
+    entry.ip = event->ip_info.ip.addr;
+    entry.netmask = event->ip_info.netmask.addr;
+    entry.gw = event->ip_info.gw.addr;
+    if (esp_netif_get_dns_info(wifi_sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
+        entry.dns = dns.ip.u_addr.ip4.addr;
+    }
+    entry.has_ip = 1;
+
+    if (wifi_cache_save(&entry) == ESP_OK) {
+        wifi_cache = entry;
+        wifi_cache_ready = 1;
+    }
+}
+
+/*
+ * Connectivity supervisor task: owns every reconnect (Wi-Fi association and
+ * MQTT), event handlers only post what happened.
+ */
+#define CONN_LINK_BASE_MS       500
+#define CONN_LINK_MAX_MS        60000
+#define CONN_BROKER_BASE_MS     1000
+#define CONN_BROKER_MAX_MS      120000
+#define CONN_IP_TIMEOUT_MS      15000
+#define CONN_STABLE_MS          60000
+#define CONN_QUEUE_LEN          16
+
+static xQueueHandle conn_queue = NULL;
+static conn_sup_t conn_sup;
+
+static void conn_post(conn_event_t ev)
+{
+    xQueueSend(conn_queue, &ev, 0);
+}
+
+static void conn_mqtt_state(int connected)
+{
+    metric_inc(&metrics, connected ? diag_mqtt_connects : diag_mqtt_drops, 1);
+    conn_post(connected ? CONN_EV_BROKER_UP : CONN_EV_BROKER_DOWN);
+}
+
+static int conn_link_connect(void* ctx)
+{
+    return (esp_wifi_connect() == ESP_OK) ? 0 : -1;
+}
+
+static void conn_link_reset(void* ctx)
+{
+    esp_wifi_disconnect();
+}
+
+static int conn_broker_connect(void* ctx)
+{
+    return (mqtt_reconnect() == ESP_OK) ? 0 : -1;
+}
+
+static void conn_broker_reset(void* ctx)
+{
+    mqtt_disconnect();
+}
+
+static void conn_publish_bits(void* ctx, uint32_t bits)
+{
+    xEventGroupClearBits(conn_events, CONN_BITS_ALL & ~bits);
+    xEventGroupSetBits(conn_events, bits);
+    ESP_LOGI(TAG, "link:%d ip:%d broker:%d", !!(bits & CONN_BIT_LINK),
+            !!(bits & CONN_BIT_IP), !!(bits & CONN_BIT_BROKER));
+}
+
+static uint32_t conn_random(void* ctx)
+{
+    return esp_random();
+}
+
+static void conn_task(void* arg)
+{
+    int64_t tick_ms = portTICK_PERIOD_MS;
+    int32_t wait_ms = -1;
+    conn_event_t ev;
+
+    for(;;) {
+        // round up so a retry never fires before its deadline
+        TickType_t ticks = (wait_ms < 0) ? portMAX_DELAY : (TickType_t) ((wait_ms + tick_ms - 1) / tick_ms);
+        if (xQueueReceive(conn_queue, &ev, ticks) == pdTRUE) {
+            conn_sup_post(&conn_sup, ev, esp_timer_get_time() / 1000);
+        }
+        wait_ms = conn_sup_step(&conn_sup, esp_timer_get_time() / 1000);
+    }
+}
+
+static void conn_start(void)
+{
+    static const conn_config_t conn_cfg = {
+        .link_base_ms = CONN_LINK_BASE_MS,
+        .link_max_ms = CONN_LINK_MAX_MS,
+        .broker_base_ms = CONN_BROKER_BASE_MS,
+        .broker_max_ms = CONN_BROKER_MAX_MS,
+        .ip_timeout_ms = CONN_IP_TIMEOUT_MS,
+        .stable_ms = CONN_STABLE_MS,
+    };
+    static const conn_ops_t conn_ops = {
+        .link_connect = conn_link_connect,
+        .link_reset = conn_link_reset,
+        .broker_connect = conn_broker_connect,
+        .broker_reset = conn_broker_reset,
+        .publish_bits = conn_publish_bits,
+        .random = conn_random,
+    };
+
+    conn_events = xEventGroupCreate();
+    conn_queue = xQueueCreate(CONN_QUEUE_LEN, sizeof(conn_event_t));
+    conn_sup_init(&conn_sup, &conn_cfg, &conn_ops);
+    mqtt_set_conn_cb(conn_mqtt_state);
+    topology_task_create(TOPO_NET, conn_task, "conn_task", 2048, NULL, 5, NULL);
+}
 
 static void event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
-        wifi_global_stat = 1;
+        conn_post(CONN_EV_LINK_START);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_associated = 1;
+        if (wifi_static_lease) {
+            wifi_apply_static_lease();
+        }
+        conn_post(CONN_EV_LINK_UP);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        wifi_global_stat = 0;
-        esp_wifi_connect();
+        if (wifi_had_ip) {
+            // link dropped, time the reconnect and try the cached AP again
+            wifi_connect_start_us = esp_timer_get_time();
+            wifi_cache_tries = 0;
+            wifi_apply_config(1);
+        } else if (wifi_use_cache && (++wifi_cache_tries >= WIFI_CACHE_MAX_TRIES)) {
+            ESP_LOGW(TAG, "cached AP not reachable, scanning");
+            wifi_cache_invalidate();
+            wifi_cache_ready = 0;
+            wifi_apply_config(0);
+        }
+        wifi_had_ip = 0;
+        wifi_associated = 0;
+        metric_inc(&metrics, diag_wifi_drops, 1);
+        conn_post(CONN_EV_LINK_DOWN);
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-        wifi_global_stat = 2;
+        wifi_time_to_ip_ms = (int) ((esp_timer_get_time() - wifi_connect_start_us) / 1000);
+        ESP_LOGI(TAG, "got ip:" IPSTR ", time to ip %d ms (%s)", IP2STR(&event->ip_info.ip),
+                wifi_time_to_ip_ms, wifi_use_cache ? "cached AP" : "scan");
+        if (wifi_associated) {
+            // the BSSID and channel only mean something once associated
+            wifi_save_cache(event);
+        }
+        wifi_had_ip = 1;
+        conn_post(CONN_EV_IP_UP);
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_LOST_IP) {
+        conn_post(CONN_EV_IP_DOWN);
     }
 }
 
@@ -97,6 +451,9 @@ static void event_handler(void* arg, esp_event_base_t event_base,
 /* Initialize Wi-Fi as sta and set scan method */
 static void fast_scan(void)
 {
+    wifi_connect_start_us = esp_timer_get_time();
+    conn_start();
+
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
@@ -105,24 +462,18 @@ static void fast_scan(void)
 
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_LOST_IP, &event_handler, NULL, NULL));
 
     // Initialize default station as network interface instance (esp-netif)
-    esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
-    assert(sta_netif);
+    wifi_sta_netif = esp_netif_create_default_wifi_sta();
+    assert(wifi_sta_netif);
 
-    // Initialize and start WiFi
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = DEFAULT_SSID,
-            .password = DEFAULT_PWD,
-            .scan_method = DEFAULT_SCAN_METHOD,
-            .sort_method = DEFAULT_SORT_METHOD,
-            .threshold.rssi = DEFAULT_RSSI,
-            .threshold.authmode = DEFAULT_AUTHMODE,
-        },
-    };
+    wifi_cache_ready = (wifi_cache_load(&wifi_cache, DEFAULT_SSID) == ESP_OK);
+    wifi_cache_tries = 0;
+
+    // Initialize and start WiFi, directed to the last good AP when known
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    wifi_apply_config(1);
     ESP_ERROR_CHECK(esp_wifi_start());
 }
 
@@ -132,11 +483,341 @@ const char mqtt_url[] = "mqtt://mqtt.iotera.io";
 const char mqtt_username[] = "mqtt_1000000181_eaaeb0b6-d102-4180-8e5d-9ea2f1f78501";
 const char mqtt_password[] = "rzkc0ex70w46x70l";
 uint32_t mqtt_port = 1883;
-char payload[512];
+#define PAYLOAD_MAX 2048
+char payload[PAYLOAD_MAX];
+int payload_len = -1;
 const char ID[] = "0001";
-uint32_t pulse1 = 0;
-uint32_t pulse2 = 0;
+uint64_t pulse1 = 0;     // counters of the last acquisition reply
+uint64_t pulse2 = 0;
+
+// edge statistics per channel, owned by gpio_task_example
+#define PULSE_BURST_GAP_US      10000   // edges closer than this form a burst
+#define PULSE_BURST_MIN_EDGES   5
+static pulse_stats_t pulse_stats[PULSE_CAPTURE_CHANNELS];
+static uint64_t pulse_total[PULSE_COUNTER_CHANNELS];          // counters, gpio task side
+static uint64_t pulse_window_count[PULSE_CAPTURE_CHANNELS];    // counter at window start
+static pulse_summary_t pulse_summary[PULSE_CAPTURE_CHANNELS];  // last window, regular task side
+
+/*
+ * Acquisition handoff: the regular task pushes requests, the gpio task
+ * answers with its counters (and the closed window for ACQ_REQ_WINDOW).
+ * One ring per direction, each with one producer and one consumer, so the
+ * two tasks share no lock even when they run on different cores.
+ */
+#define ACQ_RING_LEN            4       // power of two
+#define ACQ_REPLY_TIMEOUT_MS    200
+
+typedef enum {
+	ACQ_REQ_SNAPSHOT = 0,
+	ACQ_REQ_WINDOW,
+} acq_req_t;
+
+typedef struct {
+	uint8_t type;           // acq_req_t answered
+	uint64_t pulse[PULSE_COUNTER_CHANNELS];
+	pulse_summary_t summary[PULSE_CAPTURE_CHANNELS];
+} acq_reply_t;
+
+static uint8_t acq_request_buf[ACQ_RING_LEN];
+static acq_reply_t acq_reply_buf[ACQ_RING_LEN];
+static spsc_ring_t acq_requests;    // regular task -> gpio task
+static spsc_ring_t acq_replies;     // gpio task -> regular task
+static TaskHandle_t gpio_task_handle = NULL;
+static TaskHandle_t acq_waiter = NULL;  // notified by the gpio task once replies are pushed
 float battery;
+sample_t sample;
+static batch_t sample_batch;
+
+// report by exception, fields in the order of rbe_fields
+#define RBE_PULSE_DEADBAND      100     // counts
+#define RBE_BATTERY_DEADBAND    0.1     // V
+#define RBE_BATTERY_HYSTERESIS  0.05    // V
+#define RBE_HEARTBEAT_MS        900000  // report at least every 15 minutes
+static const rbe_field_config_t rbe_fields[] = {
+	{ .deadband = RBE_PULSE_DEADBAND },
+	{ .deadband = RBE_PULSE_DEADBAND },
+	{ .deadband = RBE_BATTERY_DEADBAND, .hysteresis = RBE_BATTERY_HYSTERESIS },
+};
+static rbe_t sample_rbe;
+
+// store-and-forward while offline, records are sample blocks (sample_block.h)
+// the backlog is replayed one record at a time next to the live publishes
+#define TLOG_DRAIN_PERIOD_MS    250
+#define TLOG_DRAIN_INFLIGHT     (MQTT_INFLIGHT_MAX - 1)     // one slot is left for live data
+static tlog_t telemetry_log;
+static uint8_t telemetry_log_ready = 0;
+static uint8_t tlog_record[TLOG_RECORD_MAX];
+static sample_t replay_samples[BATCH_MAX_SAMPLES];
+static batch_t replay_batch;
+
+// record being replayed, consumed once every envelope of it is acked
+typedef struct {
+    int count;          // samples of the record, 0 -> none peeked
+    int sent;           // samples handed to the client so far
+    int inflight;
+    uint8_t failed;     // an envelope was not acked, replay the record again
+    mqtt_pub_handle_t handles[TLOG_DRAIN_INFLIGHT];
+} tlog_drain_t;
+static tlog_drain_t tlog_drain;
+
+// batches waiting for PUBACK, kept until acked or stored
+#define PUB_TIMEOUT_MS      30000
+typedef struct {
+    mqtt_pub_handle_t handle;   // 0 -> slot free
+    int count;
+    sample_t samples[BATCH_MAX_SAMPLES];
+} pending_pub_t;
+static pending_pub_t pending_pubs[MQTT_INFLIGHT_MAX];
+
+// dictionary, append only (v2 appends the pulse_stats names), the gateway
+// expands the indexes with the table of the envelope's "dict" version
+static const char* const wire_dict_v2[] = {
+	"sensor", "param", "value", "ts",
+	"wifi_node", "pulse_counter", "battery",
+	"ID", "CH1", "CH2",
+	"pulse_stats", "edges", "rate", "min_us", "max_us",
+	"p50_us", "p90_us", "p99_us", "bursts", "burst_max",
+};
+
+static const wire_config_t wire_json = { .format = WIRE_JSON };
+static const wire_config_t wire_cbor = { .format = WIRE_CBOR };
+static const wire_config_t wire_cbor_dict = {
+	.format = WIRE_CBOR,
+	.dict = wire_dict_v2,
+	.dict_len = sizeof(wire_dict_v2) / sizeof(wire_dict_v2[0]),
+	.dict_version = 2,
+};
+static const wire_config_t* const wire_cfg = (DEFAULT_WIRE_FORMAT == WIRE_JSON) ? &wire_json
+		: (DEFAULT_WIRE_DICT ? &wire_cbor_dict : &wire_cbor);
+
+// JSON keeps its precomputed literals, this is the hot path of the default format
+static void pack_sample_json(json_writer_t* w, const sample_t* s, int first, int with_ts)
+{
+	if (!first) {
+		json_lit(w, ",");
+	}
+	json_lit(w, "{\"sensor\":\"wifi_node\",\"param\":\"pulse_counter\",\"value\":{"
+	"\"ID\":");
+	json_str(w, ID);
+	json_lit(w, ",\"CH1\":");
+	json_u64(w, s->pulse1);
+	if (s->pulse2 != SAMPLE_NOT_MEASURED) {
+		json_lit(w, ",\"CH2\":");
+		json_u64(w, s->pulse2);
+	}
+	json_lit(w, "}");
+	if (with_ts) {
+		json_lit(w, ",\"ts\":");
+		json_u64(w, s->timestamp);
+	}
+	json_lit(w, "},"
+
+	"{\"sensor\":\"wifi_node\",\"param\":\"battery\",\"value\":");
+	json_float(w, s->battery, 6);
+	if (with_ts) {
+		json_lit(w, ",\"ts\":");
+		json_u64(w, s->timestamp);
+	}
+	json_lit(w, "}");
+}
+
+void pack_sample_items(wire_writer_t* w, const sample_t* s, int first, int with_ts)
+{
+	if (w->cfg->format == WIRE_JSON) {
+		pack_sample_json(&w->json, s, first, with_ts);
+		return;
+	}
+
+	wire_item_begin(w, "wifi_node", "pulse_counter", first, with_ts);
+	// a channel that was not measured is left out rather than sent as 0
+	int ch2 = (s->pulse2 != SAMPLE_NOT_MEASURED);
+	wire_map_begin(w, ch2 ? 3 : 2);
+	wire_key(w, "ID", 1);
+	wire_str(w, ID);
+	wire_key(w, "CH1", 0);
+	wire_u64(w, s->pulse1);
+	if (ch2) {
+		wire_key(w, "CH2", 0);
+		wire_u64(w, s->pulse2);
+	}
+	wire_map_end(w);
+	if (with_ts) {
+		wire_item_ts(w, s->timestamp);
+	}
+	wire_item_end(w);
+
+	wire_item_begin(w, "wifi_node", "battery", 0, with_ts);
+	wire_float(w, s->battery, 6);
+	if (with_ts) {
+		wire_item_ts(w, s->timestamp);
+	}
+	wire_item_end(w);
+}
+
+int pack_data_as(const sample_t* s, const wire_config_t* cfg)
+{
+	wire_writer_t w;
+	wire_init(&w, cfg, payload, sizeof(payload));
+
+	// Pack data
+	wire_payload_begin(&w);
+	pack_sample_items(&w, s, 1, 0);
+
+	payload_len = wire_payload_end(&w);
+	return payload_len;
+}
+
+int pack_data(const sample_t* s)
+{
+	return pack_data_as(s, wire_cfg);
+}
+
+static void pulse_stats_setup(void)
+{
+	static const pulse_stats_config_t cfg = {
+		.burst_gap_us = PULSE_BURST_GAP_US,
+		.burst_min_edges = PULSE_BURST_MIN_EDGES,
+	};
+
+	for (int ch = 0; ch < PULSE_CAPTURE_CHANNELS; ch++) {
+		pulse_stats_init(&pulse_stats[ch], &cfg, esp_timer_get_time());
+	}
+	spsc_init(&acq_requests, acq_request_buf, sizeof(acq_request_buf[0]), ACQ_RING_LEN);
+	spsc_init(&acq_replies, acq_reply_buf, sizeof(acq_reply_buf[0]), ACQ_RING_LEN);
+}
+
+// gpio task: close the statistics window of every channel, the edge count comes from the counter
+static void summarize_pulses(pulse_summary_t* out)
+{
+	int64_t now = esp_timer_get_time();
+
+	for (int ch = 0; ch < PULSE_CAPTURE_CHANNELS; ch++) {
+		uint32_t edges = (uint32_t) (pulse_total[ch] - pulse_window_count[ch]);
+		pulse_window_count[ch] = pulse_total[ch];
+		pulse_stats_window(&pulse_stats[ch], now, edges, &out[ch]);
+	}
+}
+
+// gpio task: answer every pending request
+static void acq_serve(void)
+{
+	static acq_reply_t reply;
+	uint8_t type;
+	int answered = 0;
+
+	while (spsc_pop(&acq_requests, &type) == 0) {
+		reply.type = type;
+		memcpy(reply.pulse, pulse_total, sizeof(reply.pulse));
+		if (type == ACQ_REQ_WINDOW) {
+			summarize_pulses(reply.summary);
+		}
+		if (spsc_push(&acq_replies, &reply) != 0) {
+			break; // the requester gave up on earlier replies, it drains them next time
+		}
+		answered = 1;
+	}
+	TaskHandle_t waiter = __atomic_load_n(&acq_waiter, __ATOMIC_ACQUIRE);
+	if (answered && (waiter != NULL)) {
+		xTaskNotifyGive(waiter);
+	}
+}
+
+/*
+ * regular task: ask the gpio task and sleep until it notifies a reply.
+ * Replies to requests that timed out earlier are applied on the way, their
+ * late notifications only cost one more look at the ring.
+ * return 0 once the answer arrived, -1 on timeout (gpio task stalled)
+ */
+static int acq_request(acq_req_t type)
+{
+	static acq_reply_t reply;
+	uint8_t req = (uint8_t) type;
+	TickType_t start = xTaskGetTickCount();
+	TickType_t timeout = pdMS_TO_TICKS(ACQ_REPLY_TIMEOUT_MS);
+
+	// one requester: stored before the push, the gpio task sees it with the request
+	__atomic_store_n(&acq_waiter, xTaskGetCurrentTaskHandle(), __ATOMIC_RELEASE);
+	if (spsc_push(&acq_requests, &req) != 0) {
+		return -1;
+	}
+	if (gpio_task_handle != NULL) {
+		xTaskNotifyGive(gpio_task_handle);
+	}
+	for (;;) {
+		while (spsc_pop(&acq_replies, &reply) == 0) {
+			pulse1 = reply.pulse[0];
+			pulse2 = reply.pulse[1];
+			if (reply.type == ACQ_REQ_WINDOW) {
+				memcpy(pulse_summary, reply.summary, sizeof(pulse_summary));
+			}
+			if (reply.type == req) {
+				return 0;
+			}
+		}
+		TickType_t elapsed = xTaskGetTickCount() - start;
+		if (elapsed >= timeout) {
+			return -1;
+		}
+		ulTaskNotifyTake(pdTRUE, timeout - elapsed);
+	}
+}
+
+// timed 0: PCNT counts without timestamps, only edges and rate are known
+static void pack_pulse_summary(wire_writer_t* w, const pulse_summary_t* p, int timed)
+{
+	wire_map_begin(w, timed ? 9 : 2);
+	wire_key(w, "edges", 1);
+	wire_u64(w, p->edges);
+	wire_key(w, "rate", 0);
+	wire_float(w, p->rate_hz, 3);
+	if (!timed) {
+		wire_map_end(w);
+		return;
+	}
+	wire_key(w, "min_us", 0);
+	wire_u64(w, p->min_us);
+	wire_key(w, "max_us", 0);
+	wire_u64(w, p->max_us);
+	wire_key(w, "p50_us", 0);
+	wire_u64(w, p->p50_us);
+	wire_key(w, "p90_us", 0);
+	wire_u64(w, p->p90_us);
+	wire_key(w, "p99_us", 0);
+	wire_u64(w, p->p99_us);
+	wire_key(w, "bursts", 0);
+	wire_u64(w, p->bursts);
+	wire_key(w, "burst_max", 0);
+	wire_u64(w, p->burst_max);
+	wire_map_end(w);
+}
+
+/*
+ * Publish the last window summaries, best effort: summaries are not stored
+ * while offline, the raw counters in the samples are.
+ */
+void send_pulse_summary(void)
+{
+	wire_writer_t w;
+	int timed = (pulse_counter_backend() == PULSE_COUNTER_BACKEND_ISR);
+
+	if (!(xEventGroupGetBits(conn_events) & CONN_BIT_BROKER)) {
+		return;
+	}
+	wire_init(&w, wire_cfg, payload, sizeof(payload));
+	wire_payload_begin(&w);
+	wire_item_begin(&w, "wifi_node", "pulse_stats", 1, 0);
+	wire_map_begin(&w, PULSE_CAPTURE_CHANNELS);
+	for (int ch = 0; ch < PULSE_CAPTURE_CHANNELS; ch++) {
+		wire_key(&w, (ch == 0) ? "CH1" : "CH2", ch == 0);
+		pack_pulse_summary(&w, &pulse_summary[ch], timed);
+	}
+	wire_map_end(&w);
+	wire_item_end(&w);
+	int len = wire_payload_end(&w);
+	if (len > 0) {
+		mqtt_publish_iotera_queued(payload, len);
+	}
+}
 
 /*
  *  Application for Regular mode
@@ -148,84 +829,435 @@ void init_regular_mode(void)
 	// init mqtt
 	mqtt_init(mqtt_url,mqtt_port,mqtt_username,mqtt_password);
 
+	batch_init(&sample_batch, DEFAULT_BATCH_SAMPLES, DEFAULT_BATCH_MAX_AGE_MS,
+			DEFAULT_BATCH_MAX_PAYLOAD, wire_cfg, pack_sample_items);
+	rbe_init(&sample_rbe, rbe_fields, sizeof(rbe_fields) / sizeof(rbe_fields[0]), RBE_HEARTBEAT_MS);
+
+	// init offline log, runs without store-and-forward if the partition is missing
+	tlog_flash_t flash;
+	esp_err_t err = tlog_flash_from_partition(&flash, TLOG_PARTITION_LABEL);
+	if (err == ESP_OK) {
+		err = tlog_open(&telemetry_log, &flash);
+	}
+	if (err == ESP_OK) {
+		telemetry_log_ready = 1;
+		printf("telemetry log: %d pending\r\n", tlog_pending(&telemetry_log));
+	}
+	else {
+		printf("telemetry log unavailable: %s\r\n", esp_err_to_name(err));
+	}
+
 	vTaskDelay(pdMS_TO_TICKS(100));
 }
 
-void pack_data(void)
+/*
+ * Store samples as column blocks, up to BATCH_MAX_SAMPLES per log record.
+ * A block of exactly sizeof(sample_t) bytes gets a pad byte, that length
+ * is reserved for the single sample records of older firmware.
+ */
+void store_samples(const sample_t* s, int n)
+{
+	while (telemetry_log_ready && (n > 0)) {
+		int take = (n < BATCH_MAX_SAMPLES) ? n : BATCH_MAX_SAMPLES;
+		int len;
+		while (((len = sblock_encode(s, take, tlog_record, sizeof(tlog_record))) < 0) && (take > 1)) {
+			take--;
+		}
+		if (len < 0) {
+			printf("sample store failed\r\n");
+			return;
+		}
+		if (len == sizeof(sample_t)) {
+			tlog_record[len++] = 0;
+		}
+		if (tlog_append(&telemetry_log, tlog_record, len) == ESP_OK) {
+			printf("%d sample(s) stored in %d bytes, pending:%d\r\n", take, len, tlog_pending(&telemetry_log));
+		}
+		else {
+			printf("sample store failed\r\n");
+		}
+		s += take;
+		n -= take;
+	}
+}
+
+// move the n oldest batched samples to the offline log
+void store_batch_data(int n)
 {
-	bzero(payload,512);
+	if (n > sample_batch.count) {
+		n = sample_batch.count;
+	}
+	store_samples(sample_batch.samples, n);
+	batch_drop(&sample_batch, n);
+}
 
-	// Pack data
-	sprintf(payload,"{\"payload\":["
-	"{\"sensor\":\"wifi_node\",\"param\":\"pulse_counter\",\"value\":{"
-	"\"ID\":\"%s\",\"CH1\":%i,\"CH2\":%i}},"
+/*
+ * Take a sample, return 1 if it was queued for publishing.
+ * In report by exception mode samples without a significant change are
+ * dropped; the pulse counters are cumulative, so no edge is lost.
+ * now_ms is the sampling deadline, so the heartbeat is a whole number of
+ * sample periods whatever the scheduling jitter.
+ */
+/*
+ * No battery ADC on this board yet: a cell discharging 0.1 V a day from
+ * 4.1 V, recharged every day, with +-20 mV of noise. The noise stays well
+ * inside RBE_BATTERY_DEADBAND, so report by exception can suppress samples;
+ * a uniformly random reading would move past it on most samples.
+ */
+static float battery_read(void)
+{
+    int64_t day_s = (esp_timer_get_time() / 1000000) % 86400;
+    float noise = ((float) (esp_random() % 41) - 20.0f) / 1000.0f;
+
+    return 4.1f - 0.1f * (float) day_s / 86400.0f + noise;
+}
+
+int get_sensor_data_regular_mode(int64_t now_ms)
+{
+    battery = battery_read();
+
+    sample.timestamp = (uint32_t) time(NULL);
+    sample.battery = battery;
+    sample.pulse1 = pulse1;
+    sample.pulse2 = pulse2;
+
+    if (DEFAULT_RBE_MODE) {
+        double values[] = { (double) sample.pulse1, (double) sample.pulse2, sample.battery };
+        uint32_t why = rbe_update(&sample_rbe, values, now_ms);
+        if (why == 0) {
+            metric_inc(&metrics, diag_rbe_suppressed, 1);
+            return 0;
+        }
+        printf("report by exception: 0x%08x\r\n", why);
+    }
+
+    if (batch_add(&sample_batch, &sample, esp_timer_get_time()) == BATCH_FULL) {
+        // publishing fell behind, the held samples go to the offline log
+        printf("batch full\r\n");
+        store_batch_data(sample_batch.count);
+        batch_add(&sample_batch, &sample, esp_timer_get_time());
+    }
+    return 1;
+}
+
+// samples of one log record, -1 if it is unusable
+static int stored_record_samples(const uint8_t* rec, uint16_t len, sample_t* out)
+{
+	if (len == sizeof(sample_t)) {
+		memcpy(out, rec, len); // written by older firmware
+		return 1;
+	}
+	return sblock_decode(rec, len, out, BATCH_MAX_SAMPLES);
+}
 
-	"{\"sensor\":\"wifi_node\",\"param\":\"battery\",\"value\":%f}]}",
+// peek the oldest usable record into replay_samples, unusable ones are skipped
+static int drain_load_record(void)
+{
+	uint16_t len;
 
-	ID,pulse1,pulse2,
-	battery);
+	for (;;) {
+		esp_err_t err = tlog_peek(&telemetry_log, tlog_record, sizeof(tlog_record), &len);
+		if (err == ESP_ERR_NOT_FOUND) {
+			return 0;
+		}
+		int n = (err == ESP_OK) ? stored_record_samples(tlog_record, len, replay_samples) : -1;
+		if (n > 0) {
+			return n;
+		}
+		tlog_consume(&telemetry_log); // unusable record, skip it
+	}
 }
 
-void get_sensor_data_regular_mode(void)
+/*
+ * Replay the offline log without blocking, oldest record first.
+ * Envelopes go out through the async publish path while in-flight slots are
+ * free; the record is consumed once all of them are acked. A publish that
+ * fails or times out replays the whole record, the gateway sees duplicates
+ * rather than gaps.
+ */
+void drain_stored_data(void)
 {
-	// get random battery value 
-    battery = ((float) esp_random() / (float) UINT32_MAX) * 5.0;
+	tlog_drain_t* d = &tlog_drain;
+	int packed = 0;
+
+	for (int i = 0; i < d->inflight; ) {
+		mqtt_pub_status_t st = mqtt_pub_status(d->handles[i]);
+		if (st == MQTT_PUB_PENDING) {
+			i++;
+			continue;
+		}
+		if (st != MQTT_PUB_DONE) {
+			d->failed = 1;
+		}
+		mqtt_pub_release(d->handles[i]);
+		d->handles[i] = d->handles[--d->inflight];
+	}
+	if (d->failed) {
+		if (d->inflight > 0) {
+			return; // let the rest finish before the record is replayed
+		}
+		printf("stored record not acked, replaying it\r\n");
+		d->failed = 0;
+		d->sent = 0;
+	}
+	else if ((d->inflight == 0) && (d->count > 0) && (d->sent == d->count)) {
+		tlog_consume(&telemetry_log);
+		d->count = 0;
+	}
+
+	if (!telemetry_log_ready || !(xEventGroupGetBits(conn_events) & CONN_BIT_BROKER)) {
+		return;
+	}
+	if (d->count == 0) {
+		d->count = drain_load_record();
+		d->sent = 0;
+	}
+	while ((d->sent < d->count) && (d->inflight < TLOG_DRAIN_INFLIGHT)) {
+		batch_init(&replay_batch, BATCH_MAX_SAMPLES, 0, DEFAULT_BATCH_MAX_PAYLOAD, wire_cfg, pack_sample_items);
+		for (int i = d->sent; i < d->count; i++) {
+			batch_add(&replay_batch, &replay_samples[i], 0);
+		}
+		int len = batch_pack(&replay_batch, payload, sizeof(payload), &packed);
+		if (len < 0) {
+			d->sent++; // can not be packed, skip it
+			continue;
+		}
+		mqtt_pub_handle_t pub = mqtt_publish_iotera_async(payload, len, PUB_TIMEOUT_MS, NULL, NULL);
+		if (pub == 0) {
+			return; // window full or link lost, go on from here next time
+		}
+		d->handles[d->inflight++] = pub;
+		d->sent += packed;
+	}
+}
+
+/*
+ * Collect finished async publishes, samples of a failed or timed out
+ * publish are moved to the offline log.
+ */
+void reap_publishes(void)
+{
+	for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+		pending_pub_t* p = &pending_pubs[i];
+		if (p->handle == 0) {
+			continue;
+		}
+		mqtt_pub_status_t st = mqtt_pub_status(p->handle);
+		if (st == MQTT_PUB_PENDING) {
+			continue;
+		}
+		if (st != MQTT_PUB_DONE) {
+			printf("publish not acked (%d), storing %d sample(s)\r\n", st, p->count);
+			store_samples(p->samples, p->count);
+		}
+		mqtt_pub_release(p->handle);
+		p->handle = 0;
+	}
+}
 
-    pack_data();
-    vTaskDelay(pdMS_TO_TICKS(1000));
+static pending_pub_t* pending_pub_slot(void)
+{
+	for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+		if (pending_pubs[i].handle == 0) {
+			return &pending_pubs[i];
+		}
+	}
+	return NULL;
 }
 
 void send_sensor_data_regular_mode(void)
 {
-	int mqtt_stat = -1;
-	int mqtt_pub_stat = -1;
+	EventBits_t conn_bits = xEventGroupGetBits(conn_events);
+	mqtt_pub_handle_t pub;
+	pending_pub_t* pending;
+	int packed = 0;
+
+	reap_publishes();
+
+	// wait until the batch is full or old enough
+	if (!batch_due(&sample_batch, esp_timer_get_time())) {
+		return;
+	}
 	// check wifi
-	if (wifi_global_stat != 0)
+	if (conn_bits & CONN_BIT_IP)
 	{
 		printf("wifi connected\r\n");
-		mqtt_stat = mqtt_conn_stat(); // check mqtt connection first
-		if (mqtt_stat == ESP_OK){
+		// reconnects are left to the supervisor, only check the state here
+		if (conn_bits & CONN_BIT_BROKER){
 			printf("connected to mqtt server\r\n");
-			mqtt_pub_stat = mqtt_publish_iotera(payload); // try to publish to iotera server
-			if ((mqtt_pub_stat != 0)||(mqtt_pub_stat != -1)){
-				printf("publish succeed:%d\r\n",mqtt_pub_stat);
+			pending = pending_pub_slot();
+			if (pending == NULL) {
+				// every in-flight slot waits for a PUBACK, do not block the sampler
+				printf("publish window full\r\n");
+				store_batch_data(sample_batch.count);
+				return;
+			}
+			int64_t pack_start = esp_timer_get_time();
+			payload_len = batch_pack(&sample_batch, payload, sizeof(payload), &packed);
+			metric_observe(&metrics, diag_pack_us, (uint32_t) (esp_timer_get_time() - pack_start));
+			if (payload_len < 0) {
+				printf("payload too large\r\n");
+				store_batch_data(1);
+				return;
+			}
+			pub = mqtt_publish_iotera_async(payload, payload_len, PUB_TIMEOUT_MS, NULL, NULL); // try to publish to iotera server
+			if (pub != 0){
+				metric_observe(&metrics, diag_payload_bytes, payload_len);
+				printf("publish queued, %d sample(s), %d bytes\r\n",packed,payload_len);
+				memcpy(pending->samples, sample_batch.samples, packed * sizeof(sample_t));
+				pending->count = packed;
+				pending->handle = pub;
+				batch_drop(&sample_batch, packed);
 			}
 			else{
-				printf("publish failed:%d\r\n",mqtt_pub_stat);
+				printf("publish rejected\r\n");
+				store_batch_data(packed);
 			}
 		}
 		else{
 			printf("disconnected to mqtt server\r\n");
+			store_batch_data(sample_batch.count);
 		}
 
 	}
 	else {
 		printf("wifi disconnected\r\n");
+		store_batch_data(sample_batch.count);
 	}
 }
 
 /*
  * regular mode:
  * sampling data: every 1 minute
- * direct sending data every sampling
+ * sending data when the batch is due (every sampling with DEFAULT_BATCH_SAMPLES 1)
+ * with DEFAULT_RBE_MODE only samples with a significant change are batched,
+ * at least one every RBE_HEARTBEAT_MS
  * not using deepsleep
  *
+ * jobs run at fixed deadlines, publish latency does not shift the sampling
  */
-void regular_mode (void *arg)
+#define SAMPLE_PERIOD_MS    60000
+#define PUBLISH_OFFSET_MS   1000    // publish 1 s after sampling
+#define HEALTH_PERIOD_MS    600000
+#define METRICS_PERIOD_MS   300000
+#define METRICS_OFFSET_MS   2000
+#define METRICS_CALIBRATE_N 1000
+#define DIAG_PAYLOAD_MAX    768
+
+static char diag_payload[DIAG_PAYLOAD_MAX];
+
+static void metrics_setup(void)
 {
-	init_regular_mode();
+	metrics_init(&metrics);
+	diag_heap_free = metric_register(&metrics, "heap_free", METRIC_GAUGE);
+	diag_heap_min = metric_register(&metrics, "heap_min", METRIC_GAUGE);
+	diag_heap_largest = metric_register(&metrics, "heap_largest", METRIC_GAUGE);
+	diag_stack_gpio = metric_register(&metrics, "stack_gpio", METRIC_GAUGE);
+	diag_stack_regular = metric_register(&metrics, "stack_regular", METRIC_GAUGE);
+	diag_edge_ring_max = metric_register(&metrics, "edge_ring_max", METRIC_GAUGE);
+	diag_edges_dropped = metric_register(&metrics, "edges_dropped", METRIC_GAUGE);
+	diag_wifi_drops = metric_register(&metrics, "wifi_drops", METRIC_COUNTER);
+	diag_mqtt_connects = metric_register(&metrics, "mqtt_connects", METRIC_COUNTER);
+	diag_mqtt_drops = metric_register(&metrics, "mqtt_drops", METRIC_COUNTER);
+	diag_pub_acked = metric_register(&metrics, "pub_acked", METRIC_GAUGE);
+	diag_pub_timeouts = metric_register(&metrics, "pub_timeouts", METRIC_GAUGE);
+	diag_pub_lat_max = metric_register(&metrics, "pub_lat_max_ms", METRIC_GAUGE);
+	diag_pack_us = metric_register(&metrics, "pack_us", METRIC_HIST);
+	diag_payload_bytes = metric_register(&metrics, "payload_bytes", METRIC_HIST);
+	diag_update_ns = metric_register(&metrics, "update_ns", METRIC_GAUGE);
+	diag_rbe_suppressed = metric_register(&metrics, "rbe_suppressed", METRIC_COUNTER);
 
-	while(1)
-	{
-		get_sensor_data_regular_mode();
-		send_sensor_data_regular_mode();
-		vTaskDelay(pdMS_TO_TICKS(1000));
-		printf("regular mode, adaptor OK\r\n");
+	// cost of one hot path update, measured on the gauge it is stored in
+	int64_t t0 = esp_timer_get_time();
+	for (int i = 0; i < METRICS_CALIBRATE_N; i++) {
+		metric_inc(&metrics, diag_update_ns, 1);
+	}
+	int64_t elapsed = esp_timer_get_time() - t0;
+	metric_set(&metrics, diag_update_ns, (uint32_t) (elapsed * 1000 / METRICS_CALIBRATE_N));
+}
 
-		vTaskDelay(pdMS_TO_TICKS(60000));
+static void metrics_job(void* arg)
+{
+	mqtt_pub_stats_t st;
+	json_writer_t w;
+
+	// gauges sampled here, counters and histograms are updated where they happen
+	metric_set(&metrics, diag_heap_free, esp_get_free_heap_size());
+	metric_set(&metrics, diag_heap_min, esp_get_minimum_free_heap_size());
+	metric_set(&metrics, diag_heap_largest, heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+	if (gpio_task_handle != NULL) {
+		metric_set(&metrics, diag_stack_gpio, uxTaskGetStackHighWaterMark(gpio_task_handle));
+	}
+	metric_set(&metrics, diag_stack_regular, uxTaskGetStackHighWaterMark(NULL));
+	mqtt_pub_get_stats(&st);
+	metric_set(&metrics, diag_pub_acked, st.acked);
+	metric_set(&metrics, diag_pub_timeouts, st.timeouts);
+	metric_set(&metrics, diag_pub_lat_max, st.lat_max_ms);
+
+	if (!(xEventGroupGetBits(conn_events) & CONN_BIT_BROKER)) {
+		return;
+	}
+	json_init(&w, diag_payload, sizeof(diag_payload));
+	metrics_pack(&metrics, &w);
+	int len = json_finish(&w);
+	if (len > 0) {
+		mqtt_publish_diag(diag_payload, len);
 	}
 }
 
+// arg is the job itself, its deadline has not been advanced yet
+static void sample_job(void* arg)
+{
+	const sched_job_t* job = (const sched_job_t*) arg;
+
+	if (acq_request(ACQ_REQ_SNAPSHOT) != 0) {
+		printf("no counters from the gpio task\r\n");
+	}
+	// a suppressed sample leaves the pulse window open until the next report
+	if (get_sensor_data_regular_mode(job->next_us / 1000) && (acq_request(ACQ_REQ_WINDOW) == 0)) {
+		send_pulse_summary();
+	}
+}
+
+static void publish_job(void* arg)
+{
+	send_sensor_data_regular_mode();
+}
+
+static void drain_job(void* arg)
+{
+	drain_stored_data();
+}
+
+static void health_job(void* arg)
+{
+	printf("regular mode, adaptor OK\r\n");
+	sched_print_stats((const sched_t*) arg);
+	mqtt_pub_print_stats();
+}
+
+static sched_t regular_sched;
+static sched_job_t regular_jobs[] = {
+	{ .name = "sample", .fn = sample_job, .arg = &regular_jobs[0], .period_ms = SAMPLE_PERIOD_MS,
+	  .offset_ms = 0, .policy = SCHED_CATCH_UP },
+	{ .name = "publish", .fn = publish_job, .period_ms = SAMPLE_PERIOD_MS,
+	  .offset_ms = PUBLISH_OFFSET_MS, .policy = SCHED_SKIP },
+	{ .name = "drain", .fn = drain_job, .period_ms = TLOG_DRAIN_PERIOD_MS,
+	  .offset_ms = PUBLISH_OFFSET_MS, .policy = SCHED_SKIP },
+	{ .name = "health", .fn = health_job, .arg = &regular_sched, .period_ms = HEALTH_PERIOD_MS,
+	  .offset_ms = HEALTH_PERIOD_MS, .policy = SCHED_SKIP },
+	{ .name = "metrics", .fn = metrics_job, .period_ms = METRICS_PERIOD_MS,
+	  .offset_ms = METRICS_OFFSET_MS, .policy = SCHED_SKIP },
+};
+
+void regular_mode (void *arg)
+{
+	init_regular_mode();
+
+	sched_init_default(&regular_sched, regular_jobs, sizeof(regular_jobs) / sizeof(regular_jobs[0]));
+	sched_run(&regular_sched);
+}
+
 // END OF MQTT & SENDING DATA
 
 // START OF READ GPIO
@@ -236,34 +1268,553 @@ void regular_mode (void *arg)
 #define GPIO_INPUT_IO_0     4
 #define GPIO_INPUT_IO_1     5
 #define GPIO_INPUT_PIN_SEL  ((1ULL<<GPIO_INPUT_IO_0) | (1ULL<<GPIO_INPUT_IO_1))
-#define ESP_INTR_FLAG_DEFAULT 0
 
-static xQueueHandle gpio_evt_queue = NULL;
+#define PULSE_DRAIN_PERIOD_MS 100
 
-static void IRAM_ATTR gpio_isr_handler(void* arg)
-{
-    uint32_t gpio_num = (uint32_t) arg;
-    xQueueSendFromISR(gpio_evt_queue, &gpio_num, NULL);
-}
+// GPIO4 counts both edges, GPIO5 rising edge only
+#define GPIO_TASK_STACK         3072
+#define GPIO_TASK_STACK_MARGIN  512     // warn when fewer bytes than this were never used
+
+static const pulse_counter_pin_t pulse_pins[PULSE_COUNTER_CHANNELS] = {
+    { .gpio_num = GPIO_INPUT_IO_0, .both_edges = 1 },
+    { .gpio_num = GPIO_INPUT_IO_1, .both_edges = 0 },
+};
 
+/*
+ * The pulse counter is set up from this task, so its ISR is allocated on
+ * the acquisition core and shares it only with this consumer.
+ */
 static void gpio_task_example(void* arg)
 {
-    uint32_t io_num;
+    // drain buffer kept off the task stack, only this task touches it
+    static uint32_t edges[PULSE_CAPTURE_RING_SIZE];
+    uint32_t dropped[PULSE_CAPTURE_CHANNELS] = {0};
+    UBaseType_t stack_low = GPIO_TASK_STACK;
+
+    //count pulses on GPIO4/5 with PCNT, or GPIO isr as fallback
+    ESP_ERROR_CHECK(pulse_counter_init(DEFAULT_PULSE_BACKEND, pulse_pins, PULSE_COUNTER_CHANNELS));
+
+    pulse_capture_set_consumer(xTaskGetCurrentTaskHandle());
     for(;;) {
-        if(xQueueReceive(gpio_evt_queue, &io_num, portMAX_DELAY)) {
-            printf("GPIO[%d] intr, val: %d\n", io_num, gpio_get_level(io_num));
-            if (io_num == 4) {
-                pulse1++;
-            } else if (io_num == 5) {
-                pulse2++;                
+        // woken by the ISR at half ring, by a request, or periodically to flush a partial batch
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PULSE_DRAIN_PERIOD_MS));
+
+        if (pulse_counter_backend() == PULSE_COUNTER_BACKEND_ISR) {
+            uint32_t drops = 0;
+            for (int ch = 0; ch < PULSE_CAPTURE_CHANNELS; ch++) {
+                // free ring slots for the ISR
+                size_t n = pulse_capture_drain(ch, edges, PULSE_CAPTURE_RING_SIZE);
+                metric_max(&metrics, diag_edge_ring_max, n);
+                pulse_stats_add(&pulse_stats[ch], edges, n);
+                // read after the drain: every edge lost so far is newer than this batch
+                uint32_t drop = pulse_capture_dropped(ch);
+                if (drop != dropped[ch]) {
+                    printf("GPIO[%d] edge ring overflow, dropped: %d\n", pulse_pins[ch].gpio_num, drop);
+                    pulse_stats_gap(&pulse_stats[ch]);
+                    dropped[ch] = drop;
+                }
+                drops += drop;
             }
+            metric_set(&metrics, diag_edges_dropped, drops);
+        }
+        for (int ch = 0; ch < PULSE_COUNTER_CHANNELS; ch++) {
+            pulse_total[ch] = pulse_counter_get(ch);
+        }
+        acq_serve();
 
+        UBaseType_t stack_left = uxTaskGetStackHighWaterMark(NULL);
+        if ((stack_left < GPIO_TASK_STACK_MARGIN) && (stack_left < stack_low)) {
+            printf("gpio task stack low: %d bytes left\n", stack_left);
         }
+        stack_low = stack_left;
     }
 }
 
 // END OF READ GPIO
 
+// START OF LOW POWER MODE
+
+#define LP_BURST_SAMPLES        15      // report every 15 samples
+#define LP_PULSE_THRESHOLD      1000    // or after 1000 CH1 edges
+#define LP_CONNECT_TIMEOUT_MS   10000
+#define LP_ACK_TIMEOUT_MS       5000    // wait for PUBACK before the radio goes off
+#define LP_ULP_POLL_US          1000    // CH1 pulses must last longer than this in deep sleep
+
+static RTC_DATA_ATTR lp_rtc_state_t lp_rtc;
+static batch_t lp_burst;
+
+static int64_t lp_now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static lp_wake_t lp_wake_cause(void)
+{
+    switch (esp_sleep_get_wakeup_cause()) {
+        case ESP_SLEEP_WAKEUP_TIMER:
+            return LP_WAKE_TIMER;
+        case ESP_SLEEP_WAKEUP_ULP:
+            return LP_WAKE_PULSE;
+        default:
+            return LP_WAKE_POWERON;
+    }
+}
+
+static uint32_t lp_pulse_edges(void)
+{
+    return ulp_pulse_take();
+}
+
+static void lp_take_sample(sample_t* s, const lp_rtc_state_t* rtc)
+{
+    s->timestamp = (uint32_t) time(NULL);
+    s->battery = battery_read();
+    s->pulse1 = rtc->pulse1;
+    s->pulse2 = SAMPLE_NOT_MEASURED; // GPIO5 is not an RTC GPIO, nothing counts it in deep sleep
+}
+
+static int lp_report(const sample_t* samples, int count)
+{
+    mqtt_pub_handle_t handles[MQTT_INFLIGHT_MAX];
+    int burst_len[MQTT_INFLIGHT_MAX];
+    int bursts = 0;
+    int queued = 0;
+    int acked_upto = 0;
+    int sent = 0;
+    int packed = 0;
+    int64_t start = esp_timer_get_time();
+    EventBits_t bits;
+
+    fast_scan();
+    mqtt_init(mqtt_url,mqtt_port,mqtt_username,mqtt_password);
+    bits = xEventGroupWaitBits(conn_events, CONN_BIT_BROKER, pdFALSE, pdTRUE, pdMS_TO_TICKS(LP_CONNECT_TIMEOUT_MS));
+    if (!(bits & CONN_BIT_BROKER)) {
+        int waited = (int) ((esp_timer_get_time() - start) / 1000);
+        printf("low power: no connection after %d ms\r\n", waited);
+        if (wifi_use_cache && DEFAULT_STATIC_IP) {
+            // the reused lease may be stale, take a fresh one next wake
+            wifi_cache_invalidate();
+        }
+        esp_wifi_stop();
+        return 0;
+    }
+
+    // publish the held samples as few envelopes as possible, all in flight at once
+    batch_init(&lp_burst, BATCH_MAX_SAMPLES, 0, DEFAULT_BATCH_MAX_PAYLOAD, wire_cfg, pack_sample_items);
+    while ((queued < count) && (bursts < MQTT_INFLIGHT_MAX)) {
+        batch_drop(&lp_burst, lp_burst.count);
+        for (int i = queued; (i < count) && (lp_burst.count < BATCH_MAX_SAMPLES); i++) {
+            batch_add(&lp_burst, &samples[i], 0);
+        }
+        payload_len = batch_pack(&lp_burst, payload, sizeof(payload), &packed);
+        if (payload_len < 0) {
+            break;
+        }
+        handles[bursts] = mqtt_publish_iotera_async(payload, payload_len, LP_ACK_TIMEOUT_MS, NULL, NULL);
+        if (handles[bursts] == 0) {
+            break;
+        }
+        burst_len[bursts++] = packed;
+        queued += packed;
+    }
+
+    // only samples up to the first unacked burst count as sent
+    for (int i = 0; i < bursts; i++) {
+        mqtt_pub_status_t st;
+        while ((st = mqtt_pub_status(handles[i])) == MQTT_PUB_PENDING) {
+            vTaskDelay(pdMS_TO_TICKS(50));
+        }
+        mqtt_pub_release(handles[i]);
+        if ((st == MQTT_PUB_DONE) && (sent == acked_upto)) {
+            sent += burst_len[i];
+        }
+        acked_upto += burst_len[i];
+    }
+    printf("low power: sent %d of %d sample(s), time to ip %d ms\r\n", sent, count, wifi_time_to_ip_ms);
+
+    esp_wifi_stop();
+    return sent;
+}
+
+static void lp_deep_sleep(int64_t sleep_us, uint32_t wake_edges)
+{
+    esp_sleep_enable_timer_wakeup((sleep_us > 0) ? sleep_us : 1000);
+    // the ULP keeps counting either way, it only wakes the CPU when armed
+    ulp_pulse_arm(wake_edges);
+    if (wake_edges > 0) {
+        esp_sleep_enable_ulp_wakeup();
+    }
+    esp_deep_sleep_start();
+}
+
+/*
+ * low power mode:
+ * sampling data: every 1 minute, into RTC memory
+ * sending data in a burst every LP_BURST_SAMPLES samples or LP_PULSE_THRESHOLD edges
+ * deepsleep between wakes
+ */
+static void low_power_mode(void)
+{
+    static const lp_config_t lp_cfg = {
+        .sample_period_ms = SAMPLE_PERIOD_MS,
+        .burst_samples = LP_BURST_SAMPLES,
+        .pulse_threshold = LP_PULSE_THRESHOLD,
+    };
+    static const lp_ops_t lp_ops = {
+        .now_us = lp_now_us,
+        .wake_cause = lp_wake_cause,
+        .pulse_edges = lp_pulse_edges,
+        .take_sample = lp_take_sample,
+        .report = lp_report,
+        .deep_sleep = lp_deep_sleep,
+    };
+
+    // CH1 stays an RTC input with pull-up so the ULP can poll it
+    rtc_gpio_init(GPIO_INPUT_IO_0);
+    rtc_gpio_set_direction(GPIO_INPUT_IO_0, RTC_GPIO_MODE_INPUT_ONLY);
+    rtc_gpio_pullup_en(GPIO_INPUT_IO_0);
+    ulp_pulse_start(GPIO_INPUT_IO_0, LP_ULP_POLL_US, lp_wake_cause() == LP_WAKE_POWERON);
+
+    lp_step(&lp_rtc, &lp_cfg, &lp_ops);
+}
+
+// END OF LOW POWER MODE
+
+// START OF BENCH MODE
+
+/*
+ * bench mode:
+ * every stage of the pipeline runs on synthetic input, one CSV row per
+ * stage, then BENCH PASS or BENCH FAIL against bench_baselines.
+ *   capture -> PULSE_CAPTURE_WAKE_FILL edges through the ISR path, then drained
+ *   pack    -> pack_data() of one sample, in each wire format
+ *              (bytes_per_s / msgs_per_s is the size of one sample)
+ *   batch   -> batch_pack() of a full batch
+ *   block   -> sblock_encode() of a full batch, as stored offline
+ *   publish -> QoS1 async publish until its PUBACK (broker receipt)
+ *   acq_*   -> wake-up lateness of a 1 tick periodic task at the gpio task
+ *              priority while a load task keeps the publish queue full:
+ *              acq_pinned on the acquisition core, load on the networking core
+ *              acq_shared with both on the networking core
+ *              (the same core on a single core chip, so the rows match)
+ * publish records nothing (count 0) when the broker can not be reached.
+ * This firmware has no inbound command path; the command -> confirm round
+ * trip of the 7 sketch is a host bench (test/bench_cmd_confirm.c).
+ */
+#define BENCH_PUBLISH_ITERATIONS    32
+#define BENCH_PUBLISH_TIMEOUT_MS    5000
+#define BENCH_CONNECT_TIMEOUT_MS    15000
+#define BENCH_JITTER_PRIO           10      // as gpio_task_example
+#define BENCH_LOAD_PRIO             4
+#define BENCH_LOAD_STACK            4096
+
+// generous first limits, tighten them from the CSV of known good runs.
+// Rates are items per second of the stage: edges, samples, PUBACKs, ticks.
+static const bench_baseline_t bench_baselines[] = {
+	{ "capture", 200, 100000 },
+	{ "pack_json", 500, 2000 },
+	{ "pack_cbor", 500, 2000 },
+	{ "pack_cbor_dict", 500, 2000 },
+	{ "batch", 5000, 2000 },
+	{ "block", 1000, 10000 },
+	{ "publish", 1000000, 2 },
+	{ "acq_pinned", 1000, configTICK_RATE_HZ / 2 },
+	{ "acq_shared", 20000, configTICK_RATE_HZ / 2 },
+};
+#define BENCH_BASELINE_COUNT ((int) (sizeof(bench_baselines) / sizeof(bench_baselines[0])))
+
+static bench_t bench;
+static batch_t bench_batch;
+static volatile uint8_t bench_load_run;
+static TaskHandle_t bench_waiter;
+
+static void bench_sample(sample_t* s, int i)
+{
+	s->timestamp = (uint32_t) time(NULL);
+	s->battery = 3.3f + (float) (i % 100) / 100.0f;
+	s->pulse1 = 1000000ULL + (uint64_t) i * 37;
+	s->pulse2 = 2000000ULL + (uint64_t) i * 11;
+}
+
+static void bench_capture(bench_t* b)
+{
+	static pulse_channel_t ch;
+
+	for (int i = 0; i < BENCH_SAMPLES_MAX; i++) {
+		int64_t t0 = esp_timer_get_time();
+		for (int e = 0; e < PULSE_CAPTURE_WAKE_FILL; e++) {
+			pulse_capture_edge(&ch, (uint32_t) t0 + e);
+		}
+		ch.tail = ch.head; // the consumer drained the batch
+		bench_record(b, (uint32_t) (esp_timer_get_time() - t0), PULSE_CAPTURE_WAKE_FILL,
+				PULSE_CAPTURE_WAKE_FILL * sizeof(uint32_t));
+	}
+}
+
+static void bench_pack(bench_t* b, const wire_config_t* cfg)
+{
+	sample_t s;
+
+	for (int i = 0; i < BENCH_SAMPLES_MAX; i++) {
+		bench_sample(&s, i);
+		int64_t t0 = esp_timer_get_time();
+		int len = pack_data_as(&s, cfg);
+		bench_record(b, (uint32_t) (esp_timer_get_time() - t0), 1, (len > 0) ? len : 0);
+	}
+}
+
+static void bench_pack_json(bench_t* b)
+{
+	bench_pack(b, &wire_json);
+}
+
+static void bench_pack_cbor(bench_t* b)
+{
+	bench_pack(b, &wire_cbor);
+}
+
+static void bench_pack_cbor_dict(bench_t* b)
+{
+	bench_pack(b, &wire_cbor_dict);
+}
+
+static void bench_batch_pack(bench_t* b)
+{
+	sample_t s;
+	int packed = 0;
+
+	batch_init(&bench_batch, BATCH_MAX_SAMPLES, 0, DEFAULT_BATCH_MAX_PAYLOAD, wire_cfg, pack_sample_items);
+	for (int i = 0; i < BATCH_MAX_SAMPLES; i++) {
+		bench_sample(&s, i);
+		batch_add(&bench_batch, &s, 0);
+	}
+	for (int i = 0; i < BENCH_SAMPLES_MAX; i++) {
+		int64_t t0 = esp_timer_get_time();
+		int len = batch_pack(&bench_batch, payload, sizeof(payload), &packed);
+		bench_record(b, (uint32_t) (esp_timer_get_time() - t0), packed, (len > 0) ? len : 0);
+	}
+}
+
+static void bench_block(bench_t* b)
+{
+	sample_t s[BATCH_MAX_SAMPLES];
+
+	// steady field data: fixed period, slow counters, battery mostly flat
+	for (int i = 0; i < BATCH_MAX_SAMPLES; i++) {
+		bench_sample(&s[i], 0);
+		s[i].timestamp += i * (SAMPLE_PERIOD_MS / 1000);
+		s[i].pulse1 += i * 37;
+		s[i].pulse2 += i * 11;
+		s[i].battery -= (float) (i / 4) / 100.0f;
+	}
+	for (int i = 0; i < BENCH_SAMPLES_MAX; i++) {
+		int64_t t0 = esp_timer_get_time();
+		int len = sblock_encode(s, BATCH_MAX_SAMPLES, tlog_record, sizeof(tlog_record));
+		bench_record(b, (uint32_t) (esp_timer_get_time() - t0), BATCH_MAX_SAMPLES, (len > 0) ? len : 0);
+	}
+}
+
+static void bench_publish(bench_t* b)
+{
+	sample_t s;
+	EventBits_t bits;
+
+	bits = xEventGroupWaitBits(conn_events, CONN_BIT_BROKER, pdFALSE, pdTRUE, pdMS_TO_TICKS(BENCH_CONNECT_TIMEOUT_MS));
+	if (!(bits & CONN_BIT_BROKER)) {
+		printf("bench: no broker, publish skipped\r\n");
+		return;
+	}
+	// msgs/s counts from here, not from the wait for the broker
+	bench_begin(b, b->name, esp_timer_get_time());
+
+	for (int i = 0; i < BENCH_PUBLISH_ITERATIONS; i++) {
+		mqtt_pub_status_t st;
+		bench_sample(&s, i);
+		int len = pack_data(&s);
+		int64_t t0 = esp_timer_get_time();
+		mqtt_pub_handle_t h = mqtt_publish_iotera_async(payload, len, BENCH_PUBLISH_TIMEOUT_MS, NULL, NULL);
+		if (h == 0) {
+			continue;
+		}
+		while ((st = mqtt_pub_status(h)) == MQTT_PUB_PENDING) {
+			vTaskDelay(1);
+		}
+		mqtt_pub_release(h);
+		if (st == MQTT_PUB_DONE) {
+			bench_record(b, (uint32_t) (esp_timer_get_time() - t0), 1, len);
+		}
+	}
+}
+
+// pack and queue samples as fast as the publisher takes them
+static void bench_load_task(void* arg)
+{
+	sample_t s;
+
+	for (int i = 0; bench_load_run; i++) {
+		bench_sample(&s, i);
+		int len = pack_data(&s);
+		if ((len <= 0) || (mqtt_publish_iotera_queued(payload, len) < 0)) {
+			vTaskDelay(1); // queue full, lets the idle task feed the watchdog
+		}
+	}
+	vTaskDelete(NULL);
+}
+
+// lateness of each tick against the first wake-up
+static void bench_jitter_task(void* arg)
+{
+	bench_t* b = (bench_t*) arg;
+	int64_t tick_us = (int64_t) portTICK_PERIOD_MS * 1000;
+	TickType_t wake = xTaskGetTickCount();
+
+	vTaskDelayUntil(&wake, 1);
+	int64_t t0 = esp_timer_get_time();
+	for (int i = 1; i <= BENCH_SAMPLES_MAX; i++) {
+		vTaskDelayUntil(&wake, 1);
+		int64_t late = esp_timer_get_time() - (t0 + i * tick_us);
+		bench_record(b, (late > 0) ? (uint32_t) late : 0, 1, 0);
+	}
+	xTaskNotifyGive(bench_waiter);
+	vTaskDelete(NULL);
+}
+
+static void bench_jitter(bench_t* b, int core)
+{
+	const topology_t* t = topology_get();
+
+	bench_waiter = xTaskGetCurrentTaskHandle();
+	bench_load_run = 1;
+	topology_task_create_pinned(t->net_core, bench_load_task, "bench_load", BENCH_LOAD_STACK, NULL,
+			BENCH_LOAD_PRIO, NULL);
+	if (topology_task_create_pinned(core, bench_jitter_task, "bench_jitter", 2048, b,
+			BENCH_JITTER_PRIO, NULL) != ESP_OK) {
+		bench_load_run = 0;
+		return;
+	}
+	ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	bench_load_run = 0;
+	vTaskDelay(pdMS_TO_TICKS(100)); // let the load task exit
+}
+
+static void bench_acq_pinned(bench_t* b)
+{
+	bench_jitter(b, topology_get()->acq_core);
+}
+
+static void bench_acq_shared(bench_t* b)
+{
+	bench_jitter(b, topology_get()->net_core);
+}
+
+static void bench_mode(void)
+{
+	static const struct {
+		const char* name;
+		void (*run)(bench_t* b);
+	} stages[] = {
+		{ "capture", bench_capture },
+		{ "pack_json", bench_pack_json },
+		{ "pack_cbor", bench_pack_cbor },
+		{ "pack_cbor_dict", bench_pack_cbor_dict },
+		{ "batch", bench_batch_pack },
+		{ "block", bench_block },
+		{ "publish", bench_publish },
+		{ "acq_pinned", bench_acq_pinned },
+		{ "acq_shared", bench_acq_shared },
+	};
+	bench_result_t results[sizeof(stages) / sizeof(stages[0])];
+	int failed = 0;
+
+	fast_scan();
+	mqtt_init(mqtt_url,mqtt_port,mqtt_username,mqtt_password);
+
+	for (int i = 0; i < (int) (sizeof(stages) / sizeof(stages[0])); i++) {
+		bench_begin(&bench, stages[i].name, esp_timer_get_time());
+		stages[i].run(&bench);
+		bench_end(&bench, esp_timer_get_time(), &results[i]);
+		results[i].heap_min = esp_get_minimum_free_heap_size();
+	}
+
+	bench_print_csv_header();
+	for (int i = 0; i < (int) (sizeof(stages) / sizeof(stages[0])); i++) {
+		bench_print_csv(&results[i]);
+		if (bench_check(&results[i], bench_baselines, BENCH_BASELINE_COUNT) != 0) {
+			failed++;
+		}
+	}
+	printf("BENCH %s\r\n", failed ? "FAIL" : "PASS");
+}
+
+// END OF BENCH MODE
+
+// START OF PROFILE MODE
+
+/*
+ * profile mode (runs next to the regular mode):
+ * every PROFILE_PERIOD_MS a snapshot of all tasks goes into the profile ring.
+ * Press PROFILE_DUMP_KEY on the console to print the ring as CSV, and every
+ * time the ring has been refilled it is also published on the diag topic.
+ * tools/profile_csv.py turns a captured console log into per task tables.
+ * Needs CONFIG_FREERTOS_USE_TRACE_FACILITY and
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS (+ TASKLIST_INCLUDE_COREID for cores).
+ */
+#define PROFILE_PERIOD_MS       1000
+#define PROFILE_DUMP_KEY        'p'
+#define PROFILE_PUBLISH_GAP_MS  50      // let the publish queue drain
+#define PROFILE_TEXT_MAX        1536    // one snapshot, fits a publish queue slot
+#define PROFILE_STACK           3072
+#define PROFILE_PRIO            3
+
+static profile_t profile;
+static char profile_text[PROFILE_TEXT_MAX];
+
+static void profile_emit_serial(const char* text, int len, void* ctx)
+{
+	printf("%.*s", len, text);
+}
+
+static void profile_emit_mqtt(const char* text, int len, void* ctx)
+{
+	mqtt_publish_diag(text, len);
+	vTaskDelay(pdMS_TO_TICKS(PROFILE_PUBLISH_GAP_MS));
+}
+
+static void profile_task(void* arg)
+{
+	TickType_t last = xTaskGetTickCount();
+	int console = fileno(stdin);
+	char key;
+
+	if (profile_init(&profile, pulse_capture_isr_cycles, DEFAULT_CPU_MHZ) != ESP_OK) {
+		printf("profile mode needs FREERTOS_USE_TRACE_FACILITY and FREERTOS_GENERATE_RUN_TIME_STATS\r\n");
+		vTaskDelete(NULL);
+		return;
+	}
+	// the UART console blocks by default; read() skips stdio's sticky EOF
+	fcntl(console, F_SETFL, fcntl(console, F_GETFL, 0) | O_NONBLOCK);
+
+	for(;;) {
+		vTaskDelayUntil(&last, pdMS_TO_TICKS(PROFILE_PERIOD_MS));
+		if (profile_sample(&profile, (uint32_t) (esp_timer_get_time() / 1000)) != ESP_OK) {
+			printf("profile: more than %d tasks\r\n", PROFILE_TASKS_MAX);
+			continue;
+		}
+		// -1 (EAGAIN) when nothing was typed
+		if ((read(console, &key, 1) == 1) && (key == PROFILE_DUMP_KEY)) {
+			profile_dump(&profile, profile_text, sizeof(profile_text), profile_emit_serial, NULL);
+		}
+		if (((profile.taken % PROFILE_RING) == 0)
+				&& (xEventGroupGetBits(conn_events) & CONN_BIT_BROKER)) {
+			profile_dump(&profile, profile_text, sizeof(profile_text), profile_emit_mqtt, NULL);
+		}
+	}
+}
+
+// END OF PROFILE MODE
+
 void app_main(void)
 {
     // Initialize NVS
@@ -274,11 +1825,21 @@ void app_main(void)
     }
     ESP_ERROR_CHECK( ret );
 
-    fast_scan();
+    // before any task is created
+    topology_setup(DEFAULT_TASK_PINNING);
 
-    // Start sending to Iotera Platform
-    xTaskCreate(regular_mode,"Iotera regular task",4096,NULL,2,NULL);
-	vTaskDelay(pdMS_TO_TICKS(1000));
+    if (DEFAULT_LOW_POWER_MODE) {
+        low_power_mode(); // ends in deep sleep
+    }
+
+    if (DEFAULT_BENCH_MODE) {
+        bench_mode();
+        return;
+    }
+
+    metrics_setup();
+    pulse_stats_setup();
+    fast_scan();
 
     // Start GPIO init
     gpio_config_t io_conf;
@@ -295,8 +1856,8 @@ void app_main(void)
     //configure GPIO with the given settings
     gpio_config(&io_conf);
 
-    //interrupt of rising edge
-    io_conf.intr_type = GPIO_PIN_INTR_POSEDGE;
+    //interrupt is set up by the pulse counter (ISR backend) or not used (PCNT)
+    io_conf.intr_type = GPIO_PIN_INTR_DISABLE;
     //bit mask of the pins, use GPIO4/5 here
     io_conf.pin_bit_mask = GPIO_INPUT_PIN_SEL;
     //set as input mode    
@@ -305,25 +1866,16 @@ void app_main(void)
     io_conf.pull_up_en = 1;
     gpio_config(&io_conf);
 
-    //change gpio intrrupt type for one pin
-    gpio_set_intr_type(GPIO_INPUT_IO_0, GPIO_INTR_ANYEDGE);
-
-    //create a queue to handle gpio event from isr
-    gpio_evt_queue = xQueueCreate(10, sizeof(uint32_t));
-    //start gpio task
-    xTaskCreate(gpio_task_example, "gpio_task_example", 2048, NULL, 10, NULL);
-
-    //install gpio isr service
-    gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
-    //hook isr handler for specific gpio pin
-    gpio_isr_handler_add(GPIO_INPUT_IO_0, gpio_isr_handler, (void*) GPIO_INPUT_IO_0);
-    //hook isr handler for specific gpio pin
-    gpio_isr_handler_add(GPIO_INPUT_IO_1, gpio_isr_handler, (void*) GPIO_INPUT_IO_1);
-
-    //remove isr handler for gpio number.
-    gpio_isr_handler_remove(GPIO_INPUT_IO_0);
-    //hook isr handler for specific gpio pin again
-    gpio_isr_handler_add(GPIO_INPUT_IO_0, gpio_isr_handler, (void*) GPIO_INPUT_IO_0);
+    //start gpio task, it also starts the pulse counter
+    topology_task_create(TOPO_ACQ, gpio_task_example, "gpio_task_example", GPIO_TASK_STACK, NULL, 10, &gpio_task_handle);
+
+    // Start sending to Iotera Platform, its first acquisition request finds the gpio task running
+    topology_task_create(TOPO_NET, regular_mode, "Iotera regular task", 4096, NULL, 2, NULL);
+	vTaskDelay(pdMS_TO_TICKS(1000));
+
+    if (DEFAULT_PROFILE_MODE) {
+        topology_task_create(TOPO_ANY, profile_task, "profile", PROFILE_STACK, NULL, PROFILE_PRIO, NULL);
+    }
 
     int cnt = 0;
 	// main loop
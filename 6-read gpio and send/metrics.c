@@ -0,0 +1,134 @@
+/*
+ * Runtime metrics registry
+ *
+ * metric_register() -> at init only, not thread safe
+ * metric_x()        -> hot path, one atomic per update, unknown ids ignored
+ * metrics_pack()    -> {"name":value,...,"hist":[b0,b1,...]}, histograms
+ *                      trimmed after their last non empty bucket
+ */
+
+#include <string.h>
+
+#include "metrics.h"
+
+#define METRIC_HISTS_MAX    (METRICS_MAX / 4)
+
+void metrics_init(metrics_t* m)
+{
+    memset(m, 0, sizeof(*m));
+}
+
+// return the metric id, METRIC_NONE if the registry (or histogram space) is full
+int metric_register(metrics_t* m, const char* name, metric_type_t type)
+{
+    metric_t* e;
+
+    if (m->count >= METRICS_MAX) {
+        return METRIC_NONE;
+    }
+    if ((type == METRIC_HIST) && (m->hist_count >= METRIC_HISTS_MAX)) {
+        return METRIC_NONE;
+    }
+    e = &m->metrics[m->count];
+    e->name = name;
+    e->type = (uint8_t) type;
+    if (type == METRIC_HIST) {
+        e->hist = m->hist_count++;
+    }
+    return m->count++;
+}
+
+static metric_t* metric_at(metrics_t* m, int id)
+{
+    return ((id < 0) || (id >= m->count)) ? NULL : &m->metrics[id];
+}
+
+void metric_inc(metrics_t* m, int id, uint32_t n)
+{
+    metric_t* e = metric_at(m, id);
+    if (e != NULL) {
+        __atomic_fetch_add(&e->value, n, __ATOMIC_RELAXED);
+    }
+}
+
+void metric_set(metrics_t* m, int id, uint32_t v)
+{
+    metric_t* e = metric_at(m, id);
+    if (e != NULL) {
+        __atomic_store_n(&e->value, v, __ATOMIC_RELAXED);
+    }
+}
+
+void metric_max(metrics_t* m, int id, uint32_t v)
+{
+    metric_t* e = metric_at(m, id);
+    if (e == NULL) {
+        return;
+    }
+    uint32_t cur = __atomic_load_n(&e->value, __ATOMIC_RELAXED);
+    while ((v > cur) && !__atomic_compare_exchange_n(&e->value, &cur, v, 1,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // cur was reloaded, retry while v is still larger
+    }
+}
+
+void metric_observe(metrics_t* m, int id, uint32_t v)
+{
+    metric_t* e = metric_at(m, id);
+    if ((e == NULL) || (e->type != METRIC_HIST)) {
+        return;
+    }
+    int bucket = (v == 0) ? 0 : 32 - __builtin_clz(v);
+    if (bucket >= METRIC_HIST_BUCKETS) {
+        bucket = METRIC_HIST_BUCKETS - 1;
+    }
+    __atomic_fetch_add(&m->hists[e->hist][bucket], 1, __ATOMIC_RELAXED);
+}
+
+uint32_t metric_get(const metrics_t* m, int id)
+{
+    if ((id < 0) || (id >= m->count)) {
+        return 0;
+    }
+    return __atomic_load_n(&m->metrics[id].value, __ATOMIC_RELAXED);
+}
+
+static void metrics_pack_hist(const uint32_t* buckets, json_writer_t* w)
+{
+    uint32_t snap[METRIC_HIST_BUCKETS];
+    int last = 0;
+
+    for (int i = 0; i < METRIC_HIST_BUCKETS; i++) {
+        snap[i] = __atomic_load_n(&buckets[i], __ATOMIC_RELAXED);
+        if (snap[i] != 0) {
+            last = i;
+        }
+    }
+    json_lit(w, "[");
+    for (int i = 0; i <= last; i++) {
+        if (i > 0) {
+            json_lit(w, ",");
+        }
+        json_u64(w, snap[i]);
+    }
+    json_lit(w, "]");
+}
+
+void metrics_pack(const metrics_t* m, json_writer_t* w)
+{
+    json_lit(w, "{");
+    for (int i = 0; i < m->count; i++) {
+        const metric_t* e = &m->metrics[i];
+        if (i > 0) {
+            json_lit(w, ",");
+        }
+        json_str(w, e->name);
+        json_lit(w, ":");
+        if (e->type == METRIC_HIST) {
+            metrics_pack_hist(m->hists[e->hist], w);
+        } else {
+            json_u64(w, __atomic_load_n(&e->value, __ATOMIC_RELAXED));
+        }
+    }
+    json_lit(w, "}");
+}
@@ -0,0 +1,56 @@
+#ifndef __METRICS_H
+#define __METRICS_H
+
+#include <stdint.h>
+
+#include "json_writer.h"
+
+/*
+ * Runtime metrics registry
+ *
+ * Metrics are registered once at init and referred to by id afterwards.
+ *   counter   -> monotonic, metric_inc()
+ *   gauge     -> last value, metric_set(); metric_max() keeps a high-water mark
+ *   histogram -> power of two buckets, metric_observe()
+ *               bucket 0: v < 1, bucket i: 2^(i-1) <= v < 2^i, last: the rest
+ *
+ * Updates are single relaxed atomics on 32 bit words, safe from any task on
+ * either core without a lock (not from ISRs with the flash cache off).
+ * metrics_pack() reads without stopping writers, so one snapshot may mix
+ * values from before and after a concurrent update.
+ */
+
+#define METRICS_MAX         24
+#define METRIC_HIST_BUCKETS 16
+#define METRIC_NONE         (-1)
+
+typedef enum {
+    METRIC_COUNTER = 0,
+    METRIC_GAUGE,
+    METRIC_HIST,
+} metric_type_t;
+
+typedef struct {
+    const char* name;
+    uint8_t type;               // metric_type_t
+    uint8_t hist;               // index in hists, histograms only
+    uint32_t value;             // counter / gauge
+} metric_t;
+
+typedef struct {
+    metric_t metrics[METRICS_MAX];
+    uint32_t hists[METRICS_MAX / 4][METRIC_HIST_BUCKETS];
+    uint8_t count;
+    uint8_t hist_count;
+} metrics_t;
+
+void metrics_init(metrics_t* m);
+int metric_register(metrics_t* m, const char* name, metric_type_t type);
+void metric_inc(metrics_t* m, int id, uint32_t n);
+void metric_set(metrics_t* m, int id, uint32_t v);
+void metric_max(metrics_t* m, int id, uint32_t v);
+void metric_observe(metrics_t* m, int id, uint32_t v);
+uint32_t metric_get(const metrics_t* m, int id);
+void metrics_pack(const metrics_t* m, json_writer_t* w);
+
+#endif
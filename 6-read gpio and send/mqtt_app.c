@@ -1,5 +1,5 @@
 /*
- * MQTT Global stat
+ * MQTT state (mqtt_get_state)
  * 	0 -> mqtt error
  *	1 -> connected
  *	2 -> disconnected
@@ -11,27 +11,247 @@
  *
  *  return message_id of the publish message (for QoS 0 message_id will always be zero) on success.
  *         -1 on failure.
+ *
+ * Threading: the client handle is owned by this module and set once in
+ * mqtt_init(). The state is written by the MQTT task and read with atomic
+ * loads from any task. Publishes from any task go through a lock-free queue
+ * drained by one owner task, which is the only caller of
+ * esp_mqtt_client_publish() outside the MQTT event handler.
+ *
+ * The client is behind mqtt_port.h; the ESP-IDF adapter at the end of the
+ * file is the only code that calls esp_mqtt_client_*() or sees its types.
+ *
+ * Async publish: mqtt_publish_async() never blocks. The handle stays in an
+ * in-flight table until MQTT_EVENT_PUBLISHED brings back its msg_id (PUBACK)
+ * or its deadline passes. The table bounds the number of QoS1 messages in
+ * flight; a full table rejects the publish so the caller can store the data.
  */
 
 
-#include "mqtt_app.h"
+#include <stdio.h>
+#include <string.h>
 
-esp_mqtt_client_handle_t client;
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "mqtt_app.h"
+#include "pub_queue.h"
+#include "topics.h"
+#include "topology.h"
+
+#define MQTT_PUB_TASK_STACK     3072
+#define MQTT_PUB_TASK_PRIO      5
+#define MQTT_EXPIRE_PERIOD_MS   100     // deadline resolution
+#define MQTT_EARLY_ACKS         4
+
+typedef struct {
+    uint8_t used;
+    uint8_t gen;                // bumped on every reuse, part of the handle
+    uint8_t status;             // mqtt_pub_status_t
+    int msg_id;                 // -1 until the owner task has sent it
+    int64_t start_us;
+    int64_t deadline_us;
+    mqtt_pub_cb_t cb;           // NULL -> future, released by the caller
+    void* ctx;
+} mqtt_inflight_t;
+
+typedef struct {
+    mqtt_pub_cb_t cb;
+    void* ctx;
+    mqtt_pub_handle_t handle;
+    mqtt_pub_status_t status;
+} mqtt_completion_t;
+
+static mqtt_transport_t transport;
+static int mqtt_state = MQTT_STATE_ERROR;
+static pubq_t pub_queue;
+static TaskHandle_t pub_task = NULL;
 static const char *TAG = "MQTT_EXAMPLE";
-char mqtt_online_topic[256];
-char mqtt_lastwill_topic[256];
-char mqtt_topic[256];
-int msg_id;
+static topic_table_t topics;
+static int topic_data = TOPIC_NONE;
+static int topic_online = TOPIC_NONE;
+static int topic_offline = TOPIC_NONE;
+static int topic_diag = TOPIC_NONE;
+static mqtt_conn_cb_t conn_cb = NULL;
+
+// in-flight table, shared by producers, the owner task and the MQTT task
+static portMUX_TYPE inflight_lock = portMUX_INITIALIZER_UNLOCKED;
+static mqtt_inflight_t inflight[MQTT_INFLIGHT_MAX];
+static int early_acks[MQTT_EARLY_ACKS];  // PUBACKs seen before the msg_id was recorded
+static int early_ack_next = 0;
+static mqtt_pub_stats_t pub_stats;
+
+static void mqtt_set_state(int state)
+{
+    __atomic_store_n(&mqtt_state, state, __ATOMIC_RELEASE);
+}
+
+int mqtt_get_state(void)
+{
+    return __atomic_load_n(&mqtt_state, __ATOMIC_ACQUIRE);
+}
+
+static int mqtt_is_connected(void)
+{
+    int state = mqtt_get_state();
+    return (state != MQTT_STATE_ERROR) && (state != MQTT_STATE_DISCONNECTED);
+}
+
+static mqtt_pub_handle_t inflight_handle(int idx)
+{
+    return ((mqtt_pub_handle_t) inflight[idx].gen << 8) | (mqtt_pub_handle_t) (idx + 1);
+}
+
+// call with inflight_lock held
+static mqtt_inflight_t* inflight_find(mqtt_pub_handle_t h)
+{
+    int idx = (int) (h & 0xff) - 1;
+
+    if ((idx < 0) || (idx >= MQTT_INFLIGHT_MAX) || !inflight[idx].used
+            || (inflight[idx].gen != (uint8_t) (h >> 8))) {
+        return NULL;
+    }
+    return &inflight[idx];
+}
+
+static void inflight_record_latency(int64_t us)
+{
+    uint32_t ms = (uint32_t) (us / 1000);
+    int bucket = 0;
+
+    while ((bucket < MQTT_LAT_BUCKETS - 1) && (ms >= (1u << bucket))) {
+        bucket++;
+    }
+    pub_stats.lat_hist[bucket]++;
+    if (ms > pub_stats.lat_max_ms) {
+        pub_stats.lat_max_ms = ms;
+    }
+}
+
+/*
+ * Final state for entry idx, call with inflight_lock held.
+ * Entries with a callback are freed here, the callback is returned in done
+ * and must be called after the lock is released.
+ */
+static void inflight_resolve(int idx, mqtt_pub_status_t status, int64_t now, mqtt_completion_t* done)
+{
+    mqtt_inflight_t* e = &inflight[idx];
+
+    e->status = status;
+    switch (status) {
+        case MQTT_PUB_DONE:
+            pub_stats.acked++;
+            inflight_record_latency(now - e->start_us);
+            break;
+        case MQTT_PUB_TIMEOUT:
+            pub_stats.timeouts++;
+            break;
+        default:
+            pub_stats.failed++;
+            break;
+    }
+
+    done->cb = e->cb;
+    done->ctx = e->ctx;
+    done->handle = inflight_handle(idx);
+    done->status = status;
+    if (e->cb != NULL) {
+        e->used = 0;
+    }
+}
+
+static void inflight_complete(const mqtt_completion_t* done, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (done[i].cb != NULL) {
+            done[i].cb(done[i].handle, done[i].status, done[i].ctx);
+        }
+    }
+}
+
+// owner task, after esp_mqtt_client_publish() returned pub_stat
+static void inflight_sent(mqtt_pub_handle_t h, int pub_stat)
+{
+    mqtt_completion_t done;
+    int count = 0;
+
+    portENTER_CRITICAL(&inflight_lock);
+    mqtt_inflight_t* e = inflight_find(h);
+    if ((e != NULL) && (e->status == MQTT_PUB_PENDING)) {
+        if (pub_stat <= 0) {
+            inflight_resolve(e - inflight, MQTT_PUB_FAILED, esp_timer_get_time(), &done);
+            count = 1;
+        } else {
+            e->msg_id = pub_stat;
+            // the MQTT task may have handled the PUBACK before we got here
+            for (int i = 0; i < MQTT_EARLY_ACKS; i++) {
+                if (early_acks[i] == pub_stat) {
+                    early_acks[i] = -1;
+                    inflight_resolve(e - inflight, MQTT_PUB_DONE, esp_timer_get_time(), &done);
+                    count = 1;
+                    break;
+                }
+            }
+        }
+    }
+    portEXIT_CRITICAL(&inflight_lock);
+
+    inflight_complete(&done, count);
+}
+
+// MQTT task, MQTT_EVENT_PUBLISHED
+static void inflight_acked(int id)
+{
+    mqtt_completion_t done;
+    int count = 0;
+
+    portENTER_CRITICAL(&inflight_lock);
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (inflight[i].used && (inflight[i].status == MQTT_PUB_PENDING) && (inflight[i].msg_id == id)) {
+            inflight_resolve(i, MQTT_PUB_DONE, esp_timer_get_time(), &done);
+            count = 1;
+            break;
+        }
+    }
+    if (count == 0) {
+        early_acks[early_ack_next] = id;
+        early_ack_next = (early_ack_next + 1) % MQTT_EARLY_ACKS;
+    }
+    portEXIT_CRITICAL(&inflight_lock);
+
+    inflight_complete(&done, count);
+}
+
+// owner task, every MQTT_EXPIRE_PERIOD_MS
+static void inflight_expire(void)
+{
+    mqtt_completion_t done[MQTT_INFLIGHT_MAX];
+    int64_t now = esp_timer_get_time();
+    int count = 0;
+
+    portENTER_CRITICAL(&inflight_lock);
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (inflight[i].used && (inflight[i].status == MQTT_PUB_PENDING) && (now >= inflight[i].deadline_us)) {
+            inflight_resolve(i, MQTT_PUB_TIMEOUT, now, &done[count]);
+            count++;
+        }
+    }
+    portEXIT_CRITICAL(&inflight_lock);
+
+    inflight_complete(done, count);
+}
 
-static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
+esp_err_t mqtt_app_event(const mqtt_port_event_t* event)
 {
-    client = event->client;
+    int msg_id;
     // your_context_t *context = event->context;
-    switch (event->event_id) {
-        case MQTT_EVENT_CONNECTED:
+    switch (event->id) {
+        case MQTT_PORT_CONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
-            msg_id = esp_mqtt_client_publish(client, mqtt_online_topic, NULL, 0, 1, 0);
-            //ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
+            msg_id = transport.publish(transport.ctx, topic_str(&topics, topic_online), NULL, 0, 1);
+            ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
 
             //msg_id = esp_mqtt_client_subscribe(client, mqtt_topic, 0);
             //ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
@@ -42,38 +262,45 @@ static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
             msg_id = esp_mqtt_client_unsubscribe(client, "/topic/qos1");
             ESP_LOGI(TAG, "sent unsubscribe successful, msg_id=%d", msg_id);
             */
-            mqtt_global_stat = 1;
+            mqtt_set_state(MQTT_STATE_CONNECTED);
+            if (conn_cb != NULL) {
+                conn_cb(1);
+            }
             break;
-        case MQTT_EVENT_DISCONNECTED:
+        case MQTT_PORT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
-            mqtt_global_stat = 2;
+            mqtt_set_state(MQTT_STATE_DISCONNECTED);
+            if (conn_cb != NULL) {
+                conn_cb(0);
+            }
             break;
 
-        case MQTT_EVENT_SUBSCRIBED:
+        case MQTT_PORT_SUBSCRIBED:
             ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
             //msg_id = esp_mqtt_client_publish(client, "/topic/qos0", "data", 0, 0, 0);
             //ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
-            mqtt_global_stat = 3;
+            mqtt_set_state(MQTT_STATE_SUBSCRIBED);
             break;
-        case MQTT_EVENT_UNSUBSCRIBED:
+        case MQTT_PORT_UNSUBSCRIBED:
             ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
-            mqtt_global_stat = 4;
+            mqtt_set_state(MQTT_STATE_UNSUBSCRIBED);
             break;
-        case MQTT_EVENT_PUBLISHED:
+        case MQTT_PORT_PUBLISHED:
             ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
-            mqtt_global_stat = 5;
+            inflight_acked(event->msg_id);
+            mqtt_set_state(MQTT_STATE_PUBLISHED);
             break;
-        case MQTT_EVENT_DATA:
+        case MQTT_PORT_DATA:
             ESP_LOGI(TAG, "MQTT_EVENT_DATA");
             mqtt_data_handling(event);
-            mqtt_global_stat = 6;
+            mqtt_set_state(MQTT_STATE_DATA);
             break;
-        case MQTT_EVENT_ERROR:
+        case MQTT_PORT_ERROR:
             ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
-            mqtt_global_stat = 0;
+            mqtt_set_state(MQTT_STATE_ERROR);
             break;
         default:
-            ESP_LOGI(TAG, "Other event id:%d", event->event_id);
+            ESP_LOGI(TAG, "Other event id:%d", event->raw_id);
             break;
     }
 
@@ -81,42 +308,100 @@ static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
 }
 
 
-static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
-    ESP_LOGD(TAG, "Event dispatched from event loop base=%s, event_id=%d", base, event_id);
-    mqtt_event_handler_cb(event_data);
+/*
+ * Owner task: the only consumer of pub_queue.
+ * Producers wake it with a task notification after committing a slot.
+ */
+static void mqtt_pub_task(void* arg)
+{
+    pubq_slot_t* slot;
+
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MQTT_EXPIRE_PERIOD_MS));
+        while ((slot = pubq_peek(&pub_queue)) != NULL) {
+            int pub_stat = 0;
+            if (mqtt_is_connected()) {
+                pub_stat = transport.publish(transport.ctx, slot->topic, slot->data, slot->len, 1);
+            }
+            if (slot->tag != 0) {
+                inflight_sent(slot->tag, pub_stat);
+            }
+            if (slot->result != NULL) {
+                __atomic_store_n(slot->result, pub_stat, __ATOMIC_RELEASE);
+                xTaskNotifyGive((TaskHandle_t) slot->waiter);
+            }
+            pubq_release(&pub_queue, slot);
+        }
+        inflight_expire();
+    }
 }
 
-
-void mqtt_init(const char* mqtt_server, int mqtt_port, const char* username, const char* pass)
+/*
+ * Copy the message into a queue slot and hand it to the owner task.
+ * With result set the caller sleeps until the owner has published it; this
+ * uses the caller's task notification.
+ */
+static int mqtt_enqueue(const char* topic, const char* payload, int len, int wait, uint32_t tag)
 {
-    ESP_LOGI(TAG, "[APP] Startup..");
-    ESP_LOGI(TAG, "[APP] Free memory: %d bytes", esp_get_free_heap_size());
-    ESP_LOGI(TAG, "[APP] IDF version: %s", esp_get_idf_version());
+    int result = PUBQ_PENDING;
+    pubq_slot_t* slot;
 
-    esp_log_level_set("*", ESP_LOG_INFO);
-    esp_log_level_set("MQTT_CLIENT", ESP_LOG_VERBOSE);
-    esp_log_level_set("MQTT_EXAMPLE", ESP_LOG_VERBOSE);
-    esp_log_level_set("TRANSPORT_TCP", ESP_LOG_VERBOSE);
-    esp_log_level_set("TRANSPORT_SSL", ESP_LOG_VERBOSE);
-    esp_log_level_set("TRANSPORT", ESP_LOG_VERBOSE);
-    esp_log_level_set("OUTBOX", ESP_LOG_VERBOSE);
+    if (len == 0) {
+        len = strlen(payload);
+    }
+    if ((pub_task == NULL) || (len > PUBQ_PAYLOAD_MAX)) {
+        return -1;
+    }
+    slot = pubq_reserve(&pub_queue);
+    if (slot == NULL) {
+        return -1;
+    }
+    slot->topic = topic;
+    slot->len = (uint16_t) len;
+    slot->tag = tag;
+    memcpy(slot->data, payload, len);
+    if (wait) {
+        slot->result = &result;
+        slot->waiter = xTaskGetCurrentTaskHandle();
+    }
+    pubq_commit(&pub_queue, slot);
+    xTaskNotifyGive(pub_task);
 
-    ESP_ERROR_CHECK(nvs_flash_init());
-    ESP_ERROR_CHECK(esp_netif_init());
-    //ESP_ERROR_CHECK(esp_event_loop_create_default());
+    if (!wait) {
+        return 0;
+    }
+    // result lives on this stack, so never return before the owner wrote it
+    while (__atomic_load_n(&result, __ATOMIC_ACQUIRE) == PUBQ_PENDING) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    return result;
+}
 
-    generate_topic(username);// generate topic for iotera platform
-    esp_mqtt_client_config_t mqtt_cfg = {
-    		.uri = mqtt_server,
-    		.port = mqtt_port,
-    		.username = username,
-    		.password = pass,
-            .lwt_topic = mqtt_lastwill_topic
-    };
+/*
+ * Topics, publish queue and owner task on top of any transport.
+ * Publishes are accepted (and queued) before the client connects.
+ */
+esp_err_t mqtt_init_transport(const mqtt_transport_t* t, const char* username)
+{
+    // build the iotera topics once
+    if (topic_table_init(&topics, username) != ESP_OK) {
+        ESP_LOGE(TAG, "invalid iotera username");
+        return ESP_ERR_INVALID_ARG;
+    }
+    topic_data = topic_add(&topics, "pub", "data");
+    topic_online = topic_add(&topics, "pub", "online");
+    topic_offline = topic_add(&topics, "pub", "offline");
+    topic_diag = topic_add(&topics, "pub", "diag");
+    for (int i = 0; i < TOPIC_MAX; i++) {
+        if (topic_str(&topics, i) != NULL) {
+            printf("%s\r\n", topic_str(&topics, i));
+        }
+    }
 
-    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
-    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, client);
-    esp_mqtt_client_start(client);
+    transport = *t;
+    pubq_init(&pub_queue);
+    return topology_task_create(TOPO_NET, mqtt_pub_task, "mqtt_pub_task", MQTT_PUB_TASK_STACK, NULL,
+            MQTT_PUB_TASK_PRIO, &pub_task);
 }
 
 /*
@@ -125,109 +410,329 @@ void mqtt_init(const char* mqtt_server, int mqtt_port, const char* username, con
  *
  *
  */
-int mqtt_publish(const char* topic, char* payload)
+int mqtt_publish(const char* topic, const char* payload, int len)
 {
 	int pub_stat = 0;
-	if ((mqtt_global_stat != 0) && (mqtt_global_stat != 2)){
-		// publish payload
-		pub_stat = esp_mqtt_client_publish(client,topic,payload,0, 1, 0);
+	if (mqtt_is_connected()){
+		// publish payload, len 0 -> strlen(payload)
+		pub_stat = mqtt_enqueue(topic, payload, len, 1, 0);
 	}
 
 	return pub_stat;
 }
 
-int mqtt_publish_iotera(char* payload)
+int mqtt_publish_iotera(const char* payload, int len)
 {
-	int pub_stat = 0;
-	if ((mqtt_global_stat != 0) && (mqtt_global_stat != 2)){
-		// publish payload
-		pub_stat = esp_mqtt_client_publish(client,mqtt_topic,payload,0, 1, 0);
+	return mqtt_publish(topic_str(&topics, topic_data), payload, len);
+}
+
+/*
+ * Fire and forget publish, safe from any task on either core.
+ * Returns 0 when queued, -1 when the queue is full or the payload too large.
+ */
+int mqtt_publish_queued(const char* topic, const char* payload, int len)
+{
+	return mqtt_enqueue(topic, payload, len, 0, 0);
+}
+
+int mqtt_publish_iotera_queued(const char* payload, int len)
+{
+	return mqtt_enqueue(topic_str(&topics, topic_data), payload, len, 0, 0);
+}
+
+/*
+ * Fire and forget publish on the diagnostics topic (metrics), never blocks.
+ */
+int mqtt_publish_diag(const char* payload, int len)
+{
+	if (!mqtt_is_connected()) {
+		return -1;
 	}
+	return mqtt_enqueue(topic_str(&topics, topic_diag), payload, len, 0, 0);
+}
 
-	return pub_stat;
+/*
+ * Non-blocking QoS1 publish with completion tracking.
+ * Returns 0 (not accepted) when offline, when MQTT_INFLIGHT_MAX messages are
+ * already in flight, or when the queue is full. The result comes through cb
+ * (called from the MQTT or the publish task, keep it short), or, with cb
+ * NULL, through mqtt_pub_status() until mqtt_pub_release().
+ */
+mqtt_pub_handle_t mqtt_publish_async(const char* topic, const char* payload, int len,
+		uint32_t timeout_ms, mqtt_pub_cb_t cb, void* ctx)
+{
+	mqtt_pub_handle_t h = 0;
+	int64_t now = esp_timer_get_time();
+
+	if (mqtt_is_connected()){
+		portENTER_CRITICAL(&inflight_lock);
+		for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+			if (!inflight[i].used) {
+				mqtt_inflight_t* e = &inflight[i];
+				e->used = 1;
+				e->gen++;
+				e->status = MQTT_PUB_PENDING;
+				e->msg_id = -1;
+				e->start_us = now;
+				e->deadline_us = now + (int64_t) timeout_ms * 1000;
+				e->cb = cb;
+				e->ctx = ctx;
+				h = inflight_handle(i);
+				break;
+			}
+		}
+		portEXIT_CRITICAL(&inflight_lock);
+	}
+
+	if ((h != 0) && (mqtt_enqueue(topic, payload, len, 0, h) != 0)) {
+		mqtt_pub_release(h);
+		h = 0;
+	}
+
+	portENTER_CRITICAL(&inflight_lock);
+	if (h != 0) {
+		pub_stats.accepted++;
+	}
+	else {
+		pub_stats.rejected++;
+	}
+	portEXIT_CRITICAL(&inflight_lock);
+
+	return h;
+}
+
+mqtt_pub_handle_t mqtt_publish_iotera_async(const char* payload, int len,
+		uint32_t timeout_ms, mqtt_pub_cb_t cb, void* ctx)
+{
+	return mqtt_publish_async(topic_str(&topics, topic_data), payload, len, timeout_ms, cb, ctx);
+}
+
+mqtt_pub_status_t mqtt_pub_status(mqtt_pub_handle_t h)
+{
+	mqtt_pub_status_t status = MQTT_PUB_UNKNOWN;
+
+	portENTER_CRITICAL(&inflight_lock);
+	mqtt_inflight_t* e = inflight_find(h);
+	if (e != NULL) {
+		status = (mqtt_pub_status_t) e->status;
+	}
+	portEXIT_CRITICAL(&inflight_lock);
+
+	return status;
+}
+
+// free a handle published without callback; a pending one is abandoned
+void mqtt_pub_release(mqtt_pub_handle_t h)
+{
+	portENTER_CRITICAL(&inflight_lock);
+	mqtt_inflight_t* e = inflight_find(h);
+	if (e != NULL) {
+		e->used = 0;
+	}
+	portEXIT_CRITICAL(&inflight_lock);
+}
+
+void mqtt_pub_get_stats(mqtt_pub_stats_t* stats)
+{
+	portENTER_CRITICAL(&inflight_lock);
+	*stats = pub_stats;
+	portEXIT_CRITICAL(&inflight_lock);
+}
+
+// publish -> PUBACK latency, bucket i counts latencies below 2^i ms
+void mqtt_pub_print_stats(void)
+{
+	mqtt_pub_stats_t st;
+
+	mqtt_pub_get_stats(&st);
+	printf("publish: accepted:%d rejected:%d acked:%d failed:%d timeout:%d max:%d ms\r\n",
+			st.accepted, st.rejected, st.acked, st.failed, st.timeouts, st.lat_max_ms);
+	for (int i = 0; i < MQTT_LAT_BUCKETS; i++) {
+		if (st.lat_hist[i] == 0) {
+			continue;
+		}
+		if (i < MQTT_LAT_BUCKETS - 1) {
+			printf("  <%5d ms: %d\r\n", 1 << i, st.lat_hist[i]);
+		}
+		else {
+			printf("  >=%4d ms: %d\r\n", 1 << (i - 1), st.lat_hist[i]);
+		}
+	}
 }
 
 
 int mqtt_subscribe(const char* topic)
 {
 	int stat = 0;
-	if ((mqtt_global_stat != 0) && (mqtt_global_stat != 2)) {
+	if (mqtt_is_connected()) {
 		// publish payload
-		stat = esp_mqtt_client_subscribe(client,topic,0);
+		stat = transport.subscribe(transport.ctx, topic, 0);
 	}
 	return stat;
 }
 
+/*
+ * Connection state only, reconnecting is up to the owner of the
+ * reconnect policy (mqtt_reconnect), so polling can not cause a retry storm.
+ */
 int mqtt_conn_stat(void)
 {
-	int stat;
-	esp_err_t status = ESP_OK;
-	if (mqtt_global_stat == 2){
-		status = esp_mqtt_client_reconnect(client);
+	return mqtt_is_connected() ? 0 : -1;
+}
+
+esp_err_t mqtt_reconnect(void)
+{
+	if (transport.reconnect == NULL){
+		return ESP_ERR_INVALID_STATE;
 	}
-	if(status == ESP_OK){
-		stat = 0;
-		//printf("connected to server\r\n");
+	return transport.reconnect(transport.ctx);
+}
+
+/*
+ * Drop the session, e.g. when the link under it is gone: the client would
+ * otherwise report a connection until its keepalive times out.
+ */
+esp_err_t mqtt_disconnect(void)
+{
+	if (transport.disconnect == NULL){
+		return ESP_ERR_INVALID_STATE;
 	}
-	else {
-		//printf("disconnected from server\r\n");
-		stat = -1;}
+	return transport.disconnect(transport.ctx);
+}
 
-	return stat;
+// called from the MQTT task with 1 on connect, 0 on disconnect
+void mqtt_set_conn_cb(mqtt_conn_cb_t cb)
+{
+	conn_cb = cb;
 }
 
-void mqtt_data_handling(esp_mqtt_event_handle_t data_event)
+void mqtt_data_handling(const mqtt_port_event_t* data_event)
 {
     printf("TOPIC=%.*s\r\n", data_event->topic_len, data_event->topic);
     printf("DATA=%.*s\r\n", data_event->data_len, data_event->data);
 }
 
-void generate_topic(const char* username)
+#ifdef ESP_PLATFORM
+#include "esp_system.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "nvs_flash.h"
+#include "mqtt_client.h"
+
+static esp_mqtt_client_handle_t client = NULL;
+
+static int esp_transport_publish(void* ctx, const char* topic, const char* data, int len, int qos)
+{
+    return esp_mqtt_client_publish(*(esp_mqtt_client_handle_t*) ctx, topic, data, len, qos, 0);
+}
+
+static int esp_transport_subscribe(void* ctx, const char* topic, int qos)
 {
-	int len = 0;
-	int counter = 0;
-	int i = 0;
-	char tmp1[64];
-	char tmp2[128];
+    return esp_mqtt_client_subscribe(*(esp_mqtt_client_handle_t*) ctx, topic, qos);
+}
 
-	bzero(tmp1,sizeof(tmp1));
-	bzero(tmp2,sizeof(tmp2));
+static esp_err_t esp_transport_reconnect(void* ctx)
+{
+    esp_mqtt_client_handle_t c = *(esp_mqtt_client_handle_t*) ctx;
 
-	len = strlen(username);
-	printf("username len = %d\r\n",len);
+    if (c == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_mqtt_client_reconnect(c);
+}
 
-	while(*username != '_'){
-		username++;
-		counter++;
-	}
-	username++;
-	counter++;
-	while(*username != '_'){
-		tmp1[i] = *username;
-		username++;
-		counter++;
-		i++;
-	}
-	//printf("data tmp1: %s\r\n",tmp1);
-	username++;
-	counter++;
-	i = 0;
-	while(counter<len){
-		tmp2[i] = *username;
-		username++;
-		counter++;
-		i++;
-	}
-	//printf("data tmp2: %s\r\n",tmp2);
+static esp_err_t esp_transport_disconnect(void* ctx)
+{
+    esp_mqtt_client_handle_t c = *(esp_mqtt_client_handle_t*) ctx;
+
+    if (c == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_mqtt_client_disconnect(c);
+}
 
-	sprintf(mqtt_topic,"iotera/pub/%s/%s/data",tmp1,tmp2);
-    sprintf(mqtt_online_topic,"iotera/pub/%s/%s/online",tmp1,tmp2);
-    sprintf(mqtt_lastwill_topic,"iotera/pub/%s/%s/offline",tmp1,tmp2);
+static mqtt_port_event_id_t esp_event_port_id(esp_mqtt_event_id_t id)
+{
+    switch (id) {
+        case MQTT_EVENT_ERROR:
+            return MQTT_PORT_ERROR;
+        case MQTT_EVENT_CONNECTED:
+            return MQTT_PORT_CONNECTED;
+        case MQTT_EVENT_DISCONNECTED:
+            return MQTT_PORT_DISCONNECTED;
+        case MQTT_EVENT_SUBSCRIBED:
+            return MQTT_PORT_SUBSCRIBED;
+        case MQTT_EVENT_UNSUBSCRIBED:
+            return MQTT_PORT_UNSUBSCRIBED;
+        case MQTT_EVENT_PUBLISHED:
+            return MQTT_PORT_PUBLISHED;
+        case MQTT_EVENT_DATA:
+            return MQTT_PORT_DATA;
+        default:
+            return MQTT_PORT_OTHER;
+    }
+}
 
-	printf("%s\r\n",mqtt_topic);
-	printf("%s\r\n",mqtt_online_topic);
-	printf("%s\r\n",mqtt_lastwill_topic);
+static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
+    esp_mqtt_event_handle_t e = event_data;
+    mqtt_port_event_t event = {
+        .id = esp_event_port_id(e->event_id),
+        .raw_id = e->event_id,
+        .msg_id = e->msg_id,
+        .topic = e->topic,
+        .topic_len = e->topic_len,
+        .data = e->data,
+        .data_len = e->data_len,
+        .total_data_len = e->total_data_len,
+        .current_data_offset = e->current_data_offset,
+    };
 
+    ESP_LOGD(TAG, "Event dispatched from event loop base=%s, event_id=%d", base, event_id);
+    mqtt_app_event(&event);
 }
 
+void mqtt_init(const char* mqtt_server, int mqtt_port, const char* username, const char* pass)
+{
+    ESP_LOGI(TAG, "[APP] Startup..");
+    ESP_LOGI(TAG, "[APP] Free memory: %d bytes", esp_get_free_heap_size());
+    ESP_LOGI(TAG, "[APP] IDF version: %s", esp_get_idf_version());
 
+    esp_log_level_set("*", ESP_LOG_INFO);
+    esp_log_level_set("MQTT_CLIENT", ESP_LOG_VERBOSE);
+    esp_log_level_set("MQTT_EXAMPLE", ESP_LOG_VERBOSE);
+    esp_log_level_set("TRANSPORT_TCP", ESP_LOG_VERBOSE);
+    esp_log_level_set("TRANSPORT_SSL", ESP_LOG_VERBOSE);
+    esp_log_level_set("TRANSPORT", ESP_LOG_VERBOSE);
+    esp_log_level_set("OUTBOX", ESP_LOG_VERBOSE);
+
+    ESP_ERROR_CHECK(nvs_flash_init());
+    ESP_ERROR_CHECK(esp_netif_init());
+    //ESP_ERROR_CHECK(esp_event_loop_create_default());
+
+    // ctx points at the handle: the owner task starts before the client exists
+    const mqtt_transport_t esp_transport = {
+        .publish = esp_transport_publish,
+        .subscribe = esp_transport_subscribe,
+        .reconnect = esp_transport_reconnect,
+        .disconnect = esp_transport_disconnect,
+        .ctx = &client,
+    };
+    if (mqtt_init_transport(&esp_transport, username) != ESP_OK) {
+        return;
+    }
+
+    esp_mqtt_client_config_t mqtt_cfg = {
+    		.uri = mqtt_server,
+    		.port = mqtt_port,
+    		.username = username,
+    		.password = pass,
+            .lwt_topic = topic_str(&topics, topic_offline),
+            // reconnects are paced by the caller through mqtt_reconnect()
+            .disable_auto_reconnect = true
+    };
+
+    client = esp_mqtt_client_init(&mqtt_cfg);
+    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, client);
+    esp_mqtt_client_start(client);
+}
+#endif
@@ -1,36 +1,84 @@
 #ifndef __MQTT_APP_H
 #define __MQTT_APP_H
 
-#include <stdio.h>
 #include <stdint.h>
 #include <stddef.h>
-#include <string.h>
-#include "esp_wifi.h"
-#include "esp_system.h"
-#include "nvs_flash.h"
-#include "esp_event.h"
-#include "esp_netif.h"
-
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "freertos/semphr.h"
-#include "freertos/queue.h"
-
-#include "lwip/sockets.h"
-#include "lwip/dns.h"
-#include "lwip/netdb.h"
-
-#include "esp_log.h"
-#include "mqtt_client.h"
-//#include "http_parser.h"
-
-int mqtt_global_stat;
+#include "esp_err.h"
+#include "mqtt_port.h"
+
+/*
+ * The module only reaches the MQTT client through mqtt_transport_t and is
+ * fed events through mqtt_app_event() (both in mqtt_port.h), so the publish
+ * pipeline (queue, owner task, in-flight table, topics, command handling)
+ * also builds off target against a FreeRTOS/esp_timer shim and any client
+ * that provides these ops. mqtt_init() wires in the ESP-IDF client.
+ */
+
+typedef void (*mqtt_conn_cb_t)(int connected);
+
+typedef enum {
+    MQTT_STATE_ERROR = 0,
+    MQTT_STATE_CONNECTED,
+    MQTT_STATE_DISCONNECTED,
+    MQTT_STATE_SUBSCRIBED,
+    MQTT_STATE_UNSUBSCRIBED,
+    MQTT_STATE_PUBLISHED,
+    MQTT_STATE_DATA,
+} mqtt_state_t;
+
+int mqtt_get_state(void);
+
+/*
+ * Async publish with completion tracking
+ */
+#define MQTT_INFLIGHT_MAX   4       // QoS1 messages waiting for PUBACK
+#define MQTT_LAT_BUCKETS    14      // <1, <2, <4 ... <4096 ms, >=4096 ms
+
+typedef uint32_t mqtt_pub_handle_t;     // 0 -> not accepted
+
+typedef enum {
+    MQTT_PUB_PENDING = 0,   // queued or waiting for PUBACK
+    MQTT_PUB_DONE,          // PUBACK received
+    MQTT_PUB_FAILED,        // client refused it (offline, outbox full)
+    MQTT_PUB_TIMEOUT,       // no PUBACK before the deadline
+    MQTT_PUB_UNKNOWN,       // released or invalid handle
+} mqtt_pub_status_t;
+
+typedef void (*mqtt_pub_cb_t)(mqtt_pub_handle_t h, mqtt_pub_status_t status, void* ctx);
+
+typedef struct {
+    uint32_t accepted;
+    uint32_t rejected;
+    uint32_t acked;
+    uint32_t failed;
+    uint32_t timeouts;
+    uint32_t lat_max_ms;
+    uint32_t lat_hist[MQTT_LAT_BUCKETS];
+} mqtt_pub_stats_t;
+
+mqtt_pub_handle_t mqtt_publish_async(const char* topic, const char* payload, int len,
+        uint32_t timeout_ms, mqtt_pub_cb_t cb, void* ctx);
+mqtt_pub_handle_t mqtt_publish_iotera_async(const char* payload, int len,
+        uint32_t timeout_ms, mqtt_pub_cb_t cb, void* ctx);
+mqtt_pub_status_t mqtt_pub_status(mqtt_pub_handle_t h);
+void mqtt_pub_release(mqtt_pub_handle_t h);
+void mqtt_pub_get_stats(mqtt_pub_stats_t* stats);
+void mqtt_pub_print_stats(void);
+esp_err_t mqtt_init_transport(const mqtt_transport_t* transport, const char* username);
+esp_err_t mqtt_app_event(const mqtt_port_event_t* event);
+#ifdef ESP_PLATFORM
 void mqtt_init(const char* mqtt_server, int mqtt_port, const char* username, const char* pass);
-int mqtt_publish(const char* topic, char* payload);
-int mqtt_publish_iotera(char* payload);
+#endif
+int mqtt_publish(const char* topic, const char* payload, int len);
+int mqtt_publish_iotera(const char* payload, int len);
+int mqtt_publish_queued(const char* topic, const char* payload, int len);
+int mqtt_publish_iotera_queued(const char* payload, int len);
+int mqtt_publish_diag(const char* payload, int len);
 int mqtt_subscribe(const char* topic);
 int mqtt_conn_stat(void);
-void mqtt_data_handling(esp_mqtt_event_handle_t event);
-void generate_topic(const char* username);
+esp_err_t mqtt_reconnect(void);
+esp_err_t mqtt_disconnect(void);
+void mqtt_set_conn_cb(mqtt_conn_cb_t cb);
+void mqtt_data_handling(const mqtt_port_event_t* event);
 
 #endif
@@ -0,0 +1,45 @@
+#ifndef __MQTT_PORT_H
+#define __MQTT_PORT_H
+
+#include "esp_err.h"
+
+/*
+ * MQTT client port
+ *
+ * What mqtt_app needs from an MQTT client and what it is told back, without
+ * the client's own types. The module calls out through mqtt_transport_t and
+ * is fed mqtt_port_event_t; the esp-mqtt adapter at the end of mqtt_app.c
+ * converts esp_mqtt_event_t into it, host tests build events directly.
+ */
+typedef struct {
+    int (*publish)(void* ctx, const char* topic, const char* data, int len, int qos);
+    int (*subscribe)(void* ctx, const char* topic, int qos);
+    esp_err_t (*reconnect)(void* ctx);
+    esp_err_t (*disconnect)(void* ctx);
+    void* ctx;
+} mqtt_transport_t;
+
+typedef enum {
+    MQTT_PORT_ERROR = 0,
+    MQTT_PORT_CONNECTED,
+    MQTT_PORT_DISCONNECTED,
+    MQTT_PORT_SUBSCRIBED,
+    MQTT_PORT_UNSUBSCRIBED,
+    MQTT_PORT_PUBLISHED,    // PUBACK of msg_id
+    MQTT_PORT_DATA,
+    MQTT_PORT_OTHER,
+} mqtt_port_event_id_t;
+
+typedef struct {
+    mqtt_port_event_id_t id;
+    int raw_id;                 // client event id, for logging
+    int msg_id;
+    const char* topic;          // DATA: first chunk only
+    int topic_len;
+    const char* data;
+    int data_len;
+    int total_data_len;
+    int current_data_offset;
+} mqtt_port_event_t;
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * Task profiling
+ *
+ * Run time counters are cumulative, so every sample keeps the counters of
+ * the previous one (by xTaskNumber) and reports the difference. A task seen
+ * for the first time reports 0 for that sample.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "profile.h"
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+
+static TaskStatus_t profile_status[PROFILE_TASKS_MAX];
+
+esp_err_t profile_init(profile_t* p, profile_isr_fn isr_cycles, uint32_t cpu_mhz)
+{
+    memset(p, 0, sizeof(*p));
+    p->isr_cycles = isr_cycles;
+    p->cpu_mhz = (cpu_mhz != 0) ? cpu_mhz : 1;
+    // baseline for the first delta
+    return profile_sample(p, 0);
+}
+
+static uint32_t profile_prev_runtime(const profile_t* p, uint32_t num, int* found)
+{
+    for (int i = 0; i < p->prev_count; i++) {
+        if (p->prev_num[i] == num) {
+            *found = 1;
+            return p->prev_runtime[i];
+        }
+    }
+    *found = 0;
+    return 0;
+}
+
+static uint16_t profile_permille(uint32_t part, uint32_t total)
+{
+    uint64_t pm = (total != 0) ? (uint64_t) part * 1000 / total : 0;
+    return (pm > 1000) ? 1000 : (uint16_t) pm;
+}
+
+esp_err_t profile_sample(profile_t* p, uint32_t uptime_ms)
+{
+    uint32_t total = 0;
+    UBaseType_t n = uxTaskGetSystemState(profile_status, PROFILE_TASKS_MAX, &total);
+
+    if (n == 0) {
+        return ESP_ERR_INVALID_SIZE; // more tasks than PROFILE_TASKS_MAX
+    }
+
+    uint32_t total_delta = total - p->prev_total;
+    uint32_t isr = (p->isr_cycles != NULL) ? p->isr_cycles() : 0;
+    profile_snap_t* snap = &p->ring[p->taken % PROFILE_RING];
+
+    snap->seq = p->taken;
+    snap->uptime_ms = uptime_ms;
+    // run time counter is in us (esp_timer), isr time in cycles
+    snap->isr_permille = profile_permille((isr - p->prev_isr) / p->cpu_mhz, total_delta);
+    snap->count = (uint8_t) n;
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t* st = &profile_status[i];
+        profile_task_t* t = &snap->tasks[i];
+        int found;
+        uint32_t prev = profile_prev_runtime(p, st->xTaskNumber, &found);
+
+        strncpy(t->name, st->pcTaskName, PROFILE_NAME_LEN - 1);
+        t->name[PROFILE_NAME_LEN - 1] = '\0';
+#if configTASKLIST_INCLUDE_COREID
+        t->core = (st->xCoreID == tskNO_AFFINITY) ? -1 : (int8_t) st->xCoreID;
+#else
+        t->core = -1;
+#endif
+        t->prio = (uint8_t) st->uxCurrentPriority;
+        t->cpu_permille = found ? profile_permille(st->ulRunTimeCounter - prev, total_delta) : 0;
+        t->stack_free = st->usStackHighWaterMark;
+    }
+
+    for (UBaseType_t i = 0; i < n; i++) {
+        p->prev_num[i] = profile_status[i].xTaskNumber;
+        p->prev_runtime[i] = profile_status[i].ulRunTimeCounter;
+    }
+    p->prev_count = (uint8_t) n;
+    p->prev_total = total;
+    p->prev_isr = isr;
+    p->taken++;
+
+    return ESP_OK;
+}
+
+#else
+
+esp_err_t profile_init(profile_t* p, profile_isr_fn isr_cycles, uint32_t cpu_mhz)
+{
+    memset(p, 0, sizeof(*p));
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t profile_sample(profile_t* p, uint32_t uptime_ms)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
+
+/*
+ * Render the ring into buf, one snapshot at a time, and hand each to emit.
+ * The first sample (baseline from profile_init) is skipped, rows that do
+ * not fit in buf are dropped.
+ */
+void profile_dump(const profile_t* p, char* buf, size_t cap, profile_emit_fn emit, void* ctx)
+{
+    uint32_t first = (p->taken > PROFILE_RING) ? p->taken - PROFILE_RING : 1;
+
+    for (uint32_t seq = first; seq < p->taken; seq++) {
+        const profile_snap_t* snap = &p->ring[seq % PROFILE_RING];
+        size_t len = 0;
+        int n;
+
+        n = snprintf(buf, cap, "prof,%u,%u,isr,-1,0,%u,0\n",
+                snap->seq, snap->uptime_ms, snap->isr_permille);
+        if ((n < 0) || ((size_t) n >= cap)) {
+            continue;
+        }
+        len = n;
+        for (int i = 0; i < snap->count; i++) {
+            const profile_task_t* t = &snap->tasks[i];
+            n = snprintf(&buf[len], cap - len, "prof,%u,%u,%s,%d,%u,%u,%u\n",
+                    snap->seq, snap->uptime_ms, t->name, t->core, t->prio,
+                    t->cpu_permille, t->stack_free);
+            if ((n < 0) || ((size_t) n >= cap - len)) {
+                break;
+            }
+            len += n;
+        }
+        emit(buf, (int) len, ctx);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+/*
+ * Task profiling
+ *
+ * profile_sample() takes one snapshot of every task: CPU share since the
+ * previous snapshot, stack high-water mark, priority and core, plus the time
+ * spent in instrumented ISRs. The last PROFILE_RING snapshots are kept.
+ *
+ * profile_dump() renders the ring oldest first, one block per snapshot:
+ *   prof,<seq>,<uptime_ms>,<task>,<core>,<prio>,<cpu_permille>,<stack_free>
+ * cpu_permille is per core (up to 1000 for a task that never yields, the
+ * sum over all tasks is 1000 per core). stack_free is the lowest number of
+ * unused stack bytes seen. ISR time is reported as task "isr" on core -1.
+ * The rows are plain CSV, a spreadsheet or a pivot on task gives the table.
+ *
+ * Needs CONFIG_FREERTOS_USE_TRACE_FACILITY and
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, profile_init() fails without.
+ */
+
+#define PROFILE_TASKS_MAX   24
+#define PROFILE_RING        8
+#define PROFILE_NAME_LEN    16
+
+typedef struct {
+    char name[PROFILE_NAME_LEN];
+    int8_t core;                // -1 -> not pinned
+    uint8_t prio;
+    uint16_t cpu_permille;
+    uint32_t stack_free;        // bytes
+} profile_task_t;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t uptime_ms;
+    uint32_t isr_permille;
+    uint8_t count;
+    profile_task_t tasks[PROFILE_TASKS_MAX];
+} profile_snap_t;
+
+// cumulative ISR time in CPU cycles, may wrap between two samples only once
+typedef uint32_t (*profile_isr_fn)(void);
+// one rendered snapshot, text is not NUL terminated
+typedef void (*profile_emit_fn)(const char* text, int len, void* ctx);
+
+typedef struct {
+    profile_snap_t ring[PROFILE_RING];
+    uint32_t taken;             // snapshots since init, next seq
+    profile_isr_fn isr_cycles;
+    uint32_t cpu_mhz;
+    uint32_t prev_total;        // run time counter of the previous sample
+    uint32_t prev_isr;
+    uint8_t prev_count;
+    uint32_t prev_num[PROFILE_TASKS_MAX];       // xTaskNumber
+    uint32_t prev_runtime[PROFILE_TASKS_MAX];
+} profile_t;
+
+esp_err_t profile_init(profile_t* p, profile_isr_fn isr_cycles, uint32_t cpu_mhz);
+esp_err_t profile_sample(profile_t* p, uint32_t uptime_ms);
+void profile_dump(const profile_t* p, char* buf, size_t cap, profile_emit_fn emit, void* ctx);
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Lock-free MPSC publish queue (bounded, per slot sequence numbers)
+ *
+ * slot.seq == pos          -> free for the producer holding ticket pos
+ * slot.seq == pos + 1      -> filled, readable by the consumer at pos
+ * slot.seq == pos + SLOTS  -> released, free for the next lap
+ */
+
+#include "pub_queue.h"
+
+#define PUBQ_MASK   (PUBQ_SLOTS - 1)
+
+void pubq_init(pubq_t* q)
+{
+    for (uint32_t i = 0; i < PUBQ_SLOTS; i++) {
+        q->slots[i].seq = i;
+    }
+    q->head = 0;
+    q->tail = 0;
+    q->full = 0;
+}
+
+pubq_slot_t* pubq_reserve(pubq_t* q)
+{
+    uint32_t pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+
+    for (;;) {
+        pubq_slot_t* slot = &q->slots[pos & PUBQ_MASK];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t) (seq - pos);
+
+        if (diff == 0) {
+            // pos is reloaded by the CAS on failure
+            if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                slot->pos = pos;
+                slot->result = NULL;
+                slot->waiter = NULL;
+                slot->tag = 0;
+                return slot;
+            }
+        } else if (diff < 0) {
+            // the consumer has not released this slot from the previous lap
+            __atomic_fetch_add(&q->full, 1, __ATOMIC_RELAXED);
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void pubq_commit(pubq_t* q, pubq_slot_t* slot)
+{
+    __atomic_store_n(&slot->seq, slot->pos + 1, __ATOMIC_RELEASE);
+}
+
+pubq_slot_t* pubq_peek(pubq_t* q)
+{
+    pubq_slot_t* slot = &q->slots[q->tail & PUBQ_MASK];
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != q->tail + 1) {
+        return NULL;
+    }
+    return slot;
+}
+
+void pubq_release(pubq_t* q, pubq_slot_t* slot)
+{
+    __atomic_store_n(&slot->seq, q->tail + PUBQ_SLOTS, __ATOMIC_RELEASE);
+    q->tail++;
+}
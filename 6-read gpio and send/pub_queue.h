@@ -0,0 +1,52 @@
+#ifndef __PUB_QUEUE_H
+#define __PUB_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Lock-free multi-producer, single-consumer publish queue
+ *
+ * Bounded ring of fixed slots with a sequence number per slot. Producers on
+ * any task or core claim a slot with one compare-and-swap on head, fill it
+ * in place and publish it by storing its sequence; there is no lock, so a
+ * preempted producer never blocks the others, it only holds its own slot.
+ * The single consumer (the MQTT owner task) reads slots in place and hands
+ * them back with pubq_release().
+ *
+ * Only GCC __atomic builtins are used, so the same code runs under pthreads.
+ */
+
+#define PUBQ_SLOTS          8       // power of two
+#define PUBQ_PAYLOAD_MAX    1536
+#define PUBQ_PENDING        (-2)    // *result until the consumer fills it in
+
+typedef struct {
+    uint32_t seq;
+    uint32_t pos;               // ticket of the current owner
+    const char* topic;          // must outlive the slot (module owned topics)
+    int* result;                // optional, written by the consumer
+    void* waiter;               // optional, woken by the consumer
+    uint32_t tag;               // optional, opaque to the queue
+    uint16_t len;
+    char data[PUBQ_PAYLOAD_MAX];
+} pubq_slot_t;
+
+typedef struct {
+    pubq_slot_t slots[PUBQ_SLOTS];
+    uint32_t head;              // next ticket, shared by producers
+    uint32_t tail;              // consumer only
+    uint32_t full;              // reserve attempts on a full queue
+} pubq_t;
+
+void pubq_init(pubq_t* q);
+
+// producers
+pubq_slot_t* pubq_reserve(pubq_t* q);    // NULL if full
+void pubq_commit(pubq_t* q, pubq_slot_t* slot);
+
+// consumer
+pubq_slot_t* pubq_peek(pubq_t* q);       // NULL if empty
+void pubq_release(pubq_t* q, pubq_slot_t* slot);
+
+#endif
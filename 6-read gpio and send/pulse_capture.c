@@ -0,0 +1,147 @@
+/*
+ * Pulse capture engine
+ *
+ * ISR side  : pulse_capture_isr() -> pulse_capture_edge()
+ *             count++, push timestamp, wake consumer once the ring is half full
+ * Task side : pulse_capture_drain() pulls timestamps in batches,
+ *             pulse_capture_count() reads the exact edge count
+ *
+ * The GPIO ISR service must already be installed (gpio_install_isr_service).
+ * With CONFIG_EXAMPLE_PROFILE_MODE the ISR also sums its own CPU cycles.
+ */
+
+#include <string.h>
+
+#include "pulse_capture.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#if CONFIG_EXAMPLE_PROFILE_MODE
+#include "soc/cpu.h"
+#endif
+
+static const char *TAG = "PULSE_CAPTURE";
+
+static pulse_channel_t pulse_channels[PULSE_CAPTURE_CHANNELS];
+static int pulse_channel_num = 0;
+static TaskHandle_t pulse_consumer = NULL;
+static volatile uint32_t pulse_isr_cycles = 0;
+
+/*
+ * Count one edge and store its timestamp.
+ * Only one context may call this per channel (the channel's ISR).
+ * return 1 if the ring just reached PULSE_CAPTURE_WAKE_FILL, 0 otherwise.
+ */
+int IRAM_ATTR pulse_capture_edge(pulse_channel_t* ch, uint32_t timestamp)
+{
+    uint32_t head = ch->head;
+    uint32_t fill = head - ch->tail;
+
+    ch->count++;
+    if (fill >= PULSE_CAPTURE_RING_SIZE) {
+        ch->dropped++;
+        return 0;
+    }
+    ch->ring[head & PULSE_CAPTURE_RING_MASK] = timestamp;
+    ch->head = head + 1; // publish the slot after it is written
+
+    return (fill + 1) == PULSE_CAPTURE_WAKE_FILL;
+}
+
+static void IRAM_ATTR pulse_capture_isr(void* arg)
+{
+    pulse_channel_t* ch = (pulse_channel_t*) arg;
+    BaseType_t woken = pdFALSE;
+#if CONFIG_EXAMPLE_PROFILE_MODE
+    uint32_t start = esp_cpu_get_ccount();
+#endif
+
+    if (pulse_capture_edge(ch, (uint32_t) esp_timer_get_time()) && pulse_consumer != NULL) {
+        vTaskNotifyGiveFromISR(pulse_consumer, &woken);
+    }
+#if CONFIG_EXAMPLE_PROFILE_MODE
+    pulse_isr_cycles += esp_cpu_get_ccount() - start;
+#endif
+    if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+esp_err_t pulse_capture_init(const uint32_t* gpio_nums, int channels)
+{
+    esp_err_t err;
+
+    if ((channels <= 0) || (channels > PULSE_CAPTURE_CHANNELS)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i < channels; i++) {
+        pulse_channel_t* ch = &pulse_channels[i];
+        memset((void*) ch, 0, sizeof(*ch));
+        ch->gpio_num = gpio_nums[i];
+
+        err = gpio_isr_handler_add(ch->gpio_num, pulse_capture_isr, ch);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "isr add failed on GPIO[%d]: %d", ch->gpio_num, err);
+            return err;
+        }
+    }
+    pulse_channel_num = channels;
+
+    return ESP_OK;
+}
+
+void pulse_capture_set_consumer(TaskHandle_t task)
+{
+    pulse_consumer = task;
+}
+
+/*
+ * Copy up to max pending timestamps (oldest first) and release their slots.
+ * return number of timestamps copied.
+ */
+size_t pulse_capture_drain(int channel, uint32_t* timestamps, size_t max)
+{
+    pulse_channel_t* ch = pulse_capture_channel(channel);
+    if (ch == NULL) {
+        return 0;
+    }
+
+    uint32_t tail = ch->tail;
+    uint32_t avail = ch->head - tail;
+    size_t n = (avail < max) ? avail : max;
+
+    for (size_t i = 0; i < n; i++) {
+        timestamps[i] = ch->ring[(tail + i) & PULSE_CAPTURE_RING_MASK];
+    }
+    ch->tail = tail + n; // hand the slots back to the ISR
+
+    return n;
+}
+
+uint32_t pulse_capture_count(int channel)
+{
+    pulse_channel_t* ch = pulse_capture_channel(channel);
+    return (ch != NULL) ? ch->count : 0;
+}
+
+uint32_t pulse_capture_dropped(int channel)
+{
+    pulse_channel_t* ch = pulse_capture_channel(channel);
+    return (ch != NULL) ? ch->dropped : 0;
+}
+
+pulse_channel_t* pulse_capture_channel(int channel)
+{
+    if ((channel < 0) || (channel >= pulse_channel_num)) {
+        return NULL;
+    }
+    return &pulse_channels[channel];
+}
+
+// cumulative cycles spent in the GPIO ISR, 0 unless profiling
+uint32_t pulse_capture_isr_cycles(void)
+{
+    return pulse_isr_cycles;
+}
@@ -0,0 +1,47 @@
+#ifndef __PULSE_CAPTURE_H
+#define __PULSE_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Pulse capture engine
+ *
+ * The GPIO ISR no longer posts one queue message per edge. Each channel keeps
+ * its own edge counter and a ring of edge timestamps; the ISR is the only
+ * writer of count/head/dropped and the consumer task is the only writer of
+ * tail, so no lock is needed on either side.
+ *
+ * count   -> exact number of edges seen, never lost
+ * ring    -> timestamps (esp_timer, us, low 32 bits) drained in batches
+ * dropped -> timestamps that did not fit in the ring (count is still exact)
+ */
+
+#define PULSE_CAPTURE_CHANNELS      2
+#define PULSE_CAPTURE_RING_SIZE     64  // must be a power of two
+#define PULSE_CAPTURE_RING_MASK     (PULSE_CAPTURE_RING_SIZE - 1)
+#define PULSE_CAPTURE_WAKE_FILL     (PULSE_CAPTURE_RING_SIZE / 2)  // wake consumer at half full
+
+typedef struct {
+    uint32_t gpio_num;
+    volatile uint32_t count;
+    volatile uint32_t dropped;
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t ring[PULSE_CAPTURE_RING_SIZE];
+} pulse_channel_t;
+
+esp_err_t pulse_capture_init(const uint32_t* gpio_nums, int channels);
+void pulse_capture_set_consumer(TaskHandle_t task);
+int pulse_capture_edge(pulse_channel_t* ch, uint32_t timestamp);
+size_t pulse_capture_drain(int channel, uint32_t* timestamps, size_t max);
+uint32_t pulse_capture_count(int channel);
+uint32_t pulse_capture_dropped(int channel);
+pulse_channel_t* pulse_capture_channel(int channel);
+uint32_t pulse_capture_isr_cycles(void);
+
+#endif
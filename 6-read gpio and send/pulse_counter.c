@@ -0,0 +1,223 @@
+/*
+ * Pulse counter front end
+ *
+ * PCNT backend : unit N counts channel N, the H_LIM event ISR only bumps the
+ *                wrap counter, so the CPU is not involved per pulse.
+ * ISR backend  : GPIO interrupt per edge through the pulse capture engine.
+ *
+ * pulse_counter_get() keeps per channel state (last value), call it from one
+ * task only (gpio_task_example).
+ */
+
+#include <string.h>
+
+#include "pulse_counter.h"
+#include "pulse_capture.h"
+
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "driver/pcnt.h"
+
+static const char *TAG = "PULSE_COUNTER";
+
+static pulse_counter_backend_t counter_backend = PULSE_COUNTER_BACKEND_ISR;
+static int counter_channels = 0;
+static pulse_accum_t counter_accum[PULSE_COUNTER_CHANNELS];
+
+uint64_t pulse_accum_extend(pulse_accum_t* acc, uint32_t wraps, int16_t raw)
+{
+    uint64_t value = (uint64_t) wraps * PULSE_PCNT_H_LIM;
+
+    if (raw > 0) {
+        value += (uint64_t) raw;
+    }
+    if (value < acc->last) {
+        // counter already wrapped to 0 but the limit ISR has not run yet
+        value += PULSE_PCNT_H_LIM;
+    }
+    acc->last = value;
+
+    return value;
+}
+
+static uint64_t pulse_accum_extend32(pulse_accum_t* acc, uint32_t count)
+{
+    uint64_t value = (acc->last & ~(uint64_t) UINT32_MAX) | count;
+
+    if (value < acc->last) {
+        value += (uint64_t) UINT32_MAX + 1;
+    }
+    acc->last = value;
+
+    return value;
+}
+
+static void IRAM_ATTR pcnt_overflow_isr(void* arg)
+{
+    pulse_accum_t* acc = (pulse_accum_t*) arg;
+    acc->wraps++;
+}
+
+/*
+ * Undo a partial PCNT setup: stop the first units configured, detach their
+ * pins and ISR handlers, and remove the ISR service if we installed it, so
+ * the GPIO ISR backend gets the pins back clean.
+ */
+static void pcnt_backend_teardown(int units, int service_installed)
+{
+    for (int i = 0; i < units; i++) {
+        pcnt_unit_t unit = (pcnt_unit_t) (PCNT_UNIT_0 + i);
+
+        pcnt_counter_pause(unit);
+        pcnt_event_disable(unit, PCNT_EVT_H_LIM);
+        pcnt_isr_handler_remove(unit);
+        pcnt_set_pin(unit, PCNT_CHANNEL_0, PCNT_PIN_NOT_USED, PCNT_PIN_NOT_USED);
+    }
+    if (service_installed) {
+        pcnt_isr_service_uninstall();
+    }
+}
+
+static esp_err_t pcnt_backend_init(const pulse_counter_pin_t* pins, int channels)
+{
+    esp_err_t err;
+    int service_installed;
+    int units = 0;
+
+    err = pcnt_isr_service_install(0);
+    if ((err != ESP_OK) && (err != ESP_ERR_INVALID_STATE)) {
+        return err;
+    }
+    service_installed = (err == ESP_OK);
+
+    for (int i = 0; i < channels; i++) {
+        pcnt_unit_t unit = (pcnt_unit_t) (PCNT_UNIT_0 + i);
+        pcnt_config_t pcnt_cfg = {
+            .pulse_gpio_num = pins[i].gpio_num,
+            .ctrl_gpio_num = PCNT_PIN_NOT_USED,
+            .channel = PCNT_CHANNEL_0,
+            .unit = unit,
+            .pos_mode = PCNT_COUNT_INC,
+            .neg_mode = pins[i].both_edges ? PCNT_COUNT_INC : PCNT_COUNT_DIS,
+            .lctrl_mode = PCNT_MODE_KEEP,
+            .hctrl_mode = PCNT_MODE_KEEP,
+            .counter_h_lim = PULSE_PCNT_H_LIM,
+            .counter_l_lim = 0,
+        };
+
+        err = pcnt_unit_config(&pcnt_cfg);
+        if (err != ESP_OK) {
+            break;
+        }
+        units = i + 1;
+        pcnt_set_filter_value(unit, PULSE_PCNT_FILTER_APB);
+        pcnt_filter_enable(unit);
+
+        pcnt_event_enable(unit, PCNT_EVT_H_LIM);
+        pcnt_counter_pause(unit);
+        pcnt_counter_clear(unit);
+
+        err = pcnt_isr_handler_add(unit, pcnt_overflow_isr, &counter_accum[i]);
+        if (err != ESP_OK) {
+            break;
+        }
+        pcnt_counter_resume(unit);
+    }
+
+    if (err != ESP_OK) {
+        pcnt_backend_teardown(units, service_installed);
+    }
+    return err;
+}
+
+static esp_err_t isr_backend_init(const pulse_counter_pin_t* pins, int channels)
+{
+    uint32_t gpio_nums[PULSE_CAPTURE_CHANNELS];
+    esp_err_t err;
+
+    if (channels > PULSE_CAPTURE_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    err = gpio_install_isr_service(0);
+    if ((err != ESP_OK) && (err != ESP_ERR_INVALID_STATE)) {
+        return err;
+    }
+
+    for (int i = 0; i < channels; i++) {
+        gpio_nums[i] = pins[i].gpio_num;
+        gpio_set_intr_type(pins[i].gpio_num, pins[i].both_edges ? GPIO_INTR_ANYEDGE : GPIO_INTR_POSEDGE);
+    }
+
+    err = pulse_capture_init(gpio_nums, channels);
+    for (int i = 0; (err == ESP_OK) && (i < channels); i++) {
+        gpio_intr_enable(pins[i].gpio_num);
+    }
+
+    return err;
+}
+
+/*
+ * Start counting on the given pins.
+ * If the PCNT backend can not be set up the ISR backend is used instead.
+ */
+esp_err_t pulse_counter_init(pulse_counter_backend_t backend, const pulse_counter_pin_t* pins, int channels)
+{
+    esp_err_t err = ESP_FAIL;
+
+    if ((channels <= 0) || (channels > PULSE_COUNTER_CHANNELS)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // both backends count from zero, whatever a previous backend left here
+    memset(counter_accum, 0, sizeof(counter_accum));
+
+    if (backend == PULSE_COUNTER_BACKEND_PCNT) {
+        err = pcnt_backend_init(pins, channels);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "PCNT init failed (%d), falling back to GPIO ISR", err);
+        }
+    }
+
+    if (err == ESP_OK) {
+        counter_backend = PULSE_COUNTER_BACKEND_PCNT;
+    } else {
+        err = isr_backend_init(pins, channels);
+        counter_backend = PULSE_COUNTER_BACKEND_ISR;
+    }
+
+    if (err == ESP_OK) {
+        counter_channels = channels;
+        ESP_LOGI(TAG, "counting %d channel(s) with %s", channels,
+                counter_backend == PULSE_COUNTER_BACKEND_PCNT ? "PCNT" : "GPIO ISR");
+    }
+
+    return err;
+}
+
+pulse_counter_backend_t pulse_counter_backend(void)
+{
+    return counter_backend;
+}
+
+uint64_t pulse_counter_get(int channel)
+{
+    pulse_accum_t* acc;
+
+    if ((channel < 0) || (channel >= counter_channels)) {
+        return 0;
+    }
+    acc = &counter_accum[channel];
+
+    if (counter_backend == PULSE_COUNTER_BACKEND_ISR) {
+        return pulse_accum_extend32(acc, pulse_capture_count(channel));
+    }
+
+    uint32_t wraps;
+    int16_t raw = 0;
+    do {
+        wraps = acc->wraps;
+        pcnt_get_counter_value((pcnt_unit_t) (PCNT_UNIT_0 + channel), &raw);
+    } while (wraps != acc->wraps);
+
+    return pulse_accum_extend(acc, wraps, raw);
+}
@@ -0,0 +1,46 @@
+#ifndef __PULSE_COUNTER_H
+#define __PULSE_COUNTER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Pulse counter front end
+ *
+ * One API over two backends:
+ *  PULSE_COUNTER_BACKEND_PCNT -> hardware PCNT unit per channel, glitch filter,
+ *                                16 bit counter extended to 64 bit, no CPU per pulse
+ *  PULSE_COUNTER_BACKEND_ISR  -> GPIO interrupt + pulse capture engine (fallback)
+ */
+
+#define PULSE_COUNTER_CHANNELS      2
+#define PULSE_PCNT_H_LIM            32767   // counter resets to 0 when it reaches this
+#define PULSE_PCNT_FILTER_APB       1000    // ignore pulses shorter than 1000 APB cycles (12.5 us)
+
+typedef enum {
+    PULSE_COUNTER_BACKEND_ISR = 0,
+    PULSE_COUNTER_BACKEND_PCNT,
+} pulse_counter_backend_t;
+
+typedef struct {
+    uint32_t gpio_num;
+    uint8_t both_edges;     // 1 -> count rising and falling edge, 0 -> rising only
+} pulse_counter_pin_t;
+
+/*
+ * 16 -> 64 bit extension of a hardware counter that wraps at PULSE_PCNT_H_LIM.
+ * wraps is bumped by the limit event ISR; last guards against a wrap whose
+ * ISR has not run yet when the counter is read.
+ */
+typedef struct {
+    volatile uint32_t wraps;
+    uint64_t last;
+} pulse_accum_t;
+
+uint64_t pulse_accum_extend(pulse_accum_t* acc, uint32_t wraps, int16_t raw);
+
+esp_err_t pulse_counter_init(pulse_counter_backend_t backend, const pulse_counter_pin_t* pins, int channels);
+pulse_counter_backend_t pulse_counter_backend(void);
+uint64_t pulse_counter_get(int channel);
+
+#endif
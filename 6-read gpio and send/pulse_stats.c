@@ -0,0 +1,156 @@
+/*
+ * Streaming pulse statistics
+ *
+ * pulse_stats_add()    -> consumer task, per drained batch of timestamps
+ * pulse_stats_gap()    -> timestamps were lost after the last batch
+ * pulse_stats_window() -> close the window, summary out, counters reset
+ * Not thread safe, the caller serialises add and window.
+ */
+
+#include <string.h>
+
+#include "pulse_stats.h"
+
+static int pulse_stats_bucket(uint32_t v)
+{
+    if (v < PULSE_STATS_SUB) {
+        return (int) v;
+    }
+    int e = 31 - __builtin_clz(v);
+    uint32_t m = (v >> (e - PULSE_STATS_SUB_BITS)) & (PULSE_STATS_SUB - 1);
+    return ((e - PULSE_STATS_SUB_BITS + 1) << PULSE_STATS_SUB_BITS) + (int) m;
+}
+
+// middle of the bucket's value range
+static uint32_t pulse_stats_bucket_value(int idx)
+{
+    if (idx < PULSE_STATS_SUB) {
+        return (uint32_t) idx;
+    }
+    int e = (idx >> PULSE_STATS_SUB_BITS) + PULSE_STATS_SUB_BITS - 1;
+    int shift = e - PULSE_STATS_SUB_BITS;
+    uint64_t low = (uint64_t) (PULSE_STATS_SUB + (idx & (PULSE_STATS_SUB - 1))) << shift;
+    return (uint32_t) (low + ((1ULL << shift) >> 1));
+}
+
+static void pulse_stats_reset(pulse_stats_t* ps, int64_t now_us)
+{
+    ps->window_start_us = now_us;
+    ps->edges = 0;
+    ps->intervals = 0;
+    ps->min_us = UINT32_MAX;
+    ps->max_us = 0;
+    ps->bursts = 0;
+    ps->burst_max = 0;
+    memset(ps->hist, 0, sizeof(ps->hist));
+}
+
+void pulse_stats_init(pulse_stats_t* ps, const pulse_stats_config_t* cfg, int64_t now_us)
+{
+    memset(ps, 0, sizeof(*ps));
+    ps->cfg = *cfg;
+    pulse_stats_reset(ps, now_us);
+}
+
+void pulse_stats_add(pulse_stats_t* ps, const uint32_t* timestamps, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t ts = timestamps[i];
+
+        ps->edges++;
+        if (!ps->have_last) {
+            ps->have_last = 1;
+            ps->last_ts = ts;
+            ps->run = 1;
+            continue;
+        }
+
+        uint32_t dt = ts - ps->last_ts; // modulo 2^32, wraps cleanly
+        ps->last_ts = ts;
+        ps->intervals++;
+        if (dt < ps->min_us) {
+            ps->min_us = dt;
+        }
+        if (dt > ps->max_us) {
+            ps->max_us = dt;
+        }
+        ps->hist[pulse_stats_bucket(dt)]++;
+
+        if (dt < ps->cfg.burst_gap_us) {
+            ps->run++;
+            if (ps->run == ps->cfg.burst_min_edges) {
+                ps->bursts++;
+            }
+            if ((ps->run >= ps->cfg.burst_min_edges) && (ps->run > ps->burst_max)) {
+                ps->burst_max = ps->run;
+            }
+        } else {
+            ps->run = 1;
+        }
+    }
+}
+
+/*
+ * The next timestamp starts a new chain: no interval is taken to it and a
+ * burst in progress ends. Its edge is still counted.
+ */
+void pulse_stats_gap(pulse_stats_t* ps)
+{
+    ps->have_last = 0;
+    ps->run = 0;
+}
+
+// interval at permille (500 -> median), 0 without intervals
+uint32_t pulse_stats_percentile(const pulse_stats_t* ps, uint32_t permille)
+{
+    if (ps->intervals == 0) {
+        return 0;
+    }
+    // nearest rank: the smallest value with at least permille of the intervals at or below it
+    uint64_t rank = ((uint64_t) ps->intervals * permille + 999) / 1000;
+    uint64_t seen = 0;
+
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (int i = 0; i < PULSE_STATS_BUCKETS; i++) {
+        seen += ps->hist[i];
+        if (seen >= rank) {
+            uint32_t v = pulse_stats_bucket_value(i);
+            // the exact extremes are known, keep estimates inside them
+            if (v < ps->min_us) {
+                v = ps->min_us;
+            }
+            if (v > ps->max_us) {
+                v = ps->max_us;
+            }
+            return v;
+        }
+    }
+    return ps->max_us;
+}
+
+/*
+ * exact_edges: edge count from the counter for this window (timestamps can be
+ * dropped when the ring overflows, and PCNT gives none), 0 -> timestamps seen.
+ */
+void pulse_stats_window(pulse_stats_t* ps, int64_t now_us, uint32_t exact_edges, pulse_summary_t* out)
+{
+    int64_t window_us = now_us - ps->window_start_us;
+
+    memset(out, 0, sizeof(*out));
+    out->edges = (exact_edges != 0) ? exact_edges : ps->edges;
+    out->rate_hz = (window_us > 0) ? (float) ((double) out->edges * 1e6 / (double) window_us) : 0.0f;
+    out->intervals = ps->intervals;
+    if (ps->intervals > 0) {
+        out->min_us = ps->min_us;
+        out->max_us = ps->max_us;
+        out->p50_us = pulse_stats_percentile(ps, 500);
+        out->p90_us = pulse_stats_percentile(ps, 900);
+        out->p99_us = pulse_stats_percentile(ps, 990);
+    }
+    out->bursts = ps->bursts;
+    out->burst_max = ps->burst_max;
+
+    pulse_stats_reset(ps, now_us);
+}
@@ -0,0 +1,66 @@
+#ifndef __PULSE_STATS_H
+#define __PULSE_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Streaming pulse statistics
+ *
+ * Fed with the edge timestamps drained from the capture ring, summarised
+ * once per reporting window. Memory is constant whatever the pulse rate:
+ *   intervals -> log-linear histogram, PULSE_STATS_SUB_BITS sub-buckets per
+ *                power of two, percentiles within 1/2^(SUB_BITS + 1) relative
+ *   bursts    -> runs of at least burst_min_edges edges closer than
+ *                burst_gap_us, counted once per run
+ * Timestamps are the low 32 bits of esp_timer (us); intervals are taken
+ * modulo 2^32, so windows longer than ~71 minutes between two edges alias.
+ * The interval chain continues across windows. When timestamps were lost
+ * (ring overflow) the caller breaks it with pulse_stats_gap(), so the
+ * interval over the lost edges is not recorded.
+ */
+
+#define PULSE_STATS_SUB_BITS    3
+#define PULSE_STATS_SUB         (1 << PULSE_STATS_SUB_BITS)
+#define PULSE_STATS_BUCKETS     ((33 - PULSE_STATS_SUB_BITS) << PULSE_STATS_SUB_BITS)
+
+typedef struct {
+    uint32_t burst_gap_us;
+    uint32_t burst_min_edges;
+} pulse_stats_config_t;
+
+typedef struct {
+    pulse_stats_config_t cfg;
+    int64_t window_start_us;
+    uint32_t edges;             // timestamps seen this window
+    uint32_t intervals;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t last_ts;
+    uint8_t have_last;
+    uint32_t run;               // edges in the current run of close edges
+    uint32_t bursts;
+    uint32_t burst_max;         // longest run this window, in edges
+    uint32_t hist[PULSE_STATS_BUCKETS];
+} pulse_stats_t;
+
+typedef struct {
+    uint32_t edges;             // exact count if the caller passed one
+    float rate_hz;
+    uint32_t intervals;         // 0 -> no timestamps, interval fields are 0
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t bursts;
+    uint32_t burst_max;
+} pulse_summary_t;
+
+void pulse_stats_init(pulse_stats_t* ps, const pulse_stats_config_t* cfg, int64_t now_us);
+void pulse_stats_add(pulse_stats_t* ps, const uint32_t* timestamps, size_t n);
+void pulse_stats_gap(pulse_stats_t* ps);
+void pulse_stats_window(pulse_stats_t* ps, int64_t now_us, uint32_t exact_edges, pulse_summary_t* out);
+uint32_t pulse_stats_percentile(const pulse_stats_t* ps, uint32_t permille);
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * Report by exception
+ *
+ * rbe_update() -> 0 to suppress the sample, otherwise why it is reported:
+ *                 bit i for field i, RBE_FIRST, RBE_HEARTBEAT.
+ *                 A reported sample becomes the new reference of every field.
+ */
+
+#include <string.h>
+
+#include "rbe.h"
+
+void rbe_init(rbe_t* r, const rbe_field_config_t* fields, int count, uint32_t heartbeat_ms)
+{
+    memset(r, 0, sizeof(*r));
+    if (count > RBE_FIELDS_MAX) {
+        count = RBE_FIELDS_MAX;
+    }
+    for (int i = 0; i < count; i++) {
+        r->fields[i].cfg = fields[i];
+    }
+    r->count = count;
+    r->heartbeat_ms = heartbeat_ms;
+}
+
+static int rbe_field_changed(const rbe_field_t* f, double v)
+{
+    double diff = v - f->ref;
+    int8_t dir = (diff > 0) ? 1 : -1;
+    double threshold = f->cfg.deadband;
+
+    if (diff == 0) {
+        return 0;
+    }
+    if (diff < 0) {
+        diff = -diff;
+    }
+    if ((f->dir != 0) && (dir != f->dir)) {
+        threshold += f->cfg.hysteresis;
+    }
+    return diff >= threshold;
+}
+
+uint32_t rbe_update(rbe_t* r, const double* values, int64_t now_ms)
+{
+    uint32_t why = 0;
+
+    if (!r->primed) {
+        why |= RBE_FIRST;
+    } else if ((r->heartbeat_ms > 0) && ((now_ms - r->last_ms) >= (int64_t) r->heartbeat_ms)) {
+        why |= RBE_HEARTBEAT;
+    }
+    for (int i = 0; i < r->count; i++) {
+        if (r->primed && rbe_field_changed(&r->fields[i], values[i])) {
+            why |= 1u << i;
+        }
+    }
+
+    if (why == 0) {
+        r->suppressed++;
+        return 0;
+    }
+
+    for (int i = 0; i < r->count; i++) {
+        rbe_field_t* f = &r->fields[i];
+        if (why & (1u << i)) {
+            f->dir = (values[i] > f->ref) ? 1 : -1;
+        }
+        f->ref = values[i];
+    }
+    r->last_ms = now_ms;
+    r->primed = 1;
+    r->reported++;
+
+    return why;
+}
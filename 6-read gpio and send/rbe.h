@@ -0,0 +1,47 @@
+#ifndef __RBE_H
+#define __RBE_H
+
+#include <stdint.h>
+
+/*
+ * Report by exception
+ *
+ * Decides per sample whether it is worth publishing. A sample is reported
+ * when any field moved at least its deadband away from the last reported
+ * value, or when nothing was reported for heartbeat_ms. A change against the
+ * direction of the field's last reported change needs deadband + hysteresis,
+ * so a value wobbling around one level is not reported on every wobble.
+ *
+ * Counters (monotonic) use a deadband in counts and no hysteresis. A deadband
+ * of 0 reports any change.
+ */
+
+#define RBE_FIELDS_MAX      8
+#define RBE_FIRST           (1u << 30)  // first sample after rbe_init
+#define RBE_HEARTBEAT       (1u << 31)  // silence reached heartbeat_ms
+
+typedef struct {
+    double deadband;
+    double hysteresis;
+} rbe_field_config_t;
+
+typedef struct {
+    rbe_field_config_t cfg;
+    double ref;             // value last reported
+    int8_t dir;             // direction of the last reported change, 0 none yet
+} rbe_field_t;
+
+typedef struct {
+    rbe_field_t fields[RBE_FIELDS_MAX];
+    int count;
+    uint32_t heartbeat_ms;
+    int64_t last_ms;        // time of the last report
+    uint8_t primed;
+    uint32_t reported;
+    uint32_t suppressed;
+} rbe_t;
+
+void rbe_init(rbe_t* r, const rbe_field_config_t* fields, int count, uint32_t heartbeat_ms);
+uint32_t rbe_update(rbe_t* r, const double* values, int64_t now_ms);
+
+#endif
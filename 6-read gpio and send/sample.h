@@ -0,0 +1,19 @@
+#ifndef __SAMPLE_H
+#define __SAMPLE_H
+
+#include <stdint.h>
+
+/*
+ * One telemetry sample
+ * Also the record format of the telemetry log, so keep the layout fixed.
+ */
+#define SAMPLE_NOT_MEASURED     UINT64_MAX  // pulse value of a channel that was not counted
+
+typedef struct {
+    uint32_t timestamp;     // time(NULL) when sampled, seconds
+    float battery;
+    uint64_t pulse1;
+    uint64_t pulse2;
+} sample_t;
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * Column block codec
+ *
+ * sblock_encode() -> block length, -1 if it does not fit cap (or bad count)
+ * sblock_decode() -> number of samples, -1 on a malformed block
+ */
+
+#include <string.h>
+
+#include "sample_block.h"
+
+typedef struct {
+    uint8_t* buf;
+    size_t cap;
+    size_t len;
+    uint8_t bit;            // bits used in buf[len - 1], 8 -> start a new byte
+    uint8_t overflow;
+} sblock_out_t;
+
+typedef struct {
+    const uint8_t* buf;
+    size_t len;
+    size_t pos;
+    uint8_t bit;            // bits consumed in buf[pos - 1]
+    uint8_t error;
+} sblock_in_t;
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+static void out_byte(sblock_out_t* o, uint8_t b)
+{
+    if (o->len >= o->cap) {
+        o->overflow = 1;
+        return;
+    }
+    o->buf[o->len++] = b;
+}
+
+static void out_varint(sblock_out_t* o, uint64_t v)
+{
+    while (v >= 0x80) {
+        out_byte(o, (uint8_t) (v | 0x80));
+        v >>= 7;
+    }
+    out_byte(o, (uint8_t) v);
+}
+
+static void out_bits(sblock_out_t* o, uint32_t v, int n)
+{
+    while (n > 0) {
+        if (o->bit == 8) {
+            out_byte(o, 0);
+            o->bit = 0;
+            if (o->overflow) {
+                return;
+            }
+        }
+        int take = 8 - o->bit;
+        if (take > n) {
+            take = n;
+        }
+        uint32_t part = (v >> (n - take)) & ((1u << take) - 1);
+        o->buf[o->len - 1] |= (uint8_t) (part << (8 - o->bit - take));
+        o->bit += take;
+        n -= take;
+    }
+}
+
+static uint8_t in_byte(sblock_in_t* in)
+{
+    if (in->pos >= in->len) {
+        in->error = 1;
+        return 0;
+    }
+    return in->buf[in->pos++];
+}
+
+static uint64_t in_varint(sblock_in_t* in)
+{
+    uint64_t v = 0;
+
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t b = in_byte(in);
+        v |= (uint64_t) (b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+    }
+    in->error = 1;
+    return 0;
+}
+
+static uint32_t in_bits(sblock_in_t* in, int n)
+{
+    uint32_t v = 0;
+
+    while ((n > 0) && !in->error) {
+        if (in->bit == 8) {
+            in_byte(in);
+            in->bit = 0;
+            if (in->error) {
+                return 0;
+            }
+        }
+        int take = 8 - in->bit;
+        if (take > n) {
+            take = n;
+        }
+        uint32_t part = (in->buf[in->pos - 1] >> (8 - in->bit - take)) & ((1u << take) - 1);
+        v = (v << take) | part;
+        in->bit += take;
+        n -= take;
+    }
+    return v;
+}
+
+static uint32_t float_bits(float f)
+{
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    return v;
+}
+
+static float bits_float(uint32_t v)
+{
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+int sblock_encode(const sample_t* samples, int count, uint8_t* buf, size_t cap)
+{
+    sblock_out_t o = { .buf = buf, .cap = cap, .bit = 8 };
+    int64_t prev_delta = 0;
+
+    if ((count <= 0) || (count > SBLOCK_SAMPLES_MAX)) {
+        return -1;
+    }
+
+    out_byte(&o, SBLOCK_VERSION);
+    out_varint(&o, (uint64_t) count);
+    out_varint(&o, samples[0].timestamp);
+    out_varint(&o, samples[0].pulse1);
+    out_varint(&o, samples[0].pulse2);
+    uint32_t bat = float_bits(samples[0].battery);
+    for (int i = 0; i < 4; i++) {
+        out_byte(&o, (uint8_t) (bat >> (8 * i)));
+    }
+
+    for (int i = 1; i < count; i++) {
+        int64_t delta = (int64_t) samples[i].timestamp - (int64_t) samples[i - 1].timestamp;
+        out_varint(&o, zigzag(delta - prev_delta));
+        prev_delta = delta;
+    }
+    for (int i = 1; i < count; i++) {
+        out_varint(&o, zigzag((int64_t) (samples[i].pulse1 - samples[i - 1].pulse1)));
+    }
+    for (int i = 1; i < count; i++) {
+        out_varint(&o, zigzag((int64_t) (samples[i].pulse2 - samples[i - 1].pulse2)));
+    }
+
+    // Gorilla: reuse the previous leading/trailing window when the XOR fits it
+    int lead_prev = -1;
+    int trail_prev = 0;
+    for (int i = 1; i < count; i++) {
+        uint32_t cur = float_bits(samples[i].battery);
+        uint32_t x = cur ^ bat;
+        bat = cur;
+        if (x == 0) {
+            out_bits(&o, 0, 1);
+            continue;
+        }
+        int lead = __builtin_clz(x);
+        int trail = __builtin_ctz(x);
+        if ((lead_prev >= 0) && (lead >= lead_prev) && (trail >= trail_prev)) {
+            out_bits(&o, 0x2, 2);
+            out_bits(&o, x >> trail_prev, 32 - lead_prev - trail_prev);
+        } else {
+            int sig = 32 - lead - trail;
+            out_bits(&o, 0x3, 2);
+            out_bits(&o, (uint32_t) lead, 5);
+            out_bits(&o, (uint32_t) (sig - 1), 5);
+            out_bits(&o, x >> trail, sig);
+            lead_prev = lead;
+            trail_prev = trail;
+        }
+    }
+
+    return o.overflow ? -1 : (int) o.len;
+}
+
+int sblock_decode(const uint8_t* buf, size_t len, sample_t* samples, int max)
+{
+    sblock_in_t in = { .buf = buf, .len = len, .bit = 8 };
+    int64_t delta = 0;
+
+    if (in_byte(&in) != SBLOCK_VERSION) {
+        return -1;
+    }
+    uint64_t count = in_varint(&in);
+    if (in.error || (count == 0) || (count > (uint64_t) max) || (count > SBLOCK_SAMPLES_MAX)) {
+        return -1;
+    }
+
+    samples[0].timestamp = (uint32_t) in_varint(&in);
+    samples[0].pulse1 = in_varint(&in);
+    samples[0].pulse2 = in_varint(&in);
+    uint32_t bat = 0;
+    for (int i = 0; i < 4; i++) {
+        bat |= (uint32_t) in_byte(&in) << (8 * i);
+    }
+    samples[0].battery = bits_float(bat);
+
+    for (int i = 1; i < (int) count; i++) {
+        delta += unzigzag(in_varint(&in));
+        samples[i].timestamp = (uint32_t) ((int64_t) samples[i - 1].timestamp + delta);
+    }
+    for (int i = 1; i < (int) count; i++) {
+        samples[i].pulse1 = samples[i - 1].pulse1 + (uint64_t) unzigzag(in_varint(&in));
+    }
+    for (int i = 1; i < (int) count; i++) {
+        samples[i].pulse2 = samples[i - 1].pulse2 + (uint64_t) unzigzag(in_varint(&in));
+    }
+
+    int lead = 0;
+    int trail = 0;
+    for (int i = 1; i < (int) count; i++) {
+        uint32_t x = 0;
+        if (in_bits(&in, 1)) {
+            if (in_bits(&in, 1)) {
+                lead = (int) in_bits(&in, 5);
+                int sig = (int) in_bits(&in, 5) + 1;
+                trail = 32 - lead - sig;
+                if (trail < 0) {
+                    return -1;
+                }
+            }
+            x = in_bits(&in, 32 - lead - trail) << trail;
+        }
+        bat ^= x;
+        samples[i].battery = bits_float(bat);
+    }
+
+    return in.error ? -1 : (int) count;
+}
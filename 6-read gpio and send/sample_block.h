@@ -0,0 +1,33 @@
+#ifndef __SAMPLE_BLOCK_H
+#define __SAMPLE_BLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sample.h"
+
+/*
+ * Column block codec for runs of samples
+ *
+ * Samples are stored column by column, each column coded for how it moves:
+ *   timestamp -> first value, then delta of delta (zigzag varint), a steady
+ *                sampling period costs one byte per sample
+ *   pulse1/2  -> first value, then zigzag varint deltas (a counter reset is
+ *                just a negative delta)
+ *   battery   -> first value raw, then Gorilla XOR bits: 1 bit when
+ *                unchanged, the meaningful XOR bits otherwise
+ *
+ * Layout (all varints LEB128):
+ *   version, count, ts0, pulse1_0, pulse2_0, battery0 (4 bytes LE),
+ *   ts dod[count - 1], pulse1 delta[count - 1], pulse2 delta[count - 1],
+ *   battery bit stream (MSB first, padded to a byte)
+ * Decoding ignores bytes after the bit stream.
+ */
+
+#define SBLOCK_VERSION      1
+#define SBLOCK_SAMPLES_MAX  64
+
+int sblock_encode(const sample_t* samples, int count, uint8_t* buf, size_t cap);
+int sblock_decode(const uint8_t* buf, size_t len, sample_t* samples, int max);
+
+#endif
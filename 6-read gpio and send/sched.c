@@ -0,0 +1,144 @@
+/*
+ * Periodic job scheduler
+ *
+ * sched_run_once(): sleep until the earliest deadline, run that job, then
+ * move its deadline forward by whole periods according to its policy.
+ */
+
+#include <stdio.h>
+
+#include "sched.h"
+
+#define SCHED_MAX_CATCH_UP  3
+
+void sched_init(sched_t* s, sched_job_t* jobs, int count,
+        int64_t (*now_us)(void), void (*sleep_us)(int64_t us))
+{
+    int64_t start;
+
+    s->now_us = now_us;
+    s->sleep_us = sleep_us;
+    s->jobs = jobs;
+    s->job_count = count;
+    s->max_catch_up = SCHED_MAX_CATCH_UP;
+
+    start = now_us();
+    for (int i = 0; i < count; i++) {
+        sched_job_t* job = &jobs[i];
+        job->next_us = start + (int64_t) job->offset_ms * 1000;
+        job->runs = 0;
+        job->overruns = 0;
+        job->skipped = 0;
+        job->late_max_us = 0;
+        job->late_sum_us = 0;
+        job->exec_max_us = 0;
+    }
+}
+
+static void sched_advance(sched_t* s, sched_job_t* job, int64_t now)
+{
+    int64_t period = (int64_t) job->period_ms * 1000;
+
+    job->next_us += period;
+    if (job->next_us > now) {
+        return;
+    }
+
+    job->overruns++;
+    if ((job->policy == SCHED_CATCH_UP) && (now - job->next_us < period * s->max_catch_up)) {
+        return; // next run starts right away
+    }
+
+    // realign on the first deadline still ahead
+    int64_t missed = (now - job->next_us) / period + 1;
+    job->next_us += missed * period;
+    job->skipped += (uint32_t) missed;
+}
+
+/*
+ * Wait for and run the next due job.
+ * return the job that ran.
+ */
+sched_job_t* sched_run_once(sched_t* s)
+{
+    sched_job_t* job = NULL;
+    int64_t now;
+    int64_t late;
+
+    for (int i = 0; i < s->job_count; i++) {
+        if ((job == NULL) || (s->jobs[i].next_us < job->next_us)) {
+            job = &s->jobs[i];
+        }
+    }
+    if (job == NULL) {
+        return NULL;
+    }
+
+    now = s->now_us();
+    if (job->next_us > now) {
+        s->sleep_us(job->next_us - now);
+        now = s->now_us();
+    }
+
+    late = now - job->next_us;
+    if (late < 0) {
+        late = 0; // woke up early on tick rounding
+    }
+    job->late_sum_us += late;
+    if (late > job->late_max_us) {
+        job->late_max_us = late;
+    }
+
+    job->fn(job->arg);
+    job->runs++;
+
+    int64_t end = s->now_us();
+    if (end - now > job->exec_max_us) {
+        job->exec_max_us = end - now;
+    }
+    sched_advance(s, job, end);
+
+    return job;
+}
+
+void sched_run(sched_t* s)
+{
+    for (;;) {
+        sched_run_once(s);
+    }
+}
+
+void sched_print_stats(const sched_t* s)
+{
+    for (int i = 0; i < s->job_count; i++) {
+        const sched_job_t* job = &s->jobs[i];
+        printf("sched %s: runs:%u late avg:%lldus max:%lldus exec max:%lldus overruns:%u skipped:%u\r\n",
+                job->name, job->runs,
+                job->runs ? (long long) (job->late_sum_us / job->runs) : 0LL,
+                (long long) job->late_max_us, (long long) job->exec_max_us,
+                job->overruns, job->skipped);
+    }
+}
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+static int64_t sched_now_us(void)
+{
+    return esp_timer_get_time();
+}
+
+static void sched_sleep_us(int64_t us)
+{
+    // round up so the job never starts before its deadline
+    int64_t tick_us = (int64_t) portTICK_PERIOD_MS * 1000;
+    vTaskDelay((TickType_t) ((us + tick_us - 1) / tick_us));
+}
+
+void sched_init_default(sched_t* s, sched_job_t* jobs, int count)
+{
+    sched_init(s, jobs, count, sched_now_us, sched_sleep_us);
+}
+#endif
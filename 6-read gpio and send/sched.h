@@ -0,0 +1,62 @@
+#ifndef __SCHED_H
+#define __SCHED_H
+
+#include <stdint.h>
+
+/*
+ * Periodic job scheduler
+ *
+ * Jobs run from one task at absolute deadlines (offset + n * period), so the
+ * period does not drift with how long a job takes. Per job it records how
+ * late each run started (jitter), the longest run and the number of overruns.
+ *
+ * Overrun policy, when a job is still behind after running:
+ *   SCHED_CATCH_UP -> run missed periods back to back (at most max_catch_up)
+ *   SCHED_SKIP     -> drop missed periods and realign on the next deadline
+ *
+ * The clock is injected (now_us/sleep_us) so the timing can be simulated.
+ */
+
+typedef enum {
+    SCHED_CATCH_UP = 0,
+    SCHED_SKIP,
+} sched_policy_t;
+
+typedef void (*sched_fn)(void* arg);
+
+typedef struct {
+    const char* name;
+    sched_fn fn;
+    void* arg;
+    uint32_t period_ms;
+    uint32_t offset_ms;     // first run at start + offset
+    sched_policy_t policy;
+
+    int64_t next_us;        // next deadline
+    uint32_t runs;
+    uint32_t overruns;      // runs that ended past the following deadline
+    uint32_t skipped;       // periods dropped
+    int64_t late_max_us;    // worst start latency
+    int64_t late_sum_us;
+    int64_t exec_max_us;    // longest run
+} sched_job_t;
+
+typedef struct {
+    int64_t (*now_us)(void);
+    void (*sleep_us)(int64_t us);
+    sched_job_t* jobs;
+    int job_count;
+    uint32_t max_catch_up;
+} sched_t;
+
+void sched_init(sched_t* s, sched_job_t* jobs, int count,
+        int64_t (*now_us)(void), void (*sleep_us)(int64_t us));
+sched_job_t* sched_run_once(sched_t* s);
+void sched_run(sched_t* s);
+void sched_print_stats(const sched_t* s);
+
+#ifdef ESP_PLATFORM
+void sched_init_default(sched_t* s, sched_job_t* jobs, int count);
+#endif
+
+#endif
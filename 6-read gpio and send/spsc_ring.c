@@ -0,0 +1,56 @@
+/*
+ * Single producer, single consumer ring
+ *
+ * spsc_push() -> 0, or -1 when full (counted in dropped)
+ * spsc_pop()  -> 0, or -1 when empty
+ */
+
+#include <string.h>
+
+#include "spsc_ring.h"
+
+// return -1 if capacity is not a power of two
+int spsc_init(spsc_ring_t* r, void* storage, uint32_t elem_size, uint32_t capacity)
+{
+    memset(r, 0, sizeof(*r));
+    if ((capacity == 0) || ((capacity & (capacity - 1)) != 0)) {
+        return -1;
+    }
+    r->buf = (uint8_t*) storage;
+    r->elem_size = elem_size;
+    r->mask = capacity - 1;
+    return 0;
+}
+
+int spsc_push(spsc_ring_t* r, const void* elem)
+{
+    uint32_t head = r->head;
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+    if ((head - tail) > r->mask) {
+        r->dropped++;
+        return -1;
+    }
+    memcpy(&r->buf[(head & r->mask) * r->elem_size], elem, r->elem_size);
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int spsc_pop(spsc_ring_t* r, void* elem)
+{
+    uint32_t tail = r->tail;
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return -1;
+    }
+    memcpy(elem, &r->buf[(tail & r->mask) * r->elem_size], r->elem_size);
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// elements waiting, exact from either side, a snapshot from any other
+uint32_t spsc_count(const spsc_ring_t* r)
+{
+    return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
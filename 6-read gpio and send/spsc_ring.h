@@ -0,0 +1,30 @@
+#ifndef __SPSC_RING_H
+#define __SPSC_RING_H
+
+#include <stdint.h>
+
+/*
+ * Single producer, single consumer ring
+ *
+ * Fixed size elements copied in and out of caller owned storage, no lock and
+ * no heap. The producer is the only writer of head, the consumer the only
+ * writer of tail; an element is published with a release store of head and
+ * freed with a release store of tail, so the two sides may run on different
+ * cores. Capacity must be a power of two.
+ */
+
+typedef struct {
+    uint8_t* buf;
+    uint32_t elem_size;
+    uint32_t mask;          // capacity - 1
+    uint32_t head;          // producer
+    uint32_t tail;          // consumer
+    uint32_t dropped;       // pushes refused because the ring was full
+} spsc_ring_t;
+
+int spsc_init(spsc_ring_t* r, void* storage, uint32_t elem_size, uint32_t capacity);
+int spsc_push(spsc_ring_t* r, const void* elem);
+int spsc_pop(spsc_ring_t* r, void* elem);
+uint32_t spsc_count(const spsc_ring_t* r);
+
+#endif
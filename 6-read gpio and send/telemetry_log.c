@@ -0,0 +1,414 @@
+/*
+ * Store-and-forward telemetry log
+ *
+ * sector layout
+ *   [sector header 16B][record][record]...[erased]
+ * record layout (4 byte aligned)
+ *   [state 4B][magic 2B][len 2B][seq 4B][crc 4B][data len B]
+ *
+ * Write order is header (state left erased) -> data -> state WRITTEN, so a
+ * record torn by a reset is never handed out. Flash bits are only cleared
+ * between erases: state goes ERASED -> WRITTEN -> CONSUMED.
+ */
+
+#include <string.h>
+
+#include "telemetry_log.h"
+
+#define TLOG_SECTOR_MAGIC       0x474f4c54  // "TLOG"
+#define TLOG_RECORD_MAGIC       0x5a17
+#define TLOG_ERASED_MAGIC       0xffff
+#define TLOG_DATA_START         16
+
+#define TLOG_STATE_ERASED       0xffffffff
+#define TLOG_STATE_WRITTEN      0x0000ffff
+#define TLOG_STATE_CONSUMED     0x00000000
+
+#define TLOG_ALIGN(n)           (((n) + 3) & ~3u)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t reserved[2];
+} tlog_sector_hdr_t;
+
+typedef struct {
+    uint32_t state;
+    uint16_t magic;
+    uint16_t len;
+    uint32_t seq;
+    uint32_t crc;
+} tlog_record_hdr_t;
+
+typedef struct {
+    uint32_t end;           // first free offset, TLOG_SECTOR_SIZE if closed
+    uint32_t first_written; // offset of the first WRITTEN record, 0 if none
+    uint32_t written;       // number of WRITTEN records
+    uint32_t last_seq;
+    uint8_t has_records;
+} tlog_scan_t;
+
+static uint32_t tlog_crc32(const uint8_t* data, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static size_t tlog_addr(uint32_t sector, uint32_t offset)
+{
+    return (size_t) sector * TLOG_SECTOR_SIZE + offset;
+}
+
+static int tlog_record_ok(const tlog_record_hdr_t* hdr, uint32_t offset)
+{
+    return (hdr->magic == TLOG_RECORD_MAGIC)
+            && (hdr->len > 0) && (hdr->len <= TLOG_RECORD_MAX)
+            && (offset + sizeof(*hdr) + hdr->len <= TLOG_SECTOR_SIZE);
+}
+
+static int tlog_sector_ok(tlog_t* log, uint32_t sector, uint32_t* seq)
+{
+    tlog_sector_hdr_t shdr;
+
+    if (log->flash.read(log->flash.ctx, tlog_addr(sector, 0), &shdr, sizeof(shdr)) != ESP_OK) {
+        return 0;
+    }
+    if (shdr.magic != TLOG_SECTOR_MAGIC) {
+        return 0;
+    }
+    if (seq != NULL) {
+        *seq = shdr.seq;
+    }
+    return 1;
+}
+
+static esp_err_t tlog_scan_sector(tlog_t* log, uint32_t sector, tlog_scan_t* scan)
+{
+    tlog_record_hdr_t hdr;
+    uint32_t offset = TLOG_DATA_START;
+    esp_err_t err;
+
+    memset(scan, 0, sizeof(*scan));
+    while (offset + sizeof(hdr) <= TLOG_SECTOR_SIZE) {
+        err = log->flash.read(log->flash.ctx, tlog_addr(sector, offset), &hdr, sizeof(hdr));
+        if (err != ESP_OK) {
+            return err;
+        }
+        if ((hdr.magic == TLOG_ERASED_MAGIC) && (hdr.len == 0xffff)) {
+            scan->end = offset;
+            return ESP_OK;
+        }
+        if (!tlog_record_ok(&hdr, offset)) {
+            // garbage can not be programmed over, close the sector
+            scan->end = TLOG_SECTOR_SIZE;
+            return ESP_OK;
+        }
+        if (hdr.state == TLOG_STATE_WRITTEN) {
+            if (scan->written++ == 0) {
+                scan->first_written = offset;
+            }
+        }
+        scan->last_seq = hdr.seq;
+        scan->has_records = 1;
+        offset += TLOG_ALIGN(sizeof(hdr) + hdr.len);
+    }
+    scan->end = TLOG_SECTOR_SIZE;
+
+    return ESP_OK;
+}
+
+static esp_err_t tlog_start_sector(tlog_t* log, uint32_t sector, uint32_t seq)
+{
+    tlog_sector_hdr_t shdr = {
+        .magic = TLOG_SECTOR_MAGIC,
+        .seq = seq,
+        .reserved = {0xffffffff, 0xffffffff},
+    };
+    esp_err_t err;
+
+    err = log->flash.erase(log->flash.ctx, tlog_addr(sector, 0), TLOG_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = log->flash.write(log->flash.ctx, tlog_addr(sector, 0), &shdr, sizeof(shdr));
+    if (err != ESP_OK) {
+        return err;
+    }
+    log->head_sector = sector;
+    log->head_offset = TLOG_DATA_START;
+    log->head_seq = seq;
+
+    return ESP_OK;
+}
+
+/*
+ * Scan the partition and rebuild both cursors.
+ * An empty or foreign partition is formatted.
+ */
+esp_err_t tlog_open(tlog_t* log, const tlog_flash_t* flash)
+{
+    tlog_scan_t scan;
+    uint32_t seq;
+    int found = 0;
+    int have_read = 0;
+    esp_err_t err;
+
+    memset(log, 0, sizeof(*log));
+    log->flash = *flash;
+    log->sectors = flash->size / TLOG_SECTOR_SIZE;
+    if (log->sectors < 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // newest sector is the head
+    for (uint32_t s = 0; s < log->sectors; s++) {
+        if (tlog_sector_ok(log, s, &seq) && (!found || ((int32_t) (seq - log->head_seq) > 0))) {
+            log->head_sector = s;
+            log->head_seq = seq;
+            found = 1;
+        }
+    }
+    if (!found) {
+        err = tlog_start_sector(log, 0, 1);
+        log->read_sector = 0;
+        log->read_offset = TLOG_DATA_START;
+        return err;
+    }
+
+    // sectors are used round robin, so oldest -> newest starts after the head
+    for (uint32_t i = 1; i <= log->sectors; i++) {
+        uint32_t s = (log->head_sector + i) % log->sectors;
+        if (!tlog_sector_ok(log, s, NULL)) {
+            continue;
+        }
+        err = tlog_scan_sector(log, s, &scan);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (!have_read && (scan.written > 0)) {
+            log->read_sector = s;
+            log->read_offset = scan.first_written;
+            have_read = 1;
+        }
+        if (scan.has_records) {
+            log->next_seq = scan.last_seq + 1;
+        }
+        log->pending += scan.written;
+        if (s == log->head_sector) {
+            log->head_offset = scan.end;
+        }
+    }
+    if (!have_read) {
+        log->read_sector = log->head_sector;
+        log->read_offset = log->head_offset;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t tlog_advance_head(tlog_t* log)
+{
+    uint32_t next = (log->head_sector + 1) % log->sectors;
+    tlog_scan_t scan;
+
+    if (log->read_sector == next) {
+        if (log->pending == 0) {
+            // everything sent, restart reading at the new head
+            log->read_offset = TLOG_DATA_START;
+        } else {
+            // log is full: the oldest sector is recycled with unsent records in it
+            if (tlog_scan_sector(log, next, &scan) == ESP_OK) {
+                uint32_t lost = (scan.written < log->pending) ? scan.written : log->pending;
+                log->dropped += lost;
+                log->pending -= lost;
+            }
+            log->read_sector = (next + 1) % log->sectors;
+            log->read_offset = TLOG_DATA_START;
+        }
+    }
+
+    return tlog_start_sector(log, next, log->head_seq + 1);
+}
+
+esp_err_t tlog_append(tlog_t* log, const void* data, uint16_t len)
+{
+    tlog_record_hdr_t hdr;
+    uint32_t need = TLOG_ALIGN(sizeof(hdr) + len);
+    uint32_t state = TLOG_STATE_WRITTEN;
+    size_t addr;
+    esp_err_t err;
+
+    if ((len == 0) || (len > TLOG_RECORD_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (log->head_offset + need > TLOG_SECTOR_SIZE) {
+        err = tlog_advance_head(log);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    hdr.state = TLOG_STATE_ERASED;
+    hdr.magic = TLOG_RECORD_MAGIC;
+    hdr.len = len;
+    hdr.seq = log->next_seq;
+    hdr.crc = tlog_crc32((const uint8_t*) data, len);
+
+    addr = tlog_addr(log->head_sector, log->head_offset);
+    log->head_offset += need; // the slot is used even if a write below fails
+
+    err = log->flash.write(log->flash.ctx, addr, &hdr, sizeof(hdr));
+    if (err == ESP_OK) {
+        err = log->flash.write(log->flash.ctx, addr + sizeof(hdr), data, len);
+    }
+    if (err == ESP_OK) {
+        err = log->flash.write(log->flash.ctx, addr, &state, sizeof(state));
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    log->next_seq++;
+    log->pending++;
+
+    return ESP_OK;
+}
+
+/*
+ * Copy the oldest unconsumed record into dst without consuming it.
+ * return ESP_ERR_NOT_FOUND if the log is empty,
+ *        ESP_ERR_INVALID_SIZE if the record is larger than cap.
+ */
+esp_err_t tlog_peek(tlog_t* log, void* dst, uint16_t cap, uint16_t* len)
+{
+    tlog_record_hdr_t hdr;
+    esp_err_t err;
+
+    for (;;) {
+        if ((log->read_sector == log->head_sector) && (log->read_offset >= log->head_offset)) {
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        size_t addr = tlog_addr(log->read_sector, log->read_offset);
+        if (log->read_offset + sizeof(hdr) <= TLOG_SECTOR_SIZE) {
+            err = log->flash.read(log->flash.ctx, addr, &hdr, sizeof(hdr));
+            if (err != ESP_OK) {
+                return err;
+            }
+        } else {
+            hdr.magic = TLOG_ERASED_MAGIC;
+        }
+
+        if (!tlog_record_ok(&hdr, log->read_offset)) {
+            // end of this sector
+            if (log->read_sector == log->head_sector) {
+                return ESP_ERR_NOT_FOUND;
+            }
+            log->read_sector = (log->read_sector + 1) % log->sectors;
+            log->read_offset = TLOG_DATA_START;
+            continue;
+        }
+
+        if (hdr.state == TLOG_STATE_WRITTEN) {
+            if (hdr.len > cap) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            err = log->flash.read(log->flash.ctx, addr + sizeof(hdr), dst, hdr.len);
+            if (err != ESP_OK) {
+                return err;
+            }
+            if (tlog_crc32((const uint8_t*) dst, hdr.len) == hdr.crc) {
+                *len = hdr.len;
+                return ESP_OK;
+            }
+            // corrupted data, never hand it out
+            tlog_consume(log);
+            continue;
+        }
+
+        // consumed or torn record
+        log->read_offset += TLOG_ALIGN(sizeof(hdr) + hdr.len);
+    }
+}
+
+/*
+ * Mark the record returned by the last tlog_peek() as sent.
+ */
+esp_err_t tlog_consume(tlog_t* log)
+{
+    tlog_record_hdr_t hdr;
+    uint32_t state = TLOG_STATE_CONSUMED;
+    size_t addr = tlog_addr(log->read_sector, log->read_offset);
+    esp_err_t err;
+
+    if ((log->read_sector == log->head_sector) && (log->read_offset >= log->head_offset)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    err = log->flash.read(log->flash.ctx, addr, &hdr, sizeof(hdr));
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!tlog_record_ok(&hdr, log->read_offset) || (hdr.state != TLOG_STATE_WRITTEN)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    err = log->flash.write(log->flash.ctx, addr, &state, sizeof(state));
+    if (err != ESP_OK) {
+        return err;
+    }
+    log->read_offset += TLOG_ALIGN(sizeof(hdr) + hdr.len);
+    if (log->pending > 0) {
+        log->pending--;
+    }
+
+    return ESP_OK;
+}
+
+uint32_t tlog_pending(const tlog_t* log)
+{
+    return log->pending;
+}
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+
+static esp_err_t tlog_part_read(void* ctx, size_t offset, void* dst, size_t len)
+{
+    return esp_partition_read((const esp_partition_t*) ctx, offset, dst, len);
+}
+
+static esp_err_t tlog_part_write(void* ctx, size_t offset, const void* src, size_t len)
+{
+    return esp_partition_write((const esp_partition_t*) ctx, offset, src, len);
+}
+
+static esp_err_t tlog_part_erase(void* ctx, size_t offset, size_t len)
+{
+    return esp_partition_erase_range((const esp_partition_t*) ctx, offset, len);
+}
+
+esp_err_t tlog_flash_from_partition(tlog_flash_t* flash, const char* label)
+{
+    const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+            ESP_PARTITION_SUBTYPE_ANY, label);
+    if (part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    flash->read = tlog_part_read;
+    flash->write = tlog_part_write;
+    flash->erase = tlog_part_erase;
+    flash->ctx = (void*) part;
+    flash->size = part->size - (part->size % TLOG_SECTOR_SIZE);
+
+    return ESP_OK;
+}
+#endif
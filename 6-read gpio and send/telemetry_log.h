@@ -0,0 +1,59 @@
+#ifndef __TELEMETRY_LOG_H
+#define __TELEMETRY_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*
+ * Store-and-forward telemetry log
+ *
+ * Append-only record log on a raw data partition, used as a ring of sectors:
+ * sectors are filled in order and erased only when the head wraps onto them,
+ * so every sector sees the same number of erase cycles.
+ *
+ * Partition table entry (partitions.csv):
+ *   telemlog, data, 0x99, , 64K
+ *
+ * Nothing is written to NVS: the write cursor is the end of the newest
+ * sector, the read cursor is the oldest record not yet marked consumed.
+ * Records are marked consumed by clearing bits in their state word, so both
+ * cursors are recovered by scanning after a reboot.
+ */
+
+#define TLOG_PARTITION_LABEL    "telemlog"
+#define TLOG_SECTOR_SIZE        4096
+#define TLOG_RECORD_MAX         256
+
+typedef struct {
+    esp_err_t (*read)(void* ctx, size_t offset, void* dst, size_t len);
+    esp_err_t (*write)(void* ctx, size_t offset, const void* src, size_t len);
+    esp_err_t (*erase)(void* ctx, size_t offset, size_t len); // sector aligned
+    void* ctx;
+    size_t size;    // multiple of TLOG_SECTOR_SIZE
+} tlog_flash_t;
+
+typedef struct {
+    tlog_flash_t flash;
+    uint32_t sectors;
+    uint32_t head_sector;   // sector being written
+    uint32_t head_offset;   // next write offset in head_sector
+    uint32_t head_seq;      // sequence number of head_sector
+    uint32_t read_sector;   // read cursor
+    uint32_t read_offset;
+    uint32_t next_seq;      // sequence number of the next record
+    uint32_t pending;       // records written but not consumed
+    uint32_t dropped;       // records overwritten before being consumed
+} tlog_t;
+
+esp_err_t tlog_open(tlog_t* log, const tlog_flash_t* flash);
+esp_err_t tlog_append(tlog_t* log, const void* data, uint16_t len);
+esp_err_t tlog_peek(tlog_t* log, void* dst, uint16_t cap, uint16_t* len);
+esp_err_t tlog_consume(tlog_t* log);
+uint32_t tlog_pending(const tlog_t* log);
+
+#ifdef ESP_PLATFORM
+esp_err_t tlog_flash_from_partition(tlog_flash_t* flash, const char* label);
+#endif
+
+#endif
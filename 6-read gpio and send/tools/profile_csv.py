@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+Profile CSV tool
+
+Reads a console log (idf.py monitor output, or the diag topic payloads)
+holding profile_dump() rows:
+    prof,<seq>,<uptime_ms>,<task>,<core>,<prio>,<cpu_permille>,<stack_free>
+Anything else on the line or in the log is ignored, so a raw capture works.
+Snapshots dumped more than once (the ring is printed whole on every key
+press) are kept once, by seq, so give it the logs of one boot only. Tasks
+pinned to a core are named task@core.
+
+    profile_csv.py monitor.log                  -> cpu_permille, one column per task
+    profile_csv.py --field stack_free log       -> stack_free instead
+    profile_csv.py --summary monitor.log        -> per task avg/max cpu, min stack
+
+Output is CSV on stdout.
+"""
+
+import argparse
+import csv
+import re
+import sys
+
+ROW = re.compile(r"prof,(\d+),(\d+),([^,\s]+),(-?\d+),(\d+),(\d+),(\d+)")
+FIELDS = ("cpu_permille", "stack_free", "prio", "core")
+
+
+def parse(lines):
+    """{seq: (uptime_ms, {task: row})}, a task seen twice keeps its last row"""
+    snaps = {}
+    for line in lines:
+        m = ROW.search(line)
+        if m is None:
+            continue
+        seq, uptime, task, core, prio, cpu, stack = m.groups()
+        row = {"core": int(core), "prio": int(prio), "cpu_permille": int(cpu), "stack_free": int(stack)}
+        # tasks with the same name on two cores stay apart
+        key = task if row["core"] < 0 else "%s@%d" % (task, row["core"])
+        snaps.setdefault(int(seq), (int(uptime), {}))[1][key] = row
+    return snaps
+
+
+def write_table(snaps, field, out):
+    tasks = sorted({t for _, rows in snaps.values() for t in rows})
+    w = csv.writer(out, lineterminator="\n")
+    w.writerow(["seq", "uptime_ms"] + tasks)
+    for seq in sorted(snaps):
+        uptime, rows = snaps[seq]
+        w.writerow([seq, uptime] + [rows[t][field] if t in rows else "" for t in tasks])
+
+
+def write_summary(snaps, out):
+    per_task = {}
+    for _, rows in snaps.values():
+        for task, row in rows.items():
+            per_task.setdefault(task, []).append(row)
+    w = csv.writer(out, lineterminator="\n")
+    w.writerow(["task", "samples", "cpu_avg_permille", "cpu_max_permille", "stack_free_min", "prio"])
+    # busiest first
+    for task, rows in sorted(per_task.items(), key=lambda kv: -sum(r["cpu_permille"] for r in kv[1])):
+        cpu = [r["cpu_permille"] for r in rows]
+        w.writerow([task, len(rows), round(sum(cpu) / len(cpu), 1), max(cpu),
+                    min(r["stack_free"] for r in rows), rows[-1]["prio"]])
+
+
+def main():
+    ap = argparse.ArgumentParser(description="profile_dump() rows to per task CSV")
+    ap.add_argument("log", nargs="*", help="console logs, stdin when none")
+    ap.add_argument("--field", choices=FIELDS, default="cpu_permille", help="table value")
+    ap.add_argument("--summary", action="store_true", help="one row per task instead of a table")
+    args = ap.parse_args()
+
+    snaps = {}
+    if not args.log:
+        snaps = parse(sys.stdin)
+    for name in args.log:
+        with open(name, errors="replace") as f:
+            for seq, (uptime, rows) in parse(f).items():
+                snaps.setdefault(seq, (uptime, {}))[1].update(rows)
+    if not snaps:
+        sys.exit("no prof rows found")
+
+    if args.summary:
+        write_summary(snaps, sys.stdout)
+    else:
+        write_table(snaps, args.field, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
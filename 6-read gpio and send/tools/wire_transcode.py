@@ -0,0 +1,231 @@
+#!/usr/bin/env python3
+"""
+Wire transcoder
+
+Turns one CBOR telemetry envelope (wire.h, WIRE_CBOR) back into the Iotera
+JSON the device sends in WIRE_JSON, byte for byte:
+    {"payload":[{"sensor":..,"param":..,"value":..,"ts":..},...]}
+With dictionary coding the envelope carries "dict":<version>; map keys and
+the sensor/param names sent as indexes are expanded with that table, the
+dict member itself is not part of the JSON. Floats travel as float32 and
+are printed with the decimals the JSON packer uses for them (FLOAT_DECIMALS,
+by key, or by param for an item value), NaN and |v| > 1e18 as null.
+
+    wire_transcode.py payload.cbor      -> JSON on stdout
+    wire_transcode.py < payload.cbor
+    wire_transcode.py --hex dump.txt    -> input is hex text (console capture)
+
+Exit status 1 with a message on a malformed envelope or an unknown dict.
+"""
+
+import argparse
+import math
+import struct
+import sys
+
+# append only, in step with wire_dict_v<n> in main.c
+DICT_V1 = (
+    "sensor", "param", "value", "ts",
+    "wifi_node", "pulse_counter", "battery",
+    "ID", "CH1", "CH2",
+)
+DICT_V2 = DICT_V1 + (
+    "pulse_stats", "edges", "rate", "min_us", "max_us",
+    "p50_us", "p90_us", "p99_us", "bursts", "burst_max",
+)
+DICTS = {1: DICT_V1, 2: DICT_V2}
+
+# wire_float() decimals in main.c
+FLOAT_DECIMALS = {"battery": 6, "rate": 3}
+FLOAT_DECIMALS_DEFAULT = 6
+
+BREAK = object()
+
+
+class WireError(Exception):
+    pass
+
+
+class Float32(float):
+    """a float32 from the wire, kept apart from integers"""
+
+
+class Map(list):
+    """a CBOR map as its (key, value) pairs: the order is kept, keys may be indexes"""
+
+
+class Decoder:
+    """the subset cbor_writer.c emits, plus float16/64 for other senders"""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, n):
+        if self.pos + n > len(self.data):
+            raise WireError("truncated at byte %d" % self.pos)
+        chunk = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return chunk
+
+    def arg(self, info):
+        if info < 24:
+            return info
+        if info in (24, 25, 26, 27):
+            return int.from_bytes(self.take(1 << (info - 24)), "big")
+        raise WireError("bad argument 0x%02x at byte %d" % (info, self.pos - 1))
+
+    def item(self):
+        head = self.take(1)[0]
+        major, info = head >> 5, head & 0x1f
+        if head == 0xff:
+            return BREAK
+        if major == 0:
+            return self.arg(info)
+        if major == 1:
+            return -1 - self.arg(info)
+        if major == 3:
+            return self.take(self.arg(info)).decode("utf-8")
+        if major == 4:
+            if info == 31:
+                out = []
+                while True:
+                    v = self.item()
+                    if v is BREAK:
+                        return out
+                    out.append(v)
+            return [self.value() for _ in range(self.arg(info))]
+        if major == 5:
+            if info == 31:
+                raise WireError("indefinite map at byte %d" % (self.pos - 1))
+            return Map((self.value(), self.value()) for _ in range(self.arg(info)))
+        if major == 7:
+            if info == 25:
+                return Float32(struct.unpack(">e", self.take(2))[0])
+            if info == 26:
+                return Float32(struct.unpack(">f", self.take(4))[0])
+            if info == 27:
+                return Float32(struct.unpack(">d", self.take(8))[0])
+            if info in (20, 21, 22):
+                return (False, True, None)[info - 20]
+        raise WireError("unsupported item 0x%02x at byte %d" % (head, self.pos - 1))
+
+    def value(self):
+        v = self.item()
+        if v is BREAK:
+            raise WireError("unexpected break at byte %d" % (self.pos - 1))
+        return v
+
+
+def json_str(s):
+    """json_str() of json_writer.c: only '"', '\\' and controls are escaped"""
+    out = ['"']
+    for c in s:
+        if c in '"\\':
+            out.append("\\" + c)
+        elif ord(c) < 0x20:
+            out.append("\\u%04x" % ord(c))
+        else:
+            out.append(c)
+    out.append('"')
+    return "".join(out)
+
+
+def json_float(v, decimals):
+    if math.isnan(v) or math.isinf(v) or abs(v) > 1e18:
+        return "null"
+    return "%.*f" % (decimals, v)
+
+
+class Transcoder:
+    def __init__(self, table):
+        self.table = table
+
+    def name(self, v):
+        if isinstance(v, str):
+            return v
+        if (self.table is not None) and isinstance(v, int) and not isinstance(v, bool) \
+                and (0 <= v < len(self.table)):
+            return self.table[v]
+        raise WireError("name %r not in the dictionary" % (v,))
+
+    def value(self, v, key):
+        if isinstance(v, Float32):
+            return json_float(v, FLOAT_DECIMALS.get(key, FLOAT_DECIMALS_DEFAULT))
+        if isinstance(v, bool):
+            return "true" if v else "false"
+        if v is None:
+            return "null"
+        if isinstance(v, int):
+            return str(v)
+        if isinstance(v, str):
+            return json_str(v)
+        if isinstance(v, Map):
+            return self.map(v)
+        if isinstance(v, list):
+            return "[" + ",".join(self.value(x, key) for x in v) + "]"
+        raise WireError("unexpected value %r" % (v,))
+
+    def map(self, pairs, item=False):
+        parts = []
+        param = None
+        for k, v in pairs:
+            k = self.name(k)
+            if item and (k in ("sensor", "param")):
+                v = self.name(v)
+                if k == "param":
+                    param = v
+            # an item value is formatted by its param, a member by its key
+            key = param if (item and k == "value") else k
+            parts.append(json_str(k) + ":" + self.value(v, key))
+        return "{" + ",".join(parts) + "}"
+
+
+def transcode(data):
+    dec = Decoder(data)
+    env = dec.value()
+    if dec.pos != len(data):
+        raise WireError("%d trailing bytes" % (len(data) - dec.pos))
+    if not isinstance(env, Map):
+        raise WireError("envelope is not a map")
+    members = dict(env)
+    table = None
+    if "dict" in members:
+        table = DICTS.get(members["dict"])
+        if table is None:
+            raise WireError("unknown dict version %r" % (members["dict"],))
+    payload = members.get("payload")
+    if not isinstance(payload, list):
+        raise WireError("no payload array")
+    t = Transcoder(table)
+    items = []
+    for item in payload:
+        if not isinstance(item, Map):
+            raise WireError("payload item is not a map")
+        items.append(t.map(item, item=True))
+    return '{"payload":[' + ",".join(items) + "]}"
+
+
+def main():
+    ap = argparse.ArgumentParser(description="CBOR telemetry envelope to Iotera JSON")
+    ap.add_argument("payload", nargs="?", help="CBOR envelope, stdin when none")
+    ap.add_argument("--hex", action="store_true", help="input is hex text")
+    args = ap.parse_args()
+
+    if args.payload:
+        with open(args.payload, "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+    if args.hex:
+        data = bytes.fromhex(data.decode("ascii", errors="replace"))
+
+    try:
+        out = transcode(data)
+    except (WireError, UnicodeDecodeError, ValueError) as e:
+        sys.exit("wire_transcode: %s" % e)
+    sys.stdout.buffer.write(out.encode("utf-8"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,142 @@
+/*
+ * Iotera topic registry, arena backed, FNV-1a hashed for inbound lookup
+ */
+
+#include <string.h>
+
+#include "topics.h"
+
+#define TOPIC_ROOT  "iotera/"
+
+static uint32_t topic_hash(const char* s, int len)
+{
+    uint32_t h = 2166136261u;
+
+    for (int i = 0; i < len; i++) {
+        h ^= (uint8_t) s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int topic_put(topic_table_t* t, const char* s, size_t n)
+{
+    if (n > (size_t) (TOPIC_ARENA_SIZE - t->used)) {
+        return -1;
+    }
+    memcpy(&t->arena[t->used], s, n);
+    t->used += n;
+    return 0;
+}
+
+/*
+ * username: mqtt_<account>_<device>, the device part may contain '_'.
+ * Returns ESP_ERR_INVALID_ARG if a part is missing, ESP_ERR_INVALID_SIZE if
+ * it does not fit the arena.
+ */
+esp_err_t topic_table_init(topic_table_t* t, const char* username)
+{
+    const char* account;
+    const char* device;
+    size_t account_len;
+    size_t device_len;
+
+    memset(t, 0, sizeof(*t));
+    memset(t->slot, TOPIC_NONE, sizeof(t->slot));
+
+    account = strchr(username, '_');
+    if (account == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    account++;
+    device = strchr(account, '_');
+    if ((device == NULL) || (device == account) || (device[1] == '\0')) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    account_len = device - account;
+    device++;
+    device_len = strlen(device);
+
+    if ((topic_put(t, account, account_len) != 0) || (topic_put(t, "/", 1) != 0)
+            || (topic_put(t, device, device_len) != 0) || (topic_put(t, "", 1) != 0)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    t->base_len = (uint16_t) (account_len + 1 + device_len);
+
+    return ESP_OK;
+}
+
+/*
+ * Build iotera/<dir>/<base>/<leaf> and return its id.
+ * Adding a topic that already exists returns the existing id.
+ */
+int topic_add(topic_table_t* t, const char* dir, const char* leaf)
+{
+    uint16_t start = t->used;
+    int id;
+
+    if (t->count == TOPIC_MAX) {
+        return TOPIC_NONE;
+    }
+    if ((topic_put(t, TOPIC_ROOT, sizeof(TOPIC_ROOT) - 1) != 0)
+            || (topic_put(t, dir, strlen(dir)) != 0) || (topic_put(t, "/", 1) != 0)
+            || (topic_put(t, t->arena, t->base_len) != 0) || (topic_put(t, "/", 1) != 0)
+            || (topic_put(t, leaf, strlen(leaf)) != 0)
+            || (t->used - start > UINT8_MAX) || (topic_put(t, "", 1) != 0)) {
+        t->used = start;
+        return TOPIC_NONE;
+    }
+
+    int len = t->used - start - 1;
+    id = topic_lookup(t, &t->arena[start], len);
+    if (id != TOPIC_NONE) {
+        t->used = start;
+        return id;
+    }
+
+    id = t->count++;
+    t->off[id] = start;
+    t->len[id] = (uint8_t) len;
+    t->hash[id] = topic_hash(&t->arena[start], len);
+
+    uint32_t i = t->hash[id] & (TOPIC_HASH_SLOTS - 1);
+    while (t->slot[i] != TOPIC_NONE) {
+        i = (i + 1) & (TOPIC_HASH_SLOTS - 1);
+    }
+    t->slot[i] = (int8_t) id;
+
+    return id;
+}
+
+const char* topic_str(const topic_table_t* t, int id)
+{
+    if ((id < 0) || (id >= t->count)) {
+        return NULL;
+    }
+    return &t->arena[t->off[id]];
+}
+
+int topic_len(const topic_table_t* t, int id)
+{
+    if ((id < 0) || (id >= t->count)) {
+        return 0;
+    }
+    return t->len[id];
+}
+
+// inbound topics are not NUL terminated, len is required
+int topic_lookup(const topic_table_t* t, const char* topic, int len)
+{
+    uint32_t h = topic_hash(topic, len);
+    uint32_t i = h & (TOPIC_HASH_SLOTS - 1);
+
+    while (t->slot[i] != TOPIC_NONE) {
+        int id = t->slot[i];
+        if ((t->hash[id] == h) && (t->len[id] == len)
+                && (memcmp(&t->arena[t->off[id]], topic, len) == 0)) {
+            return id;
+        }
+        i = (i + 1) & (TOPIC_HASH_SLOTS - 1);
+    }
+    return TOPIC_NONE;
+}
@@ -0,0 +1,39 @@
+#ifndef __TOPICS_H
+#define __TOPICS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Iotera topic registry
+ *
+ * The username (mqtt_<account>_<device>) is parsed once with bounds checks
+ * and every topic string is built into one arena:
+ *   iotera/<dir>/<account>/<device>/<leaf>
+ * Topics are referred to by small interned ids. Inbound topics are mapped
+ * back to their id with one hash and one compare (topic_lookup).
+ */
+
+#define TOPIC_MAX           8
+#define TOPIC_ARENA_SIZE    512
+#define TOPIC_HASH_SLOTS    16      // power of two, larger than TOPIC_MAX
+#define TOPIC_NONE          (-1)
+
+typedef struct {
+    char arena[TOPIC_ARENA_SIZE];   // "<account>/<device>", then the topics
+    uint16_t used;
+    uint16_t base_len;              // length of "<account>/<device>"
+    uint8_t count;
+    uint16_t off[TOPIC_MAX];
+    uint8_t len[TOPIC_MAX];
+    uint32_t hash[TOPIC_MAX];
+    int8_t slot[TOPIC_HASH_SLOTS];  // topic id per hash slot, TOPIC_NONE if empty
+} topic_table_t;
+
+esp_err_t topic_table_init(topic_table_t* t, const char* username);
+int topic_add(topic_table_t* t, const char* dir, const char* leaf);
+const char* topic_str(const topic_table_t* t, int id);
+int topic_len(const topic_table_t* t, int id);
+int topic_lookup(const topic_table_t* t, const char* topic, int len);
+
+#endif
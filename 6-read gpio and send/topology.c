@@ -0,0 +1,77 @@
+/*
+ * Task topology
+ *
+ * topology_init()               -> layout for a core count, nothing is created
+ * topology_task_create()        -> xTaskCreatePinnedToCore() on the role's core
+ * topology_task_create_pinned() -> on a given core whatever the roles, for
+ *                                  benchmarks placing load on purpose
+ */
+
+#include "topology.h"
+
+void topology_init(topology_t* t, int cores, int pinned)
+{
+    t->cores = (uint8_t) cores;
+    t->pinned = (pinned && (cores > 1)) ? 1 : 0;
+    t->net_core = 0;
+    t->acq_core = (cores > 1) ? 1 : 0;
+}
+
+// core of the role, TOPO_NO_AFFINITY when it is free to move
+int topology_core(const topology_t* t, topo_role_t role)
+{
+    if (!t->pinned) {
+        return TOPO_NO_AFFINITY;
+    }
+    switch (role) {
+    case TOPO_ACQ:
+        return t->acq_core;
+    case TOPO_NET:
+        return t->net_core;
+    default:
+        return TOPO_NO_AFFINITY;
+    }
+}
+
+#include "esp_log.h"
+
+static const char *TAG = "TOPOLOGY";
+
+static topology_t topology = { .cores = 1 };
+
+// call before any task is created
+void topology_setup(int pinned)
+{
+    topology_init(&topology, portNUM_PROCESSORS, pinned);
+    if (topology.pinned) {
+        ESP_LOGI(TAG, "acquisition on core %d, networking on core %d", topology.acq_core, topology.net_core);
+    } else if (pinned) {
+        ESP_LOGI(TAG, "single core, tasks are not pinned");
+    } else {
+        ESP_LOGI(TAG, "%d core(s), tasks are not pinned", topology.cores);
+    }
+}
+
+const topology_t* topology_get(void)
+{
+    return &topology;
+}
+
+// core TOPO_NO_AFFINITY -> free to move, a core the chip lacks -> ESP_ERR_INVALID_ARG
+esp_err_t topology_task_create_pinned(int core, TaskFunction_t fn, const char* name,
+        uint32_t stack, void* arg, UBaseType_t prio, TaskHandle_t* handle)
+{
+    if ((core != TOPO_NO_AFFINITY) && ((core < 0) || (core >= portNUM_PROCESSORS))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    BaseType_t ok = xTaskCreatePinnedToCore(fn, name, stack, arg, prio, handle,
+            (core == TOPO_NO_AFFINITY) ? tskNO_AFFINITY : core);
+
+    return (ok == pdPASS) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t topology_task_create(topo_role_t role, TaskFunction_t fn, const char* name,
+        uint32_t stack, void* arg, UBaseType_t prio, TaskHandle_t* handle)
+{
+    return topology_task_create_pinned(topology_core(&topology, role), fn, name, stack, arg, prio, handle);
+}
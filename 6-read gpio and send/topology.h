@@ -0,0 +1,49 @@
+#ifndef __TOPOLOGY_H
+#define __TOPOLOGY_H
+
+#include <stdint.h>
+
+/*
+ * Task topology
+ *
+ * Maps task roles to cores. On a dual core ESP32 with pinning enabled:
+ *   TOPO_NET -> core 0, next to the Wi-Fi, lwIP and MQTT client tasks
+ *               (their default core)
+ *   TOPO_ACQ -> core 1, the sampling task and the ISRs it installs
+ * TOPO_ANY tasks, all tasks without pinning and every task on a single core
+ * chip (ESP32-S2) keep no affinity and are ordered by priority only.
+ *
+ * Data between the roles goes through spsc_ring.h rings, tasks only notify.
+ */
+
+#define TOPO_NO_AFFINITY    -1
+
+typedef enum {
+    TOPO_ACQ = 0,
+    TOPO_NET,
+    TOPO_ANY,
+} topo_role_t;
+
+typedef struct {
+    uint8_t cores;
+    uint8_t pinned;     // 0 when pinning was not asked for or is not possible
+    int8_t acq_core;
+    int8_t net_core;
+} topology_t;
+
+void topology_init(topology_t* t, int cores, int pinned);
+int topology_core(const topology_t* t, topo_role_t role);
+
+// FreeRTOS only, also builds against the host shim
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+void topology_setup(int pinned);
+const topology_t* topology_get(void);
+esp_err_t topology_task_create(topo_role_t role, TaskFunction_t fn, const char* name,
+        uint32_t stack, void* arg, UBaseType_t prio, TaskHandle_t* handle);
+esp_err_t topology_task_create_pinned(int core, TaskFunction_t fn, const char* name,
+        uint32_t stack, void* arg, UBaseType_t prio, TaskHandle_t* handle);
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * Edge counting in deep sleep on the ULP coprocessor
+ *
+ * The program is built from the ulp.h macros at run time, no ULP toolchain
+ * is needed. Its data words sit at the start of the reserved RTC slow
+ * memory (CONFIG_ESP32_ULP_COPROC_RESERVE_MEM), the code right after.
+ * Only the ULP writes EDGES and LEVEL, only the CPU writes TAKEN and
+ * WAKE_AFTER, so neither side needs a lock.
+ */
+
+#include "ulp_pulse.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_log.h"
+#include "esp32/ulp.h"
+#include "driver/rtc_io.h"
+#include "soc/rtc_cntl_reg.h"
+#include "soc/rtc_io_reg.h"
+
+static const char *TAG = "ULP_PULSE";
+
+enum {
+    ULP_PULSE_EDGES = 0,        // both edges, wraps at 16 bit
+    ULP_PULSE_LEVEL,            // level seen by the last poll
+    ULP_PULSE_TAKEN,            // EDGES at the last take
+    ULP_PULSE_WAKE_AFTER,       // edges past TAKEN that wake the chip
+    ULP_PULSE_DATA_WORDS = 4,
+};
+
+#define ULP_PULSE_PROG_ADDR     ULP_PULSE_DATA_WORDS
+
+enum {
+    LBL_CHECK = 0,
+    LBL_HALT,
+};
+
+static uint16_t ulp_word(int i)
+{
+    return (uint16_t) (RTC_SLOW_MEM[i] & 0xffff);
+}
+
+esp_err_t ulp_pulse_start(int gpio_num, uint32_t poll_us, int power_on)
+{
+    int bit = RTC_GPIO_IN_NEXT_S + rtc_io_number_get(gpio_num);
+    const ulp_insn_t program[] = {
+        I_MOVI(R3, 0),
+        // count a level change as one edge
+        I_RD_REG(RTC_GPIO_IN_REG, bit, bit),
+        I_LD(R1, R3, ULP_PULSE_LEVEL),
+        I_SUBR(R2, R0, R1),
+        M_BXZ(LBL_CHECK),
+        I_ST(R0, R3, ULP_PULSE_LEVEL),
+        I_LD(R0, R3, ULP_PULSE_EDGES),
+        I_ADDI(R0, R0, 1),
+        I_ST(R0, R3, ULP_PULSE_EDGES),
+        M_LABEL(LBL_CHECK),
+        // wake once EDGES - TAKEN >= WAKE_AFTER, never when WAKE_AFTER is 0
+        I_LD(R1, R3, ULP_PULSE_WAKE_AFTER),
+        I_MOVR(R0, R1),
+        M_BL(LBL_HALT, 1),
+        I_LD(R0, R3, ULP_PULSE_EDGES),
+        I_LD(R2, R3, ULP_PULSE_TAKEN),
+        I_SUBR(R0, R0, R2),
+        I_SUBR(R0, R0, R1),
+        M_BXF(LBL_HALT),
+        // the SoC may still be going to sleep, try again on the next poll
+        I_RD_REG(RTC_CNTL_LOW_POWER_ST_REG, RTC_CNTL_RDY_FOR_WAKEUP_S, RTC_CNTL_RDY_FOR_WAKEUP_S),
+        M_BL(LBL_HALT, 1),
+        I_WAKE(),
+        I_END(),
+        M_LABEL(LBL_HALT),
+        I_HALT(),
+    };
+    size_t size = sizeof(program) / sizeof(ulp_insn_t);
+    esp_err_t err = ESP_OK;
+
+    // the program survives deep sleep and may be running, only load it once
+    if (power_on) {
+        RTC_SLOW_MEM[ULP_PULSE_EDGES] = 0;
+        RTC_SLOW_MEM[ULP_PULSE_LEVEL] = rtc_gpio_get_level(gpio_num);
+        RTC_SLOW_MEM[ULP_PULSE_TAKEN] = 0;
+        RTC_SLOW_MEM[ULP_PULSE_WAKE_AFTER] = 0;
+        err = ulp_process_macros_and_load(ULP_PULSE_PROG_ADDR, program, &size);
+    }
+    if (err == ESP_OK) {
+        err = ulp_set_wakeup_period(0, poll_us);
+    }
+    // restarts the poll timer, a threshold wake stopped it
+    if (err == ESP_OK) {
+        err = ulp_run(ULP_PULSE_PROG_ADDR);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ULP start failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+uint32_t ulp_pulse_take(void)
+{
+    uint16_t edges = ulp_word(ULP_PULSE_EDGES);
+    uint32_t delta = ulp_pulse_delta(edges, ulp_word(ULP_PULSE_TAKEN));
+
+    RTC_SLOW_MEM[ULP_PULSE_TAKEN] = edges;
+    return delta;
+}
+
+void ulp_pulse_arm(uint32_t wake_after)
+{
+    RTC_SLOW_MEM[ULP_PULSE_WAKE_AFTER] = (wake_after > ULP_PULSE_WAKE_MAX) ? ULP_PULSE_WAKE_MAX : wake_after;
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef __ULP_PULSE_H
+#define __ULP_PULSE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Edge counting in deep sleep on the ULP coprocessor
+ *
+ * A small ULP program polls one RTC GPIO every poll period, counts both
+ * edges into RTC slow memory and wakes the chip once wake_after edges were
+ * counted since the last ulp_pulse_take(). The main CPU stays asleep for
+ * every edge in between, the timer wake is left to the caller.
+ *
+ *   ulp_pulse_start() -> load and run the program, on power on also reset
+ *   ulp_pulse_take()  -> edges since the last take
+ *   ulp_pulse_arm()   -> edge count that wakes the chip, 0 -> count only
+ *
+ * The ULP works on 16 bit words: at most ULP_PULSE_WAKE_MAX edges between
+ * two takes, and pulses shorter than the poll period are missed.
+ */
+
+#define ULP_PULSE_WAKE_MAX      0xffff
+
+// edges between two reads of the 16 bit ULP counter
+static inline uint32_t ulp_pulse_delta(uint16_t edges, uint16_t taken)
+{
+    return (uint16_t) (edges - taken);
+}
+
+esp_err_t ulp_pulse_start(int gpio_num, uint32_t poll_us, int power_on);
+uint32_t ulp_pulse_take(void);
+void ulp_pulse_arm(uint32_t wake_after);
+
+#endif
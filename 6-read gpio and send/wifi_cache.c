@@ -0,0 +1,95 @@
+/*
+ * Last good Wi-Fi association, RTC copy in front of an NVS blob
+ */
+
+#include <string.h>
+
+#include "wifi_cache.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#define WIFI_CACHE_NVS_KEY  "last"
+
+static const char *TAG = "WIFI_CACHE";
+
+static RTC_DATA_ATTR wifi_cache_t rtc_cache;
+
+static int wifi_cache_valid(const wifi_cache_t* cache, const char* ssid)
+{
+    return (cache->magic == WIFI_CACHE_MAGIC)
+            && (cache->channel != 0)
+            && (strncmp(cache->ssid, ssid, sizeof(cache->ssid)) == 0);
+}
+
+/*
+ * Fill cache with the last good association for ssid.
+ * Returns ESP_ERR_NOT_FOUND if there is none (first boot, SSID changed,
+ * or the entry was invalidated after a failed directed connect).
+ */
+esp_err_t wifi_cache_load(wifi_cache_t* cache, const char* ssid)
+{
+    nvs_handle_t nvs;
+    size_t len = sizeof(*cache);
+    esp_err_t err;
+
+    if (wifi_cache_valid(&rtc_cache, ssid)) {
+        *cache = rtc_cache;
+        return ESP_OK;
+    }
+
+    // cold boot, RTC memory is lost
+    err = nvs_open(WIFI_CACHE_NVS_NS, NVS_READONLY, &nvs);
+    if (err != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    err = nvs_get_blob(nvs, WIFI_CACHE_NVS_KEY, cache, &len);
+    nvs_close(nvs);
+
+    if ((err != ESP_OK) || (len != sizeof(*cache)) || !wifi_cache_valid(cache, ssid)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    rtc_cache = *cache;
+
+    return ESP_OK;
+}
+
+esp_err_t wifi_cache_save(const wifi_cache_t* cache)
+{
+    wifi_cache_t entry;
+    nvs_handle_t nvs;
+    esp_err_t err;
+
+    memcpy(&entry, cache, sizeof(entry));
+    entry.magic = WIFI_CACHE_MAGIC;
+    if (memcmp(&rtc_cache, &entry, sizeof(entry)) == 0) {
+        return ESP_OK;
+    }
+    rtc_cache = entry;
+
+    err = nvs_open(WIFI_CACHE_NVS_NS, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs, WIFI_CACHE_NVS_KEY, &rtc_cache, sizeof(rtc_cache));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+
+    ESP_LOGI(TAG, "saved channel %d, %s", rtc_cache.channel, rtc_cache.has_ip ? "with lease" : "no lease");
+    return err;
+}
+
+void wifi_cache_invalidate(void)
+{
+    nvs_handle_t nvs;
+
+    memset(&rtc_cache, 0, sizeof(rtc_cache));
+    if (nvs_open(WIFI_CACHE_NVS_NS, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_erase_key(nvs, WIFI_CACHE_NVS_KEY);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef __WIFI_CACHE_H
+#define __WIFI_CACHE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Last good Wi-Fi association
+ *
+ * BSSID, channel and IP lease of the last successful connect, kept in RTC
+ * memory (survives deep sleep) and in NVS (survives power loss). With a
+ * valid entry the station associates directly to the cached AP on the
+ * cached channel instead of scanning, and can skip DHCP by reusing the lease.
+ *
+ * NVS is only written when the entry changes, so a node that wakes every
+ * minute on the same AP does not wear the flash.
+ */
+
+#define WIFI_CACHE_MAGIC        0x57434331  // "WCC1"
+#define WIFI_CACHE_NVS_NS       "wificache"
+
+// no implicit padding, entries are compared with memcmp
+typedef struct {
+    uint32_t magic;
+    uint32_t ip;            // network byte order, as in esp_ip4_addr_t
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t has_ip;
+    char ssid[33];          // entry is only used for the same SSID
+    uint8_t reserved[3];
+} wifi_cache_t;
+
+esp_err_t wifi_cache_load(wifi_cache_t* cache, const char* ssid);
+esp_err_t wifi_cache_save(const wifi_cache_t* cache);
+void wifi_cache_invalidate(void);
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * Telemetry wire format
+ *
+ * JSON goes through the Iotera helpers of the JSON writer, CBOR through the
+ * CBOR writer. Dictionary lookups are a linear scan, dict is meant to stay
+ * short (a few dozen names).
+ */
+
+#include <string.h>
+
+#include "wire.h"
+
+void wire_init(wire_writer_t* w, const wire_config_t* cfg, char* buf, size_t cap)
+{
+    w->cfg = cfg;
+    if (cfg->format == WIRE_CBOR) {
+        cbor_init(&w->cbor, buf, cap);
+    } else {
+        json_init(&w->json, buf, cap);
+    }
+}
+
+size_t wire_mark(const wire_writer_t* w)
+{
+    return (w->cfg->format == WIRE_CBOR) ? w->cbor.len : w->json.len;
+}
+
+// drop everything written after mark, including a latched overflow
+void wire_rewind(wire_writer_t* w, size_t mark)
+{
+    if (w->cfg->format == WIRE_CBOR) {
+        w->cbor.len = mark;
+        w->cbor.overflow = 0;
+    } else {
+        w->json.len = mark;
+        w->json.overflow = 0;
+    }
+}
+
+// 1 if the envelope could no longer be closed (JSON: "]}" + NUL, CBOR: break)
+int wire_full(const wire_writer_t* w)
+{
+    if (w->cfg->format == WIRE_CBOR) {
+        return w->cbor.overflow || (w->cbor.cap - w->cbor.len < 1);
+    }
+    return w->json.overflow || (w->json.cap - w->json.len <= 2);
+}
+
+static int wire_dict_find(const wire_config_t* cfg, const char* name)
+{
+    for (int i = 0; (cfg->dict != NULL) && (i < cfg->dict_len); i++) {
+        if (strcmp(cfg->dict[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void wire_cbor_name(wire_writer_t* w, const char* name)
+{
+    int idx = wire_dict_find(w->cfg, name);
+
+    if (idx < 0) {
+        cbor_text(&w->cbor, name);
+    } else {
+        cbor_uint(&w->cbor, (uint64_t) idx);
+    }
+}
+
+void wire_payload_begin(wire_writer_t* w)
+{
+    if (w->cfg->format != WIRE_CBOR) {
+        iotera_payload_begin(&w->json);
+        return;
+    }
+    if ((w->cfg->dict != NULL) && (w->cfg->dict_version != 0)) {
+        cbor_map(&w->cbor, 2);
+        cbor_text(&w->cbor, "dict");
+        cbor_uint(&w->cbor, w->cfg->dict_version);
+    } else {
+        cbor_map(&w->cbor, 1);
+    }
+    cbor_text(&w->cbor, "payload");
+    cbor_array_indef(&w->cbor);
+}
+
+void wire_item_begin(wire_writer_t* w, const char* sensor, const char* param, int first, int with_ts)
+{
+    if (w->cfg->format != WIRE_CBOR) {
+        iotera_item_begin(&w->json, sensor, param, first);
+        return;
+    }
+    cbor_map(&w->cbor, with_ts ? 4 : 3);
+    wire_cbor_name(w, "sensor");
+    wire_cbor_name(w, sensor);
+    wire_cbor_name(w, "param");
+    wire_cbor_name(w, param);
+    wire_cbor_name(w, "value");
+}
+
+// after the value, only for items opened with with_ts
+void wire_item_ts(wire_writer_t* w, uint32_t ts)
+{
+    wire_key(w, "ts", 0);
+    wire_u64(w, ts);
+}
+
+void wire_item_end(wire_writer_t* w)
+{
+    if (w->cfg->format != WIRE_CBOR) {
+        iotera_item_end(&w->json);
+    }
+}
+
+int wire_payload_end(wire_writer_t* w)
+{
+    if (w->cfg->format != WIRE_CBOR) {
+        return iotera_payload_end(&w->json);
+    }
+    cbor_byte(&w->cbor, CBOR_BREAK);
+    return cbor_finish(&w->cbor);
+}
+
+void wire_map_begin(wire_writer_t* w, uint32_t n)
+{
+    if (w->cfg->format == WIRE_CBOR) {
+        cbor_map(&w->cbor, n);
+    } else {
+        json_lit(&w->json, "{");
+    }
+}
+
+void wire_map_end(wire_writer_t* w)
+{
+    if (w->cfg->format != WIRE_CBOR) {
+        json_lit(&w->json, "}");
+    }
+}
+
+void wire_key(wire_writer_t* w, const char* key, int first)
+{
+    if (w->cfg->format == WIRE_CBOR) {
+        wire_cbor_name(w, key);
+        return;
+    }
+    if (!first) {
+        json_lit(&w->json, ",");
+    }
+    json_str(&w->json, key);
+    json_lit(&w->json, ":");
+}
+
+void wire_str(wire_writer_t* w, const char* s)
+{
+    if (w->cfg->format == WIRE_CBOR) {
+        cbor_text(&w->cbor, s);
+    } else {
+        json_str(&w->json, s);
+    }
+}
+
+void wire_u64(wire_writer_t* w, uint64_t v)
+{
+    if (w->cfg->format == WIRE_CBOR) {
+        cbor_uint(&w->cbor, v);
+    } else {
+        json_u64(&w->json, v);
+    }
+}
+
+// decimals applies to JSON only, CBOR always carries the full float32
+void wire_float(wire_writer_t* w, float v, int decimals)
+{
+    if (w->cfg->format == WIRE_CBOR) {
+        cbor_float(&w->cbor, v);
+    } else {
+        json_float(&w->json, v, decimals);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef __WIRE_H
+#define __WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "json_writer.h"
+#include "cbor_writer.h"
+
+/*
+ * Telemetry wire format
+ *
+ * One writer for the Iotera envelope in either encoding:
+ *   WIRE_JSON -> {"payload":[{"sensor":..,"param":..,"value":..,"ts":..},...]}
+ *   WIRE_CBOR -> the same maps and arrays in CBOR, payload array of
+ *                indefinite length so items can be streamed
+ *
+ * With a dictionary (CBOR only) every map key and sensor/param name found in
+ * dict is sent as its index instead of text, and the envelope carries
+ * "dict":<dict_version> so a gateway knows which table to expand with:
+ *   {"dict":1,"payload":[{0:5,1:6,2:{..},3:1700000000},...]}
+ * Names missing from dict stay text. The envelope keys are never coded.
+ */
+
+typedef enum {
+    WIRE_JSON = 0,
+    WIRE_CBOR,
+} wire_format_t;
+
+typedef struct {
+    wire_format_t format;
+    const char* const* dict;    // NULL -> no dictionary
+    uint8_t dict_len;
+    uint8_t dict_version;       // sent in the envelope, keep in sync with the gateway
+} wire_config_t;
+
+typedef struct {
+    const wire_config_t* cfg;
+    union {
+        json_writer_t json;
+        cbor_writer_t cbor;
+    };
+} wire_writer_t;
+
+void wire_init(wire_writer_t* w, const wire_config_t* cfg, char* buf, size_t cap);
+size_t wire_mark(const wire_writer_t* w);
+void wire_rewind(wire_writer_t* w, size_t mark);
+int wire_full(const wire_writer_t* w);
+
+void wire_payload_begin(wire_writer_t* w);
+void wire_item_begin(wire_writer_t* w, const char* sensor, const char* param, int first, int with_ts);
+void wire_item_ts(wire_writer_t* w, uint32_t ts);
+void wire_item_end(wire_writer_t* w);
+int wire_payload_end(wire_writer_t* w);
+
+// values, keys of a map need first set on the first key only
+void wire_map_begin(wire_writer_t* w, uint32_t n);
+void wire_map_end(wire_writer_t* w);
+void wire_key(wire_writer_t* w, const char* key, int first);
+void wire_str(wire_writer_t* w, const char* s);
+void wire_u64(wire_writer_t* w, uint64_t v);
+void wire_float(wire_writer_t* w, float v, int decimals);
+
+#endif
@@ -31,23 +31,32 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
-#include "freertos/queue.h"
 
 #include "esp_wifi.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_system.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
 #include "mqtt_client.h"
 #include "nvs_flash.h"
-#include "cJSON.h"
 
 #include "driver/gpio.h"
+#include "driver/ledc.h"
 
 #include "lwip/sockets.h"
 #include "lwip/dns.h"
 #include "lwip/netdb.h"
 
+/*
+ * The JSON writer and the topic registry are the modules of
+ * "6-read gpio and send", not copies: build this file with json_writer.c/.h
+ * and topics.c/.h from that directory next to it in main/, so a fix there
+ * lands in both programs.
+ */
+#include "json_writer.h"
+#include "topics.h"
+
 /* Set the SSID and Password via project configuration, or can set directly here */
 #define DEFAULT_SSID "SSID"
 #define DEFAULT_PWD "PASSWORD"
@@ -138,71 +147,566 @@ static void fast_scan(void)
     ESP_ERROR_CHECK(esp_wifi_start());
 }
 
+// START OF COMMAND PARSER
+
+/*
+ * Streaming command parser
+ *
+ * Pulls "id", "param", "value" and the optional "sensor" out of the top
+ * level object of a command such as {"id":"...","param":"turnon","value":1}. Bytes are fed as they
+ * arrive, so a message split over several MQTT_EVENT_DATA chunks is parsed
+ * without reassembly. No heap, the whole state lives in cmd_parser_t.
+ * Other keys and nested values are skipped.
+ */
+#define CMD_ID_MAX      64
+#define CMD_PARAM_MAX   32
+#define CMD_TOKEN_MAX   24
+
+#define CMD_HAVE_ID     0x01
+#define CMD_HAVE_PARAM  0x02
+#define CMD_HAVE_VALUE  0x04
+#define CMD_HAVE_SENSOR 0x08
+#define CMD_HAVE_ALL    (CMD_HAVE_ID | CMD_HAVE_PARAM | CMD_HAVE_VALUE)
+
+typedef enum {
+    CMD_PARSE_MORE = 0,
+    CMD_PARSE_DONE,
+    CMD_PARSE_ERROR,
+} cmd_parse_stat_t;
+
+typedef enum {
+    CMD_ST_START = 0,   // expect '{'
+    CMD_ST_KEY_OR_END,  // expect '"' or '}'
+    CMD_ST_KEY_START,   // expect '"'
+    CMD_ST_KEY,         // inside key string
+    CMD_ST_COLON,       // expect ':'
+    CMD_ST_VALUE,       // expect start of a value
+    CMD_ST_STRING,      // inside string value
+    CMD_ST_NUMBER,      // inside number
+    CMD_ST_LITERAL,     // inside true/false/null
+    CMD_ST_SKIP,        // inside nested object/array
+    CMD_ST_NEXT,        // expect ',' or '}'
+    CMD_ST_DONE,
+    CMD_ST_ERROR,
+} cmd_state_t;
+
+typedef enum {
+    CMD_KEY_OTHER = 0,
+    CMD_KEY_ID,
+    CMD_KEY_PARAM,
+    CMD_KEY_VALUE,
+    CMD_KEY_SENSOR,
+} cmd_key_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t key;
+    uint8_t esc;        // 1 -> after '\', >1 -> remaining \uXXXX hex digits + 1
+    uint8_t skip_str;   // inside a string while skipping
+    uint8_t depth;      // nesting depth while skipping
+    uint8_t have;       // CMD_HAVE_x bits
+    char tok[CMD_TOKEN_MAX];
+    uint8_t tok_len;
+    char* dst;          // string destination, NULL -> discard
+    uint8_t dst_cap;
+    uint8_t dst_len;
+    char id[CMD_ID_MAX];
+    char param[CMD_PARAM_MAX];
+    char sensor[CMD_PARAM_MAX];
+    int32_t value;
+} cmd_parser_t;
+
+static void cmd_parser_reset(cmd_parser_t* p)
+{
+    memset(p, 0, sizeof(*p));
+}
+
+static int cmd_is_ws(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+static int32_t cmd_atoi(const char* s, size_t n)
+{
+    int32_t v = 0;
+    int neg = 0;
+    size_t i = 0;
+
+    if ((n > 0) && (s[0] == '-')) {
+        neg = 1;
+        i++;
+    }
+    // integer part only, "1.0" -> 1
+    for (; (i < n) && (s[i] >= '0') && (s[i] <= '9'); i++) {
+        if (v > (INT32_MAX - 9) / 10) {
+            break; // saturate instead of overflowing
+        }
+        v = v * 10 + (s[i] - '0');
+    }
+    return neg ? -v : v;
+}
+
+// start collecting a string into dst (NULL -> discard)
+static void cmd_string_begin(cmd_parser_t* p, char* dst, uint8_t cap)
+{
+    p->dst = dst;
+    p->dst_cap = cap;
+    p->dst_len = 0;
+    p->esc = 0;
+}
+
+/*
+ * Consume one string byte.
+ * return 1 at the closing quote, 0 otherwise, -1 if dst is too small
+ */
+static int cmd_string_byte(cmd_parser_t* p, char c)
+{
+    if (p->esc > 1) {
+        // \uXXXX: hex digits are dropped, '?' was stored for the code point
+        if (--p->esc == 1) {
+            p->esc = 0; // last digit, the next byte is plain again
+        }
+        return 0;
+    }
+    if (p->esc == 1) {
+        p->esc = 0;
+        switch (c) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'u': c = '?'; p->esc = 5; break;
+            default: break;
+        }
+    } else if (c == '\\') {
+        p->esc = 1;
+        return 0;
+    } else if (c == '"') {
+        if (p->dst != NULL) {
+            p->dst[p->dst_len] = '\0';
+        }
+        return 1;
+    }
+
+    if (p->dst != NULL) {
+        if (p->dst_len + 1 >= p->dst_cap) {
+            return -1;
+        }
+        p->dst[p->dst_len++] = c;
+    }
+    return 0;
+}
+
+static void cmd_value_end(cmd_parser_t* p)
+{
+    if (p->key == CMD_KEY_VALUE) {
+        p->tok[p->tok_len] = '\0';
+        if ((p->tok_len == 4) && (memcmp(p->tok, "true", 4) == 0)) {
+            p->value = 1;
+        } else if ((p->tok_len == 5) && (memcmp(p->tok, "false", 5) == 0)) {
+            p->value = 0;
+        } else {
+            p->value = cmd_atoi(p->tok, p->tok_len);
+        }
+        p->have |= CMD_HAVE_VALUE;
+    }
+    p->state = CMD_ST_NEXT;
+}
+
+static int cmd_parse_byte(cmd_parser_t* p, char c)
+{
+    int r;
+
+    switch (p->state) {
+        case CMD_ST_START:
+            if (c == '{') {
+                p->state = CMD_ST_KEY_OR_END;
+            } else if (!cmd_is_ws(c)) {
+                return -1;
+            }
+            break;
+        case CMD_ST_KEY_OR_END:
+        case CMD_ST_KEY_START:
+            if (c == '"') {
+                cmd_string_begin(p, p->tok, sizeof(p->tok));
+                p->state = CMD_ST_KEY;
+            } else if ((c == '}') && (p->state == CMD_ST_KEY_OR_END)) {
+                p->state = CMD_ST_DONE;
+            } else if (!cmd_is_ws(c)) {
+                return -1;
+            }
+            break;
+        case CMD_ST_KEY:
+            r = cmd_string_byte(p, c);
+            if (r < 0) {
+                // longer than any key we look for
+                cmd_string_begin(p, NULL, 0);
+                p->key = CMD_KEY_OTHER;
+            } else if (r > 0) {
+                if (p->dst == NULL) {
+                    p->key = CMD_KEY_OTHER;
+                } else if (strcmp(p->tok, "id") == 0) {
+                    p->key = CMD_KEY_ID;
+                } else if (strcmp(p->tok, "param") == 0) {
+                    p->key = CMD_KEY_PARAM;
+                } else if (strcmp(p->tok, "value") == 0) {
+                    p->key = CMD_KEY_VALUE;
+                } else if (strcmp(p->tok, "sensor") == 0) {
+                    p->key = CMD_KEY_SENSOR;
+                } else {
+                    p->key = CMD_KEY_OTHER;
+                }
+                p->state = CMD_ST_COLON;
+            }
+            break;
+        case CMD_ST_COLON:
+            if (c == ':') {
+                p->state = CMD_ST_VALUE;
+            } else if (!cmd_is_ws(c)) {
+                return -1;
+            }
+            break;
+        case CMD_ST_VALUE:
+            if (cmd_is_ws(c)) {
+                break;
+            }
+            p->tok_len = 0;
+            if (c == '"') {
+                if (p->key == CMD_KEY_ID) {
+                    cmd_string_begin(p, p->id, sizeof(p->id));
+                } else if (p->key == CMD_KEY_PARAM) {
+                    cmd_string_begin(p, p->param, sizeof(p->param));
+                } else if (p->key == CMD_KEY_VALUE) {
+                    cmd_string_begin(p, p->tok, sizeof(p->tok));
+                } else if (p->key == CMD_KEY_SENSOR) {
+                    cmd_string_begin(p, p->sensor, sizeof(p->sensor));
+                } else {
+                    cmd_string_begin(p, NULL, 0);
+                }
+                p->state = CMD_ST_STRING;
+            } else if ((c == '{') || (c == '[')) {
+                p->depth = 1;
+                p->skip_str = 0;
+                p->esc = 0;
+                p->state = CMD_ST_SKIP;
+            } else if ((c == '-') || ((c >= '0') && (c <= '9'))) {
+                p->tok[p->tok_len++] = c;
+                p->state = CMD_ST_NUMBER;
+            } else if ((c >= 'a') && (c <= 'z')) {
+                p->tok[p->tok_len++] = c;
+                p->state = CMD_ST_LITERAL;
+            } else {
+                return -1;
+            }
+            break;
+        case CMD_ST_STRING:
+            r = cmd_string_byte(p, c);
+            if (r < 0) {
+                return -1;
+            } else if (r > 0) {
+                if (p->key == CMD_KEY_ID) {
+                    p->have |= CMD_HAVE_ID;
+                } else if (p->key == CMD_KEY_PARAM) {
+                    p->have |= CMD_HAVE_PARAM;
+                } else if (p->key == CMD_KEY_SENSOR) {
+                    p->have |= CMD_HAVE_SENSOR;
+                } else if (p->key == CMD_KEY_VALUE) {
+                    // "value":"1" is accepted as a number
+                    p->tok_len = p->dst_len;
+                    cmd_value_end(p);
+                    break;
+                }
+                p->state = CMD_ST_NEXT;
+            }
+            break;
+        case CMD_ST_NUMBER:
+        case CMD_ST_LITERAL:
+            if (((p->state == CMD_ST_NUMBER) && (((c >= '0') && (c <= '9')) || (c == '.') || (c == '-') || (c == '+') || (c == 'e') || (c == 'E')))
+                    || ((p->state == CMD_ST_LITERAL) && (c >= 'a') && (c <= 'z'))) {
+                if (p->tok_len + 1 >= (int) sizeof(p->tok)) {
+                    return -1;
+                }
+                p->tok[p->tok_len++] = c;
+                break;
+            }
+            cmd_value_end(p);
+            return cmd_parse_byte(p, c); // c belongs to the next token
+        case CMD_ST_SKIP:
+            if (p->skip_str) {
+                if (p->esc) {
+                    p->esc = 0;
+                } else if (c == '\\') {
+                    p->esc = 1;
+                } else if (c == '"') {
+                    p->skip_str = 0;
+                }
+            } else if (c == '"') {
+                p->skip_str = 1;
+            } else if ((c == '{') || (c == '[')) {
+                if (++p->depth == 0) {
+                    return -1;
+                }
+            } else if ((c == '}') || (c == ']')) {
+                if (--p->depth == 0) {
+                    p->state = CMD_ST_NEXT;
+                }
+            }
+            break;
+        case CMD_ST_NEXT:
+            if (c == ',') {
+                p->state = CMD_ST_KEY_START;
+            } else if (c == '}') {
+                p->state = CMD_ST_DONE;
+            } else if (!cmd_is_ws(c)) {
+                return -1;
+            }
+            break;
+        case CMD_ST_DONE:
+            if (!cmd_is_ws(c)) {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+/*
+ * Feed the next chunk of a message (not NUL terminated, len bytes).
+ * return CMD_PARSE_DONE once the top level object is closed.
+ */
+static cmd_parse_stat_t cmd_parser_feed(cmd_parser_t* p, const char* data, int len)
+{
+    for (int i = 0; (i < len) && (p->state != CMD_ST_ERROR); i++) {
+        if (cmd_parse_byte(p, data[i]) < 0) {
+            p->state = CMD_ST_ERROR;
+        }
+    }
+
+    if (p->state == CMD_ST_ERROR) {
+        return CMD_PARSE_ERROR;
+    }
+    return (p->state == CMD_ST_DONE) ? CMD_PARSE_DONE : CMD_PARSE_MORE;
+}
+
+// END OF COMMAND PARSER
+
+// START OF COMMAND DISPATCH
+
+/*
+ * Command routes, (param, sensor) -> handler
+ *
+ * cmd_routes[] is sorted by param, then sensor (strcmp order), so a command
+ * is found with a binary search instead of a strcmp chain; the order is
+ * checked once at startup. A command without "sensor" goes to the first
+ * route of its param.
+ * Every command is answered on command_result: handlers only drive their
+ * actuator and return the value to report, cmd_confirm() builds the reply.
+ */
+#define CMD_RESULT_OK       0
+#define CMD_RESULT_FAILED   1
+#define CMD_RESULT_UNKNOWN  2
+
+typedef int (*cmd_handler_t)(int32_t value, int32_t* report);
+
+// parsed command, as queued for the worker
+typedef struct {
+    char id[CMD_ID_MAX];
+    char param[CMD_PARAM_MAX];
+    char sensor[CMD_PARAM_MAX];
+    uint8_t have;               // CMD_HAVE_x bits
+    int32_t value;
+} cmd_msg_t;
+
+typedef struct {
+    const char* param;          // command param
+    const char* sensor;         // actuator, echoed in the confirm
+    const char* report_param;   // param of the confirmed value
+    cmd_handler_t handler;
+} cmd_route_t;
+
+static uint8_t actuator_request(uint8_t blink);
+
+static int cmd_turnon(int32_t value, int32_t* report)
+{
+    *report = actuator_request(value != 0);
+    return CMD_RESULT_OK;
+}
+
+static const cmd_route_t cmd_routes[] = {
+    // keep sorted by param, then sensor
+    { "turnon", "led_onboard", "ledstat", cmd_turnon },
+};
+#define CMD_ROUTE_COUNT     ((int) (sizeof(cmd_routes) / sizeof(cmd_routes[0])))
+
+static int cmd_route_cmp(const cmd_route_t* r, const char* param, const char* sensor)
+{
+    int c = strcmp(r->param, param);
+    return ((c != 0) || (sensor == NULL)) ? c : strcmp(r->sensor, sensor);
+}
+
+// the tables are passed in so the host tests can run them on any size
+static esp_err_t cmd_routes_check(const cmd_route_t* routes, int count)
+{
+    for (int i = 1; i < count; i++) {
+        if (cmd_route_cmp(&routes[i - 1], routes[i].param, routes[i].sensor) >= 0) {
+            ESP_LOGE(TAG, "cmd_routes[] not sorted at %s/%s", routes[i].param, routes[i].sensor);
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    return ESP_OK;
+}
+
+// sensor NULL -> first route of param
+static const cmd_route_t* cmd_route_find(const cmd_route_t* routes, int count,
+        const char* param, const char* sensor)
+{
+    int lo = 0;
+    int hi = count;
+
+    // lower bound
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cmd_route_cmp(&routes[mid], param, sensor) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if ((lo < count) && (cmd_route_cmp(&routes[lo], param, sensor) == 0)) {
+        return &routes[lo];
+    }
+    return NULL;
+}
+
+/*
+ * command_result payload
+ * {"result":0,"id":"..","payload":[{"sensor":"..","param":"..","configtype":"data","value":1}]}
+ * an unknown command is answered with an empty payload.
+ */
+static int cmd_confirm(char* buf, size_t cap, const char* id, int result,
+        const cmd_route_t* route, int32_t value)
+{
+    json_writer_t w;
+
+    json_init(&w, buf, cap);
+    json_lit(&w, "{\"result\":");
+    json_i64(&w, result);
+    json_lit(&w, ",\"id\":");
+    json_str(&w, id);
+    json_lit(&w, ",\"payload\":[");
+    if (route != NULL) {
+        json_lit(&w, "{\"sensor\":");
+        json_str(&w, route->sensor);
+        json_lit(&w, ",\"param\":");
+        json_str(&w, route->report_param);
+        json_lit(&w, ",\"configtype\":\"data\",\"value\":");
+        json_i64(&w, value);
+        json_lit(&w, "}");
+    }
+    json_lit(&w, "]}");
+
+    return json_finish(&w);
+}
+
+/*
+ * Run the handler of a parsed command and write its confirm into buf.
+ * return the confirm length, -1 if it does not fit
+ */
+static int cmd_dispatch(const cmd_msg_t* cmd, char* buf, size_t cap)
+{
+    const char* sensor = (cmd->have & CMD_HAVE_SENSOR) ? cmd->sensor : NULL;
+    const cmd_route_t* route = cmd_route_find(cmd_routes, CMD_ROUTE_COUNT, cmd->param, sensor);
+    int32_t report = 0;
+    int result;
+
+    if (route == NULL) {
+        printf("unknown command %s/%s\n", sensor ? sensor : "-", cmd->param);
+        return cmd_confirm(buf, cap, cmd->id, CMD_RESULT_UNKNOWN, NULL, 0);
+    }
+    result = route->handler(cmd->value, &report);
+
+    return cmd_confirm(buf, cap, cmd->id, result, route, report);
+}
+
+// END OF COMMAND DISPATCH
+
 // START OF MQTT & SENDING DATA
 const char mqtt_url[] = "mqtt://mqtt.iotera.io";
 const char mqtt_username[] = ;
 const char mqtt_password[] = ;
 uint32_t mqtt_port = 1883;
 
-uint8_t turnon = 0;
-
-int mqtt_global_stat;
+// written by the MQTT task, read from the app tasks
+static int mqtt_global_stat = 0;
 void mqtt_init(const char* mqtt_server, int mqtt_port, const char* username, const char* pass);
-int mqtt_publish_iotera(char* payload);
+int mqtt_publish_iotera(const char* payload, int len);
 int mqtt_subscribe_iotera(void);
 void mqtt_data_handling(esp_mqtt_event_handle_t event);
-void generate_topic(const char* username);
 
-esp_mqtt_client_handle_t client;
+static esp_mqtt_client_handle_t client = NULL;   // set once in mqtt_init
 char confirm_payload[512];	
-char mqtt_online_topic[256];
-char mqtt_lastwill_topic[256];
-char mqtt_topic[256];
-char mqtt_confirm_topic[256];
-int msg_id;
+static topic_table_t topics;
+static int topic_command = TOPIC_NONE;
+static int topic_confirm = TOPIC_NONE;
+static int topic_online = TOPIC_NONE;
+static int topic_offline = TOPIC_NONE;
+
+static void mqtt_set_state(int state)
+{
+    __atomic_store_n(&mqtt_global_stat, state, __ATOMIC_RELEASE);
+}
+
+static int mqtt_is_connected(void)
+{
+    int state = __atomic_load_n(&mqtt_global_stat, __ATOMIC_ACQUIRE);
+    return (state != 0) && (state != 2);
+}
 
 static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
 {
-    client = event->client;
+    int msg_id;
     // your_context_t *context = event->context;
     switch (event->event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
-            msg_id = esp_mqtt_client_publish(client, mqtt_online_topic, NULL, 0, 1, 0);
+            msg_id = esp_mqtt_client_publish(client, topic_str(&topics, topic_online), NULL, 0, 1, 0);
             ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
 
-            msg_id = esp_mqtt_client_subscribe(client, mqtt_topic, 0);
+            msg_id = esp_mqtt_client_subscribe(client, topic_str(&topics, topic_command), 0);
             ESP_LOGI(TAG, "sent subscribe successful, msg_id=%d", msg_id);
 
-            mqtt_global_stat = 1;
+            mqtt_set_state(1);
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
-            mqtt_global_stat = 2;
+            mqtt_set_state(2);
             break;
 
         case MQTT_EVENT_SUBSCRIBED:
             ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
-            msg_id = esp_mqtt_client_publish(client, mqtt_topic, "Device subscribed", 0, 0, 0);
+            msg_id = esp_mqtt_client_publish(client, topic_str(&topics, topic_command), "Device subscribed", 0, 0, 0);
             ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
-            mqtt_global_stat = 3;
+            mqtt_set_state(3);
             break;
         case MQTT_EVENT_UNSUBSCRIBED:
             ESP_LOGI(TAG, "MQTT_EVENT_UNSUBSCRIBED, msg_id=%d", event->msg_id);
-            mqtt_global_stat = 4;
+            mqtt_set_state(4);
             break;
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
-            mqtt_global_stat = 5;
+            mqtt_set_state(5);
             break;
         case MQTT_EVENT_DATA:
             ESP_LOGI(TAG, "MQTT_EVENT_DATA");
             mqtt_data_handling(event);
-            mqtt_global_stat = 6;
+            mqtt_set_state(6);
             break;
         case MQTT_EVENT_ERROR:
             ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
-            mqtt_global_stat = 0;
+            mqtt_set_state(0);
             break;
         default:
             ESP_LOGI(TAG, "Other event id:%d", event->event_id);
@@ -237,17 +741,30 @@ void mqtt_init(const char* mqtt_server, int mqtt_port, const char* username, con
     ESP_ERROR_CHECK(esp_netif_init());
     //ESP_ERROR_CHECK(esp_event_loop_create_default());
 
-    generate_topic(username);// generate topic for iotera platform
+    // build the iotera topics once
+    if (topic_table_init(&topics, username) != ESP_OK) {
+        ESP_LOGE(TAG, "invalid iotera username");
+        return;
+    }
+    topic_command = topic_add(&topics, "sub", "command");
+    topic_confirm = topic_add(&topics, "pub", "command_result");
+    topic_online = topic_add(&topics, "pub", "online");
+    topic_offline = topic_add(&topics, "pub", "offline");
+    for (int i = 0; i < TOPIC_MAX; i++) {
+        if (topic_str(&topics, i) != NULL) {
+            printf("%s\r\n", topic_str(&topics, i));
+        }
+    }
 
     esp_mqtt_client_config_t mqtt_cfg = {
     		.uri = mqtt_server,
     		.port = mqtt_port,
     		.username = username,
     		.password = pass,
-            .lwt_topic = mqtt_lastwill_topic
+            .lwt_topic = topic_str(&topics, topic_offline)
     };
 
-    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
+    client = esp_mqtt_client_init(&mqtt_cfg);
     esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, client);
     esp_mqtt_client_start(client);
 }
@@ -258,12 +775,12 @@ void mqtt_init(const char* mqtt_server, int mqtt_port, const char* username, con
  *
  *
  */
-int mqtt_publish_iotera(char* payload)
+int mqtt_publish_iotera(const char* payload, int len)
 {
 	int pub_stat = 0;
-	if ((mqtt_global_stat != 0) && (mqtt_global_stat != 2)){
-		// publish payload
-		pub_stat = esp_mqtt_client_publish(client,mqtt_confirm_topic,payload,0, 1, 0);
+	if (mqtt_is_connected()){
+		// publish payload, len 0 -> strlen(payload)
+		pub_stat = esp_mqtt_client_publish(client,topic_str(&topics, topic_confirm),payload,len, 1, 0);
 	}
 
 	return pub_stat;
@@ -272,112 +789,308 @@ int mqtt_publish_iotera(char* payload)
 int mqtt_subscribe_iotera()
 {
     int subs_stat = 0;
-	if ((mqtt_global_stat != 0) && (mqtt_global_stat != 2)){
+	if (mqtt_is_connected()){
 		// subscribe
-		subs_stat = esp_mqtt_client_subscribe(client,mqtt_topic, 0);
+		subs_stat = esp_mqtt_client_subscribe(client,topic_str(&topics, topic_command), 0);
 	}
 
 	return subs_stat;
 }
 
-void mqtt_data_handling(esp_mqtt_event_handle_t data_event)
+/*
+ * Inbound commands
+ *
+ * The MQTT task only parses (streaming, bounded per byte) and copies the
+ * command into cmd_queue without waiting; the handler, the actuator and the
+ * confirm publish run in cmd_worker. A full queue drops the command and
+ * counts it, the callback time is measured on every MQTT_EVENT_DATA.
+ */
+#define CMD_QUEUE_LEN       8
+#define CMD_WORKER_STACK    3072
+#if CONFIG_EXAMPLE_CMD_WORKER_PRIO
+#define CMD_WORKER_PRIO     CONFIG_EXAMPLE_CMD_WORKER_PRIO
+#else
+#define CMD_WORKER_PRIO     5
+#endif
+
+typedef struct {
+    uint32_t received;
+    uint32_t dropped;       // queue full
+    uint32_t invalid;
+    uint32_t depth_max;     // queue high water mark
+    uint32_t cb_calls;
+    uint32_t cb_max_us;     // longest mqtt_data_handling
+    uint32_t cb_sum_us;
+} cmd_stats_t;
+
+static xQueueHandle cmd_queue = NULL;
+static cmd_stats_t cmd_stats;   // written by the MQTT task, read by cmd_worker
+
+// relaxed like metrics.c: every field is read whole, a snapshot may mix
+// fields of two updates
+static void cmd_stat_add(uint32_t* v, uint32_t n)
 {
-    printf("TOPIC=%.*s\r\n", data_event->topic_len, data_event->topic);
-    printf("DATA=%.*s\r\n", data_event->data_len, data_event->data);
-
-    cJSON *root = cJSON_Parse(data_event->data);
-    if (cJSON_IsObject(root)) {
-        int n = cJSON_GetArraySize(root);
-        printf("Num JSON element: %d\n", n);
-        char *id;
-        char *param;
-        uint8_t value;
-        id = cJSON_GetStringValue(cJSON_GetObjectItem(root, "id"));
-        param = cJSON_GetStringValue(cJSON_GetObjectItem(root, "param"));
-        value = cJSON_GetObjectItem(root, "value")->valueint;
-        printf("%s %s %d\n", id, param, value);
-
-        if (strcmp(param, "turnon") == 0) {
-            turnon = value;
-            bzero(confirm_payload,512);
-            // Pack data
-            sprintf(confirm_payload,"{\"result\":0,\"id\":\"%s\",\"payload\":["
-            "{\"sensor\":\"led_onboard\",\"param\":\"ledstat\",\"configtype\":\"data\",\"value\":%d}]}",
-            id, turnon);
-
-            mqtt_publish_iotera(confirm_payload);
-        }
+    __atomic_fetch_add(v, n, __ATOMIC_RELAXED);
+}
+
+static void cmd_stat_max(uint32_t* v, uint32_t n)
+{
+    uint32_t cur = __atomic_load_n(v, __ATOMIC_RELAXED);
+    while ((n > cur) && !__atomic_compare_exchange_n(v, &cur, n, 1,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // cur was reloaded, retry while n is still larger
     }
 }
 
-void generate_topic(const char* username)
+static void cmd_receive(esp_mqtt_event_handle_t data_event)
 {
-	int len = 0;
-	int counter = 0;
-	int i = 0;
-	char tmp1[64];
-	char tmp2[128];
+    // parser state is kept across the chunks of one message
+    static cmd_parser_t cmd;
+    static cmd_parse_stat_t cmd_stat;
+    static int topic_id = TOPIC_NONE;
+    cmd_msg_t msg;
+
+    if (data_event->current_data_offset == 0) {
+        // topic is only present in the first chunk
+        topic_id = topic_lookup(&topics, data_event->topic, data_event->topic_len);
+        cmd_parser_reset(&cmd);
+    }
+    if (topic_id != topic_command) {
+        return;
+    }
 
-	bzero(tmp1,sizeof(tmp1));
-	bzero(tmp2,sizeof(tmp2));
+    cmd_stat = cmd_parser_feed(&cmd, data_event->data, data_event->data_len);
+    if (data_event->current_data_offset + data_event->data_len < data_event->total_data_len) {
+        return; // wait for the rest of the message
+    }
 
-	len = strlen(username);
-	printf("username len = %d\r\n",len);
+    cmd_stat_add(&cmd_stats.received, 1);
+    if ((cmd_stat != CMD_PARSE_DONE) || ((cmd.have & CMD_HAVE_ALL) != CMD_HAVE_ALL)) {
+        cmd_stat_add(&cmd_stats.invalid, 1);
+        return;
+    }
 
-	while(*username != '_'){
-		username++;
-		counter++;
-	}
-	username++;
-	counter++;
-	while(*username != '_'){
-		tmp1[i] = *username;
-		username++;
-		counter++;
-		i++;
-	}
-	//printf("data tmp1: %s\r\n",tmp1);
-	username++;
-	counter++;
-	i = 0;
-	while(counter<len){
-		tmp2[i] = *username;
-		username++;
-		counter++;
-		i++;
-	}
-	//printf("data tmp2: %s\r\n",tmp2);
+    memcpy(msg.id, cmd.id, sizeof(msg.id));
+    memcpy(msg.param, cmd.param, sizeof(msg.param));
+    memcpy(msg.sensor, cmd.sensor, sizeof(msg.sensor));
+    msg.have = cmd.have;
+    msg.value = cmd.value;
+    if ((cmd_queue == NULL) || (xQueueSend(cmd_queue, &msg, 0) != pdTRUE)) {
+        cmd_stat_add(&cmd_stats.dropped, 1);
+        return;
+    }
+    cmd_stat_max(&cmd_stats.depth_max, uxQueueMessagesWaiting(cmd_queue));
+}
+
+void mqtt_data_handling(esp_mqtt_event_handle_t data_event)
+{
+    int64_t start = esp_timer_get_time();
+
+    cmd_receive(data_event);
+
+    uint32_t us = (uint32_t) (esp_timer_get_time() - start);
+    cmd_stat_add(&cmd_stats.cb_calls, 1);
+    cmd_stat_add(&cmd_stats.cb_sum_us, us);
+    cmd_stat_max(&cmd_stats.cb_max_us, us);
+}
+
+static void cmd_print_stats(void)
+{
+    cmd_stats_t st = {
+        .received = __atomic_load_n(&cmd_stats.received, __ATOMIC_RELAXED),
+        .dropped = __atomic_load_n(&cmd_stats.dropped, __ATOMIC_RELAXED),
+        .invalid = __atomic_load_n(&cmd_stats.invalid, __ATOMIC_RELAXED),
+        .depth_max = __atomic_load_n(&cmd_stats.depth_max, __ATOMIC_RELAXED),
+        .cb_calls = __atomic_load_n(&cmd_stats.cb_calls, __ATOMIC_RELAXED),
+        .cb_max_us = __atomic_load_n(&cmd_stats.cb_max_us, __ATOMIC_RELAXED),
+        .cb_sum_us = __atomic_load_n(&cmd_stats.cb_sum_us, __ATOMIC_RELAXED),
+    };
+
+    printf("commands: received:%d invalid:%d dropped:%d depth max:%d/%d\r\n",
+            st.received, st.invalid, st.dropped, st.depth_max, CMD_QUEUE_LEN);
+    printf("data callback: calls:%d max:%d us avg:%d us\r\n",
+            st.cb_calls, st.cb_max_us, st.cb_calls ? st.cb_sum_us / st.cb_calls : 0);
+}
+
+static void cmd_worker(void* arg)
+{
+    cmd_msg_t msg;
+
+    for(;;) {
+        if (xQueueReceive(cmd_queue, &msg, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        printf("%s %s %d\n", msg.id, msg.param, msg.value);
 
-	sprintf(mqtt_topic,"iotera/sub/%s/%s/command",tmp1,tmp2);
-    sprintf(mqtt_confirm_topic,"iotera/pub/%s/%s/command_result",tmp1,tmp2);
-    sprintf(mqtt_online_topic,"iotera/pub/%s/%s/online",tmp1,tmp2);
-    sprintf(mqtt_lastwill_topic,"iotera/pub/%s/%s/offline",tmp1,tmp2);
+        // actuate first, the confirm may wait on the network
+        int len = cmd_dispatch(&msg, confirm_payload, sizeof(confirm_payload));
+        if (len > 0) {
+            mqtt_publish_iotera(confirm_payload, len);
+        }
+        cmd_print_stats();
+    }
+}
 
-	printf("%s\r\n",mqtt_topic);
-	printf("%s\r\n",mqtt_confirm_topic);
-	printf("%s\r\n",mqtt_online_topic);
-	printf("%s\r\n",mqtt_lastwill_topic);
+static void cmd_worker_start(void)
+{
+    cmd_queue = xQueueCreate(CMD_QUEUE_LEN, sizeof(cmd_msg_t));
+    xTaskCreate(cmd_worker, "cmd_worker", CMD_WORKER_STACK, NULL, CMD_WORKER_PRIO, NULL);
 }
+
 // END OF MQTT & SENDING DATA
 
 // START OF BLINK GPIO
 
-#define BLINK_GPIO 2
-
+/*
+ * LED actuator
+ *
+ * The LED toggles every BLINK_TOGGLE_MS like the original loop did (1 s on,
+ * 1 s off). actuator_request() only stores the wanted state and notifies
+ * actuator_task, which sleeps on the notification otherwise: no periodic
+ * wakeup when idle. When the period is a whole number of Hz LEDC generates
+ * the pattern (50 % duty from REF_TICK) and the CPU does nothing while the
+ * LED blinks. ledc_timer_config() only takes whole Hz, so the 2 s period
+ * (0.5 Hz), or a chip whose LEDC can not run that slow, falls back to an
+ * esp_timer toggling the GPIO, started only while blinking.
+ */
+#define BLINK_GPIO          2
+#define BLINK_TOGGLE_MS     1000
+#define BLINK_PERIOD_MS     (2 * BLINK_TOGGLE_MS)
+#define BLINK_LEDC_HZ       ((1000 % BLINK_PERIOD_MS) ? 0 : 1000 / BLINK_PERIOD_MS)
+#define BLINK_LEDC_MODE     LEDC_LOW_SPEED_MODE
+#define BLINK_LEDC_TIMER    LEDC_TIMER_0
+#define BLINK_LEDC_CHANNEL  LEDC_CHANNEL_0
+#define BLINK_LEDC_BITS     LEDC_TIMER_11_BIT
+#define BLINK_LEDC_DUTY     (1 << (BLINK_LEDC_BITS - 1))    // 50 %
+#define ACTUATOR_STACK      2048
+#define ACTUATOR_PRIO       6   // above cmd_worker
+
+typedef struct {
+    uint32_t applied;
+    uint32_t last_us;       // request to output latency
+    uint32_t max_us;
+} actuator_stats_t;
+
+static TaskHandle_t actuator_handle = NULL;
+static uint8_t actuator_wanted = 0;     // written by any task
+static int64_t actuator_req_time = 0;
+static uint8_t actuator_ledc = 0;       // LEDC generates the pattern
+static esp_timer_handle_t blink_timer = NULL;
 static uint8_t s_led_state = 0;
+static actuator_stats_t actuator_stats;
 
-static void blink_led(void)
+static void blink_timer_cb(void* arg)
 {
-    /* Set the GPIO level according to the state (LOW or HIGH)*/
+    s_led_state = !s_led_state;
     gpio_set_level(BLINK_GPIO, s_led_state);
 }
 
+static esp_err_t configure_ledc(void)
+{
+    ledc_timer_config_t timer_cfg = {
+        .speed_mode = BLINK_LEDC_MODE,
+        .duty_resolution = BLINK_LEDC_BITS,
+        .timer_num = BLINK_LEDC_TIMER,
+        .freq_hz = BLINK_LEDC_HZ,
+        .clk_cfg = LEDC_USE_REF_TICK,
+    };
+    ledc_channel_config_t channel_cfg = {
+        .gpio_num = BLINK_GPIO,
+        .speed_mode = BLINK_LEDC_MODE,
+        .channel = BLINK_LEDC_CHANNEL,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = BLINK_LEDC_TIMER,
+        .duty = 0,
+        .hpoint = 0,
+    };
+    esp_err_t err;
+
+    err = ledc_timer_config(&timer_cfg);
+    if (err == ESP_OK) {
+        err = ledc_channel_config(&channel_cfg);
+    }
+    return err;
+}
+
 static void configure_led(void)
 {
     ESP_LOGI(TAG, "Example configured to blink GPIO LED!");
+    if ((BLINK_LEDC_HZ != 0) && (configure_ledc() == ESP_OK)) {
+        actuator_ledc = 1;
+        return;
+    }
+
+    ESP_LOGW(TAG, "LEDC can not blink with a %d ms period, using esp_timer", BLINK_PERIOD_MS);
     gpio_reset_pin(BLINK_GPIO);
     /* Set the GPIO as a push/pull output */
     gpio_set_direction(BLINK_GPIO, GPIO_MODE_OUTPUT);
+    gpio_set_level(BLINK_GPIO, 0);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = blink_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "blink",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &blink_timer));
+}
+
+static void actuator_apply(uint8_t blink)
+{
+    if (actuator_ledc) {
+        ledc_set_duty(BLINK_LEDC_MODE, BLINK_LEDC_CHANNEL, blink ? BLINK_LEDC_DUTY : 0);
+        ledc_update_duty(BLINK_LEDC_MODE, BLINK_LEDC_CHANNEL);
+        return;
+    }
+
+    esp_timer_stop(blink_timer); // not running is fine
+    s_led_state = blink;
+    gpio_set_level(BLINK_GPIO, s_led_state);
+    if (blink) {
+        esp_timer_start_periodic(blink_timer, (uint64_t) BLINK_TOGGLE_MS * 1000);
+    }
+}
+
+static void actuator_task(void* arg)
+{
+    uint8_t current = 0;
+
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        uint8_t blink = __atomic_load_n(&actuator_wanted, __ATOMIC_ACQUIRE);
+        int64_t requested = __atomic_load_n(&actuator_req_time, __ATOMIC_ACQUIRE);
+        if (blink != current) {
+            actuator_apply(blink);
+            current = blink;
+        }
+
+        uint32_t us = (uint32_t) (esp_timer_get_time() - requested);
+        actuator_stats.applied++;
+        actuator_stats.last_us = us;
+        if (us > actuator_stats.max_us) {
+            actuator_stats.max_us = us;
+        }
+        ESP_LOGI(TAG, "LED %s, latency %d us (max %d us)", blink ? "blinking" : "off",
+                actuator_stats.last_us, actuator_stats.max_us);
+    }
+}
+
+static void actuator_start(void)
+{
+    configure_led();
+    xTaskCreate(actuator_task, "actuator", ACTUATOR_STACK, NULL, ACTUATOR_PRIO, &actuator_handle);
+}
+
+// returns the state that will be applied
+static uint8_t actuator_request(uint8_t blink)
+{
+    __atomic_store_n(&actuator_req_time, esp_timer_get_time(), __ATOMIC_RELEASE);
+    __atomic_store_n(&actuator_wanted, blink, __ATOMIC_RELEASE);
+    if (actuator_handle != NULL) {
+        xTaskNotifyGive(actuator_handle);
+    }
+    return blink;
 }
 
 // END OF BLINK GPIO
@@ -391,26 +1104,18 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK( ret );
+    ESP_ERROR_CHECK(cmd_routes_check(cmd_routes, CMD_ROUTE_COUNT));
 
     fast_scan();
 
     // Start setting onboard LED GPIO Blink
-    configure_led();
+    actuator_start();
+
+	// commands are executed by the worker, not in the MQTT task
+	cmd_worker_start();
 
 	// init mqtt
 	mqtt_init(mqtt_url,mqtt_port,mqtt_username,mqtt_password);
 
-	// main loop
-    while(1)
-    {
-        if (turnon == 1) {
-            ESP_LOGI(TAG, "Turning the LED %s!", s_led_state == true ? "ON" : "OFF");
-            blink_led();
-            /* Toggle the LED state */
-            s_led_state = !s_led_state;            
-        } else {
-            gpio_set_level(BLINK_GPIO, 0);
-        }
-        vTaskDelay(1000 / portTICK_RATE_MS);
-    }
+    // nothing left to poll, the actuator runs on notifications
 }
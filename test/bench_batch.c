@@ -0,0 +1,154 @@
+/*
+ * batch host benchmark
+ *
+ * Stands in for the broker measurement until one can be run against
+ * mosquitto: packs a day of one minute samples with each batch size the
+ * way main.c does (envelopes capped at the default max payload) and prints
+ * the pack timings through bench.c as CSV:
+ *   one iteration = one day of samples, msgs/s = samples per second
+ * followed by the MQTT traffic per sample: PUBLISH (QoS 1) and PUBACK
+ * packets with their fixed header, topic and packet id, so the saving of
+ * each batch size shows without a broker. Batched items carry their own
+ * "ts", so small JSON batches can cost more than single samples.
+ */
+
+#include <string.h>
+
+#include "batch.h"
+#include "bench.h"
+#include "esp_timer.h"
+
+#include "test_util.h"
+
+#define BENCH_ITERATIONS    50
+#define DAY_SAMPLES         1440
+#define MAX_PAYLOAD         1536    // DEFAULT_BATCH_MAX_PAYLOAD of main.c
+#define PAYLOAD_MAX         2048
+#define SAMPLE_PERIOD_US    60000000LL
+#define TOPIC_DATA          "iotera/pub/account/device/data"
+#define PUBACK_BYTES        4
+
+static const char ID[] = "B8:27:EB:12:34:56";
+static const wire_config_t wire_json = { .format = WIRE_JSON };
+static const wire_config_t wire_cbor = { .format = WIRE_CBOR };
+static const int batch_sizes[] = { 1, 2, 4, 8, 16 };
+
+typedef struct {
+    uint32_t samples;
+    uint32_t publishes;
+    uint64_t payload;
+    uint64_t mqtt;          // PUBLISH + PUBACK bytes
+} traffic_t;
+
+// the items of pack_sample_items in main.c
+static void pack_item(wire_writer_t* w, const sample_t* s, int first, int with_ts)
+{
+    wire_item_begin(w, "wifi_node", "pulse_counter", first, with_ts);
+    wire_map_begin(w, 3);
+    wire_key(w, "ID", 1);
+    wire_str(w, ID);
+    wire_key(w, "CH1", 0);
+    wire_u64(w, s->pulse1);
+    wire_key(w, "CH2", 0);
+    wire_u64(w, s->pulse2);
+    wire_map_end(w);
+    if (with_ts) {
+        wire_item_ts(w, s->timestamp);
+    }
+    wire_item_end(w);
+
+    wire_item_begin(w, "wifi_node", "battery", 0, with_ts);
+    wire_float(w, s->battery, 6);
+    if (with_ts) {
+        wire_item_ts(w, s->timestamp);
+    }
+    wire_item_end(w);
+}
+
+// MQTT 3.1.1 PUBLISH with QoS 1
+static uint32_t publish_bytes(int payload_len)
+{
+    uint32_t remaining = 2 + (uint32_t) strlen(TOPIC_DATA) + 2 + (uint32_t) payload_len;
+    uint32_t len_bytes = 1;
+
+    for (uint32_t v = remaining; v >= 128; v /= 128) {
+        len_bytes++;
+    }
+    return 1 + len_bytes + remaining;
+}
+
+static void run_day(const wire_config_t* wire, int batch_size, traffic_t* t)
+{
+    static char buf[PAYLOAD_MAX];
+    static batch_t batch;
+    int packed = 0;
+
+    // only the count trigger fires, the age one is past the day
+    batch_init(&batch, batch_size, DAY_SAMPLES * 60000u, MAX_PAYLOAD, wire, pack_item);
+    for (int i = 0; i < DAY_SAMPLES; i++) {
+        sample_t s = {
+            .timestamp = 1700000000u + i * 60,
+            .battery = 4.2f - (float) i / DAY_SAMPLES,
+            .pulse1 = 100000u + i * 37u,
+            .pulse2 = 2000u + i * 3u,
+        };
+        if (batch_add(&batch, &s, i * SAMPLE_PERIOD_US) == BATCH_HELD) {
+            continue;
+        }
+        while (batch.count > 0) {
+            int len = batch_pack(&batch, buf, sizeof(buf), &packed);
+            CHECK(len > 0);
+            if (len <= 0) {
+                return;
+            }
+            t->samples += packed;
+            t->publishes++;
+            t->payload += len;
+            t->mqtt += publish_bytes(len) + PUBACK_BYTES;
+            batch_drop(&batch, packed);
+        }
+    }
+}
+
+int main(void)
+{
+    static const struct {
+        const char* name;
+        const wire_config_t* wire;
+    } formats[] = { { "json", &wire_json }, { "cbor", &wire_cbor } };
+    static char names[10][24];
+    bench_result_t results[10];
+    traffic_t traffic[10];
+    int n = 0;
+
+    for (int f = 0; f < 2; f++) {
+        for (size_t k = 0; k < sizeof(batch_sizes) / sizeof(batch_sizes[0]); k++, n++) {
+            bench_t b;
+            snprintf(names[n], sizeof(names[n]), "batch_%s_%d", formats[f].name, batch_sizes[k]);
+            bench_begin(&b, names[n], esp_timer_get_time());
+            for (int it = 0; it < BENCH_ITERATIONS; it++) {
+                traffic_t t = {0};
+                int64_t t0 = esp_timer_get_time();
+                run_day(formats[f].wire, batch_sizes[k], &t);
+                bench_record(&b, (uint32_t) (esp_timer_get_time() - t0), DAY_SAMPLES, t.payload);
+                traffic[n] = t;
+            }
+            bench_end(&b, esp_timer_get_time(), &results[n]);
+        }
+    }
+
+    bench_print_csv_header();
+    for (int i = 0; i < n; i++) {
+        bench_print_csv(&results[i]);
+    }
+    printf("bench,publishes_per_day,payload_per_sample,mqtt_per_sample\n");
+    for (int i = 0; i < n; i++) {
+        printf("%s,%u,%.1f,%.1f\n", results[i].name, traffic[i].publishes,
+                (double) traffic[i].payload / DAY_SAMPLES, (double) traffic[i].mqtt / DAY_SAMPLES);
+    }
+    // every sample of the day went out, whatever the batch size
+    for (int i = 0; i < n; i++) {
+        CHECK_EQ(traffic[i].samples, DAY_SAMPLES);
+    }
+    TEST_EXIT();
+}
@@ -0,0 +1,96 @@
+/*
+ * Command round trip host benchmark (7 sketch)
+ *
+ * Inbound command -> confirm, through the sketch as it runs: the host
+ * esp-mqtt fake delivers MQTT_EVENT_DATA on the command topic to the
+ * handler mqtt_init() registered, cmd_receive queues it, cmd_worker (a real
+ * task on the pthread shim) dispatches it and publishes the confirm. One
+ * iteration = one command, its latency ends when the confirm reaches the
+ * client. bench.c CSV, then bench_check() against the baseline below.
+ *   confirm         -> one command at a time
+ *   confirm_chunked -> the command delivered in 16 byte events
+ */
+
+#include <sched.h>
+
+#include "receive_command.c"
+
+#include "bench.h"
+
+#include "test_util.h"
+
+#define CONFIRM_WAIT_US     1000000
+
+// host limits, loose enough for a loaded CI machine
+static const bench_baseline_t baselines[] = {
+    { "confirm", 20000, 200 },
+    { "confirm_chunked", 20000, 200 },
+};
+
+static const char command[] = "{\"id\":\"5f1c2d7e-8a41-4b2e-9c3a-1d2e3f405162\","
+        "\"param\":\"turnon\",\"sensor\":\"led_onboard\",\"value\":1}";
+
+// latency of one command until its confirm is published, -1 without confirm
+static int64_t round_trip(const char* topic, int chunk)
+{
+    int logged = host_mqtt_log_count();
+    int64_t t0 = esp_timer_get_time();
+    host_mqtt_msg_t msg;
+
+    host_mqtt_data(topic, command, (int) strlen(command), chunk);
+    while (host_mqtt_log_count() == logged) {
+        if (esp_timer_get_time() - t0 > CONFIRM_WAIT_US) {
+            return -1;
+        }
+        sched_yield();
+    }
+    int64_t us = esp_timer_get_time() - t0;
+    if ((host_mqtt_log(logged, &msg) != 0) || (strstr(msg.topic, "command_result") == NULL)
+            || (strstr(msg.data, "5f1c2d7e-8a41-4b2e-9c3a-1d2e3f405162") == NULL)) {
+        return -1;
+    }
+    return us;
+}
+
+static void run(const char* name, const char* topic, int chunk, bench_result_t* res)
+{
+    bench_t b;
+    int missing = 0;
+
+    bench_begin(&b, name, esp_timer_get_time());
+    for (int i = 0; i < BENCH_SAMPLES_MAX; i++) {
+        int64_t us = round_trip(topic, chunk);
+        if (us < 0) {
+            missing++;
+            continue;
+        }
+        bench_record(&b, (uint32_t) us, 1, strlen(command));
+    }
+    bench_end(&b, esp_timer_get_time(), res);
+    CHECK_EQ(missing, 0);
+}
+
+int main(void)
+{
+    bench_result_t results[2];
+
+    host_mqtt_reset();
+    mqtt_init("mqtt://localhost", 1883, mqtt_username, mqtt_password);
+    cmd_worker_start();
+    host_mqtt_connect();
+    CHECK(mqtt_is_connected());
+    const char* topic = topic_str(&topics, topic_command);
+    CHECK(topic != NULL);
+
+    run("confirm", topic, 0, &results[0]);
+    run("confirm_chunked", topic, 16, &results[1]);
+    CHECK_EQ(cmd_stats.dropped, 0);
+    CHECK_EQ(cmd_stats.invalid, 0);
+
+    bench_print_csv_header();
+    for (int i = 0; i < 2; i++) {
+        bench_print_csv(&results[i]);
+        CHECK_EQ(bench_check(&results[i], baselines, 2), 0);
+    }
+    TEST_EXIT();
+}
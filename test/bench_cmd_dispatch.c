@@ -0,0 +1,119 @@
+/*
+ * Command dispatch host benchmark (7 sketch)
+ *
+ * Route lookup cost as the command table grows: cmd_route_find (binary
+ * search of the sorted table) against a strcmp scan of the same table,
+ * for 1 to 1024 routes. Lookups cycle through every route plus a miss, so
+ * the scan pays its average, not its best case. A last row times the full
+ * cmd_dispatch of the real table, confirm included. bench.c CSV:
+ *   one iteration = BENCH_BATCH lookups, msgs/s = lookups per second
+ */
+
+#include "receive_command.c"
+
+#include "bench.h"
+
+#include "test_util.h"
+
+#define BENCH_ITERATIONS    50
+#define BENCH_BATCH         20000
+#define ROUTES_MAX          1024
+#define NAME_MAX            24
+
+static char names[ROUTES_MAX + 1][NAME_MAX];
+static cmd_route_t routes[ROUTES_MAX];
+static const int sizes[] = { 1, 4, 16, 64, 256, 1024 };
+
+static int handler_value(int32_t value, int32_t* report)
+{
+    *report = value;
+    return CMD_RESULT_OK;
+}
+
+static const cmd_route_t* linear_find(const cmd_route_t* r, int count, const char* param, const char* sensor)
+{
+    for (int i = 0; i < count; i++) {
+        if (cmd_route_cmp(&r[i], param, sensor) == 0) {
+            return &r[i];
+        }
+    }
+    return NULL;
+}
+
+static void run(const char* name, int count, int binary, bench_result_t* res)
+{
+    bench_t b;
+    int found = 0;
+
+    bench_begin(&b, name, esp_timer_get_time());
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        int64_t t0 = esp_timer_get_time();
+        for (int i = 0; i < BENCH_BATCH; i++) {
+            // index count is the miss, it sorts after every route
+            const char* param = names[i % (count + 1)];
+            const cmd_route_t* r = binary ? cmd_route_find(routes, count, param, "led")
+                    : linear_find(routes, count, param, "led");
+            found += (r != NULL);
+        }
+        bench_record(&b, (uint32_t) (esp_timer_get_time() - t0), BENCH_BATCH, 0);
+    }
+    bench_end(&b, esp_timer_get_time(), res);
+    CHECK(found > 0);
+}
+
+static void run_dispatch(bench_result_t* res)
+{
+    cmd_msg_t cmd = { .id = "5f1c2d7e-8a41-4b2e-9c3a-1d2e3f405162", .param = "turnon",
+                      .sensor = "led_onboard", .have = CMD_HAVE_ALL | CMD_HAVE_SENSOR, .value = 1 };
+    char buf[256];
+    bench_t b;
+    size_t bytes = 0;
+
+    bench_begin(&b, "cmd_dispatch", esp_timer_get_time());
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        int64_t t0 = esp_timer_get_time();
+        for (int i = 0; i < BENCH_BATCH; i++) {
+            bytes += cmd_dispatch(&cmd, buf, sizeof(buf));
+        }
+        bench_record(&b, (uint32_t) (esp_timer_get_time() - t0), BENCH_BATCH, bytes);
+        bytes = 0;
+    }
+    bench_end(&b, esp_timer_get_time(), res);
+}
+
+int main(void)
+{
+    static char row_names[2 * sizeof(sizes) / sizeof(sizes[0])][32];
+    bench_result_t results[2 * sizeof(sizes) / sizeof(sizes[0]) + 1];
+    int n = 0;
+
+    for (int i = 0; i <= ROUTES_MAX; i++) {
+        snprintf(names[i], NAME_MAX, "%s%04d", (i < ROUTES_MAX) ? "set_param_" : "zz_", i);
+    }
+    for (int i = 0; i < ROUTES_MAX; i++) {
+        routes[i].param = names[i];
+        routes[i].sensor = "led";
+        routes[i].report_param = "r";
+        routes[i].handler = handler_value;
+    }
+    CHECK_EQ(cmd_routes_check(routes, ROUTES_MAX), ESP_OK);
+
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        // the miss for this size sorts after all its routes
+        snprintf(names[sizes[k]], NAME_MAX, "zz_%04d", sizes[k]);
+        for (int binary = 1; binary >= 0; binary--, n++) {
+            snprintf(row_names[n], sizeof(row_names[n]), "%s_%d", binary ? "route_find" : "strcmp_scan", sizes[k]);
+            run(row_names[n], sizes[k], binary, &results[n]);
+        }
+        if (sizes[k] < ROUTES_MAX) {
+            snprintf(names[sizes[k]], NAME_MAX, "set_param_%04d", sizes[k]);
+        }
+    }
+    run_dispatch(&results[n++]);
+
+    bench_print_csv_header();
+    for (int i = 0; i < n; i++) {
+        bench_print_csv(&results[i]);
+    }
+    TEST_EXIT();
+}
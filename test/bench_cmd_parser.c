@@ -0,0 +1,125 @@
+/*
+ * Command parser host benchmark (7 sketch)
+ *
+ * Parses a typical command with the streaming parser, whole and in
+ * 32 byte chunks as esp-mqtt may deliver it. With cJSON found at configure
+ * time (HAVE_CJSON) the same message is parsed with cJSON_Parse plus field
+ * lookups, the extracted fields are compared and both rates are printed as
+ * bench.c CSV: one iteration = BENCH_BATCH commands.
+ */
+
+#include "receive_command.c"
+
+#include "bench.h"
+#ifdef HAVE_CJSON
+#include "cJSON.h"
+#endif
+
+#include "test_util.h"
+
+#define BENCH_ITERATIONS    100
+#define BENCH_BATCH         2000
+#define BENCH_CHUNK         32
+
+static const char command[] =
+    "{\"id\":\"5f1c2d7e-8a41-4b2e-9c3a-1d2e3f405162\",\"sensor\":\"led_onboard\","
+    "\"param\":\"turnon\",\"value\":1,\"meta\":{\"src\":\"dashboard\",\"tags\":[\"a\",\"b\"]}}";
+
+static int parse_stream(int chunk, cmd_parser_t* p)
+{
+    int len = sizeof(command) - 1;
+    cmd_parse_stat_t stat = CMD_PARSE_MORE;
+
+    cmd_parser_reset(p);
+    for (int off = 0; off < len; off += chunk) {
+        int n = (len - off < chunk) ? len - off : chunk;
+        stat = cmd_parser_feed(p, command + off, n);
+    }
+    return (stat == CMD_PARSE_DONE) && ((p->have & CMD_HAVE_ALL) == CMD_HAVE_ALL);
+}
+
+#ifdef HAVE_CJSON
+static int parse_cjson(cmd_parser_t* p)
+{
+    cJSON* root = cJSON_Parse(command);
+    int ok = 0;
+
+    if (root != NULL) {
+        cJSON* id = cJSON_GetObjectItemCaseSensitive(root, "id");
+        cJSON* param = cJSON_GetObjectItemCaseSensitive(root, "param");
+        cJSON* sensor = cJSON_GetObjectItemCaseSensitive(root, "sensor");
+        cJSON* value = cJSON_GetObjectItemCaseSensitive(root, "value");
+        if (cJSON_IsString(id) && cJSON_IsString(param) && cJSON_IsNumber(value)) {
+            snprintf(p->id, sizeof(p->id), "%s", id->valuestring);
+            snprintf(p->param, sizeof(p->param), "%s", param->valuestring);
+            p->have = CMD_HAVE_ALL;
+            if (cJSON_IsString(sensor)) {
+                snprintf(p->sensor, sizeof(p->sensor), "%s", sensor->valuestring);
+                p->have |= CMD_HAVE_SENSOR;
+            }
+            p->value = value->valueint;
+            ok = 1;
+        }
+        cJSON_Delete(root);
+    }
+    return ok;
+}
+#endif
+
+static void run(const char* name, int mode, bench_result_t* r)
+{
+    cmd_parser_t p;
+    bench_t b;
+
+    bench_begin(&b, name, esp_timer_get_time());
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        int64_t t0 = esp_timer_get_time();
+        int ok = 1;
+        for (int i = 0; i < BENCH_BATCH; i++) {
+#ifdef HAVE_CJSON
+            if (mode == 2) {
+                ok &= parse_cjson(&p);
+                continue;
+            }
+#endif
+            ok &= parse_stream(mode ? BENCH_CHUNK : (int) sizeof(command), &p);
+        }
+        CHECK(ok);
+        bench_record(&b, (uint32_t) (esp_timer_get_time() - t0), BENCH_BATCH,
+                (size_t) BENCH_BATCH * (sizeof(command) - 1));
+    }
+    bench_end(&b, esp_timer_get_time(), r);
+}
+
+int main(void)
+{
+    bench_result_t whole, chunked;
+    cmd_parser_t a, c;
+
+    CHECK(parse_stream(sizeof(command), &a));
+    CHECK(parse_stream(BENCH_CHUNK, &c));
+    CHECK(strcmp(a.id, c.id) == 0);
+
+    run("cmd_parser", 0, &whole);
+    run("cmd_parser_chunked", 1, &chunked);
+    bench_print_csv_header();
+    bench_print_csv(&whole);
+    bench_print_csv(&chunked);
+#ifdef HAVE_CJSON
+    bench_result_t cjson;
+    cmd_parser_t j;
+
+    memset(&j, 0, sizeof(j));
+    CHECK(parse_cjson(&j));
+    CHECK((strcmp(a.id, j.id) == 0) && (strcmp(a.param, j.param) == 0)
+            && (strcmp(a.sensor, j.sensor) == 0) && (a.value == j.value));
+    run("cjson", 2, &cjson);
+    bench_print_csv(&cjson);
+    if (cjson.msgs_per_s > 0) {
+        printf("cmd_parser/cJSON rate ratio: %.2f\n", (double) whole.msgs_per_s / cjson.msgs_per_s);
+    }
+#else
+    printf("cJSON not found at configure time, comparison skipped\n");
+#endif
+    TEST_EXIT();
+}
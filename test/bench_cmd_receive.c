@@ -0,0 +1,131 @@
+/*
+ * Command receive host benchmark (7 sketch)
+ *
+ * Time spent in mqtt_data_handling, i.e. in the esp-mqtt task, per
+ * MQTT_EVENT_DATA, timed with esp_timer_get_time like the sketch does:
+ *   whole     -> one command per event, the queue drained between events
+ *   chunk16   -> the same command split in 16 byte events
+ *   full      -> cmd_queue full and nobody draining: every command is
+ *                dropped, xQueueSend(.., 0) must not wait for space
+ *   other     -> data on a topic that is not the command topic
+ * One iteration = BENCH_BATCH events, its latency is the slowest event of
+ * the batch, so p50 is the typical worst case of 1000 events and max the
+ * worst seen. The sketch keeps the same worst case on target in
+ * cmd_stats.cb_max_us, printed by cmd_print_stats().
+ *
+ * Host numbers are not ESP32 numbers: they show the path has no lock and
+ * no wait, the large maxima are the host scheduler preempting the run.
+ */
+
+#include "receive_command.c"
+
+#include "bench.h"
+
+#include "test_util.h"
+
+#define BENCH_ITERATIONS    BENCH_SAMPLES_MAX
+#define BENCH_BATCH         1000
+#define RECEIVE_BUDGET_US   50      // host p50 of the per batch worst case
+
+static const char command[] = "{\"id\":\"5f1c2d7e-8a41-4b2e-9c3a-1d2e3f405162\","
+        "\"param\":\"turnon\",\"sensor\":\"led_onboard\",\"value\":1}";
+
+// one message as esp-mqtt delivers it, returns the slowest event
+static uint32_t deliver(const char* topic, int chunk)
+{
+    int len = (int) strlen(command);
+    int offset = 0;
+    uint32_t slowest = 0;
+
+    do {
+        int n = (len - offset < chunk) ? len - offset : chunk;
+        esp_mqtt_event_t event = {
+            .event_id = MQTT_EVENT_DATA,
+            .data = (char*) command + offset,
+            .data_len = n,
+            .total_data_len = len,
+            .current_data_offset = offset,
+            .topic = (offset == 0) ? (char*) topic : NULL,
+            .topic_len = (offset == 0) ? (int) strlen(topic) : 0,
+        };
+        int64_t t0 = esp_timer_get_time();
+        mqtt_data_handling(&event);
+        uint32_t us = (uint32_t) (esp_timer_get_time() - t0);
+        if (us > slowest) {
+            slowest = us;
+        }
+        offset += n;
+    } while (offset < len);
+    return slowest;
+}
+
+static void drain(void)
+{
+    cmd_msg_t msg;
+
+    while (xQueueReceive(cmd_queue, &msg, 0) == pdTRUE) {
+    }
+}
+
+static void run(const char* name, const char* topic, int chunk, int full, bench_result_t* res)
+{
+    bench_t b;
+
+    drain();
+    if (full) {
+        cmd_msg_t msg = {0};
+        while (xQueueSend(cmd_queue, &msg, 0) == pdTRUE) {
+        }
+    }
+    bench_begin(&b, name, esp_timer_get_time());
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        uint32_t slowest = 0;
+        for (int i = 0; i < BENCH_BATCH; i++) {
+            uint32_t us = deliver(topic, chunk);
+            if (us > slowest) {
+                slowest = us;
+            }
+            if (!full) {
+                drain();
+            }
+        }
+        bench_record(&b, slowest, BENCH_BATCH, BENCH_BATCH * strlen(command));
+    }
+    bench_end(&b, esp_timer_get_time(), res);
+    CHECK(res->p50_us <= RECEIVE_BUDGET_US);
+}
+
+int main(void)
+{
+    bench_result_t results[4];
+    int len = (int) strlen(command);
+
+    CHECK_EQ(topic_table_init(&topics, mqtt_username), ESP_OK);
+    topic_command = topic_add(&topics, "sub", "command");
+    const char* topic = topic_str(&topics, topic_command);
+    CHECK(topic != NULL);
+    cmd_queue = xQueueCreate(CMD_QUEUE_LEN, sizeof(cmd_msg_t));
+
+    run("cmd_receive_whole", topic, len, 0, &results[0]);
+    CHECK_EQ(cmd_stats.received, BENCH_ITERATIONS * BENCH_BATCH);
+    CHECK_EQ(cmd_stats.invalid, 0);
+    CHECK_EQ(cmd_stats.dropped, 0);
+    CHECK_EQ(cmd_stats.depth_max, 1);
+
+    run("cmd_receive_chunk16", topic, 16, 0, &results[1]);
+    CHECK_EQ(cmd_stats.received, 2 * BENCH_ITERATIONS * BENCH_BATCH);
+    CHECK_EQ(cmd_stats.dropped, 0);
+
+    run("cmd_receive_full", topic, len, 1, &results[2]);
+    CHECK_EQ(cmd_stats.dropped, BENCH_ITERATIONS * BENCH_BATCH);
+
+    run("cmd_receive_other", "iotera/pub/other", len, 0, &results[3]);
+    CHECK_EQ(cmd_stats.received, 3 * BENCH_ITERATIONS * BENCH_BATCH);
+
+    bench_print_csv_header();
+    for (int i = 0; i < 4; i++) {
+        bench_print_csv(&results[i]);
+    }
+    cmd_print_stats();
+    TEST_EXIT();
+}
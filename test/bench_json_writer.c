@@ -0,0 +1,121 @@
+/*
+ * json_writer host benchmark
+ *
+ * Packs the same 10 sample Iotera envelope main.c sends, once with
+ * json_writer and once with snprintf, checks both produce identical bytes
+ * and prints the timings through bench.c as CSV:
+ *   one iteration = BENCH_BATCH payloads, msgs/s = payloads per second
+ */
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "json_writer.h"
+#include "bench.h"
+#include "esp_timer.h"
+
+#include "test_util.h"
+
+#define BENCH_ITERATIONS    100
+#define BENCH_BATCH         1000
+#define BENCH_SAMPLES       10
+#define PAYLOAD_MAX         2048
+
+typedef struct {
+    uint32_t timestamp;
+    uint32_t pulse1;
+    uint32_t pulse2;
+    float battery;
+} bench_sample_t;
+
+static const char ID[] = "B8:27:EB:12:34:56";
+static bench_sample_t samples[BENCH_SAMPLES];
+
+static int pack_writer(char* buf, size_t cap)
+{
+    json_writer_t w;
+
+    json_init(&w, buf, cap);
+    iotera_payload_begin(&w);
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        const bench_sample_t* s = &samples[i];
+        if (i != 0) {
+            json_lit(&w, ",");
+        }
+        json_lit(&w, "{\"sensor\":\"wifi_node\",\"param\":\"pulse_counter\",\"value\":{\"ID\":");
+        json_str(&w, ID);
+        json_lit(&w, ",\"CH1\":");
+        json_u64(&w, s->pulse1);
+        json_lit(&w, ",\"CH2\":");
+        json_u64(&w, s->pulse2);
+        json_lit(&w, "},\"ts\":");
+        json_u64(&w, s->timestamp);
+        json_lit(&w, "},{\"sensor\":\"wifi_node\",\"param\":\"battery\",\"value\":");
+        json_float(&w, s->battery, 6);
+        json_lit(&w, ",\"ts\":");
+        json_u64(&w, s->timestamp);
+        json_lit(&w, "}");
+    }
+    return iotera_payload_end(&w);
+}
+
+static int pack_sprintf(char* buf, size_t cap)
+{
+    int len = snprintf(buf, cap, "{\"payload\":[");
+
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        const bench_sample_t* s = &samples[i];
+        len += snprintf(buf + len, cap - len,
+                "%s{\"sensor\":\"wifi_node\",\"param\":\"pulse_counter\",\"value\":{\"ID\":\"%s\","
+                "\"CH1\":%" PRIu32 ",\"CH2\":%" PRIu32 "},\"ts\":%" PRIu32 "},"
+                "{\"sensor\":\"wifi_node\",\"param\":\"battery\",\"value\":%.6f,\"ts\":%" PRIu32 "}",
+                (i != 0) ? "," : "", ID, s->pulse1, s->pulse2, s->timestamp,
+                s->battery, s->timestamp);
+    }
+    len += snprintf(buf + len, cap - len, "]}");
+    return len;
+}
+
+static void run(const char* name, int (*pack)(char*, size_t), bench_result_t* r)
+{
+    static char buf[PAYLOAD_MAX];
+    bench_t b;
+
+    bench_begin(&b, name, esp_timer_get_time());
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        int64_t t0 = esp_timer_get_time();
+        size_t bytes = 0;
+        for (int i = 0; i < BENCH_BATCH; i++) {
+            samples[i % BENCH_SAMPLES].pulse1++;
+            bytes += pack(buf, sizeof(buf));
+        }
+        bench_record(&b, (uint32_t) (esp_timer_get_time() - t0), BENCH_BATCH, bytes);
+    }
+    bench_end(&b, esp_timer_get_time(), r);
+}
+
+int main(void)
+{
+    static char a[PAYLOAD_MAX], b[PAYLOAD_MAX];
+    bench_result_t writer, libc;
+
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        samples[i].timestamp = 1700000000u + i * 60;
+        samples[i].pulse1 = 1000u * i;
+        samples[i].pulse2 = 7u * i;
+        samples[i].battery = 3.3f + 0.137f * i;
+    }
+    CHECK(pack_writer(a, sizeof(a)) > 0);
+    CHECK(pack_sprintf(b, sizeof(b)) > 0);
+    CHECK(strcmp(a, b) == 0);
+
+    run("json_writer", pack_writer, &writer);
+    run("sprintf", pack_sprintf, &libc);
+    bench_print_csv_header();
+    bench_print_csv(&writer);
+    bench_print_csv(&libc);
+    if (writer.msgs_per_s > 0) {
+        printf("sprintf/json_writer time ratio: %.2f\n", (double) writer.msgs_per_s / libc.msgs_per_s);
+    }
+    TEST_EXIT();
+}
@@ -0,0 +1,152 @@
+/*
+ * metrics host benchmark
+ *
+ * Cost of one update on the hot path, the figure main.c calibrates on
+ * target into the update_ns gauge. One iteration = BENCH_BATCH updates,
+ * msgs/s = updates per second:
+ *   inc            -> metric_inc, one thread
+ *   set            -> metric_set
+ *   max            -> metric_max with a rising value (a CAS every time)
+ *   max_held       -> metric_max below the mark (a load only)
+ *   observe        -> metric_observe over every bucket
+ *   inc_contended  -> metric_inc on one counter while BENCH_THREADS - 1
+ *                     other threads hammer it too
+ * bench.c CSV plus ns per update, then bench_check() against the limits
+ * below.
+ */
+
+#include <pthread.h>
+
+#include "metrics.h"
+#include "bench.h"
+#include "esp_timer.h"
+
+#include "test_util.h"
+
+#define BENCH_ITERATIONS    BENCH_SAMPLES_MAX
+#define BENCH_BATCH         10000
+#define BENCH_THREADS       4
+
+// host limits, loose enough for a loaded CI machine: 100 ns per update
+static const bench_baseline_t baselines[] = {
+    { "inc", 0, 10000000 },
+    { "set", 0, 10000000 },
+    { "max", 0, 10000000 },
+    { "max_held", 0, 10000000 },
+    { "observe", 0, 10000000 },
+};
+
+typedef enum {
+    OP_INC = 0,
+    OP_SET,
+    OP_MAX,
+    OP_MAX_HELD,
+    OP_OBSERVE,
+} op_t;
+
+static metrics_t m;
+static int id_counter, id_gauge, id_hist;
+static volatile int hammer_run;
+
+static void batch(op_t op, uint32_t base)
+{
+    for (uint32_t i = 0; i < BENCH_BATCH; i++) {
+        switch (op) {
+            case OP_INC:
+                metric_inc(&m, id_counter, 1);
+                break;
+            case OP_SET:
+                metric_set(&m, id_gauge, base + i);
+                break;
+            case OP_MAX:
+                metric_max(&m, id_gauge, base + i);
+                break;
+            case OP_MAX_HELD:
+                metric_max(&m, id_gauge, i);
+                break;
+            case OP_OBSERVE:
+                metric_observe(&m, id_hist, (base + i) << (i & 15));
+                break;
+        }
+    }
+}
+
+static double run(const char* name, op_t op, bench_result_t* res)
+{
+    bench_t b;
+    int64_t total_us = 0;
+
+    metric_set(&m, id_gauge, 0);
+    if (op == OP_MAX_HELD) {
+        metric_set(&m, id_gauge, UINT32_MAX);
+    }
+    bench_begin(&b, name, esp_timer_get_time());
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        int64_t t0 = esp_timer_get_time();
+        batch(op, (uint32_t) it * BENCH_BATCH);
+        int64_t us = esp_timer_get_time() - t0;
+        total_us += us;
+        bench_record(&b, (uint32_t) us, BENCH_BATCH, 0);
+    }
+    bench_end(&b, esp_timer_get_time(), res);
+    return (double) total_us * 1000.0 / ((double) BENCH_ITERATIONS * BENCH_BATCH);
+}
+
+static void* hammer(void* arg)
+{
+    while (__atomic_load_n(&hammer_run, __ATOMIC_RELAXED)) {
+        metric_inc(&m, id_counter, 1);
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    static const struct {
+        const char* name;
+        op_t op;
+    } ops[] = {
+        { "inc", OP_INC },
+        { "set", OP_SET },
+        { "max", OP_MAX },
+        { "max_held", OP_MAX_HELD },
+        { "observe", OP_OBSERVE },
+    };
+    enum { ROWS = sizeof(ops) / sizeof(ops[0]) + 1 };
+    bench_result_t results[ROWS];
+    double ns[ROWS];
+    pthread_t threads[BENCH_THREADS - 1];
+
+    metrics_init(&m);
+    id_counter = metric_register(&m, "counter", METRIC_COUNTER);
+    id_gauge = metric_register(&m, "gauge", METRIC_GAUGE);
+    id_hist = metric_register(&m, "hist", METRIC_HIST);
+
+    for (int i = 0; i < ROWS - 1; i++) {
+        ns[i] = run(ops[i].name, ops[i].op, &results[i]);
+    }
+    CHECK_EQ(metric_get(&m, id_counter), BENCH_ITERATIONS * BENCH_BATCH);
+
+    hammer_run = 1;
+    for (int i = 0; i < BENCH_THREADS - 1; i++) {
+        pthread_create(&threads[i], NULL, hammer, NULL);
+    }
+    ns[ROWS - 1] = run("inc_contended", OP_INC, &results[ROWS - 1]);
+    __atomic_store_n(&hammer_run, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < BENCH_THREADS - 1; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    bench_print_csv_header();
+    for (int i = 0; i < ROWS; i++) {
+        bench_print_csv(&results[i]);
+    }
+    printf("update,ns_per_update\n");
+    for (int i = 0; i < ROWS; i++) {
+        printf("%s,%.1f\n", results[i].name, ns[i]);
+    }
+    for (int i = 0; i < ROWS - 1; i++) {
+        CHECK_EQ(bench_check(&results[i], baselines, ROWS - 1), 0);
+    }
+    TEST_EXIT();
+}
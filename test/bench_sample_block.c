@@ -0,0 +1,160 @@
+/*
+ * sample_block host benchmark
+ *
+ * Compression of the offline log records against the raw sample_t layout
+ * (24 bytes) for the data the device sees, in blocks of 16 samples
+ * (BATCH_MAX_SAMPLES, as main.c stores them) and of SBLOCK_SAMPLES_MAX:
+ *   steady    -> fixed period, slow counters, flat battery
+ *   field     -> +-2 s period jitter, bursty counters, battery noise in the
+ *                last ADC bits
+ *   reset     -> field data with both counters restarting mid block
+ *   ch2_off   -> field data, CH2 SAMPLE_NOT_MEASURED (low power mode)
+ *   nan_batt  -> field data, battery NaN (ADC read failed)
+ *   random    -> uniform random fields, the worst case
+ * Every block is decoded back and compared. bench.c CSV for sblock_encode
+ * (one iteration = one block, msgs/s = samples per second), then
+ *   scenario,samples_per_block,bytes_per_sample,ratio
+ * with ratio = sizeof(sample_t) / bytes_per_sample.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "sample_block.h"
+#include "bench.h"
+#include "esp_timer.h"
+
+#include "test_util.h"
+
+#define BENCH_ITERATIONS    BENCH_SAMPLES_MAX
+#define BLOCK_SMALL         16
+#define BUF_MAX             (SBLOCK_SAMPLES_MAX * 64)
+
+static uint32_t rng_state = 0x6c078965;
+
+static uint32_t rng_next(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static float bits_float(uint32_t v)
+{
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+typedef enum {
+    DATA_STEADY = 0,
+    DATA_FIELD,
+    DATA_RESET,
+    DATA_CH2_OFF,
+    DATA_NAN_BATT,
+    DATA_RANDOM,
+} data_t;
+
+static const char* const data_names[] = { "steady", "field", "reset", "ch2_off", "nan_batt", "random" };
+
+static void fill(sample_t* s, int count, data_t data, int block)
+{
+    uint32_t ts = 1700000000u + (uint32_t) block * count * 60;
+    uint64_t p1 = 100000 + (uint64_t) block * 5000;
+    uint64_t p2 = 20000 + (uint64_t) block * 300;
+
+    for (int i = 0; i < count; i++) {
+        if (data == DATA_RANDOM) {
+            s[i].timestamp = rng_next();
+            s[i].battery = bits_float(rng_next());
+            s[i].pulse1 = ((uint64_t) rng_next() << 32) | rng_next();
+            s[i].pulse2 = ((uint64_t) rng_next() << 32) | rng_next();
+            continue;
+        }
+        if (data == DATA_STEADY) {
+            ts += 60;
+            p1 += 12;
+            p2 += 1;
+            s[i].battery = 3.7f;
+        } else {
+            ts += 58 + rng_next() % 5;
+            p1 += (rng_next() % 8 == 0) ? 200 + rng_next() % 800 : rng_next() % 20;
+            p2 += rng_next() % 3;
+            // 12 bit ADC, x2 divider: the last bits move
+            s[i].battery = (float) (2300 + rng_next() % 4) * 3.3f / 4095.0f * 2.0f;
+        }
+        if ((data == DATA_RESET) && (i == count / 2)) {
+            p1 = 0;
+            p2 = 0;
+        }
+        s[i].timestamp = ts;
+        s[i].pulse1 = p1;
+        s[i].pulse2 = (data == DATA_CH2_OFF) ? SAMPLE_NOT_MEASURED : p2;
+        if (data == DATA_NAN_BATT) {
+            s[i].battery = NAN;
+        }
+    }
+}
+
+static double run(const char* name, data_t data, int count, bench_result_t* res)
+{
+    static uint8_t buf[BUF_MAX];
+    sample_t s[SBLOCK_SAMPLES_MAX];
+    sample_t out[SBLOCK_SAMPLES_MAX];
+    uint64_t bytes = 0;
+    int bad = 0;
+    bench_t b;
+
+    bench_begin(&b, name, esp_timer_get_time());
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        fill(s, count, data, it);
+        int64_t t0 = esp_timer_get_time();
+        int len = sblock_encode(s, count, buf, sizeof(buf));
+        bench_record(&b, (uint32_t) (esp_timer_get_time() - t0), count, (len > 0) ? len : 0);
+        if ((len <= 0) || (sblock_decode(buf, len, out, SBLOCK_SAMPLES_MAX) != count)
+                || (memcmp(s, out, count * sizeof(sample_t)) != 0)) {
+            bad++;
+            continue;
+        }
+        bytes += len;
+    }
+    bench_end(&b, esp_timer_get_time(), res);
+    CHECK_EQ(bad, 0);
+    return (double) bytes / ((double) BENCH_ITERATIONS * count);
+}
+
+int main(void)
+{
+    static const int blocks[] = { BLOCK_SMALL, SBLOCK_SAMPLES_MAX };
+    enum { ROWS = 6 * 2 };
+    static char names[ROWS][32];
+    bench_result_t results[ROWS];
+    double per_sample[ROWS];
+    int n = 0;
+
+    for (int d = DATA_STEADY; d <= DATA_RANDOM; d++) {
+        for (int k = 0; k < 2; k++, n++) {
+            snprintf(names[n], sizeof(names[n]), "sblock_%s_%d", data_names[d], blocks[k]);
+            per_sample[n] = run(names[n], (data_t) d, blocks[k], &results[n]);
+        }
+    }
+
+    bench_print_csv_header();
+    for (int i = 0; i < n; i++) {
+        bench_print_csv(&results[i]);
+    }
+    printf("scenario,samples_per_block,bytes_per_sample,ratio\n");
+    for (int i = 0; i < n; i++) {
+        printf("%s,%d,%.2f,%.2f\n", data_names[i / 2], blocks[i % 2], per_sample[i],
+                (double) sizeof(sample_t) / per_sample[i]);
+    }
+
+    // the codec pays off on device data, and costs little on noise
+    CHECK(per_sample[DATA_STEADY * 2] * 4 < sizeof(sample_t));
+    CHECK(per_sample[DATA_FIELD * 2] * 2 < sizeof(sample_t));
+    CHECK(per_sample[DATA_CH2_OFF * 2] * 2 < sizeof(sample_t));
+    CHECK(per_sample[DATA_RANDOM * 2 + 1] < 2 * sizeof(sample_t));
+    TEST_EXIT();
+}
@@ -0,0 +1,61 @@
+#ifndef __HOST_PCNT_H
+#define __HOST_PCNT_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum { PCNT_UNIT_0, PCNT_UNIT_1, PCNT_UNIT_2, PCNT_UNIT_3, PCNT_UNIT_MAX } pcnt_unit_t;
+typedef enum { PCNT_CHANNEL_0, PCNT_CHANNEL_1 } pcnt_channel_t;
+typedef enum { PCNT_COUNT_DIS, PCNT_COUNT_INC, PCNT_COUNT_DEC } pcnt_count_mode_t;
+typedef enum { PCNT_MODE_KEEP, PCNT_MODE_REVERSE, PCNT_MODE_DISABLE } pcnt_ctrl_mode_t;
+typedef enum { PCNT_EVT_L_LIM, PCNT_EVT_H_LIM, PCNT_EVT_ZERO } pcnt_evt_type_t;
+
+#define PCNT_PIN_NOT_USED   (-1)
+
+typedef struct {
+    int pulse_gpio_num;
+    int ctrl_gpio_num;
+    pcnt_ctrl_mode_t lctrl_mode;
+    pcnt_ctrl_mode_t hctrl_mode;
+    pcnt_count_mode_t pos_mode;
+    pcnt_count_mode_t neg_mode;
+    int16_t counter_h_lim;
+    int16_t counter_l_lim;
+    pcnt_unit_t unit;
+    pcnt_channel_t channel;
+} pcnt_config_t;
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* cfg);
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t value);
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit);
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t evt);
+esp_err_t pcnt_event_disable(pcnt_unit_t unit, pcnt_evt_type_t evt);
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit);
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit);
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit);
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count);
+esp_err_t pcnt_set_pin(pcnt_unit_t unit, pcnt_channel_t channel, int pulse_io, int ctrl_io);
+esp_err_t pcnt_isr_service_install(int flags);
+void pcnt_isr_service_uninstall(void);
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*isr)(void*), void* arg);
+esp_err_t pcnt_isr_handler_remove(pcnt_unit_t unit);
+
+/* host only: fake hardware state */
+typedef struct {
+    int pulse_gpio;             // PCNT_PIN_NOT_USED when detached
+    int running;
+    int h_lim_event;
+    void (*isr)(void*);
+    void* isr_arg;
+    int16_t h_lim;
+    int16_t count;
+} host_pcnt_unit_t;
+
+extern host_pcnt_unit_t host_pcnt_units[PCNT_UNIT_MAX];
+extern int host_pcnt_service;       // ISR service installed
+extern int host_pcnt_fail_unit;     // pcnt_unit_config fails on this unit, -1 -> never
+
+void host_pcnt_reset(void);
+void host_pcnt_pulse(pcnt_unit_t unit, int pulses);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef __HOST_ESP_ATTR_H
+#define __HOST_ESP_ATTR_H
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef __HOST_ESP_EVENT_H
+#define __HOST_ESP_EVENT_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef const char* esp_event_base_t;
+typedef void (*esp_event_handler_t)(void* arg, esp_event_base_t base, int32_t id, void* data);
+typedef void* esp_event_handler_instance_t;
+
+#define ESP_EVENT_ANY_ID    -1
+
+extern esp_event_base_t WIFI_EVENT;
+extern esp_event_base_t IP_EVENT;
+
+esp_err_t esp_event_loop_create_default(void);
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id,
+        esp_event_handler_t handler, void* arg);
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t id,
+        esp_event_handler_t handler, void* arg, esp_event_handler_instance_t* instance);
+
+/* host only: deliver an event to the registered handlers inline */
+void host_event_post(esp_event_base_t base, int32_t id, void* data);
+
+#endif
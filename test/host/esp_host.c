@@ -0,0 +1,178 @@
+/*
+ * Host ESP shim
+ *
+ * esp_timer_get_time -> CLOCK_MONOTONIC in us
+ * gpio               -> ISR table, host_gpio_fire() calls the handler inline
+ * esp_timer          -> created timers never fire, tests drive callbacks directly
+ *                       with host_timer_fire()
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+
+#define HOST_GPIO_MAX   40
+
+struct host_timer {
+    esp_timer_create_args_t args;
+    uint64_t period_us;
+};
+
+static struct {
+    gpio_isr_t isr;
+    void* arg;
+    int level;
+} host_gpio[HOST_GPIO_MAX];
+
+const char* esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:                    return "ESP_OK";
+    case ESP_FAIL:                  return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:     return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+    default:                        return "ESP_ERR_UNKNOWN";
+    }
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle)
+{
+    struct host_timer* timer = calloc(1, sizeof(*timer));
+
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->args = *args;
+    *handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    timer->period_us = period_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    timer->period_us = timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    timer->period_us = 0;
+    return ESP_OK;
+}
+
+uint64_t host_timer_period(esp_timer_handle_t timer)
+{
+    return timer->period_us;
+}
+
+void host_timer_fire(esp_timer_handle_t timer)
+{
+    timer->args.callback(timer->args.arg);
+}
+
+static int host_gpio_valid(gpio_num_t gpio)
+{
+    return (gpio >= 0) && (gpio < HOST_GPIO_MAX);
+}
+
+esp_err_t gpio_config(const gpio_config_t* cfg)
+{
+    (void) cfg;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+    if (!host_gpio_valid(gpio)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_gpio[gpio].level = level ? 1 : 0;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio)
+{
+    return host_gpio_valid(gpio) ? host_gpio[gpio].level : 0;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    (void) flags;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t isr, void* arg)
+{
+    if (!host_gpio_valid(gpio)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_gpio[gpio].isr = isr;
+    host_gpio[gpio].arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio)
+{
+    return gpio_isr_handler_add(gpio, NULL, NULL);
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio, gpio_int_type_t type)
+{
+    (void) type;
+    return host_gpio_valid(gpio) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio)
+{
+    return host_gpio_valid(gpio) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio)
+{
+    return host_gpio_valid(gpio) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio)
+{
+    return host_gpio_valid(gpio) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode)
+{
+    (void) mode;
+    return host_gpio_valid(gpio) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio, gpio_int_type_t type)
+{
+    (void) type;
+    return host_gpio_valid(gpio) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void host_gpio_fire(gpio_num_t gpio)
+{
+    if (host_gpio_valid(gpio) && (host_gpio[gpio].isr != NULL)) {
+        host_gpio[gpio].isr(host_gpio[gpio].arg);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef __HOST_ESP_LOG_H
+#define __HOST_ESP_LOG_H
+
+#include <stdio.h>
+
+/*
+ * Host log shim: errors and warnings go to stderr, info and debug are
+ * dropped unless HOST_LOG_VERBOSE is defined, so test output stays short.
+ */
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+#define ESP_LOGE(tag, fmt, ...)     fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...)     fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#ifdef HOST_LOG_VERBOSE
+#define ESP_LOGI(tag, fmt, ...)     fprintf(stderr, "I %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...)     fprintf(stderr, "D %s: " fmt "\n", tag, ##__VA_ARGS__)
+#else
+#define ESP_LOGI(tag, fmt, ...)     do { if (0) fprintf(stderr, "%s" fmt, tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGD(tag, fmt, ...)     do { if (0) fprintf(stderr, "%s" fmt, tag, ##__VA_ARGS__); } while (0)
+#endif
+
+static inline void esp_log_level_set(const char* tag, esp_log_level_t level)
+{
+    (void) tag;
+    (void) level;
+}
+
+#endif
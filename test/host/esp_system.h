@@ -0,0 +1,13 @@
+#ifndef __HOST_ESP_SYSTEM_H
+#define __HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+uint32_t esp_random(void);
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+const char* esp_get_idf_version(void);
+void esp_restart(void);
+
+#endif
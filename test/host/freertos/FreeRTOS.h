@@ -0,0 +1,47 @@
+#ifndef __HOST_FREERTOS_H
+#define __HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+ * Host FreeRTOS shim
+ *
+ * Tasks are pthreads, the tick is 1 ms of CLOCK_MONOTONIC, critical
+ * sections are one recursive mutex per portMUX. Only the calls the
+ * firmware modules use are provided.
+ */
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              1
+#define pdFAIL              0
+#define portMAX_DELAY       ((TickType_t) 0xffffffffu)
+#define configTICK_RATE_HZ  1000
+#define portTICK_PERIOD_MS  1
+#define portTICK_RATE_MS    portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms)   ((TickType_t) (ms))
+#define portNUM_PROCESSORS  2
+#define tskNO_AFFINITY      0x7fffffff
+
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+#define portENTER_CRITICAL(mux)         pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)          pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR()            do { } while (0)
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef __HOST_SEMPHR_H
+#define __HOST_SEMPHR_H
+
+#include "freertos/queue.h"
+
+#endif
@@ -0,0 +1,394 @@
+/*
+ * Host FreeRTOS shim
+ *
+ * task          -> detached pthread, handle allocated before the thread starts
+ * notification  -> counter + condition variable per task
+ * queue         -> copy-in ring behind one mutex
+ * event group   -> bit mask behind one mutex
+ *
+ * Timeouts are in ticks of 1 ms. The calling thread of main() gets a task
+ * handle lazily on its first notification call.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+
+struct host_task {
+    TaskFunction_t fn;
+    void* arg;
+    BaseType_t core;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t len;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t* items;
+};
+
+struct host_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+static __thread struct host_task* current_task = NULL;
+
+static struct timespec host_deadline(TickType_t ticks)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long) (ticks % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static void host_cond_init(pthread_cond_t* cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// wait on cond until woken or the deadline passes, portMAX_DELAY waits forever
+static int host_cond_wait(pthread_cond_t* cond, pthread_mutex_t* lock, TickType_t ticks,
+        const struct timespec* deadline)
+{
+    if (ticks == portMAX_DELAY) {
+        return pthread_cond_wait(cond, lock);
+    }
+    return pthread_cond_timedwait(cond, lock, deadline);
+}
+
+static struct host_task* host_task_alloc(TaskFunction_t fn, void* arg, BaseType_t core)
+{
+    struct host_task* task = calloc(1, sizeof(*task));
+
+    if (task == NULL) {
+        return NULL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    task->core = core;
+    pthread_mutex_init(&task->lock, NULL);
+    host_cond_init(&task->cond);
+    return task;
+}
+
+static void* host_task_entry(void* arg)
+{
+    struct host_task* task = (struct host_task*) arg;
+
+    current_task = task;
+    task->fn(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* arg,
+        UBaseType_t prio, TaskHandle_t* handle, BaseType_t core)
+{
+    struct host_task* task = host_task_alloc(fn, arg, core);
+    pthread_attr_t attr;
+    pthread_t thread;
+    int err;
+
+    (void) name;
+    (void) stack;
+    (void) prio;
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    if (handle != NULL) {
+        *handle = task;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    err = pthread_create(&thread, &attr, host_task_entry, task);
+    pthread_attr_destroy(&attr);
+
+    return (err == 0) ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack, void* arg,
+        UBaseType_t prio, TaskHandle_t* handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // handles stay valid so late notifications are harmless
+    if ((task == NULL) || (task == current_task)) {
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = { .tv_sec = ticks / 1000, .tv_nsec = (long) (ticks % 1000) * 1000000L };
+
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t) ((uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void vTaskDelayUntil(TickType_t* prev, TickType_t period)
+{
+    TickType_t wake = *prev + period;
+    TickType_t now = xTaskGetTickCount();
+
+    if ((int32_t) (wake - now) > 0) {
+        vTaskDelay(wake - now);
+    }
+    *prev = wake;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (current_task == NULL) {
+        current_task = host_task_alloc(NULL, NULL, 0);
+    }
+    return current_task;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    struct host_task* task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline = host_deadline(ticks == portMAX_DELAY ? 0 : ticks);
+    uint32_t value;
+
+    pthread_mutex_lock(&task->lock);
+    while ((task->notify == 0) && (ticks != 0)) {
+        if (host_cond_wait(&task->cond, &task->lock, ticks, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    value = task->notify;
+    if (value != 0) {
+        task->notify = clear ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken)
+{
+    xTaskNotifyGive(task);
+    if (woken != NULL) {
+        *woken = pdTRUE;
+    }
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    (void) task;
+    return 0;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    struct host_task* task = current_task;
+    return ((task != NULL) && (task->core != tskNO_AFFINITY)) ? task->core : 0;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size)
+{
+    struct host_queue* q = calloc(1, sizeof(*q));
+
+    if (q == NULL) {
+        return NULL;
+    }
+    q->items = calloc(len, item_size);
+    if (q->items == NULL) {
+        free(q);
+        return NULL;
+    }
+    q->len = len;
+    q->item_size = item_size;
+    pthread_mutex_init(&q->lock, NULL);
+    host_cond_init(&q->not_empty);
+    host_cond_init(&q->not_full);
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks)
+{
+    struct timespec deadline = host_deadline(ticks == portMAX_DELAY ? 0 : ticks);
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&q->lock);
+    while ((q->count == q->len) && (ticks != 0)) {
+        if (host_cond_wait(&q->not_full, &q->lock, ticks, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    if (q->count < q->len) {
+        memcpy(q->items + ((q->head + q->count) % q->len) * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_signal(&q->not_empty);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return ret;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t* woken)
+{
+    if (woken != NULL) {
+        *woken = pdFALSE;
+    }
+    return xQueueSend(q, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks)
+{
+    struct timespec deadline = host_deadline(ticks == portMAX_DELAY ? 0 : ticks);
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&q->lock);
+    while ((q->count == 0) && (ticks != 0)) {
+        if (host_cond_wait(&q->not_empty, &q->lock, ticks, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    if (q->count > 0) {
+        memcpy(item, q->items + q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->len;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return ret;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    UBaseType_t count;
+
+    pthread_mutex_lock(&q->lock);
+    count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q)
+{
+    return q->len - uxQueueMessagesWaiting(q);
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_event_group* g = calloc(1, sizeof(*g));
+
+    if (g == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&g->lock, NULL);
+    host_cond_init(&g->cond);
+    return g;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    EventBits_t now;
+
+    pthread_mutex_lock(&g->lock);
+    g->bits |= bits;
+    now = g->bits;
+    pthread_cond_broadcast(&g->cond);
+    pthread_mutex_unlock(&g->lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits)
+{
+    EventBits_t before;
+
+    pthread_mutex_lock(&g->lock);
+    before = g->bits;
+    g->bits &= ~bits;
+    pthread_mutex_unlock(&g->lock);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t g)
+{
+    EventBits_t bits;
+
+    pthread_mutex_lock(&g->lock);
+    bits = g->bits;
+    pthread_mutex_unlock(&g->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clear,
+        BaseType_t all, TickType_t ticks)
+{
+    struct timespec deadline = host_deadline(ticks == portMAX_DELAY ? 0 : ticks);
+    EventBits_t now;
+
+    pthread_mutex_lock(&g->lock);
+    for (;;) {
+        now = g->bits;
+        if (all ? ((now & bits) == bits) : ((now & bits) != 0)) {
+            if (clear) {
+                g->bits &= ~bits;
+            }
+            break;
+        }
+        if ((ticks == 0) || (host_cond_wait(&g->cond, &g->lock, ticks, &deadline) == ETIMEDOUT)) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g->lock);
+
+    return now;
+}
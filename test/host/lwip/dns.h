@@ -0,0 +1,4 @@
+#ifndef __HOST_LWIP_DNS_H
+#define __HOST_LWIP_DNS_H
+
+#endif
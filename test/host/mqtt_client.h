@@ -0,0 +1,114 @@
+#ifndef __HOST_MQTT_CLIENT_H
+#define __HOST_MQTT_CLIENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+
+/*
+ * Host esp-mqtt fake
+ *
+ * Same API as esp-mqtt 4.x. Nothing goes on the wire: publishes and
+ * subscribes are logged with increasing msg_ids, the test plays the broker
+ * with host_mqtt_connect()/host_mqtt_ack()/host_mqtt_data(), which call the
+ * registered handler inline like the esp-mqtt task would.
+ */
+
+typedef struct esp_mqtt_client* esp_mqtt_client_handle_t;
+
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+} esp_mqtt_event_id_t;
+
+typedef struct {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    void* user_context;
+    char* data;
+    int data_len;
+    int total_data_len;
+    int current_data_offset;
+    char* topic;
+    int topic_len;
+    int msg_id;
+    int session_present;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t* esp_mqtt_event_handle_t;
+
+typedef struct {
+    const char* uri;
+    uint32_t port;
+    const char* username;
+    const char* password;
+    const char* lwt_topic;
+    const char* lwt_msg;
+    int lwt_qos;
+    int lwt_retain;
+    int keepalive;
+    bool disable_auto_reconnect;
+    int reconnect_timeout_ms;
+    int task_prio;
+    int task_stack;
+    int buffer_size;
+    int out_buffer_size;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* cfg);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+        esp_event_handler_t handler, void* arg);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client);
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data,
+        int len, int qos, int retain);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char* topic, int qos);
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char* topic);
+
+/* host only */
+#define HOST_MQTT_LOG_MAX       256
+#define HOST_MQTT_TOPIC_MAX     128
+#define HOST_MQTT_DATA_MAX      1024
+
+typedef struct {
+    int msg_id;
+    int qos;
+    int subscribe;              // 1 -> subscribe, 0 -> publish
+    int len;
+    char topic[HOST_MQTT_TOPIC_MAX];
+    char data[HOST_MQTT_DATA_MAX];
+} host_mqtt_msg_t;
+
+typedef struct {
+    int connected;
+    int starts;
+    int reconnects;
+    int disconnects;
+    esp_err_t reconnect_result; // returned by esp_mqtt_client_reconnect
+    int published;              // publish calls accepted
+    int rejected;               // publish calls refused (not connected)
+} host_mqtt_state_t;
+
+void host_mqtt_reset(void);
+esp_mqtt_client_handle_t host_mqtt_client(void);                // last client created
+host_mqtt_state_t* host_mqtt_state(void);
+int host_mqtt_log(int index, host_mqtt_msg_t* msg);             // 0 on success, oldest first
+int host_mqtt_log_count(void);
+void host_mqtt_connect(void);                                   // MQTT_EVENT_CONNECTED
+void host_mqtt_drop(void);                                      // MQTT_EVENT_DISCONNECTED
+void host_mqtt_ack(int msg_id);                                 // MQTT_EVENT_PUBLISHED
+void host_mqtt_suback(int msg_id);                              // MQTT_EVENT_SUBSCRIBED
+void host_mqtt_data(const char* topic, const char* data, int len, int chunk);  // MQTT_EVENT_DATA
+
+#endif
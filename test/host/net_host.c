@@ -0,0 +1,443 @@
+/*
+ * Host network shim
+ *
+ * wifi, netif, event loop, nvs and LEDC calls succeed and do nothing except
+ * keeping the state the tests look at; the esp-mqtt fake logs traffic and
+ * replays broker events through the registered handler.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "esp_event.h"
+#include "esp_system.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "nvs_flash.h"
+#include "mqtt_client.h"
+#include "driver/ledc.h"
+
+#define HOST_EVENT_HANDLERS_MAX 8
+
+esp_event_base_t WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t IP_EVENT = "IP_EVENT";
+
+static struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void* arg;
+} host_handlers[HOST_EVENT_HANDLERS_MAX];
+static int host_handler_count = 0;
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id,
+        esp_event_handler_t handler, void* arg)
+{
+    if (host_handler_count >= HOST_EVENT_HANDLERS_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+    host_handlers[host_handler_count].base = base;
+    host_handlers[host_handler_count].id = id;
+    host_handlers[host_handler_count].handler = handler;
+    host_handlers[host_handler_count].arg = arg;
+    host_handler_count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t id,
+        esp_event_handler_t handler, void* arg, esp_event_handler_instance_t* instance)
+{
+    (void) instance;
+    return esp_event_handler_register(base, id, handler, arg);
+}
+
+void host_event_post(esp_event_base_t base, int32_t id, void* data)
+{
+    for (int i = 0; i < host_handler_count; i++) {
+        if ((host_handlers[i].base == base) && ((host_handlers[i].id == ESP_EVENT_ANY_ID) || (host_handlers[i].id == id))) {
+            host_handlers[i].handler(host_handlers[i].arg, base, id, data);
+        }
+    }
+}
+
+uint32_t esp_random(void)
+{
+    return ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return 200 * 1024;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return 150 * 1024;
+}
+
+const char* esp_get_idf_version(void)
+{
+    return "host";
+}
+
+void esp_restart(void)
+{
+    abort();
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t* esp_netif_create_default_wifi_sta(void)
+{
+    static int netif;
+    return (esp_netif_t*) &netif;
+}
+
+esp_err_t esp_netif_dhcpc_start(esp_netif_t* netif)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t* netif)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t* netif, const esp_netif_ip_info_t* info)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_dns_info(esp_netif_t* netif, esp_netif_dns_type_t type, esp_netif_dns_info_t* dns)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_get_dns_info(esp_netif_t* netif, esp_netif_dns_type_t type, esp_netif_dns_info_t* dns)
+{
+    memset(dns, 0, sizeof(*dns));
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t* cfg)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t iface, wifi_config_t* cfg)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t iface, wifi_config_t* cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t* info)
+{
+    memset(info, 0, sizeof(*info));
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    return ESP_OK;
+}
+
+ledc_timer_config_t host_ledc_timer;
+uint32_t host_ledc_duty;
+
+// the LEDC divider can not reach 0 Hz, everything else is accepted here
+esp_err_t ledc_timer_config(const ledc_timer_config_t* cfg)
+{
+    if (cfg->freq_hz == 0) {
+        return ESP_FAIL;
+    }
+    host_ledc_timer = *cfg;
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t* cfg)
+{
+    host_ledc_duty = cfg->duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty)
+{
+    host_ledc_duty = duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t channel)
+{
+    return ESP_OK;
+}
+
+esp_err_t ledc_stop(ledc_mode_t mode, ledc_channel_t channel, uint32_t idle_level)
+{
+    host_ledc_duty = 0;
+    return ESP_OK;
+}
+
+struct esp_mqtt_client {
+    esp_mqtt_client_config_t cfg;
+    esp_event_handler_t handler;
+    void* handler_arg;
+};
+
+static pthread_mutex_t host_mqtt_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct esp_mqtt_client* host_mqtt_last = NULL;
+static host_mqtt_state_t host_mqtt;
+static host_mqtt_msg_t host_mqtt_msgs[HOST_MQTT_LOG_MAX];
+static int host_mqtt_msg_count = 0;
+static int host_mqtt_next_id = 1;
+
+void host_mqtt_reset(void)
+{
+    pthread_mutex_lock(&host_mqtt_lock);
+    memset(&host_mqtt, 0, sizeof(host_mqtt));
+    host_mqtt_msg_count = 0;
+    host_mqtt_next_id = 1;
+    pthread_mutex_unlock(&host_mqtt_lock);
+}
+
+esp_mqtt_client_handle_t host_mqtt_client(void)
+{
+    return host_mqtt_last;
+}
+
+host_mqtt_state_t* host_mqtt_state(void)
+{
+    return &host_mqtt;
+}
+
+int host_mqtt_log_count(void)
+{
+    int count;
+
+    pthread_mutex_lock(&host_mqtt_lock);
+    count = host_mqtt_msg_count;
+    pthread_mutex_unlock(&host_mqtt_lock);
+    return count;
+}
+
+int host_mqtt_log(int index, host_mqtt_msg_t* msg)
+{
+    int ret = -1;
+
+    pthread_mutex_lock(&host_mqtt_lock);
+    if ((index >= 0) && (index < host_mqtt_msg_count) && (index >= host_mqtt_msg_count - HOST_MQTT_LOG_MAX)) {
+        *msg = host_mqtt_msgs[index % HOST_MQTT_LOG_MAX];
+        ret = 0;
+    }
+    pthread_mutex_unlock(&host_mqtt_lock);
+    return ret;
+}
+
+static int host_mqtt_record(const char* topic, const char* data, int len, int qos, int subscribe)
+{
+    host_mqtt_msg_t* m;
+    int msg_id;
+
+    pthread_mutex_lock(&host_mqtt_lock);
+    if (!host_mqtt.connected) {
+        host_mqtt.rejected++;
+        pthread_mutex_unlock(&host_mqtt_lock);
+        return -1;
+    }
+    if ((len == 0) && (data != NULL)) {
+        len = (int) strlen(data);
+    }
+    msg_id = ((qos == 0) && !subscribe) ? 0 : host_mqtt_next_id++;
+    m = &host_mqtt_msgs[host_mqtt_msg_count % HOST_MQTT_LOG_MAX];
+    m->msg_id = msg_id;
+    m->qos = qos;
+    m->subscribe = subscribe;
+    m->len = len;
+    strncpy(m->topic, topic, sizeof(m->topic) - 1);
+    m->topic[sizeof(m->topic) - 1] = '\0';
+    memcpy(m->data, data != NULL ? data : "", (len < HOST_MQTT_DATA_MAX) ? len : HOST_MQTT_DATA_MAX);
+    host_mqtt_msg_count++;
+    if (!subscribe) {
+        host_mqtt.published++;
+    }
+    pthread_mutex_unlock(&host_mqtt_lock);
+
+    return msg_id;
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* cfg)
+{
+    struct esp_mqtt_client* client = calloc(1, sizeof(*client));
+
+    if (client != NULL) {
+        client->cfg = *cfg;
+        host_mqtt_last = client;
+    }
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+        esp_event_handler_t handler, void* arg)
+{
+    client->handler = handler;
+    client->handler_arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    host_mqtt.starts++;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    host_mqtt.connected = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client)
+{
+    host_mqtt.reconnects++;
+    return host_mqtt.reconnect_result;
+}
+
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client)
+{
+    pthread_mutex_lock(&host_mqtt_lock);
+    host_mqtt.disconnects++;
+    host_mqtt.connected = 0;
+    pthread_mutex_unlock(&host_mqtt_lock);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data,
+        int len, int qos, int retain)
+{
+    return host_mqtt_record(topic, data, len, qos, 0);
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char* topic, int qos)
+{
+    return host_mqtt_record(topic, NULL, 0, qos, 1);
+}
+
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char* topic)
+{
+    return host_mqtt.connected ? host_mqtt_next_id++ : -1;
+}
+
+static void host_mqtt_emit(esp_mqtt_event_t* event)
+{
+    struct esp_mqtt_client* client = host_mqtt_last;
+
+    if ((client == NULL) || (client->handler == NULL)) {
+        return;
+    }
+    event->client = client;
+    client->handler(client->handler_arg, "MQTT_EVENTS", event->event_id, event);
+}
+
+void host_mqtt_connect(void)
+{
+    esp_mqtt_event_t event = { .event_id = MQTT_EVENT_CONNECTED };
+
+    pthread_mutex_lock(&host_mqtt_lock);
+    host_mqtt.connected = 1;
+    pthread_mutex_unlock(&host_mqtt_lock);
+    host_mqtt_emit(&event);
+}
+
+void host_mqtt_drop(void)
+{
+    esp_mqtt_event_t event = { .event_id = MQTT_EVENT_DISCONNECTED };
+
+    pthread_mutex_lock(&host_mqtt_lock);
+    host_mqtt.connected = 0;
+    pthread_mutex_unlock(&host_mqtt_lock);
+    host_mqtt_emit(&event);
+}
+
+void host_mqtt_ack(int msg_id)
+{
+    esp_mqtt_event_t event = { .event_id = MQTT_EVENT_PUBLISHED, .msg_id = msg_id };
+    host_mqtt_emit(&event);
+}
+
+void host_mqtt_suback(int msg_id)
+{
+    esp_mqtt_event_t event = { .event_id = MQTT_EVENT_SUBSCRIBED, .msg_id = msg_id };
+    host_mqtt_emit(&event);
+}
+
+// deliver data in chunks of at most chunk bytes (0 -> one event), like esp-mqtt does
+void host_mqtt_data(const char* topic, const char* data, int len, int chunk)
+{
+    int offset = 0;
+
+    if (chunk <= 0) {
+        chunk = len;
+    }
+    do {
+        int n = (len - offset < chunk) ? len - offset : chunk;
+        esp_mqtt_event_t event = {
+            .event_id = MQTT_EVENT_DATA,
+            .data = (char*) data + offset,
+            .data_len = n,
+            .total_data_len = len,
+            .current_data_offset = offset,
+            .topic = (offset == 0) ? (char*) topic : NULL,
+            .topic_len = (offset == 0) ? (int) strlen(topic) : 0,
+        };
+        host_mqtt_emit(&event);
+        offset += n;
+    } while (offset < len);
+}
@@ -0,0 +1,172 @@
+/*
+ * Host PCNT fake
+ *
+ * Each unit counts up on host_pcnt_pulse() while running, resets to 0 at
+ * its high limit and then calls the unit ISR if the H_LIM event is enabled.
+ */
+
+#include <string.h>
+
+#include "driver/pcnt.h"
+
+host_pcnt_unit_t host_pcnt_units[PCNT_UNIT_MAX];
+int host_pcnt_service = 0;
+int host_pcnt_fail_unit = -1;
+
+static int host_pcnt_valid(pcnt_unit_t unit)
+{
+    return ((int) unit >= 0) && (unit < PCNT_UNIT_MAX);
+}
+
+void host_pcnt_reset(void)
+{
+    memset(host_pcnt_units, 0, sizeof(host_pcnt_units));
+    for (int i = 0; i < PCNT_UNIT_MAX; i++) {
+        host_pcnt_units[i].pulse_gpio = PCNT_PIN_NOT_USED;
+    }
+    host_pcnt_service = 0;
+    host_pcnt_fail_unit = -1;
+}
+
+void host_pcnt_pulse(pcnt_unit_t unit, int pulses)
+{
+    host_pcnt_unit_t* u = &host_pcnt_units[unit];
+
+    for (int i = 0; (i < pulses) && u->running; i++) {
+        if (++u->count >= u->h_lim) {
+            u->count = 0;
+            if (u->h_lim_event && (u->isr != NULL)) {
+                u->isr(u->isr_arg);
+            }
+        }
+    }
+}
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* cfg)
+{
+    if (!host_pcnt_valid(cfg->unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((int) cfg->unit == host_pcnt_fail_unit) {
+        return ESP_FAIL;
+    }
+    host_pcnt_units[cfg->unit].pulse_gpio = cfg->pulse_gpio_num;
+    host_pcnt_units[cfg->unit].h_lim = cfg->counter_h_lim;
+    host_pcnt_units[cfg->unit].running = 1;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t value)
+{
+    (void) value;
+    return host_pcnt_valid(unit) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit)
+{
+    return host_pcnt_valid(unit) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t evt)
+{
+    if (!host_pcnt_valid(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (evt == PCNT_EVT_H_LIM) {
+        host_pcnt_units[unit].h_lim_event = 1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t pcnt_event_disable(pcnt_unit_t unit, pcnt_evt_type_t evt)
+{
+    if (!host_pcnt_valid(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (evt == PCNT_EVT_H_LIM) {
+        host_pcnt_units[unit].h_lim_event = 0;
+    }
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit)
+{
+    if (!host_pcnt_valid(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_pcnt_units[unit].running = 0;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit)
+{
+    if (!host_pcnt_valid(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_pcnt_units[unit].running = 1;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit)
+{
+    if (!host_pcnt_valid(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_pcnt_units[unit].count = 0;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count)
+{
+    if (!host_pcnt_valid(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *count = host_pcnt_units[unit].count;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_set_pin(pcnt_unit_t unit, pcnt_channel_t channel, int pulse_io, int ctrl_io)
+{
+    (void) channel;
+    (void) ctrl_io;
+    if (!host_pcnt_valid(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_pcnt_units[unit].pulse_gpio = pulse_io;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_service_install(int flags)
+{
+    (void) flags;
+    if (host_pcnt_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    host_pcnt_service = 1;
+    return ESP_OK;
+}
+
+void pcnt_isr_service_uninstall(void)
+{
+    host_pcnt_service = 0;
+}
+
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*isr)(void*), void* arg)
+{
+    if (!host_pcnt_valid(unit) || !host_pcnt_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    host_pcnt_units[unit].isr = isr;
+    host_pcnt_units[unit].isr_arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_remove(pcnt_unit_t unit)
+{
+    if (!host_pcnt_valid(unit)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_pcnt_units[unit].isr = NULL;
+    host_pcnt_units[unit].isr_arg = NULL;
+    return ESP_OK;
+}
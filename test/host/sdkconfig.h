@@ -0,0 +1,6 @@
+#ifndef __HOST_SDKCONFIG_H
+#define __HOST_SDKCONFIG_H
+
+#define CONFIG_IDF_TARGET "host"
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef __TEST_UTIL_H
+#define __TEST_UTIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Minimal host test helpers: CHECK reports file:line and keeps going,
+ * TEST_EXIT turns the failure count into the process exit code for ctest.
+ */
+
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) do { \
+        long long _a = (long long) (a), _b = (long long) (b); \
+        if (_a != _b) { \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+                    __FILE__, __LINE__, #a, #b, _a, _b); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define TEST_EXIT() do { \
+        if (test_failures != 0) { \
+            fprintf(stderr, "%d check(s) failed\n", test_failures); \
+            return EXIT_FAILURE; \
+        } \
+        printf("ok\n"); \
+        return EXIT_SUCCESS; \
+    } while (0)
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * batch host test
+ *
+ * batch_add  -> HELD / DUE on the count and age triggers, FULL without
+ *               overwriting what is held
+ * batch_pack -> stops before max_payload, the rest stays for the next envelope
+ * batch_drop -> keeps the order of what is left
+ */
+
+#include <string.h>
+
+#include "batch.h"
+
+#include "test_util.h"
+
+#define PAYLOAD_MAX     2048
+
+static const wire_config_t wire_json = { .format = WIRE_JSON };
+static const wire_config_t wire_cbor = { .format = WIRE_CBOR };
+
+static void pack_item(wire_writer_t* w, const sample_t* s, int first, int with_ts)
+{
+    wire_item_begin(w, "wifi_node", "pulse_counter", first, with_ts);
+    wire_map_begin(w, 2);
+    wire_key(w, "CH1", 1);
+    wire_u64(w, s->pulse1);
+    wire_key(w, "CH2", 0);
+    wire_u64(w, s->pulse2);
+    wire_map_end(w);
+    if (with_ts) {
+        wire_item_ts(w, s->timestamp);
+    }
+    wire_item_end(w);
+}
+
+static sample_t make_sample(int i)
+{
+    sample_t s = { .timestamp = 1700000000u + i * 60, .battery = 3.3f, .pulse1 = 1000u + i, .pulse2 = i };
+    return s;
+}
+
+static void test_triggers(void)
+{
+    batch_t b;
+    sample_t s = make_sample(0);
+
+    batch_init(&b, 3, 1000, 0, &wire_json, pack_item);
+    CHECK_EQ(batch_due(&b, 0), 0);
+    CHECK_EQ(batch_add(&b, &s, 0), BATCH_HELD);
+    CHECK_EQ(batch_add(&b, &s, 500000), BATCH_HELD);
+    // the age counts from the oldest sample held
+    CHECK_EQ(batch_due(&b, 999999), 0);
+    CHECK_EQ(batch_due(&b, 1000000), 1);
+    CHECK_EQ(batch_add(&b, &s, 600000), BATCH_DUE);
+
+    // a fresh batch restarts the age
+    batch_drop(&b, b.count);
+    CHECK_EQ(batch_add(&b, &s, 5000000), BATCH_HELD);
+    CHECK_EQ(batch_due(&b, 5500000), 0);
+}
+
+static void test_full(void)
+{
+    batch_t b;
+
+    batch_init(&b, BATCH_MAX_SAMPLES, 0, 0, &wire_json, pack_item);
+    for (int i = 0; i < BATCH_MAX_SAMPLES; i++) {
+        sample_t s = make_sample(i);
+        CHECK(batch_add(&b, &s, 0) != BATCH_FULL);
+    }
+    sample_t extra = make_sample(BATCH_MAX_SAMPLES);
+    CHECK_EQ(batch_add(&b, &extra, 0), BATCH_FULL);
+    CHECK_EQ(b.count, BATCH_MAX_SAMPLES);
+    // nothing held was overwritten
+    CHECK_EQ(b.samples[0].pulse1, 1000);
+    CHECK_EQ(b.samples[BATCH_MAX_SAMPLES - 1].pulse1, 1000 + BATCH_MAX_SAMPLES - 1);
+
+    batch_drop(&b, 5);
+    CHECK_EQ(b.count, BATCH_MAX_SAMPLES - 5);
+    CHECK_EQ(b.samples[0].pulse1, 1005);
+    CHECK(batch_add(&b, &extra, 0) != BATCH_FULL);
+    CHECK_EQ(b.samples[b.count - 1].pulse1, 1000 + BATCH_MAX_SAMPLES);
+}
+
+static void test_pack_split(const wire_config_t* wire)
+{
+    static char buf[PAYLOAD_MAX];
+    batch_t b;
+    int packed = 0, one, total = 0;
+
+    // the size of a one sample envelope bounds what a two sample one needs
+    batch_init(&b, BATCH_MAX_SAMPLES, 0, 0, wire, pack_item);
+    sample_t s = make_sample(0);
+    batch_add(&b, &s, 0);
+    one = batch_pack(&b, buf, sizeof(buf), &packed);
+    CHECK(one > 0);
+    CHECK_EQ(packed, 1);
+
+    // room for a few samples only: every envelope stays under the limit
+    size_t limit = (size_t) one * 4;
+    batch_init(&b, BATCH_MAX_SAMPLES, 0, limit, wire, pack_item);
+    for (int i = 0; i < BATCH_MAX_SAMPLES; i++) {
+        s = make_sample(i);
+        batch_add(&b, &s, 0);
+    }
+    while (b.count > 0) {
+        int len = batch_pack(&b, buf, sizeof(buf), &packed);
+        CHECK(len > 0);
+        CHECK(packed > 0);
+        CHECK((size_t) len <= limit);
+        if ((len <= 0) || (packed == 0)) {
+            break;
+        }
+        CHECK_EQ(b.samples[0].pulse1, 1000 + total);
+        total += packed;
+        batch_drop(&b, packed);
+    }
+    CHECK_EQ(total, BATCH_MAX_SAMPLES);
+
+    // not even one sample fits
+    batch_init(&b, BATCH_MAX_SAMPLES, 0, 8, wire, pack_item);
+    batch_add(&b, &s, 0);
+    CHECK_EQ(batch_pack(&b, buf, sizeof(buf), &packed), -1);
+    CHECK_EQ(packed, 0);
+    CHECK_EQ(b.count, 1);
+}
+
+int main(void)
+{
+    test_triggers();
+    test_full();
+    test_pack_split(&wire_json);
+    test_pack_split(&wire_cbor);
+    TEST_EXIT();
+}
@@ -0,0 +1,35 @@
+/*
+ * LED actuator host test (7 sketch)
+ *
+ * pattern   -> the LED toggles every 1000 ms like the original loop (2 s
+ *              period); LEDC only takes whole Hz, so the esp_timer path runs
+ * on / off  -> the timer only runs while blinking, off leaves the LED low
+ */
+
+#include "receive_command.c"
+
+#include "test_util.h"
+
+int main(void)
+{
+    CHECK_EQ(BLINK_PERIOD_MS, 2000);
+    CHECK_EQ(BLINK_LEDC_HZ, 0);
+
+    configure_led();
+    CHECK_EQ(actuator_ledc, 0);
+    CHECK(blink_timer != NULL);
+    CHECK_EQ(host_timer_period(blink_timer), 0);
+
+    actuator_apply(1);
+    CHECK_EQ(host_timer_period(blink_timer), 1000 * 1000);
+    CHECK_EQ(gpio_get_level(BLINK_GPIO), 1);
+    host_timer_fire(blink_timer);
+    CHECK_EQ(gpio_get_level(BLINK_GPIO), 0);
+    host_timer_fire(blink_timer);
+    CHECK_EQ(gpio_get_level(BLINK_GPIO), 1);
+
+    actuator_apply(0);
+    CHECK_EQ(host_timer_period(blink_timer), 0);
+    CHECK_EQ(gpio_get_level(BLINK_GPIO), 0);
+    TEST_EXIT();
+}
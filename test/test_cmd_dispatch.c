@@ -0,0 +1,125 @@
+/*
+ * Command dispatch host test (7 sketch)
+ *
+ * cmd_routes[]  -> sorted, every route found by param and by param/sensor
+ * lookup        -> binary search agrees with a linear scan on large tables,
+ *                  a param with several sensors, misses on both sides
+ * check         -> unsorted and duplicate tables are refused
+ * confirm       -> known and unknown commands answer with the right payload
+ */
+
+#include "receive_command.c"
+
+#include "test_util.h"
+
+#define BIG_ROUTES      300
+#define NAME_MAX        24
+
+static char big_names[BIG_ROUTES][2][NAME_MAX];
+static cmd_route_t big_routes[BIG_ROUTES];
+
+static int handler_value(int32_t value, int32_t* report)
+{
+    *report = value;
+    return CMD_RESULT_OK;
+}
+
+static const cmd_route_t* linear_find(const cmd_route_t* routes, int count, const char* param, const char* sensor)
+{
+    for (int i = 0; i < count; i++) {
+        if (cmd_route_cmp(&routes[i], param, sensor) == 0) {
+            return &routes[i];
+        }
+    }
+    return NULL;
+}
+
+// params p000..p099, each with sensors s0..s2: sorted by construction
+static void build_big(void)
+{
+    for (int i = 0; i < BIG_ROUTES; i++) {
+        snprintf(big_names[i][0], NAME_MAX, "p%03d", i / 3);
+        snprintf(big_names[i][1], NAME_MAX, "s%d", i % 3);
+        big_routes[i].param = big_names[i][0];
+        big_routes[i].sensor = big_names[i][1];
+        big_routes[i].report_param = "r";
+        big_routes[i].handler = handler_value;
+    }
+}
+
+static void test_real_table(void)
+{
+    CHECK_EQ(cmd_routes_check(cmd_routes, CMD_ROUTE_COUNT), ESP_OK);
+    for (int i = 0; i < CMD_ROUTE_COUNT; i++) {
+        CHECK(cmd_route_find(cmd_routes, CMD_ROUTE_COUNT, cmd_routes[i].param, cmd_routes[i].sensor) == &cmd_routes[i]);
+        CHECK(cmd_route_find(cmd_routes, CMD_ROUTE_COUNT, cmd_routes[i].param, NULL) != NULL);
+    }
+    CHECK(cmd_route_find(cmd_routes, CMD_ROUTE_COUNT, "turnon", "led_offboard") == NULL);
+    CHECK(cmd_route_find(cmd_routes, CMD_ROUTE_COUNT, "turnoff", NULL) == NULL);
+    CHECK(cmd_route_find(cmd_routes, 0, "turnon", NULL) == NULL);
+}
+
+static void test_big_table(void)
+{
+    char param[NAME_MAX], sensor[NAME_MAX];
+
+    build_big();
+    CHECK_EQ(cmd_routes_check(big_routes, BIG_ROUTES), ESP_OK);
+    // p-1 .. p100 around the table, sensors s-1 .. s3 around each param
+    for (int p = -1; p <= BIG_ROUTES / 3; p++) {
+        snprintf(param, sizeof(param), (p < 0) ? "a" : "p%03d", p);
+        CHECK(cmd_route_find(big_routes, BIG_ROUTES, param, NULL) == linear_find(big_routes, BIG_ROUTES, param, NULL));
+        for (int s = -1; s <= 3; s++) {
+            snprintf(sensor, sizeof(sensor), (s < 0) ? "a" : "s%d", s);
+            const cmd_route_t* r = cmd_route_find(big_routes, BIG_ROUTES, param, sensor);
+            CHECK(r == linear_find(big_routes, BIG_ROUTES, param, sensor));
+            CHECK((r != NULL) == ((p >= 0) && (p < BIG_ROUTES / 3) && (s >= 0) && (s < 3)));
+        }
+        // without a sensor the first route of the param
+        const cmd_route_t* first = cmd_route_find(big_routes, BIG_ROUTES, param, NULL);
+        if (first != NULL) {
+            CHECK(strcmp(first->sensor, "s0") == 0);
+        }
+    }
+}
+
+static void test_check(void)
+{
+    cmd_route_t routes[3];
+
+    build_big();
+    memcpy(routes, big_routes, sizeof(routes));
+    CHECK_EQ(cmd_routes_check(routes, 3), ESP_OK);
+    routes[2] = big_routes[0];
+    CHECK_EQ(cmd_routes_check(routes, 3), ESP_ERR_INVALID_STATE);
+    routes[2] = routes[1];
+    CHECK_EQ(cmd_routes_check(routes, 3), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(cmd_routes_check(routes, 1), ESP_OK);
+}
+
+static void test_confirm(void)
+{
+    cmd_msg_t cmd = { .id = "c1", .param = "turnon", .sensor = "led_onboard",
+                      .have = CMD_HAVE_ALL | CMD_HAVE_SENSOR, .value = 1 };
+    char buf[256];
+
+    CHECK(cmd_dispatch(&cmd, buf, sizeof(buf)) > 0);
+    CHECK(strcmp(buf, "{\"result\":0,\"id\":\"c1\",\"payload\":[{\"sensor\":\"led_onboard\","
+            "\"param\":\"ledstat\",\"configtype\":\"data\",\"value\":1}]}") == 0);
+
+    strcpy(cmd.param, "reboot");
+    CHECK(cmd_dispatch(&cmd, buf, sizeof(buf)) > 0);
+    CHECK(strcmp(buf, "{\"result\":2,\"id\":\"c1\",\"payload\":[]}") == 0);
+
+    // no room for the confirm
+    CHECK_EQ(cmd_dispatch(&cmd, buf, 8), -1);
+}
+
+int main(void)
+{
+    test_real_table();
+    test_big_table();
+    test_check();
+    test_confirm();
+    TEST_EXIT();
+}
@@ -0,0 +1,388 @@
+/*
+ * Command parser host test (7 sketch)
+ *
+ * escapes    -> \uXXXX consumes exactly 4 hex digits, at any position
+ * chunking   -> every split of a message parses like the whole message
+ * generated  -> random valid commands (key order, extra keys, nesting,
+ *               escapes, whitespace) against the expected fields
+ * fuzz       -> mutated and random input: no out of bounds (built with
+ *               ASan/UBSan when available), same result for any chunking,
+ *               fields always NUL terminated inside their buffers
+ */
+
+#include "receive_command.c"
+
+#include "test_util.h"
+
+#define GENERATED_COMMANDS  20000
+#define FUZZ_INPUTS         200000
+#define FUZZ_LEN_MAX        192
+
+static uint32_t rng_state = 0x9e3779b9;
+
+static uint32_t rng_next(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rng_below(uint32_t n)
+{
+    return rng_next() % n;
+}
+
+// feed msg in chunks of chunk bytes (0 -> all at once)
+static cmd_parse_stat_t parse(cmd_parser_t* p, const char* msg, int len, int chunk)
+{
+    cmd_parse_stat_t stat = CMD_PARSE_MORE;
+
+    cmd_parser_reset(p);
+    if (chunk <= 0) {
+        chunk = len;
+    }
+    for (int off = 0; off < len; off += chunk) {
+        int n = (len - off < chunk) ? len - off : chunk;
+        stat = cmd_parser_feed(p, msg + off, n);
+    }
+    return stat;
+}
+
+static int parsed_equal(const cmd_parser_t* a, const cmd_parser_t* b)
+{
+    if (a->have != b->have) {
+        return 0;
+    }
+    if ((a->have & CMD_HAVE_ID) && (strcmp(a->id, b->id) != 0)) {
+        return 0;
+    }
+    if ((a->have & CMD_HAVE_PARAM) && (strcmp(a->param, b->param) != 0)) {
+        return 0;
+    }
+    if ((a->have & CMD_HAVE_SENSOR) && (strcmp(a->sensor, b->sensor) != 0)) {
+        return 0;
+    }
+    return !(a->have & CMD_HAVE_VALUE) || (a->value == b->value);
+}
+
+typedef struct {
+    const char* json;
+    cmd_parse_stat_t stat;
+    const char* id;
+    const char* param;
+    int32_t value;
+} parse_case_t;
+
+static const parse_case_t cases[] = {
+    { "{\"id\":\"a1\",\"param\":\"turnon\",\"value\":1}", CMD_PARSE_DONE, "a1", "turnon", 1 },
+    { " { \"value\" : 0 , \"param\" : \"turnon\" , \"id\" : \"b\" } ", CMD_PARSE_DONE, "b", "turnon", 0 },
+    // the byte after the 4th hex digit is plain again
+    { "{\"id\":\"a\\u0041b\",\"param\":\"turnon\",\"value\":1}", CMD_PARSE_DONE, "a?b", "turnon", 1 },
+    { "{\"id\":\"x\\u00e9\",\"param\":\"turnon\",\"value\":1}", CMD_PARSE_DONE, "x?", "turnon", 1 },
+    { "{\"id\":\"\\u00e9\\u00E9\\n\",\"param\":\"turnon\",\"value\":1}", CMD_PARSE_DONE, "??\n", "turnon", 1 },
+    { "{\"id\":\"\\uABCDn\",\"param\":\"turnon\",\"value\":1}", CMD_PARSE_DONE, "?n", "turnon", 1 },
+    { "{\"id\":\"q\\\"\\\\\\/\",\"param\":\"turnon\",\"value\":1}", CMD_PARSE_DONE, "q\"\\/", "turnon", 1 },
+    { "{\"p\\u0061ram\":\"x\",\"id\":\"k\",\"param\":\"turnon\",\"value\":1}", CMD_PARSE_DONE, "k", "turnon", 1 },
+    { "{\"x\":{\"a\":\"\\u0022}\",\"b\":[1,{\"c\":\"]\"}]},\"id\":\"n\",\"param\":\"turnon\",\"value\":true}",
+            CMD_PARSE_DONE, "n", "turnon", 1 },
+    { "{\"id\":\"s\",\"param\":\"turnon\",\"value\":\"1\"}", CMD_PARSE_DONE, "s", "turnon", 1 },
+    { "{\"id\":\"f\",\"param\":\"turnon\",\"value\":false}", CMD_PARSE_DONE, "f", "turnon", 0 },
+    { "{\"id\":\"d\",\"param\":\"turnon\",\"value\":-2.75e1}", CMD_PARSE_DONE, "d", "turnon", -2 },
+    { "{\"id\":\"t\",\"param\":\"turnon\",\"value\":1", CMD_PARSE_MORE, NULL, NULL, 0 },
+    { "{\"id\":\"t\",\"param\":\"turnon\" \"value\":1}", CMD_PARSE_ERROR, NULL, NULL, 0 },
+    { "[1]", CMD_PARSE_ERROR, NULL, NULL, 0 },
+    { "{\"id\":\"t\",\"param\":\"turnon\",\"value\":1} x", CMD_PARSE_ERROR, NULL, NULL, 0 },
+};
+
+static void test_cases(void)
+{
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const parse_case_t* c = &cases[i];
+        int len = (int) strlen(c->json);
+        cmd_parser_t whole, split;
+
+        cmd_parse_stat_t stat = parse(&whole, c->json, len, 0);
+        if (stat != c->stat) {
+            fprintf(stderr, "case %zu: stat %d, expected %d\n", i, stat, c->stat);
+            CHECK(stat == c->stat);
+            continue;
+        }
+        if (c->stat == CMD_PARSE_DONE) {
+            CHECK_EQ(whole.have & CMD_HAVE_ALL, CMD_HAVE_ALL);
+            CHECK(strcmp(whole.id, c->id) == 0);
+            CHECK(strcmp(whole.param, c->param) == 0);
+            CHECK_EQ(whole.value, c->value);
+        }
+        for (int chunk = 1; chunk < len; chunk++) {
+            CHECK_EQ(parse(&split, c->json, len, chunk), stat);
+            CHECK(parsed_equal(&whole, &split));
+        }
+    }
+}
+
+/*
+ * Random valid command builder. Strings are written with random escapes,
+ * the decoded text the parser must produce is kept alongside.
+ */
+typedef struct {
+    char buf[1024];
+    int len;
+} gen_t;
+
+static void gen_put(gen_t* g, const char* s)
+{
+    size_t n = strlen(s);
+    memcpy(&g->buf[g->len], s, n);
+    g->len += (int) n;
+}
+
+static void gen_ws(gen_t* g)
+{
+    static const char* ws[] = { "", "", "", " ", "\n", "\t ", "\r\n  " };
+    gen_put(g, ws[rng_below(sizeof(ws) / sizeof(ws[0]))]);
+}
+
+// write a JSON string with random escapes, decoded text into out (may be NULL)
+static void gen_string(gen_t* g, int max, char* out)
+{
+    static const char plain[] = "abcXYZ019_-:./ ";
+    static const char hex[] = "0123456789abcdefABCDEF";
+    int n = (int) rng_below(max + 1);
+    int o = 0;
+
+    gen_put(g, "\"");
+    for (int i = 0; i < n; i++) {
+        char tmp[8];
+        char dec;
+        switch (rng_below(10)) {
+            case 0:
+                tmp[0] = '\\';
+                tmp[1] = 'u';
+                for (int k = 2; k < 6; k++) {
+                    tmp[k] = hex[rng_below(sizeof(hex) - 1)];
+                }
+                tmp[6] = '\0';
+                dec = '?';
+                break;
+            case 1: strcpy(tmp, "\\n"); dec = '\n'; break;
+            case 2: strcpy(tmp, "\\\""); dec = '"'; break;
+            case 3: strcpy(tmp, "\\\\"); dec = '\\'; break;
+            case 4: strcpy(tmp, "\\t"); dec = '\t'; break;
+            default:
+                tmp[0] = plain[rng_below(sizeof(plain) - 1)];
+                tmp[1] = '\0';
+                dec = tmp[0];
+                break;
+        }
+        gen_put(g, tmp);
+        if (out != NULL) {
+            out[o++] = dec;
+        }
+    }
+    gen_put(g, "\"");
+    if (out != NULL) {
+        out[o] = '\0';
+    }
+}
+
+static void gen_other_value(gen_t* g, int depth)
+{
+    static const char* scalars[] = { "0", "-17", "3.25", "1e9", "true", "false", "null" };
+
+    switch (rng_below(depth > 2 ? 2 : 4)) {
+        case 0:
+            gen_put(g, scalars[rng_below(sizeof(scalars) / sizeof(scalars[0]))]);
+            break;
+        case 1:
+            gen_string(g, 12, NULL);
+            break;
+        case 2:
+            gen_put(g, "[");
+            for (int i = 0, n = (int) rng_below(3); i < n; i++) {
+                if (i) {
+                    gen_put(g, ",");
+                }
+                gen_ws(g);
+                gen_other_value(g, depth + 1);
+            }
+            gen_put(g, "]");
+            break;
+        default:
+            gen_put(g, "{");
+            for (int i = 0, n = (int) rng_below(3); i < n; i++) {
+                if (i) {
+                    gen_put(g, ",");
+                }
+                gen_string(g, 6, NULL);
+                gen_put(g, ":");
+                gen_other_value(g, depth + 1);
+            }
+            gen_put(g, "}");
+            break;
+    }
+}
+
+static void test_generated(void)
+{
+    int failures = 0;
+
+    for (int n = 0; (n < GENERATED_COMMANDS) && (failures < 5); n++) {
+        char id[CMD_ID_MAX], param[CMD_PARAM_MAX], sensor[CMD_PARAM_MAX];
+        int32_t value = (int32_t) rng_below(2000) - 1000;
+        int with_sensor = (int) rng_below(2);
+        int order[6] = { 0, 1, 2, 3, 4, 5 };    // id, param, value, sensor, extra, extra
+        gen_t g = { .len = 0 };
+        cmd_parser_t whole, split;
+
+        for (int i = 5; i > 0; i--) {
+            int j = (int) rng_below(i + 1);
+            int t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+        }
+
+        gen_ws(&g);
+        gen_put(&g, "{");
+        int first = 1;
+        for (int i = 0; i < 6; i++) {
+            if ((order[i] == 3) && !with_sensor) {
+                continue;
+            }
+            if (!first) {
+                gen_put(&g, ",");
+            }
+            first = 0;
+            gen_ws(&g);
+            switch (order[i]) {
+                case 0:
+                    gen_put(&g, "\"id\"");
+                    gen_ws(&g);
+                    gen_put(&g, ":");
+                    gen_ws(&g);
+                    gen_string(&g, CMD_ID_MAX - 1, id);
+                    break;
+                case 1:
+                    gen_put(&g, "\"param\":");
+                    gen_string(&g, CMD_PARAM_MAX - 1, param);
+                    break;
+                case 2: {
+                    char num[16];
+                    gen_put(&g, "\"value\":");
+                    snprintf(num, sizeof(num), rng_below(2) ? "%d" : "\"%d\"", value);
+                    gen_put(&g, num);
+                    break;
+                }
+                case 3:
+                    gen_put(&g, "\"sensor\":");
+                    gen_string(&g, CMD_PARAM_MAX - 1, sensor);
+                    break;
+                default:
+                    gen_string(&g, 30, NULL);
+                    gen_put(&g, ":");
+                    gen_ws(&g);
+                    gen_other_value(&g, 0);
+                    break;
+            }
+            gen_ws(&g);
+        }
+        gen_put(&g, "}");
+        gen_ws(&g);
+
+        int ok = (parse(&whole, g.buf, g.len, 0) == CMD_PARSE_DONE)
+                && ((whole.have & CMD_HAVE_ALL) == CMD_HAVE_ALL)
+                && (strcmp(whole.id, id) == 0) && (strcmp(whole.param, param) == 0)
+                && (whole.value == value)
+                && (!with_sensor || (strcmp(whole.sensor, sensor) == 0))
+                && (with_sensor == !!(whole.have & CMD_HAVE_SENSOR));
+        ok = ok && (parse(&split, g.buf, g.len, 1 + (int) rng_below(16)) == CMD_PARSE_DONE)
+                && parsed_equal(&whole, &split);
+        if (!ok) {
+            fprintf(stderr, "generated command failed: %.*s\n", g.len, g.buf);
+            failures++;
+        }
+    }
+    CHECK_EQ(failures, 0);
+}
+
+static int fields_bounded(const cmd_parser_t* p)
+{
+    return (memchr(p->id, '\0', sizeof(p->id)) != NULL)
+            && (memchr(p->param, '\0', sizeof(p->param)) != NULL)
+            && (memchr(p->sensor, '\0', sizeof(p->sensor)) != NULL)
+            && (p->tok_len < sizeof(p->tok));
+}
+
+static void test_fuzz(void)
+{
+    static const char* seeds[] = {
+        "{\"id\":\"a\\u0041b\",\"param\":\"turnon\",\"sensor\":\"led_onboard\",\"value\":1}",
+        "{\"x\":{\"a\":[\"\\\"\",{}]},\"id\":\"i\",\"param\":\"turnon\",\"value\":\"-3\"}",
+    };
+    static const char alphabet[] = "{}[]\":,\\u0aF -.e9tfn \n";
+    int failures = 0;
+
+    for (int n = 0; (n < FUZZ_INPUTS) && (failures < 5); n++) {
+        char msg[FUZZ_LEN_MAX];
+        int len;
+        cmd_parser_t whole, split;
+
+        if (rng_below(4) == 0) {
+            // random bytes, all 256 values
+            len = (int) rng_below(FUZZ_LEN_MAX);
+            for (int i = 0; i < len; i++) {
+                msg[i] = (char) rng_next();
+            }
+        } else {
+            const char* seed = seeds[rng_below(2)];
+            len = (int) strlen(seed);
+            memcpy(msg, seed, len);
+            for (int m = 0, mutations = 1 + (int) rng_below(4); m < mutations; m++) {
+                int at = (int) rng_below(len + 1);
+                char c = (rng_below(2) ? alphabet[rng_below(sizeof(alphabet) - 1)] : (char) rng_next());
+                switch (rng_below(3)) {
+                    case 0: // replace
+                        if (at < len) {
+                            msg[at] = c;
+                        }
+                        break;
+                    case 1: // insert
+                        if (len < FUZZ_LEN_MAX) {
+                            memmove(&msg[at + 1], &msg[at], len - at);
+                            msg[at] = c;
+                            len++;
+                        }
+                        break;
+                    default: // delete
+                        if (at < len) {
+                            memmove(&msg[at], &msg[at + 1], len - at - 1);
+                            len--;
+                        }
+                        break;
+                }
+            }
+        }
+
+        cmd_parse_stat_t stat = parse(&whole, msg, len, 0);
+        int ok = fields_bounded(&whole)
+                && (parse(&split, msg, len, 1 + (int) rng_below(8)) == stat)
+                && fields_bounded(&split);
+        if (ok && (stat == CMD_PARSE_DONE)) {
+            ok = parsed_equal(&whole, &split);
+        }
+        if (!ok) {
+            fprintf(stderr, "fuzz input %d failed (%d bytes)\n", n, len);
+            failures++;
+        }
+    }
+    CHECK_EQ(failures, 0);
+}
+
+int main(void)
+{
+    test_cases();
+    test_generated();
+    test_fuzz();
+    TEST_EXIT();
+}
@@ -0,0 +1,290 @@
+/*
+ * conn_supervisor host simulation
+ *
+ * A simulated clock drives the supervisor against a fake AP and broker:
+ *   flapping AP     -> association backs off, a session never outlives its link
+ *   flapping broker -> broker backoff grows while sessions are short-lived
+ *   refused connect -> broker_connect failing is retried with backoff
+ *   stale session   -> a client connecting after the lease is gone is reset
+ */
+
+#include <string.h>
+
+#include "conn_supervisor.h"
+
+#include "test_util.h"
+
+#define SIM_EVENTS_MAX      64
+#define ASSOC_MS            100     // association -> LINK_UP
+#define DHCP_MS             300     // LINK_UP -> IP_UP
+#define ASSOC_FAIL_MS       1000    // AP away -> LINK_DOWN
+#define BROKER_CONNECT_MS   200
+#define BROKER_FAIL_MS      1000
+
+static const conn_config_t cfg = {
+    .link_base_ms = 500,
+    .link_max_ms = 60000,
+    .broker_base_ms = 1000,
+    .broker_max_ms = 120000,
+    .ip_timeout_ms = 15000,
+    .stable_ms = 60000,
+};
+
+typedef struct {
+    int64_t at_ms;
+    conn_event_t ev;
+} sim_event_t;
+
+static struct {
+    conn_sup_t sup;
+    int64_t now_ms;
+    sim_event_t events[SIM_EVENTS_MAX];
+    int nevents;
+    uint32_t rnd;
+
+    int ap_up;
+    int broker_up;
+    int refuse_connects;    // broker_connect calls still refused
+    int associated;
+    int session;            // the fake client believes it is connected
+    int session_lost_link;  // steps where a session sat on a dead link
+    int resets;
+    int bits_bad;
+} sim;
+
+static void sim_post(int64_t delay_ms, conn_event_t ev)
+{
+    if (sim.nevents < SIM_EVENTS_MAX) {
+        sim.events[sim.nevents].at_ms = sim.now_ms + delay_ms;
+        sim.events[sim.nevents].ev = ev;
+        sim.nevents++;
+    }
+}
+
+static int sim_link_connect(void* ctx)
+{
+    if (sim.ap_up) {
+        sim.associated = 1;
+        sim_post(ASSOC_MS, CONN_EV_LINK_UP);
+        sim_post(ASSOC_MS + DHCP_MS, CONN_EV_IP_UP);
+    } else {
+        sim_post(ASSOC_FAIL_MS, CONN_EV_LINK_DOWN);
+    }
+    return 0;
+}
+
+static void sim_link_reset(void* ctx)
+{
+    sim.associated = 0;
+    sim_post(0, CONN_EV_LINK_DOWN);
+}
+
+static int sim_broker_connect(void* ctx)
+{
+    if (sim.refuse_connects > 0) {
+        sim.refuse_connects--;
+        return -1;
+    }
+    sim_post(sim.broker_up ? BROKER_CONNECT_MS : BROKER_FAIL_MS,
+            sim.broker_up ? CONN_EV_BROKER_UP : CONN_EV_BROKER_DOWN);
+    return 0;
+}
+
+static void sim_broker_reset(void* ctx)
+{
+    sim.resets++;
+    if (sim.session) {
+        sim.session = 0;
+        sim_post(0, CONN_EV_BROKER_DOWN);
+    }
+}
+
+static void sim_publish_bits(void* ctx, uint32_t bits)
+{
+    if ((bits & CONN_BIT_BROKER) && !(bits & CONN_BIT_IP)) {
+        sim.bits_bad++;
+    }
+    if ((bits & CONN_BIT_IP) && !(bits & CONN_BIT_LINK)) {
+        sim.bits_bad++;
+    }
+}
+
+static uint32_t sim_random(void* ctx)
+{
+    sim.rnd = sim.rnd * 1103515245u + 12345u;
+    return sim.rnd >> 8;
+}
+
+static const conn_ops_t ops = {
+    .link_connect = sim_link_connect,
+    .link_reset = sim_link_reset,
+    .broker_connect = sim_broker_connect,
+    .broker_reset = sim_broker_reset,
+    .publish_bits = sim_publish_bits,
+    .random = sim_random,
+};
+
+static void sim_start(void)
+{
+    memset(&sim, 0, sizeof(sim));
+    sim.rnd = 1;
+    sim.ap_up = 1;
+    sim.broker_up = 1;
+    conn_sup_init(&sim.sup, &cfg, &ops);
+    sim_post(0, CONN_EV_LINK_START);
+}
+
+// the AP going away: the station sees LINK_DOWN, the client sees nothing
+static void sim_ap(int up)
+{
+    sim.ap_up = up;
+    if (!up && sim.associated) {
+        sim.associated = 0;
+        sim_post(0, CONN_EV_LINK_DOWN);
+    }
+}
+
+static void sim_broker(int up)
+{
+    sim.broker_up = up;
+    if (!up && sim.session) {
+        sim.session = 0;
+        sim_post(0, CONN_EV_BROKER_DOWN);
+    }
+}
+
+// deliver events and run the supervisor until until_ms
+static void sim_run(int64_t until_ms)
+{
+    int32_t wait = conn_sup_step(&sim.sup, sim.now_ms);
+
+    while (sim.now_ms < until_ms) {
+        int64_t next = (wait < 0) ? until_ms : sim.now_ms + wait;
+        int first = -1;
+
+        for (int i = 0; i < sim.nevents; i++) {
+            if ((first < 0) || (sim.events[i].at_ms < sim.events[first].at_ms)) {
+                first = i;
+            }
+        }
+        if ((first >= 0) && (sim.events[first].at_ms <= next)) {
+            next = sim.events[first].at_ms;
+        } else {
+            first = -1;
+        }
+        if (next > until_ms) {
+            sim.now_ms = until_ms;
+            break;
+        }
+        sim.now_ms = next;
+        if (first >= 0) {
+            conn_event_t ev = sim.events[first].ev;
+            sim.events[first] = sim.events[--sim.nevents];
+            if (ev == CONN_EV_BROKER_UP) {
+                sim.session = 1;
+            }
+            conn_sup_post(&sim.sup, ev, sim.now_ms);
+        }
+        wait = conn_sup_step(&sim.sup, sim.now_ms);
+        if (sim.session && !sim.associated && (sim.nevents == 0)) {
+            sim.session_lost_link++;
+        }
+    }
+}
+
+static void test_steady(void)
+{
+    sim_start();
+    sim_run(10000);
+    CHECK_EQ(sim.sup.bits, CONN_BITS_ALL);
+    CHECK_EQ(sim.sup.link_attempts, 1);
+    CHECK_EQ(sim.sup.broker_attempts, 1);
+    CHECK_EQ(sim.session, 1);
+}
+
+static void test_flapping_ap(void)
+{
+    sim_start();
+    sim_run(10000);
+
+    // AP gone for 1 s every 5 s for 10 minutes
+    for (int i = 0; i < 120; i++) {
+        sim_ap(0);
+        sim_run(sim.now_ms + 1000);
+        sim_ap(1);
+        sim_run(sim.now_ms + 4000);
+    }
+    CHECK_EQ(sim.bits_bad, 0);
+    CHECK_EQ(sim.session_lost_link, 0);
+    // every drop of a connected link tore the session down
+    CHECK(sim.resets > 0);
+    CHECK(sim.sup.link_drops > 0);
+    // backoff stays up while the AP never holds for stable_ms
+    CHECK(sim.sup.link.attempt > 3);
+    CHECK(sim.sup.link_attempts < 120);
+
+    // once the AP holds the node comes back
+    sim_run(sim.now_ms + 2 * cfg.link_max_ms + 1000);
+    CHECK_EQ(sim.sup.bits, CONN_BITS_ALL);
+    CHECK_EQ(sim.session, 1);
+}
+
+static void test_flapping_broker(void)
+{
+    sim_start();
+    sim_run(10000);
+
+    // broker accepts, drops the session 2 s later, for 20 minutes
+    for (int i = 0; i < 200; i++) {
+        sim_run(sim.now_ms + 4000);
+        if (sim.session) {
+            sim_run(sim.now_ms + 2000);
+            sim_broker(0);
+            sim_broker(1);
+        }
+    }
+    CHECK_EQ(sim.bits_bad, 0);
+    CHECK(sim.sup.broker_drops > 3);
+    CHECK(sim.sup.broker.attempt > 3);
+    // the link was never touched
+    CHECK_EQ(sim.sup.link_attempts, 1);
+    CHECK_EQ(sim.resets, 0);
+}
+
+static void test_refused_connect(void)
+{
+    sim_start();
+    sim.refuse_connects = 3;
+    sim_run(60000);
+    // each refusal was rescheduled with backoff rather than dropped
+    CHECK_EQ(sim.sup.broker_attempts, 4);
+    CHECK_EQ(sim.sup.bits, CONN_BITS_ALL);
+    CHECK_EQ(sim.session, 1);
+}
+
+static void test_stale_session(void)
+{
+    sim_start();
+    sim_run(10000);
+    CHECK_EQ(sim.sup.bits, CONN_BITS_ALL);
+
+    // lease lost, then a late CONNACK for a connect started before
+    conn_sup_post(&sim.sup, CONN_EV_IP_DOWN, sim.now_ms);
+    CHECK_EQ(sim.resets, 1);
+    CHECK_EQ(sim.session, 0);
+    sim.session = 1;
+    conn_sup_post(&sim.sup, CONN_EV_BROKER_UP, sim.now_ms);
+    CHECK_EQ(sim.resets, 2);
+    CHECK_EQ(sim.session, 0);
+    CHECK_EQ(sim.sup.bits & CONN_BIT_BROKER, 0);
+}
+
+int main(void)
+{
+    test_steady();
+    test_flapping_ap();
+    test_flapping_broker();
+    test_refused_connect();
+    test_stale_session();
+    TEST_EXIT();
+}
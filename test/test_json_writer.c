@@ -0,0 +1,154 @@
+/*
+ * json_writer host test
+ *
+ * json_float -> same text as printf("%.*f") for every decimals 0..9 on
+ *               edge values and a few million random float bit patterns
+ * strings    -> escaping of quotes, backslash and control characters
+ * integers   -> 64 bit extremes
+ * overflow   -> latched, json_finish returns -1
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "json_writer.h"
+
+#include "test_util.h"
+
+#define RANDOM_FLOATS   2000000
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng_next(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int float_matches(float v, int decimals)
+{
+    char buf[64], ref[64];
+    json_writer_t w;
+
+    json_init(&w, buf, sizeof(buf));
+    json_float(&w, v, decimals);
+    json_finish(&w);
+    snprintf(ref, sizeof(ref), "%.*f", decimals, v);
+    if (strcmp(buf, ref) != 0) {
+        fprintf(stderr, "json_float(%a, %d) = \"%s\", printf \"%s\"\n", v, decimals, buf, ref);
+        return 0;
+    }
+    return 1;
+}
+
+static void test_float_edges(void)
+{
+    static const float values[] = {
+        0.0f, -0.0f, 0.5f, 1.5f, 2.5f, -2.5f, 0.125f, 0.375f, 0.05f, 0.15f, 0.25f,
+        0.999999f, 9.9999995f, 99.5f, 1e-45f, 1.17549435e-38f, 1e-10f, 4.9999995f,
+        3.3f, 4.2f, 5.0f, 123456.789f, 16777216.0f, 16777217.0f, 4294967296.0f,
+        1e17f, 999999999999999999.0f, 1e18f, -1e18f, 0.00000050000001f, 0.0000005f,
+    };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        for (int d = 0; d <= 9; d++) {
+            CHECK(float_matches(values[i], d));
+        }
+    }
+    // ties at every decimal position
+    for (int d = 0; d <= 9; d++) {
+        for (int n = 0; n < 64; n++) {
+            CHECK(float_matches(((float) n + 0.5f) / 64.0f, d));
+        }
+    }
+}
+
+static void test_float_random(void)
+{
+    int failures = 0;
+
+    for (int i = 0; (i < RANDOM_FLOATS) && (failures < 10); i++) {
+        uint32_t bits = rng_next();
+        float v;
+        memcpy(&v, &bits, sizeof(v));
+        if (isnan(v) || (fabsf(v) > 1e18f)) {
+            continue;
+        }
+        failures += !float_matches(v, i % 10);
+    }
+    // values of the battery range at the precision main.c uses
+    for (int i = 0; (i < RANDOM_FLOATS / 4) && (failures < 10); i++) {
+        float v = ((float) rng_next() / (float) UINT32_MAX) * 5.0f;
+        failures += !float_matches(v, 6);
+    }
+    CHECK_EQ(failures, 0);
+}
+
+static void test_float_special(void)
+{
+    char buf[64];
+    json_writer_t w;
+
+    json_init(&w, buf, sizeof(buf));
+    json_float(&w, NAN, 2);
+    json_lit(&w, ",");
+    json_float(&w, INFINITY, 2);
+    json_lit(&w, ",");
+    json_float(&w, -INFINITY, 2);
+    json_lit(&w, ",");
+    json_float(&w, 2e18f, 2);
+    json_lit(&w, ",");
+    json_float(&w, 1.25f, 12);     // clamped to 9 decimals
+    json_lit(&w, ",");
+    json_float(&w, 1.75f, -1);     // clamped to 0 decimals
+    CHECK(json_finish(&w) > 0);
+    CHECK(strcmp(buf, "null,null,null,null,1.250000000,2") == 0);
+}
+
+static void test_str_and_ints(void)
+{
+    char buf[128];
+    json_writer_t w;
+
+    json_init(&w, buf, sizeof(buf));
+    json_str(&w, "a\"b\\c\n\x01");
+    json_lit(&w, ",");
+    json_u64(&w, UINT64_MAX);
+    json_lit(&w, ",");
+    json_i64(&w, INT64_MIN);
+    json_lit(&w, ",");
+    json_i64(&w, 0);
+    CHECK(json_finish(&w) > 0);
+    CHECK(strcmp(buf, "\"a\\\"b\\\\c\\u000a\\u0001\",18446744073709551615,-9223372036854775808,0") == 0);
+}
+
+static void test_overflow(void)
+{
+    char buf[8];
+    json_writer_t w;
+
+    json_init(&w, buf, sizeof(buf));
+    json_lit(&w, "1234567");
+    CHECK_EQ(json_finish(&w), 7);
+
+    json_init(&w, buf, sizeof(buf));
+    json_lit(&w, "12345678");
+    json_lit(&w, "9");
+    CHECK_EQ(json_finish(&w), -1);
+    CHECK_EQ(buf[0], '\0');
+
+    json_init(&w, buf, 0);
+    CHECK_EQ(json_finish(&w), -1);
+}
+
+int main(void)
+{
+    test_float_edges();
+    test_float_special();
+    test_float_random();
+    test_str_and_ints();
+    test_overflow();
+    TEST_EXIT();
+}
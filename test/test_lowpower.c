@@ -0,0 +1,163 @@
+/*
+ * lowpower host test
+ *
+ * lp_step with fake sleep ops:
+ *   edges counted while asleep are added on every wake, not one per wake
+ *   the ULP is armed with the edges left to pulse_threshold
+ *   a threshold wake reports, after a failed report pulses do not wake
+ *   ulp_pulse_delta across the 16 bit wrap of the ULP counter
+ */
+
+#include <string.h>
+
+#include "lowpower.h"
+#include "ulp_pulse.h"
+
+#include "test_util.h"
+
+#define PERIOD_MS       60000
+#define BURST           15
+#define THRESHOLD       1000
+
+static const lp_config_t cfg = {
+    .sample_period_ms = PERIOD_MS,
+    .burst_samples = BURST,
+    .pulse_threshold = THRESHOLD,
+};
+
+static struct {
+    int64_t now_us;
+    lp_wake_t wake;
+    uint32_t edges;         // counted by the "ULP" since the last take
+    int report_ok;
+    int reports;
+    int reported;
+    int64_t sleep_us;
+    uint32_t wake_edges;
+} fake;
+
+static int64_t fake_now_us(void)
+{
+    return fake.now_us;
+}
+
+static lp_wake_t fake_wake_cause(void)
+{
+    return fake.wake;
+}
+
+static uint32_t fake_pulse_edges(void)
+{
+    uint32_t e = fake.edges;
+    fake.edges = 0;
+    return e;
+}
+
+static void fake_take_sample(sample_t* s, const lp_rtc_state_t* rtc)
+{
+    s->timestamp = (uint32_t) (fake.now_us / 1000000);
+    s->battery = 3.7f;
+    s->pulse1 = rtc->pulse1;
+    s->pulse2 = SAMPLE_NOT_MEASURED;
+}
+
+static int fake_report(const sample_t* samples, int count)
+{
+    fake.reports++;
+    fake.reported = count;
+    CHECK(samples[count - 1].pulse2 == SAMPLE_NOT_MEASURED);
+    return fake.report_ok ? count : 0;
+}
+
+static void fake_deep_sleep(int64_t sleep_us, uint32_t wake_edges)
+{
+    fake.sleep_us = sleep_us;
+    fake.wake_edges = wake_edges;
+}
+
+static const lp_ops_t ops = {
+    .now_us = fake_now_us,
+    .wake_cause = fake_wake_cause,
+    .pulse_edges = fake_pulse_edges,
+    .take_sample = fake_take_sample,
+    .report = fake_report,
+    .deep_sleep = fake_deep_sleep,
+};
+
+static lp_action_t wake(lp_rtc_state_t* rtc, lp_wake_t cause, int64_t at_us, uint32_t edges)
+{
+    fake.wake = cause;
+    fake.now_us = at_us;
+    fake.edges = edges;
+    return lp_step(rtc, &cfg, &ops);
+}
+
+static void test_edges_and_threshold(void)
+{
+    static lp_rtc_state_t rtc;
+    int64_t period = (int64_t) PERIOD_MS * 1000;
+
+    memset(&fake, 0, sizeof(fake));
+    fake.report_ok = 1;
+
+    CHECK_EQ(wake(&rtc, LP_WAKE_POWERON, 0, 0), LP_ACT_SAMPLE);
+    CHECK_EQ(fake.wake_edges, THRESHOLD);
+    CHECK_EQ(fake.sleep_us, period);
+
+    // 400 edges while asleep, one timer wake for all of them
+    CHECK_EQ(wake(&rtc, LP_WAKE_TIMER, period, 400), LP_ACT_SAMPLE);
+    CHECK_EQ(rtc.pulse1, 400);
+    CHECK_EQ(rtc.boot_count, 2);
+    CHECK_EQ(fake.wake_edges, THRESHOLD - 400);
+
+    // the ULP wakes the chip once the rest arrived
+    CHECK_EQ(wake(&rtc, LP_WAKE_PULSE, period + 1000, THRESHOLD - 400), LP_ACT_REPORT);
+    CHECK_EQ(fake.reports, 1);
+    CHECK_EQ(fake.reported, 3);
+    CHECK_EQ(rtc.pulse1, THRESHOLD);
+    CHECK_EQ(rtc.pulses_since_report, 0);
+    CHECK_EQ(rtc.count, 0);
+    CHECK_EQ(fake.wake_edges, THRESHOLD);
+    CHECK_EQ(fake.sleep_us, period - 1000);
+}
+
+static void test_failed_report(void)
+{
+    static lp_rtc_state_t rtc;
+    int64_t period = (int64_t) PERIOD_MS * 1000;
+
+    memset(&fake, 0, sizeof(fake));
+    fake.report_ok = 0;
+
+    wake(&rtc, LP_WAKE_POWERON, 0, 0);
+    CHECK_EQ(wake(&rtc, LP_WAKE_PULSE, 1000, THRESHOLD), LP_ACT_REPORT);
+    CHECK_EQ(rtc.report_fails, 1);
+    // counting goes on, but only the timer wakes the chip for the retry
+    CHECK_EQ(fake.wake_edges, 0);
+
+    CHECK_EQ(wake(&rtc, LP_WAKE_TIMER, period, 5000), LP_ACT_REPORT);
+    CHECK_EQ(fake.reports, 2);
+    CHECK_EQ(rtc.pulse1, THRESHOLD + 5000);
+
+    fake.report_ok = 1;
+    CHECK_EQ(wake(&rtc, LP_WAKE_TIMER, 2 * period, 0), LP_ACT_REPORT);
+    CHECK_EQ(rtc.report_fails, 0);
+    CHECK_EQ(rtc.count, 0);
+    CHECK_EQ(fake.wake_edges, THRESHOLD);
+}
+
+static void test_ulp_delta(void)
+{
+    CHECK_EQ(ulp_pulse_delta(10, 0), 10);
+    CHECK_EQ(ulp_pulse_delta(5, 0xfffb), 10);
+    CHECK_EQ(ulp_pulse_delta(0x1234, 0x1234), 0);
+    CHECK_EQ(ulp_pulse_delta(0xffff, 0), ULP_PULSE_WAKE_MAX);
+}
+
+int main(void)
+{
+    test_edges_and_threshold();
+    test_failed_report();
+    test_ulp_delta();
+    TEST_EXIT();
+}
@@ -0,0 +1,168 @@
+/*
+ * metrics host test
+ *
+ * register  -> ids in order, METRIC_NONE when the registry or the histogram
+ *              space is full, updates to unknown ids are ignored
+ * buckets   -> metric_observe edges: 0, 1, 2^k - 1 / 2^k, the last bucket
+ *              takes everything from 2^(BUCKETS-2) up to UINT32_MAX
+ * contended -> metric_max and metric_inc from several threads at once lose
+ *              nothing (also built under TSan)
+ * pack      -> exact JSON: counters and gauges as numbers, histograms
+ *              trimmed after their last non empty bucket, the overflow
+ *              bucket kept
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "metrics.h"
+
+#include "test_util.h"
+
+#define THREADS         4
+#define PER_THREAD      200000
+
+static metrics_t m;
+static int id_max, id_count;
+
+static void test_register(void)
+{
+    metrics_init(&m);
+    CHECK_EQ(metric_register(&m, "c", METRIC_COUNTER), 0);
+    CHECK_EQ(metric_register(&m, "g", METRIC_GAUGE), 1);
+    for (int i = 0; i < METRICS_MAX / 4; i++) {
+        CHECK_EQ(metric_register(&m, "h", METRIC_HIST), 2 + i);
+    }
+    CHECK_EQ(metric_register(&m, "h", METRIC_HIST), METRIC_NONE);
+    while (m.count < METRICS_MAX) {
+        CHECK(metric_register(&m, "x", METRIC_GAUGE) != METRIC_NONE);
+    }
+    CHECK_EQ(metric_register(&m, "x", METRIC_COUNTER), METRIC_NONE);
+
+    // ignored: unknown ids, and observe on something else than a histogram
+    metric_inc(&m, METRIC_NONE, 1);
+    metric_inc(&m, METRICS_MAX, 1);
+    metric_set(&m, -5, 1);
+    metric_max(&m, METRICS_MAX, 1);
+    metric_observe(&m, METRIC_NONE, 1);
+    metric_observe(&m, 0, 1);
+    CHECK_EQ(metric_get(&m, 0), 0);
+    CHECK_EQ(metric_get(&m, METRIC_NONE), 0);
+
+    metric_set(&m, 1, 7);
+    metric_max(&m, 1, 5);
+    CHECK_EQ(metric_get(&m, 1), 7);
+    metric_max(&m, 1, 9);
+    CHECK_EQ(metric_get(&m, 1), 9);
+}
+
+static int bucket_of(uint32_t v)
+{
+    int id;
+
+    metrics_init(&m);
+    id = metric_register(&m, "h", METRIC_HIST);
+    metric_observe(&m, id, v);
+    for (int i = 0; i < METRIC_HIST_BUCKETS; i++) {
+        if (m.hists[0][i] != 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void test_buckets(void)
+{
+    CHECK_EQ(bucket_of(0), 0);
+    CHECK_EQ(bucket_of(1), 1);
+    for (int k = 1; k < METRIC_HIST_BUCKETS - 1; k++) {
+        CHECK_EQ(bucket_of((1u << k) - 1), k);
+        CHECK_EQ(bucket_of(1u << k), k + 1);
+    }
+    // overflow bucket
+    CHECK_EQ(bucket_of(1u << (METRIC_HIST_BUCKETS - 2)), METRIC_HIST_BUCKETS - 1);
+    CHECK_EQ(bucket_of(1u << (METRIC_HIST_BUCKETS - 1)), METRIC_HIST_BUCKETS - 1);
+    CHECK_EQ(bucket_of(1u << 31), METRIC_HIST_BUCKETS - 1);
+    CHECK_EQ(bucket_of(UINT32_MAX), METRIC_HIST_BUCKETS - 1);
+}
+
+static void* writer(void* arg)
+{
+    uint32_t t = (uint32_t) (uintptr_t) arg;
+
+    for (uint32_t i = 0; i < PER_THREAD; i++) {
+        // interleaved values, the largest from the last thread
+        metric_max(&m, id_max, i * THREADS + t);
+        metric_inc(&m, id_count, 1);
+    }
+    return NULL;
+}
+
+static void test_contended(void)
+{
+    pthread_t threads[THREADS];
+
+    metrics_init(&m);
+    id_max = metric_register(&m, "max", METRIC_GAUGE);
+    id_count = metric_register(&m, "count", METRIC_COUNTER);
+    for (uintptr_t i = 0; i < THREADS; i++) {
+        pthread_create(&threads[i], NULL, writer, (void*) i);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    CHECK_EQ(metric_get(&m, id_max), (PER_THREAD - 1) * THREADS + THREADS - 1);
+    CHECK_EQ(metric_get(&m, id_count), PER_THREAD * THREADS);
+}
+
+static void expect_pack(const char* want)
+{
+    char buf[512];
+    json_writer_t w;
+
+    json_init(&w, buf, sizeof(buf));
+    metrics_pack(&m, &w);
+    CHECK(json_finish(&w) > 0);
+    if (strcmp(buf, want) != 0) {
+        fprintf(stderr, "metrics_pack: %s\n          want: %s\n", buf, want);
+        CHECK(0);
+    }
+}
+
+static void test_pack(void)
+{
+    metrics_init(&m);
+    expect_pack("{}");
+
+    int c = metric_register(&m, "wifi_drops", METRIC_COUNTER);
+    int h = metric_register(&m, "pack_us", METRIC_HIST);
+    int g = metric_register(&m, "heap_free", METRIC_GAUGE);
+    int o = metric_register(&m, "payload_bytes", METRIC_HIST);
+    // empty histogram: bucket 0 only
+    expect_pack("{\"wifi_drops\":0,\"pack_us\":[0],\"heap_free\":0,\"payload_bytes\":[0]}");
+
+    metric_inc(&m, c, 3);
+    metric_set(&m, g, UINT32_MAX);
+    metric_observe(&m, h, 0);
+    metric_observe(&m, h, 5);
+    metric_observe(&m, h, 6);
+    metric_observe(&m, o, UINT32_MAX);
+    expect_pack("{\"wifi_drops\":3,\"pack_us\":[1,0,0,2],\"heap_free\":4294967295,"
+            "\"payload_bytes\":[0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1]}");
+
+    // too small a buffer is an overflow, not a truncated object
+    char small[16];
+    json_writer_t w;
+    json_init(&w, small, sizeof(small));
+    metrics_pack(&m, &w);
+    CHECK_EQ(json_finish(&w), -1);
+}
+
+int main(void)
+{
+    test_register();
+    test_buckets();
+    test_contended();
+    test_pack();
+    TEST_EXIT();
+}
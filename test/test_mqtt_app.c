@@ -0,0 +1,255 @@
+/*
+ * mqtt_app host test
+ *
+ * The module runs unchanged on the host FreeRTOS shim: its owner task and
+ * lock-free queue are real, the client is the host esp-mqtt fake behind
+ * mqtt_port.h, adapted here the way mqtt_init() adapts esp-mqtt.
+ *   offline   -> async publishes are refused before CONNECTED and after a drop
+ *   connect   -> CONNECTED publishes the online topic
+ *   puback    -> a publish goes out through the owner task and completes on
+ *                the PUBACK of its msg_id, polled or through the callback
+ *   in flight -> MQTT_INFLIGHT_MAX unacked publishes, the next is refused
+ *   timeout   -> no PUBACK before the deadline
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+
+#include "mqtt_app.h"
+
+#include "test_util.h"
+
+#define USERNAME        "mqtt_account_device"
+#define WAIT_TICKS      2000
+
+static esp_mqtt_client_handle_t client = NULL;
+
+static int host_publish(void* ctx, const char* topic, const char* data, int len, int qos)
+{
+    return esp_mqtt_client_publish(client, topic, data, len, qos, 0);
+}
+
+static int host_subscribe(void* ctx, const char* topic, int qos)
+{
+    return esp_mqtt_client_subscribe(client, topic, qos);
+}
+
+static esp_err_t host_reconnect(void* ctx)
+{
+    return esp_mqtt_client_reconnect(client);
+}
+
+static esp_err_t host_disconnect(void* ctx)
+{
+    return esp_mqtt_client_disconnect(client);
+}
+
+static mqtt_port_event_id_t host_port_id(esp_mqtt_event_id_t id)
+{
+    switch (id) {
+        case MQTT_EVENT_CONNECTED:
+            return MQTT_PORT_CONNECTED;
+        case MQTT_EVENT_DISCONNECTED:
+            return MQTT_PORT_DISCONNECTED;
+        case MQTT_EVENT_SUBSCRIBED:
+            return MQTT_PORT_SUBSCRIBED;
+        case MQTT_EVENT_PUBLISHED:
+            return MQTT_PORT_PUBLISHED;
+        case MQTT_EVENT_DATA:
+            return MQTT_PORT_DATA;
+        default:
+            return MQTT_PORT_OTHER;
+    }
+}
+
+static void host_event(void* arg, esp_event_base_t base, int32_t event_id, void* event_data)
+{
+    esp_mqtt_event_handle_t e = event_data;
+    mqtt_port_event_t event = {
+        .id = host_port_id(e->event_id),
+        .raw_id = e->event_id,
+        .msg_id = e->msg_id,
+        .topic = e->topic,
+        .topic_len = e->topic_len,
+        .data = e->data,
+        .data_len = e->data_len,
+        .total_data_len = e->total_data_len,
+        .current_data_offset = e->current_data_offset,
+    };
+    mqtt_app_event(&event);
+}
+
+static struct {
+    int calls;
+    mqtt_pub_handle_t handle;
+    mqtt_pub_status_t status;
+} completion;
+
+static void on_done(mqtt_pub_handle_t h, mqtt_pub_status_t status, void* ctx)
+{
+    __atomic_store_n(&completion.handle, h, __ATOMIC_RELAXED);
+    __atomic_store_n(&completion.status, status, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&completion.calls, 1, __ATOMIC_RELEASE);
+}
+
+// msg_id of the count-th logged message, once the owner task has sent it
+static int wait_logged(int count, host_mqtt_msg_t* msg)
+{
+    for (int t = 0; t < WAIT_TICKS; t++) {
+        if (host_mqtt_log(count - 1, msg) == 0) {
+            return msg->msg_id;
+        }
+        vTaskDelay(1);
+    }
+    return -1;
+}
+
+static mqtt_pub_status_t wait_status(mqtt_pub_handle_t h, mqtt_pub_status_t want)
+{
+    mqtt_pub_status_t status = mqtt_pub_status(h);
+
+    for (int t = 0; (t < WAIT_TICKS) && (status != want); t++) {
+        vTaskDelay(1);
+        status = mqtt_pub_status(h);
+    }
+    return status;
+}
+
+static void test_offline(void)
+{
+    CHECK_EQ(mqtt_publish_iotera_async("{}", 0, 1000, NULL, NULL), 0);
+    CHECK_EQ(mqtt_get_state(), MQTT_STATE_ERROR);
+}
+
+static void test_connect(void)
+{
+    host_mqtt_msg_t msg;
+
+    host_mqtt_connect();
+    CHECK_EQ(mqtt_get_state(), MQTT_STATE_CONNECTED);
+    CHECK_EQ(host_mqtt_log_count(), 1);
+    CHECK_EQ(host_mqtt_log(0, &msg), 0);
+    CHECK(strstr(msg.topic, "online") != NULL);
+    CHECK_EQ(msg.qos, 1);
+}
+
+static void test_puback(void)
+{
+    mqtt_pub_stats_t st;
+    host_mqtt_msg_t msg;
+    int logged = host_mqtt_log_count();
+
+    // polled
+    mqtt_pub_handle_t h = mqtt_publish_iotera_async("{\"v\":1}", 0, 5000, NULL, NULL);
+    CHECK(h != 0);
+    int id = wait_logged(logged + 1, &msg);
+    CHECK(id > 0);
+    CHECK(strstr(msg.topic, "data") != NULL);
+    CHECK_EQ(msg.len, 7);
+    CHECK_EQ(memcmp(msg.data, "{\"v\":1}", 7), 0);
+    CHECK_EQ(mqtt_pub_status(h), MQTT_PUB_PENDING);
+    host_mqtt_ack(id + 100);    // someone else's PUBACK
+    CHECK_EQ(mqtt_pub_status(h), MQTT_PUB_PENDING);
+    host_mqtt_ack(id);
+    CHECK_EQ(mqtt_pub_status(h), MQTT_PUB_DONE);
+    mqtt_pub_release(h);
+    CHECK_EQ(mqtt_pub_status(h), MQTT_PUB_UNKNOWN);
+
+    // callback, called from the MQTT task (here the thread delivering the ack)
+    h = mqtt_publish_iotera_async("{\"v\":2}", 0, 5000, on_done, NULL);
+    CHECK(h != 0);
+    id = wait_logged(logged + 2, &msg);
+    CHECK(id > 0);
+    CHECK_EQ(__atomic_load_n(&completion.calls, __ATOMIC_ACQUIRE), 0);
+    host_mqtt_ack(id);
+    CHECK_EQ(__atomic_load_n(&completion.calls, __ATOMIC_ACQUIRE), 1);
+    CHECK_EQ(completion.handle, h);
+    CHECK_EQ(completion.status, MQTT_PUB_DONE);
+    // the callback released it
+    CHECK_EQ(mqtt_pub_status(h), MQTT_PUB_UNKNOWN);
+
+    mqtt_pub_get_stats(&st);
+    CHECK_EQ(st.accepted, 2);
+    CHECK_EQ(st.acked, 2);
+    CHECK_EQ(st.failed, 0);
+}
+
+static void test_inflight_bound(void)
+{
+    mqtt_pub_handle_t h[MQTT_INFLIGHT_MAX];
+    host_mqtt_msg_t msg;
+    int logged = host_mqtt_log_count();
+    int ids[MQTT_INFLIGHT_MAX];
+
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        h[i] = mqtt_publish_iotera_async("{}", 0, 5000, NULL, NULL);
+        CHECK(h[i] != 0);
+    }
+    CHECK_EQ(mqtt_publish_iotera_async("{}", 0, 5000, NULL, NULL), 0);
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        ids[i] = wait_logged(logged + 1 + i, &msg);
+        CHECK(ids[i] > 0);
+    }
+    // acks out of order
+    for (int i = MQTT_INFLIGHT_MAX - 1; i >= 0; i--) {
+        host_mqtt_ack(ids[i]);
+    }
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        CHECK_EQ(mqtt_pub_status(h[i]), MQTT_PUB_DONE);
+        mqtt_pub_release(h[i]);
+    }
+}
+
+static void test_timeout(void)
+{
+    host_mqtt_msg_t msg;
+    mqtt_pub_stats_t st;
+    int logged = host_mqtt_log_count();
+
+    mqtt_pub_handle_t h = mqtt_publish_iotera_async("{}", 0, 20, NULL, NULL);
+    CHECK(h != 0);
+    CHECK(wait_logged(logged + 1, &msg) > 0);
+    CHECK_EQ(wait_status(h, MQTT_PUB_TIMEOUT), MQTT_PUB_TIMEOUT);
+    // a late PUBACK does not resurrect it
+    host_mqtt_ack(msg.msg_id);
+    CHECK_EQ(mqtt_pub_status(h), MQTT_PUB_TIMEOUT);
+    mqtt_pub_release(h);
+
+    mqtt_pub_get_stats(&st);
+    CHECK_EQ(st.timeouts, 1);
+}
+
+static void test_drop(void)
+{
+    host_mqtt_drop();
+    CHECK_EQ(mqtt_get_state(), MQTT_STATE_DISCONNECTED);
+    CHECK_EQ(mqtt_publish_iotera_async("{}", 0, 1000, NULL, NULL), 0);
+}
+
+int main(void)
+{
+    const mqtt_transport_t t = {
+        .publish = host_publish,
+        .subscribe = host_subscribe,
+        .reconnect = host_reconnect,
+        .disconnect = host_disconnect,
+    };
+    const esp_mqtt_client_config_t cfg = { .uri = "mqtt://localhost", .username = USERNAME };
+
+    host_mqtt_reset();
+    CHECK_EQ(mqtt_init_transport(&t, USERNAME), ESP_OK);
+    client = esp_mqtt_client_init(&cfg);
+    esp_mqtt_client_register_event(client, MQTT_EVENT_ANY, host_event, NULL);
+    esp_mqtt_client_start(client);
+
+    test_offline();
+    test_connect();
+    test_puback();
+    test_inflight_bound();
+    test_timeout();
+    test_drop();
+    TEST_EXIT();
+}
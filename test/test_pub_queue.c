@@ -0,0 +1,157 @@
+/*
+ * pub_queue host stress test
+ *
+ * PUBQ_SLOTS is small, so producers lap the ring constantly:
+ *   stress   -> STRESS_PRODUCERS threads against one consumer, every message
+ *               arrives once, intact and in order per producer
+ *   stalled  -> a producer holding a reserved slot stops the consumer at that
+ *               slot but never blocks the other producers, they see a full
+ *               queue and carry on once it commits
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <sched.h>
+
+#include "pub_queue.h"
+
+#include "test_util.h"
+
+#define STRESS_PRODUCERS    4
+#define STRESS_MESSAGES     200000  // per producer
+
+typedef struct {
+    uint32_t producer;
+    uint32_t seq;
+} msg_hdr_t;
+
+static pubq_t queue;
+static const char topic[] = "iotera/pub/account/device/data";
+
+static void fill(pubq_slot_t* slot, uint32_t producer, uint32_t seq)
+{
+    msg_hdr_t hdr = { .producer = producer, .seq = seq };
+    uint16_t len = (uint16_t) (sizeof(hdr) + (seq % 64));
+
+    memcpy(slot->data, &hdr, sizeof(hdr));
+    for (uint16_t i = sizeof(hdr); i < len; i++) {
+        slot->data[i] = (char) (producer * 31 + seq + i);
+    }
+    slot->topic = topic;
+    slot->len = len;
+    slot->tag = producer + 1;
+}
+
+static int intact(const pubq_slot_t* slot, msg_hdr_t* hdr)
+{
+    memcpy(hdr, slot->data, sizeof(*hdr));
+    if ((slot->topic != topic) || (slot->tag != hdr->producer + 1)
+            || (slot->len != sizeof(*hdr) + (hdr->seq % 64))) {
+        return 0;
+    }
+    for (uint16_t i = sizeof(*hdr); i < slot->len; i++) {
+        if (slot->data[i] != (char) (hdr->producer * 31 + hdr->seq + i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void* producer(void* arg)
+{
+    uint32_t id = (uint32_t) (uintptr_t) arg;
+
+    for (uint32_t seq = 0; seq < STRESS_MESSAGES; seq++) {
+        pubq_slot_t* slot;
+        while ((slot = pubq_reserve(&queue)) == NULL) {
+            sched_yield();
+        }
+        fill(slot, id, seq);
+        pubq_commit(&queue, slot);
+    }
+    return NULL;
+}
+
+static void test_stress(void)
+{
+    pthread_t threads[STRESS_PRODUCERS];
+    uint32_t next[STRESS_PRODUCERS] = {0};
+    uint64_t received = 0;
+    uint64_t total = (uint64_t) STRESS_PRODUCERS * STRESS_MESSAGES;
+    int bad = 0;
+
+    pubq_init(&queue);
+    for (uintptr_t i = 0; i < STRESS_PRODUCERS; i++) {
+        pthread_create(&threads[i], NULL, producer, (void*) i);
+    }
+    while (received < total) {
+        pubq_slot_t* slot = pubq_peek(&queue);
+        msg_hdr_t hdr;
+        if (slot == NULL) {
+            sched_yield();
+            continue;
+        }
+        if (!intact(slot, &hdr) || (hdr.producer >= STRESS_PRODUCERS) || (hdr.seq != next[hdr.producer])) {
+            bad++;
+        } else {
+            next[hdr.producer]++;
+        }
+        pubq_release(&queue, slot);
+        received++;
+    }
+    for (int i = 0; i < STRESS_PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+        CHECK_EQ(next[i], STRESS_MESSAGES);
+    }
+    CHECK_EQ(bad, 0);
+    CHECK(pubq_peek(&queue) == NULL);
+    CHECK_EQ(queue.head, total);
+    CHECK_EQ(queue.tail, total);
+    printf("%llu messages, %u reserve attempts on a full queue\n",
+            (unsigned long long) total, queue.full);
+}
+
+static void test_stalled_producer(void)
+{
+    pubq_slot_t* held;
+    pubq_slot_t* slot;
+    msg_hdr_t hdr;
+    int n = 0;
+
+    pubq_init(&queue);
+    held = pubq_reserve(&queue);
+    CHECK(held != NULL);
+
+    // the others fill the rest of the ring without waiting for it
+    while ((slot = pubq_reserve(&queue)) != NULL) {
+        fill(slot, 1, n++);
+        pubq_commit(&queue, slot);
+    }
+    CHECK_EQ(n, PUBQ_SLOTS - 1);
+    CHECK_EQ(queue.full, 1);
+    // nothing is readable past the uncommitted slot
+    CHECK(pubq_peek(&queue) == NULL);
+
+    fill(held, 0, 0);
+    pubq_commit(&queue, held);
+    for (int i = 0; i < PUBQ_SLOTS; i++) {
+        slot = pubq_peek(&queue);
+        CHECK(slot != NULL);
+        if (slot == NULL) {
+            break;
+        }
+        CHECK(intact(slot, &hdr));
+        CHECK_EQ(hdr.producer, (i == 0) ? 0 : 1);
+        CHECK_EQ(hdr.seq, (i == 0) ? 0 : i - 1);
+        pubq_release(&queue, slot);
+    }
+    CHECK(pubq_peek(&queue) == NULL);
+    CHECK(pubq_reserve(&queue) != NULL);
+}
+
+int main(void)
+{
+    test_stalled_producer();
+    test_stress();
+    TEST_EXIT();
+}
@@ -0,0 +1,136 @@
+/*
+ * pulse_capture host test
+ *
+ * ring wrap  -> timestamps come out in order across the ring and index wrap
+ * overflow   -> a full ring drops timestamps, never edges
+ * consumer   -> woken exactly once when the ring reaches half full
+ */
+
+#include <string.h>
+
+#include "pulse_capture.h"
+#include "driver/gpio.h"
+
+#include "test_util.h"
+
+#define GPIO_A  4
+#define GPIO_B  5
+
+static void test_init(void)
+{
+    const uint32_t gpios[2] = { GPIO_A, GPIO_B };
+
+    CHECK_EQ(pulse_capture_init(gpios, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(pulse_capture_init(gpios, PULSE_CAPTURE_CHANNELS + 1), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(pulse_capture_init(gpios, 2), ESP_OK);
+    CHECK(pulse_capture_channel(-1) == NULL);
+    CHECK(pulse_capture_channel(2) == NULL);
+    CHECK_EQ(pulse_capture_count(0), 0);
+    CHECK_EQ(pulse_capture_dropped(1), 0);
+}
+
+// push and drain in odd sized chunks so every slot and the index wrap are hit
+static void test_ring_wrap(void)
+{
+    pulse_channel_t* ch = pulse_capture_channel(0);
+    uint32_t out[PULSE_CAPTURE_RING_SIZE];
+    uint32_t next_in = 0, next_out = 0;
+    uint32_t count0 = ch->count;
+
+    // start just below the 32 bit wrap of head/tail
+    ch->head = ch->tail = UINT32_MAX - 100;
+
+    for (int round = 0; round < 50; round++) {
+        for (int i = 0; i < 37; i++) {
+            pulse_capture_edge(ch, next_in++);
+        }
+        size_t n = pulse_capture_drain(0, out, 29);
+        CHECK_EQ(n, 29);
+        for (size_t i = 0; i < n; i++) {
+            CHECK_EQ(out[i], next_out++);
+        }
+        // keep the backlog below the ring size
+        n = pulse_capture_drain(0, out, (size_t) (ch->head - ch->tail) > 16 ? 8 : 0);
+        for (size_t i = 0; i < n; i++) {
+            CHECK_EQ(out[i], next_out++);
+        }
+    }
+    size_t n;
+    while ((n = pulse_capture_drain(0, out, PULSE_CAPTURE_RING_SIZE)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            CHECK_EQ(out[i], next_out++);
+        }
+    }
+    CHECK_EQ(next_out, next_in);
+    CHECK(ch->head < UINT32_MAX - 100);  // the index really wrapped
+    CHECK_EQ(pulse_capture_count(0) - count0, next_in);
+    CHECK_EQ(pulse_capture_dropped(0), 0);
+}
+
+static void test_overflow(void)
+{
+    pulse_channel_t* ch = pulse_capture_channel(1);
+    uint32_t out[PULSE_CAPTURE_RING_SIZE];
+    const int edges = PULSE_CAPTURE_RING_SIZE + 36;
+    int wakes = 0;
+
+    for (int i = 0; i < edges; i++) {
+        wakes += pulse_capture_edge(ch, 1000 + i);
+    }
+    CHECK_EQ(wakes, 1);
+    CHECK_EQ(pulse_capture_count(1), edges);
+    CHECK_EQ(pulse_capture_dropped(1), edges - PULSE_CAPTURE_RING_SIZE);
+
+    // the oldest timestamps are kept, the newest were dropped
+    CHECK_EQ(pulse_capture_drain(1, out, PULSE_CAPTURE_RING_SIZE), PULSE_CAPTURE_RING_SIZE);
+    CHECK_EQ(out[0], 1000);
+    CHECK_EQ(out[PULSE_CAPTURE_RING_SIZE - 1], 1000 + PULSE_CAPTURE_RING_SIZE - 1);
+    CHECK_EQ(pulse_capture_drain(1, out, PULSE_CAPTURE_RING_SIZE), 0);
+
+    // room again: the next edge is stored, the drop count stays
+    pulse_capture_edge(ch, 7);
+    CHECK_EQ(pulse_capture_drain(1, out, 1), 1);
+    CHECK_EQ(out[0], 7);
+    CHECK_EQ(pulse_capture_count(1), edges + 1);
+    CHECK_EQ(pulse_capture_dropped(1), edges - PULSE_CAPTURE_RING_SIZE);
+    CHECK_EQ(pulse_capture_drain(5, out, 1), 0);
+}
+
+// edges through the registered GPIO ISR wake the consumer at half ring
+static void test_consumer_wake(void)
+{
+    uint32_t out[PULSE_CAPTURE_RING_SIZE];
+    uint32_t count0 = pulse_capture_count(0);
+
+    pulse_capture_drain(0, out, PULSE_CAPTURE_RING_SIZE);
+    pulse_capture_set_consumer(xTaskGetCurrentTaskHandle());
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    for (int i = 0; i < PULSE_CAPTURE_WAKE_FILL - 1; i++) {
+        host_gpio_fire(GPIO_A);
+    }
+    CHECK_EQ(ulTaskNotifyTake(pdTRUE, 0), 0);
+    host_gpio_fire(GPIO_A);
+    CHECK_EQ(ulTaskNotifyTake(pdTRUE, 0), 1);
+    for (int i = 0; i < PULSE_CAPTURE_WAKE_FILL; i++) {
+        host_gpio_fire(GPIO_A);
+    }
+    CHECK_EQ(ulTaskNotifyTake(pdTRUE, 0), 0);  // past half full, no second wake
+
+    CHECK_EQ(pulse_capture_count(0) - count0, 2 * PULSE_CAPTURE_WAKE_FILL);
+    size_t n = pulse_capture_drain(0, out, PULSE_CAPTURE_RING_SIZE);
+    CHECK_EQ(n, 2 * PULSE_CAPTURE_WAKE_FILL);
+    for (size_t i = 1; i < n; i++) {
+        CHECK(out[i] >= out[i - 1]);
+    }
+    pulse_capture_set_consumer(NULL);
+}
+
+int main(void)
+{
+    test_init();
+    test_ring_wrap();
+    test_overflow();
+    test_consumer_wake();
+    TEST_EXIT();
+}
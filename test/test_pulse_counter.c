@@ -0,0 +1,129 @@
+/*
+ * pulse_counter host test
+ *
+ * pulse_accum_extend -> 16 bit PCNT value + wrap count to a monotonic 64 bit count,
+ *                       including a wrap whose limit ISR has not run yet
+ * PCNT backend       -> counts through wraps of the fake unit
+ * fallback           -> a unit failing part way tears down the units already set up
+ */
+
+#include "pulse_counter.h"
+#include "pulse_capture.h"
+#include "driver/gpio.h"
+#include "driver/pcnt.h"
+
+#include "test_util.h"
+
+static const pulse_counter_pin_t pins[PULSE_COUNTER_CHANNELS] = {
+    { .gpio_num = 4, .both_edges = 1 },
+    { .gpio_num = 5, .both_edges = 0 },
+};
+
+static void test_accum_extend(void)
+{
+    pulse_accum_t acc = {0};
+
+    CHECK_EQ(pulse_accum_extend(&acc, 0, 0), 0);
+    CHECK_EQ(pulse_accum_extend(&acc, 0, 100), 100);
+    CHECK_EQ(pulse_accum_extend(&acc, 0, 32766), 32766);
+
+    // counter reset to 0 at the limit, wraps already bumped
+    CHECK_EQ(pulse_accum_extend(&acc, 1, 0), PULSE_PCNT_H_LIM);
+    CHECK_EQ(pulse_accum_extend(&acc, 1, 5), PULSE_PCNT_H_LIM + 5);
+
+    // counter wrapped again but the limit ISR has not run: still monotonic
+    CHECK_EQ(pulse_accum_extend(&acc, 1, 32760), PULSE_PCNT_H_LIM + 32760);
+    CHECK_EQ(pulse_accum_extend(&acc, 1, 3), 2 * PULSE_PCNT_H_LIM + 3);
+    // ... and once it has run the value does not jump twice
+    CHECK_EQ(pulse_accum_extend(&acc, 2, 4), 2 * PULSE_PCNT_H_LIM + 4);
+
+    // wrap counts past 32 bit worth of pulses
+    pulse_accum_t big = {0};
+    uint32_t wraps = 200000;
+    uint64_t expect = (uint64_t) wraps * PULSE_PCNT_H_LIM + 17;
+    CHECK(expect > UINT32_MAX);
+    CHECK(pulse_accum_extend(&big, wraps, 17) == expect);
+
+    // sweep: monotonic and exact over many wraps with a lagging ISR now and then
+    pulse_accum_t sweep = {0};
+    uint64_t total = 0, prev = 0;
+    uint32_t prev_wraps = 0;
+    for (int step = 0; step < 100000; step++) {
+        total += 1 + (step * 7919) % 3000;
+        uint32_t hw_wraps = (uint32_t) (total / PULSE_PCNT_H_LIM);
+        int16_t raw = (int16_t) (total % PULSE_PCNT_H_LIM);
+        // every other fresh wrap is read before its limit ISR ran
+        uint32_t isr_wraps = ((hw_wraps != prev_wraps) && (hw_wraps & 1)) ? hw_wraps - 1 : hw_wraps;
+        prev_wraps = hw_wraps;
+        uint64_t v = pulse_accum_extend(&sweep, isr_wraps, raw);
+        if (v != total) {
+            CHECK(v == total);
+            break;
+        }
+        CHECK(v >= prev);
+        prev = v;
+    }
+}
+
+static void test_pcnt_backend(void)
+{
+    host_pcnt_reset();
+
+    CHECK_EQ(pulse_counter_init(PULSE_COUNTER_BACKEND_PCNT, pins, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(pulse_counter_init(PULSE_COUNTER_BACKEND_PCNT, pins, 2), ESP_OK);
+    CHECK_EQ(pulse_counter_backend(), PULSE_COUNTER_BACKEND_PCNT);
+
+    host_pcnt_pulse(PCNT_UNIT_0, 10);
+    CHECK_EQ(pulse_counter_get(0), 10);
+    host_pcnt_pulse(PCNT_UNIT_0, 3 * PULSE_PCNT_H_LIM);
+    CHECK_EQ(pulse_counter_get(0), 10 + 3 * PULSE_PCNT_H_LIM);
+    host_pcnt_pulse(PCNT_UNIT_1, PULSE_PCNT_H_LIM + 1);
+    CHECK_EQ(pulse_counter_get(1), PULSE_PCNT_H_LIM + 1);
+    CHECK_EQ(pulse_counter_get(2), 0);
+}
+
+static void test_fallback_teardown(void)
+{
+    host_pcnt_reset();
+    host_pcnt_fail_unit = PCNT_UNIT_1;
+
+    CHECK_EQ(pulse_counter_init(PULSE_COUNTER_BACKEND_PCNT, pins, 2), ESP_OK);
+    CHECK_EQ(pulse_counter_backend(), PULSE_COUNTER_BACKEND_ISR);
+
+    // unit 0 was fully set up, then released again
+    CHECK_EQ(host_pcnt_units[PCNT_UNIT_0].pulse_gpio, PCNT_PIN_NOT_USED);
+    CHECK_EQ(host_pcnt_units[PCNT_UNIT_0].running, 0);
+    CHECK_EQ(host_pcnt_units[PCNT_UNIT_0].h_lim_event, 0);
+    CHECK(host_pcnt_units[PCNT_UNIT_0].isr == NULL);
+    CHECK_EQ(host_pcnt_service, 0);
+
+    // the ISR backend counts from zero, not from whatever PCNT left behind
+    CHECK_EQ(pulse_counter_get(0), 0);
+    for (int i = 0; i < 5; i++) {
+        host_gpio_fire(4);
+    }
+    host_gpio_fire(5);
+    CHECK_EQ(pulse_counter_get(0), 5);
+    CHECK_EQ(pulse_counter_get(1), 1);
+}
+
+// a service installed by someone else is left in place
+static void test_fallback_keeps_foreign_service(void)
+{
+    host_pcnt_reset();
+    pcnt_isr_service_install(0);
+    host_pcnt_fail_unit = PCNT_UNIT_0;
+
+    CHECK_EQ(pulse_counter_init(PULSE_COUNTER_BACKEND_PCNT, pins, 2), ESP_OK);
+    CHECK_EQ(pulse_counter_backend(), PULSE_COUNTER_BACKEND_ISR);
+    CHECK_EQ(host_pcnt_service, 1);
+}
+
+int main(void)
+{
+    test_accum_extend();
+    test_pcnt_backend();
+    test_fallback_teardown();
+    test_fallback_keeps_foreign_service();
+    TEST_EXIT();
+}
@@ -0,0 +1,116 @@
+/*
+ * pulse_stats host test
+ *
+ * intervals -> a steady train gives exact min/max and percentiles
+ * gap       -> timestamps lost between two batches (ring overflow): no
+ *              interval over the hole, a burst does not continue through it,
+ *              every edge is still counted
+ * window    -> the counter's exact edge count wins, counters reset, the
+ *              chain continues into the next window
+ */
+
+#include "pulse_stats.h"
+
+#include "test_util.h"
+
+static const pulse_stats_config_t cfg = { .burst_gap_us = 1000, .burst_min_edges = 4 };
+
+static void test_intervals(void)
+{
+    pulse_stats_t ps;
+    pulse_summary_t s;
+    uint32_t ts[11];
+
+    for (int i = 0; i < 11; i++) {
+        ts[i] = 4000000000u + (uint32_t) i * 50000;  // wraps 2^32 half way
+    }
+    pulse_stats_init(&ps, &cfg, 0);
+    pulse_stats_add(&ps, ts, 11);
+    pulse_stats_window(&ps, 1000000, 0, &s);
+    CHECK_EQ(s.edges, 11);
+    CHECK_EQ(s.intervals, 10);
+    CHECK_EQ(s.min_us, 50000);
+    CHECK_EQ(s.max_us, 50000);
+    CHECK_EQ(s.p50_us, 50000);
+    CHECK_EQ(s.p99_us, 50000);
+    CHECK_EQ(s.bursts, 0);
+    CHECK(s.rate_hz > 10.99f && s.rate_hz < 11.01f);
+}
+
+static void test_gap(void)
+{
+    const uint32_t a[] = { 0, 100, 200 };
+    const uint32_t b[] = { 900000, 900100, 900200 };
+    const uint32_t close_a[] = { 1000000, 1000010, 1000020 };
+    const uint32_t close_b[] = { 1000500, 1000510 };
+    pulse_stats_t ps;
+    pulse_summary_t s;
+
+    pulse_stats_init(&ps, &cfg, 0);
+    pulse_stats_add(&ps, a, 3);
+    pulse_stats_gap(&ps);
+    pulse_stats_add(&ps, b, 3);
+    pulse_stats_window(&ps, 1000000, 0, &s);
+    CHECK_EQ(s.edges, 6);
+    CHECK_EQ(s.intervals, 4);
+    // without the gap: 899800 us
+    CHECK_EQ(s.max_us, 100);
+
+    // 3 + 2 close edges across the hole are not a burst of 5
+    pulse_stats_gap(&ps);
+    pulse_stats_add(&ps, close_a, 3);
+    pulse_stats_gap(&ps);
+    pulse_stats_add(&ps, close_b, 2);
+    pulse_stats_window(&ps, 2000000, 0, &s);
+    CHECK_EQ(s.edges, 5);
+    CHECK_EQ(s.intervals, 3);
+    CHECK_EQ(s.bursts, 0);
+    CHECK_EQ(s.burst_max, 0);
+
+    // a gap on a fresh chain changes nothing
+    pulse_stats_init(&ps, &cfg, 0);
+    pulse_stats_gap(&ps);
+    pulse_stats_add(&ps, close_a, 3);
+    pulse_stats_add(&ps, close_b, 2);
+    pulse_stats_window(&ps, 1000000, 0, &s);
+    CHECK_EQ(s.intervals, 4);
+    CHECK_EQ(s.max_us, 480);
+    CHECK_EQ(s.bursts, 1);
+    CHECK_EQ(s.burst_max, 5);
+}
+
+static void test_window(void)
+{
+    const uint32_t a[] = { 0, 1000, 2000 };
+    const uint32_t b[] = { 3000 };
+    pulse_stats_t ps;
+    pulse_summary_t s;
+
+    pulse_stats_init(&ps, &cfg, 0);
+    pulse_stats_add(&ps, a, 3);
+    // 2 timestamps dropped: the counter saw 5
+    pulse_stats_window(&ps, 500000, 5, &s);
+    CHECK_EQ(s.edges, 5);
+    CHECK_EQ(s.intervals, 2);
+    CHECK(s.rate_hz > 9.99f && s.rate_hz < 10.01f);
+
+    pulse_stats_add(&ps, b, 1);
+    pulse_stats_window(&ps, 1000000, 0, &s);
+    CHECK_EQ(s.edges, 1);
+    CHECK_EQ(s.intervals, 1);
+    CHECK_EQ(s.min_us, 1000);
+
+    // nothing seen
+    pulse_stats_window(&ps, 1500000, 0, &s);
+    CHECK_EQ(s.edges, 0);
+    CHECK_EQ(s.intervals, 0);
+    CHECK_EQ(s.p50_us, 0);
+}
+
+int main(void)
+{
+    test_intervals();
+    test_gap();
+    test_window();
+    TEST_EXIT();
+}
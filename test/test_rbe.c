@@ -0,0 +1,185 @@
+/*
+ * rbe host test
+ *
+ * Fields as in main.c: two pulse counters (deadband 100 counts) and the
+ * battery (deadband 0.1 V, hysteresis 0.05 V), heartbeat 15 minutes.
+ *   deadband   -> a change below the deadband is suppressed, at it reported
+ *   hysteresis -> a reversal needs deadband + hysteresis, a change in the
+ *                 direction of the last reported one only the deadband
+ *   heartbeat  -> a quiet field is reported once heartbeat_ms passed
+ *   day        -> one day of one-minute samples: two flow periods, an idle
+ *                 trickle, a slowly discharging noisy battery. Checks the
+ *                 message count, that the battery never triggers a report,
+ *                 and the delay before a counter change is reported.
+ * Battery steps are binary fractions so the thresholds compare exactly.
+ */
+
+#include "rbe.h"
+
+#include "test_util.h"
+
+#define HEARTBEAT_MS        900000
+#define SAMPLE_PERIOD_MS    60000
+#define DAY_SAMPLES         1440
+#define DAY_MESSAGES        180     // 90 flow samples, 90 idle heartbeats
+
+static const rbe_field_config_t fields[] = {
+    { .deadband = 100 },
+    { .deadband = 100 },
+    { .deadband = 0.1, .hysteresis = 0.05 },
+};
+
+static void rbe_setup(rbe_t* r, double pulse1, double pulse2, double battery)
+{
+    double v[] = { pulse1, pulse2, battery };
+
+    rbe_init(r, fields, 3, HEARTBEAT_MS);
+    CHECK_EQ(rbe_update(r, v, 0), RBE_FIRST);
+}
+
+static uint32_t update(rbe_t* r, double pulse1, double pulse2, double battery, int64_t now_ms)
+{
+    double v[] = { pulse1, pulse2, battery };
+
+    return rbe_update(r, v, now_ms);
+}
+
+static void test_deadband(void)
+{
+    rbe_t r;
+
+    rbe_setup(&r, 1000, 50, 3.5);
+    CHECK_EQ(update(&r, 1099, 149, 3.5625, 1000), 0);
+    CHECK_EQ(update(&r, 1100, 149, 3.5625, 2000), 1u << 0);
+    // the report moved every reference, CH2 and the battery included
+    CHECK_EQ(update(&r, 1100, 248, 3.625, 3000), 0);
+    CHECK_EQ(update(&r, 1100, 249, 3.625, 4000), 1u << 1);
+    CHECK_EQ(update(&r, 1100, 249, 3.75, 5000), 1u << 2);
+    CHECK_EQ(update(&r, 1300, 400, 3.875, 6000), (1u << 0) | (1u << 1) | (1u << 2));
+    CHECK_EQ(r.reported, 5);
+    CHECK_EQ(r.suppressed, 2);
+}
+
+static void test_hysteresis(void)
+{
+    rbe_t r;
+
+    rbe_setup(&r, 0, 0, 3.5);
+    CHECK_EQ(update(&r, 0, 0, 3.625, 1000), 1u << 2);      // up
+    CHECK_EQ(update(&r, 0, 0, 3.5, 2000), 0);              // back down 0.125 < 0.15
+    CHECK_EQ(update(&r, 0, 0, 3.75, 3000), 1u << 2);       // up again, the deadband is enough
+    CHECK_EQ(update(&r, 0, 0, 3.5625, 4000), 1u << 2);     // down 0.1875 >= 0.15
+    CHECK_EQ(update(&r, 0, 0, 3.4375, 5000), 1u << 2);     // down again 0.125
+    CHECK_EQ(update(&r, 0, 0, 3.5625, 6000), 0);           // up 0.125 < 0.15
+
+    // a wobble of +-0.0625 around one level is never reported
+    rbe_setup(&r, 0, 0, 3.5);
+    for (int i = 1; i <= 10; i++) {
+        CHECK_EQ(update(&r, 0, 0, (i & 1) ? 3.5625 : 3.4375, i * 1000), 0);
+    }
+}
+
+static void test_heartbeat(void)
+{
+    rbe_t r;
+
+    rbe_setup(&r, 10, 10, 3.5);
+    CHECK_EQ(update(&r, 10, 10, 3.5, HEARTBEAT_MS - 1), 0);
+    CHECK_EQ(update(&r, 20, 10, 3.5, HEARTBEAT_MS), RBE_HEARTBEAT);
+    // the heartbeat restarts from the last report of any kind
+    CHECK_EQ(update(&r, 200, 10, 3.5, HEARTBEAT_MS + 1000), 1u << 0);
+    CHECK_EQ(update(&r, 200, 10, 3.5, 2 * HEARTBEAT_MS), 0);
+    CHECK_EQ(update(&r, 200, 10, 3.5, 2 * HEARTBEAT_MS + 1000), RBE_HEARTBEAT);
+
+    // heartbeat_ms 0: a quiet field is never reported
+    rbe_init(&r, fields, 3, 0);
+    update(&r, 0, 0, 3.5, 0);
+    CHECK_EQ(update(&r, 0, 0, 3.5, 100 * HEARTBEAT_MS), 0);
+}
+
+// deterministic noise in [-0.03, 0.03] V
+static double noise(uint32_t* seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return ((double) (*seed >> 8) / (double) (1u << 24) - 0.5) * 0.06;
+}
+
+static void test_day(void)
+{
+    rbe_t r;
+    double pulse[2] = { 0, 0 };
+    double reported[2] = { 0, 0 };
+    int64_t pending_ms[2] = { -1, -1 };    // first unreported change of each counter
+    int64_t latency_max_ms = 0;
+    int64_t silence_max_ms = 0;
+    int64_t last_report_ms = 0;
+    int messages = 0, battery_reports = 0;
+    uint32_t seed = 1;
+
+    rbe_init(&r, fields, 3, HEARTBEAT_MS);
+    for (int i = 0; i < DAY_SAMPLES; i++) {
+        int64_t now_ms = (int64_t) i * SAMPLE_PERIOD_MS;
+        int minute = i;
+
+        if ((minute >= 7 * 60) && (minute < 7 * 60 + 30)) {
+            // morning flow on both channels
+            pulse[0] += 300;
+            pulse[1] += 120;
+        } else if ((minute >= 18 * 60) && (minute < 19 * 60)) {
+            pulse[0] += 150;
+        } else {
+            // idle trickle, far below the deadband
+            pulse[0] += (minute % 7 == 0) ? 3 : 0;
+            pulse[1] += (minute % 30 == 0) ? 1 : 0;
+        }
+        // 0.3 V over the day plus noise smaller than the deadband
+        double battery = 4.1 - 0.3 * i / DAY_SAMPLES + noise(&seed);
+
+        for (int ch = 0; ch < 2; ch++) {
+            if ((pulse[ch] != reported[ch]) && (pending_ms[ch] < 0)) {
+                pending_ms[ch] = now_ms;
+            }
+        }
+        uint32_t why = update(&r, pulse[0], pulse[1], battery, now_ms);
+        if (why == 0) {
+            continue;
+        }
+        messages++;
+        battery_reports += (why & (1u << 2)) != 0;
+        if (now_ms - last_report_ms > silence_max_ms) {
+            silence_max_ms = now_ms - last_report_ms;
+        }
+        last_report_ms = now_ms;
+        for (int ch = 0; ch < 2; ch++) {
+            if ((pending_ms[ch] >= 0) && (now_ms - pending_ms[ch] > latency_max_ms)) {
+                latency_max_ms = now_ms - pending_ms[ch];
+            }
+            reported[ch] = pulse[ch];
+            pending_ms[ch] = -1;
+        }
+    }
+
+    printf("day: %d of %d samples reported, %d for the battery, "
+           "counter latency max %lld min, silence max %lld min\n",
+           messages, DAY_SAMPLES, battery_reports,
+           (long long) (latency_max_ms / 60000), (long long) (silence_max_ms / 60000));
+    CHECK_EQ(messages, (int) r.reported);
+    CHECK_EQ(messages + (int) r.suppressed, DAY_SAMPLES);
+    // every flow sample plus one heartbeat per 15 idle minutes
+    CHECK_EQ(messages, DAY_MESSAGES);
+    // every report moves the battery reference: neither the noise nor the
+    // discharge between two reports reaches the deadband
+    CHECK_EQ(battery_reports, 0);
+    // a change waits at most until the next heartbeat, nothing is silent longer
+    CHECK(latency_max_ms <= HEARTBEAT_MS - SAMPLE_PERIOD_MS);
+    CHECK(silence_max_ms <= HEARTBEAT_MS);
+}
+
+int main(void)
+{
+    test_deadband();
+    test_hysteresis();
+    test_heartbeat();
+    test_day();
+    TEST_EXIT();
+}
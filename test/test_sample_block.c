@@ -0,0 +1,255 @@
+/*
+ * sample_block host test
+ *
+ * round trip -> decode(encode(x)) == x bit for bit, for:
+ *               zigzag extremes (deltas of INT64_MIN / INT64_MAX, 2^32
+ *               timestamp jumps both ways), counter resets, channels not
+ *               measured (SAMPLE_NOT_MEASURED) and back, NaN / inf / -0
+ *               batteries, 1 and SBLOCK_SAMPLES_MAX samples, random runs
+ * limits     -> bad counts, a cap one byte short, every truncated block and
+ *               a wrong version are refused
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "sample_block.h"
+
+#include "test_util.h"
+
+#define BUF_MAX     (SBLOCK_SAMPLES_MAX * 64)
+#define RANDOM_RUNS 20000
+
+static uint32_t rng_state = 0x2545f491;
+
+static uint32_t rng_next(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint64_t rng_u64(void)
+{
+    return ((uint64_t) rng_next() << 32) | rng_next();
+}
+
+static float bits_float(uint32_t v)
+{
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+// field by field, the battery by its bits so NaN payloads must survive too
+static int same_sample(const sample_t* a, const sample_t* b)
+{
+    return (a->timestamp == b->timestamp) && (a->pulse1 == b->pulse1) && (a->pulse2 == b->pulse2)
+            && (memcmp(&a->battery, &b->battery, sizeof(a->battery)) == 0);
+}
+
+// 1 when the samples survive encode + decode, the block length in *len
+static int round_trip(const sample_t* s, int count, int* len)
+{
+    static uint8_t buf[BUF_MAX];
+    sample_t out[SBLOCK_SAMPLES_MAX];
+
+    *len = sblock_encode(s, count, buf, sizeof(buf));
+    if (*len <= 0) {
+        return 0;
+    }
+    if (sblock_decode(buf, *len, out, SBLOCK_SAMPLES_MAX) != count) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!same_sample(&s[i], &out[i])) {
+            fprintf(stderr, "sample %d differs\n", i);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void fill_steady(sample_t* s, int count)
+{
+    for (int i = 0; i < count; i++) {
+        s[i].timestamp = 1700000000u + i * 60;
+        s[i].battery = 3.7f;
+        s[i].pulse1 = 1000 + i * 7;
+        s[i].pulse2 = 5000 + i * 3;
+    }
+}
+
+static void test_zigzag_extremes(void)
+{
+    sample_t s[6];
+    int len;
+
+    fill_steady(s, 6);
+    // pulse deltas of INT64_MIN, INT64_MAX, -1 and +1 across the wrap
+    s[0].pulse1 = 0;
+    s[1].pulse1 = 1ULL << 63;
+    s[2].pulse1 = 0;
+    s[3].pulse1 = (1ULL << 63) - 1;
+    s[4].pulse1 = UINT64_MAX;
+    s[5].pulse1 = 0;
+    // timestamps 0 -> UINT32_MAX -> 0: deltas of +-2^32, delta of delta 2^33
+    s[0].timestamp = 0;
+    s[1].timestamp = UINT32_MAX;
+    s[2].timestamp = 0;
+    s[3].timestamp = UINT32_MAX;
+    s[4].timestamp = UINT32_MAX;
+    s[5].timestamp = 1;
+    s[0].pulse2 = UINT64_MAX;
+    s[5].pulse2 = 0;
+    CHECK(round_trip(s, 6, &len));
+}
+
+static void test_counter_reset(void)
+{
+    sample_t s[16];
+    int len, steady;
+
+    fill_steady(s, 16);
+    CHECK(round_trip(s, 16, &steady));
+    // reboot or PCNT clear half way: counters restart from 0
+    for (int i = 8; i < 16; i++) {
+        s[i].pulse1 = (uint64_t) (i - 8) * 7;
+        s[i].pulse2 = (uint64_t) (i - 8) * 3;
+    }
+    CHECK(round_trip(s, 16, &len));
+    // one negative delta per counter costs a few bytes, not the block
+    CHECK(len <= steady + 8);
+}
+
+static void test_not_measured(void)
+{
+    sample_t s[8];
+    int len;
+
+    // CH2 not counted in low power mode, on every sample
+    fill_steady(s, 8);
+    for (int i = 0; i < 8; i++) {
+        s[i].pulse2 = SAMPLE_NOT_MEASURED;
+    }
+    CHECK(round_trip(s, 8, &len));
+
+    // ... and in and out of it: delta from and to UINT64_MAX
+    fill_steady(s, 8);
+    s[2].pulse2 = SAMPLE_NOT_MEASURED;
+    s[3].pulse2 = SAMPLE_NOT_MEASURED;
+    s[6].pulse1 = SAMPLE_NOT_MEASURED;
+    CHECK(round_trip(s, 8, &len));
+
+    // a single sample block carries it in the header
+    s[0].pulse1 = SAMPLE_NOT_MEASURED;
+    s[0].pulse2 = SAMPLE_NOT_MEASURED;
+    CHECK(round_trip(s, 1, &len));
+}
+
+static void test_battery_specials(void)
+{
+    const float specials[] = {
+        NAN, -NAN, bits_float(0x7fc00001), bits_float(0x7f800001), INFINITY, -INFINITY,
+        0.0f, -0.0f, 3.3f, bits_float(0x00000001), bits_float(0x80000000), bits_float(0xffffffff),
+    };
+    const int n = (int) (sizeof(specials) / sizeof(specials[0]));
+    sample_t s[SBLOCK_SAMPLES_MAX];
+    int len;
+
+    // a NaN battery (ADC read failed) first, in the middle and repeated
+    fill_steady(s, 4);
+    s[0].battery = NAN;
+    CHECK(round_trip(s, 4, &len));
+    fill_steady(s, 4);
+    s[1].battery = NAN;
+    s[2].battery = NAN;
+    CHECK(round_trip(s, 4, &len));
+
+    // every pair of specials, so each XOR window shape is hit
+    fill_steady(s, SBLOCK_SAMPLES_MAX);
+    for (int i = 0; i < SBLOCK_SAMPLES_MAX; i++) {
+        s[i].battery = specials[(i * 5 + i / n) % n];
+    }
+    CHECK(round_trip(s, SBLOCK_SAMPLES_MAX, &len));
+}
+
+static void test_random(void)
+{
+    sample_t s[SBLOCK_SAMPLES_MAX];
+    int failures = 0;
+    int len;
+
+    for (int run = 0; run < RANDOM_RUNS; run++) {
+        int count = 1 + (int) (rng_next() % SBLOCK_SAMPLES_MAX);
+        int mode = (int) (rng_next() % 3);
+        for (int i = 0; i < count; i++) {
+            if (mode == 0) {
+                // anything
+                s[i].timestamp = rng_next();
+                s[i].battery = bits_float(rng_next());
+                s[i].pulse1 = rng_u64();
+                s[i].pulse2 = rng_u64();
+            } else {
+                // plausible: jittered period, slow counters, occasional resets
+                s[i].timestamp = (i == 0) ? rng_next() : s[i - 1].timestamp + 60 + (rng_next() % 5) - 2;
+                s[i].battery = (i == 0 || (rng_next() % 4)) ? 3.0f + (float) (rng_next() % 1000) / 1000.0f
+                        : s[i - 1].battery;
+                s[i].pulse1 = (i == 0 || !(rng_next() % 50)) ? rng_next() % 100 : s[i - 1].pulse1 + rng_next() % 200;
+                s[i].pulse2 = (mode == 2) ? SAMPLE_NOT_MEASURED
+                        : (i == 0) ? rng_u64() : s[i - 1].pulse2 + rng_next() % 3;
+            }
+        }
+        if (!round_trip(s, count, &len)) {
+            fprintf(stderr, "random run %d (%d samples, mode %d) failed\n", run, count, mode);
+            failures++;
+        }
+    }
+    CHECK_EQ(failures, 0);
+}
+
+static void test_limits(void)
+{
+    sample_t s[SBLOCK_SAMPLES_MAX + 1];
+    sample_t out[SBLOCK_SAMPLES_MAX];
+    uint8_t buf[BUF_MAX];
+    int len;
+
+    fill_steady(s, SBLOCK_SAMPLES_MAX + 1);
+    CHECK_EQ(sblock_encode(s, 0, buf, sizeof(buf)), -1);
+    CHECK_EQ(sblock_encode(s, SBLOCK_SAMPLES_MAX + 1, buf, sizeof(buf)), -1);
+
+    s[3].battery = NAN;
+    len = sblock_encode(s, 16, buf, sizeof(buf));
+    CHECK(len > 0);
+    CHECK_EQ(sblock_encode(s, 16, buf, len - 1), -1);
+    CHECK_EQ(sblock_encode(s, 16, buf, len), len);
+
+    // the decoder needs room for all samples, and every byte of the block
+    CHECK_EQ(sblock_decode(buf, len, out, 15), -1);
+    for (int cut = 0; cut < len; cut++) {
+        if (sblock_decode(buf, cut, out, SBLOCK_SAMPLES_MAX) != -1) {
+            fprintf(stderr, "block cut at %d of %d decoded\n", cut, len);
+            CHECK(0);
+        }
+    }
+    // trailing bytes are ignored
+    buf[len] = 0xff;
+    CHECK_EQ(sblock_decode(buf, len + 1, out, SBLOCK_SAMPLES_MAX), 16);
+
+    buf[0] = SBLOCK_VERSION + 1;
+    CHECK_EQ(sblock_decode(buf, len, out, SBLOCK_SAMPLES_MAX), -1);
+}
+
+int main(void)
+{
+    test_zigzag_extremes();
+    test_counter_reset();
+    test_not_measured();
+    test_battery_specials();
+    test_random();
+    test_limits();
+    TEST_EXIT();
+}
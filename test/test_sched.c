@@ -0,0 +1,205 @@
+/*
+ * sched host test
+ *
+ * The scheduler runs on a fake clock: sleep_us advances it (plus a wake-up
+ * overshoot, like tick rounding), a job advances it by its run time.
+ *   no drift  -> deadlines stay on start + offset + n * period whatever the
+ *                run time and the wake-up overshoot
+ *   overrun   -> a run past the next deadline is counted, the grid is kept
+ *   stall     -> CATCH_UP runs the missed periods back to back, SKIP drops
+ *                them; past max_catch_up periods CATCH_UP drops them too
+ *   order     -> of two jobs the earliest deadline runs first
+ */
+
+#include "sched.h"
+
+#include "test_util.h"
+
+#define PERIOD_MS       1000
+#define PERIOD_US       ((int64_t) PERIOD_MS * 1000)
+#define RUNS_MAX        64
+
+static struct {
+    int64_t now_us;
+    int64_t overshoot_us;   // added to every sleep
+    int64_t exec_us;        // run time of every job run
+    int64_t stall_us;       // run time of the next run only, 0 none
+    int runs;
+    int64_t start_us[RUNS_MAX];
+    void* arg[RUNS_MAX];
+} fake;
+
+static int64_t fake_now_us(void)
+{
+    return fake.now_us;
+}
+
+static void fake_sleep_us(int64_t us)
+{
+    fake.now_us += us + fake.overshoot_us;
+}
+
+static void fake_job(void* arg)
+{
+    if (fake.runs < RUNS_MAX) {
+        fake.start_us[fake.runs] = fake.now_us;
+        fake.arg[fake.runs] = arg;
+    }
+    fake.runs++;
+    if (fake.stall_us != 0) {
+        fake.now_us += fake.stall_us;
+        fake.stall_us = 0;
+    } else {
+        fake.now_us += fake.exec_us;
+    }
+}
+
+static void fake_reset(int64_t overshoot_us, int64_t exec_us)
+{
+    fake.now_us = 5000000;  // the clock does not start at 0
+    fake.overshoot_us = overshoot_us;
+    fake.exec_us = exec_us;
+    fake.stall_us = 0;
+    fake.runs = 0;
+}
+
+static void job_init(sched_job_t* job, sched_policy_t policy, uint32_t offset_ms, void* arg)
+{
+    *job = (sched_job_t) {
+        .name = "job",
+        .fn = fake_job,
+        .arg = arg,
+        .period_ms = PERIOD_MS,
+        .offset_ms = offset_ms,
+        .policy = policy,
+    };
+}
+
+static void test_no_drift(void)
+{
+    sched_t s;
+    sched_job_t job;
+
+    // 30 % of the period spent running, every wake-up 2 ms late
+    fake_reset(2000, 300000);
+    job_init(&job, SCHED_CATCH_UP, 100, NULL);
+    sched_init(&s, &job, 1, fake_now_us, fake_sleep_us);
+    int64_t start = fake.now_us;
+    for (int i = 0; i < RUNS_MAX; i++) {
+        sched_run_once(&s);
+    }
+    for (int i = 0; i < RUNS_MAX; i++) {
+        CHECK_EQ(fake.start_us[i], start + 100000 + i * PERIOD_US + 2000);
+    }
+    CHECK_EQ(job.runs, RUNS_MAX);
+    CHECK_EQ(job.late_max_us, 2000);
+    CHECK_EQ(job.late_sum_us, RUNS_MAX * 2000);
+    CHECK_EQ(job.exec_max_us, 300000);
+    CHECK_EQ(job.overruns, 0);
+    CHECK_EQ(job.skipped, 0);
+}
+
+static void test_overrun(void)
+{
+    sched_t s;
+    sched_job_t job;
+
+    fake_reset(0, 100000);
+    job_init(&job, SCHED_CATCH_UP, 0, NULL);
+    sched_init(&s, &job, 1, fake_now_us, fake_sleep_us);
+    int64_t start = fake.now_us;
+    sched_run_once(&s);
+    // the second run takes 1.5 periods: the third starts late, the fourth on time
+    fake.stall_us = PERIOD_US * 3 / 2;
+    for (int i = 0; i < 3; i++) {
+        sched_run_once(&s);
+    }
+    CHECK_EQ(job.overruns, 1);
+    CHECK_EQ(job.skipped, 0);
+    CHECK_EQ(fake.start_us[2], start + PERIOD_US * 5 / 2);
+    CHECK_EQ(fake.start_us[3], start + 3 * PERIOD_US);
+    CHECK_EQ(job.late_max_us, PERIOD_US / 2);
+    CHECK_EQ(job.exec_max_us, PERIOD_US * 3 / 2);
+}
+
+// one run of stall_us, then runs until one starts back on the grid (its offset in *grid_us)
+static void stall(sched_policy_t policy, int64_t stall_us, sched_job_t* job, int64_t* grid_us)
+{
+    sched_t s;
+
+    fake_reset(0, PERIOD_US / 10);
+    job_init(job, policy, 0, NULL);
+    sched_init(&s, job, 1, fake_now_us, fake_sleep_us);
+    int64_t start = fake.now_us;
+    fake.stall_us = stall_us;
+    sched_run_once(&s);
+    do {
+        sched_run_once(&s);
+    } while (((fake.start_us[fake.runs - 1] - start) % PERIOD_US) != 0);
+    *grid_us = fake.start_us[fake.runs - 1] - start;
+}
+
+static void test_stall(void)
+{
+    sched_job_t job;
+    int64_t grid;
+
+    // 3.5 periods: within the catch-up cap of 3 missed periods
+    stall(SCHED_CATCH_UP, PERIOD_US * 7 / 2, &job, &grid);
+    CHECK_EQ(job.skipped, 0);
+    CHECK_EQ(job.overruns, 3);
+    CHECK_EQ(job.runs, 5);          // every period of 0..4 served
+    CHECK_EQ(grid, 4 * PERIOD_US);
+    CHECK_EQ(fake.start_us[1] - fake.start_us[0], PERIOD_US * 7 / 2);
+    CHECK_EQ(fake.start_us[2] - fake.start_us[1], PERIOD_US / 10);
+
+    stall(SCHED_SKIP, PERIOD_US * 7 / 2, &job, &grid);
+    CHECK_EQ(job.skipped, 3);
+    CHECK_EQ(job.overruns, 1);
+    CHECK_EQ(job.runs, 2);
+    CHECK_EQ(grid, 4 * PERIOD_US);
+
+    // 10.5 periods: past the cap both policies realign
+    stall(SCHED_CATCH_UP, PERIOD_US * 21 / 2, &job, &grid);
+    CHECK_EQ(job.skipped, 10);
+    CHECK_EQ(job.overruns, 1);
+    CHECK_EQ(job.runs, 2);
+    CHECK_EQ(grid, 11 * PERIOD_US);
+
+    stall(SCHED_SKIP, PERIOD_US * 21 / 2, &job, &grid);
+    CHECK_EQ(job.skipped, 10);
+    CHECK_EQ(job.runs, 2);
+    CHECK_EQ(grid, 11 * PERIOD_US);
+}
+
+static void test_order(void)
+{
+    static int a, b;
+    sched_t s;
+    sched_job_t jobs[2];
+
+    fake_reset(0, 1000);
+    job_init(&jobs[0], SCHED_SKIP, 600, &a);
+    job_init(&jobs[1], SCHED_SKIP, 200, &b);
+    jobs[1].period_ms = PERIOD_MS / 2;
+    sched_init(&s, jobs, 2, fake_now_us, fake_sleep_us);
+    // b 200, a 600, b 700, b 1200, a 1600
+    for (int i = 0; i < 5; i++) {
+        sched_run_once(&s);
+    }
+    CHECK(fake.arg[0] == &b);
+    CHECK(fake.arg[1] == &a);
+    CHECK(fake.arg[2] == &b);
+    CHECK(fake.arg[3] == &b);
+    CHECK(fake.arg[4] == &a);
+    CHECK_EQ(fake.start_us[4] - fake.start_us[0], 1400000);
+}
+
+int main(void)
+{
+    test_no_drift();
+    test_overrun();
+    test_stall();
+    test_order();
+    TEST_EXIT();
+}
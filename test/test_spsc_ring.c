@@ -0,0 +1,184 @@
+/*
+ * spsc_ring host test
+ *
+ * init      -> a capacity that is not a power of two is refused
+ * full      -> capacity elements fit, the next push is refused and counted
+ *              in dropped, pops come back in order until the ring is empty
+ * wrap      -> head and tail wrapping past UINT32_MAX keep count and order
+ * threads   -> one producer and one consumer thread through a small ring:
+ *              every element arrives once, in sequence and not torn, the
+ *              producer's refused pushes match dropped (also built under TSan)
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "spsc_ring.h"
+
+#include "test_util.h"
+
+#define CAPACITY        8
+#define STRESS_COUNT    200000
+
+typedef struct {
+    uint32_t seq;
+    uint32_t check;     // derived from seq, a torn copy does not match
+    uint8_t pad[24];
+} elem_t;
+
+static uint32_t elem_check(uint32_t seq)
+{
+    return ~seq * 2654435761u;
+}
+
+static void elem_make(elem_t* e, uint32_t seq)
+{
+    e->seq = seq;
+    e->check = elem_check(seq);
+    memset(e->pad, (int) (seq & 0xff), sizeof(e->pad));
+}
+
+static int elem_ok(const elem_t* e, uint32_t seq)
+{
+    for (size_t i = 0; i < sizeof(e->pad); i++) {
+        if (e->pad[i] != (uint8_t) (seq & 0xff)) {
+            return 0;
+        }
+    }
+    return (e->seq == seq) && (e->check == elem_check(seq));
+}
+
+static void test_init(void)
+{
+    spsc_ring_t r;
+    elem_t buf[CAPACITY];
+
+    CHECK_EQ(spsc_init(&r, buf, sizeof(elem_t), 0), -1);
+    CHECK_EQ(spsc_init(&r, buf, sizeof(elem_t), 3), -1);
+    CHECK_EQ(spsc_init(&r, buf, sizeof(elem_t), 6), -1);
+    CHECK_EQ(spsc_init(&r, buf, sizeof(elem_t), 1), 0);
+    CHECK_EQ(spsc_init(&r, buf, sizeof(elem_t), CAPACITY), 0);
+    CHECK_EQ(spsc_count(&r), 0);
+}
+
+static void test_full(void)
+{
+    spsc_ring_t r;
+    elem_t buf[CAPACITY], e;
+
+    spsc_init(&r, buf, sizeof(elem_t), CAPACITY);
+    CHECK_EQ(spsc_pop(&r, &e), -1);
+    for (uint32_t i = 0; i < CAPACITY; i++) {
+        elem_make(&e, i);
+        CHECK_EQ(spsc_push(&r, &e), 0);
+    }
+    CHECK_EQ(spsc_count(&r), CAPACITY);
+    elem_make(&e, CAPACITY);
+    CHECK_EQ(spsc_push(&r, &e), -1);
+    CHECK_EQ(spsc_push(&r, &e), -1);
+    CHECK_EQ(r.dropped, 2);
+    CHECK_EQ(spsc_count(&r), CAPACITY);
+
+    // one slot freed, one push accepted
+    CHECK_EQ(spsc_pop(&r, &e), 0);
+    CHECK(elem_ok(&e, 0));
+    elem_make(&e, CAPACITY);
+    CHECK_EQ(spsc_push(&r, &e), 0);
+    for (uint32_t i = 1; i <= CAPACITY; i++) {
+        CHECK_EQ(spsc_pop(&r, &e), 0);
+        CHECK(elem_ok(&e, i));
+    }
+    CHECK_EQ(spsc_pop(&r, &e), -1);
+    CHECK_EQ(spsc_count(&r), 0);
+    CHECK_EQ(r.dropped, 2);
+}
+
+static void test_wrap(void)
+{
+    spsc_ring_t r;
+    elem_t buf[CAPACITY], e;
+
+    spsc_init(&r, buf, sizeof(elem_t), CAPACITY);
+    r.head = r.tail = UINT32_MAX - 2;
+    for (uint32_t i = 0; i < CAPACITY; i++) {
+        elem_make(&e, i);
+        CHECK_EQ(spsc_push(&r, &e), 0);
+        CHECK_EQ(spsc_count(&r), i + 1);
+    }
+    CHECK_EQ(spsc_push(&r, &e), -1);
+    CHECK(r.head < r.tail);
+    for (uint32_t i = 0; i < CAPACITY; i++) {
+        CHECK_EQ(spsc_pop(&r, &e), 0);
+        CHECK(elem_ok(&e, i));
+    }
+    CHECK_EQ(spsc_pop(&r, &e), -1);
+    CHECK_EQ(spsc_count(&r), 0);
+}
+
+static spsc_ring_t stress_ring;
+static elem_t stress_buf[CAPACITY];
+static uint32_t stress_refused;    // producer's count of full rings
+static uint32_t stress_bad;        // consumer's count of elements out of sequence or torn
+
+static void* producer(void* arg)
+{
+    elem_t e;
+
+    (void) arg;
+    for (uint32_t seq = 0; seq < STRESS_COUNT; seq++) {
+        elem_make(&e, seq);
+        while (spsc_push(&stress_ring, &e) != 0) {
+            stress_refused++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void* consumer(void* arg)
+{
+    elem_t e;
+    uint32_t count;
+
+    (void) arg;
+    for (uint32_t seq = 0; seq < STRESS_COUNT; seq++) {
+        while (spsc_pop(&stress_ring, &e) != 0) {
+            sched_yield();
+        }
+        if (!elem_ok(&e, seq)) {
+            stress_bad++;
+        }
+        // exact from this side: never more than the capacity
+        count = spsc_count(&stress_ring);
+        if (count > CAPACITY) {
+            stress_bad++;
+        }
+    }
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    pthread_t p, c;
+    elem_t e;
+
+    spsc_init(&stress_ring, stress_buf, sizeof(elem_t), CAPACITY);
+    pthread_create(&c, NULL, consumer, NULL);
+    pthread_create(&p, NULL, producer, NULL);
+    pthread_join(p, NULL);
+    pthread_join(c, NULL);
+    CHECK_EQ(stress_bad, 0);
+    CHECK_EQ(stress_ring.dropped, stress_refused);
+    CHECK_EQ(spsc_count(&stress_ring), 0);
+    CHECK_EQ(spsc_pop(&stress_ring, &e), -1);
+}
+
+int main(void)
+{
+    test_init();
+    test_full();
+    test_wrap();
+    test_threads();
+    TEST_EXIT();
+}
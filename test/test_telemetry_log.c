@@ -0,0 +1,338 @@
+/*
+ * telemetry_log host test
+ *
+ * The log runs on a flash image kept in a file. Writes can only clear bits,
+ * as on NOR flash, and erase sets a sector back to 0xff. A "reboot" closes
+ * the file and opens the log again from it.
+ *   fifo     -> append, peek, consume in order, empty and oversize peeks
+ *   wrap     -> the head recycles the oldest sector with unsent records,
+ *               they are counted in dropped and reading resumes after them
+ *   torn     -> power cut in the middle of the data write: never handed out,
+ *               after the reboot either
+ *   crc      -> a bit flipped in stored data: skipped, not handed out
+ *   recovery -> both cursors and the sequence rebuilt on reopen, including
+ *               records consumed before it, and after a wrap
+ */
+
+#include <string.h>
+
+#include "telemetry_log.h"
+
+#include "test_util.h"
+
+#define IMAGE_PATH      "test_telemetry_log.img"
+#define IMAGE_SECTORS   4
+#define RECORD_LEN      200     // 18 records per sector
+#define PER_SECTOR      ((TLOG_SECTOR_SIZE - 16) / (16 + RECORD_LEN))
+
+static struct {
+    FILE* f;
+    int cut_in;     // writes left before the power cut, -1 never
+} image;
+
+static esp_err_t image_read(void* ctx, size_t offset, void* dst, size_t len)
+{
+    if ((fseek(image.f, (long) offset, SEEK_SET) != 0) || (fread(dst, 1, len, image.f) != len)) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// NOR: programming only clears bits
+static esp_err_t image_write(void* ctx, size_t offset, const void* src, size_t len)
+{
+    uint8_t old[TLOG_RECORD_MAX + 16];
+    const uint8_t* s = src;
+
+    if (len > sizeof(old)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (image.cut_in == 0) {
+        return ESP_FAIL;
+    }
+    if (image.cut_in > 0) {
+        image.cut_in--;
+        if (image.cut_in == 0) {
+            len /= 2;   // the cut lands half way through this write
+        }
+    }
+    if (image_read(ctx, offset, old, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < len; i++) {
+        old[i] &= s[i];
+    }
+    if ((fseek(image.f, (long) offset, SEEK_SET) != 0) || (fwrite(old, 1, len, image.f) != len)) {
+        return ESP_FAIL;
+    }
+    return (image.cut_in == 0) ? ESP_FAIL : ESP_OK;
+}
+
+static esp_err_t image_erase(void* ctx, size_t offset, size_t len)
+{
+    static const uint8_t ff[TLOG_SECTOR_SIZE] = { [0 ... TLOG_SECTOR_SIZE - 1] = 0xff };
+
+    if ((offset % TLOG_SECTOR_SIZE) || (len % TLOG_SECTOR_SIZE) || (fseek(image.f, (long) offset, SEEK_SET) != 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t done = 0; done < len; done += TLOG_SECTOR_SIZE) {
+        if (fwrite(ff, 1, TLOG_SECTOR_SIZE, image.f) != TLOG_SECTOR_SIZE) {
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+static const tlog_flash_t flash = {
+    .read = image_read,
+    .write = image_write,
+    .erase = image_erase,
+    .size = IMAGE_SECTORS * TLOG_SECTOR_SIZE,
+};
+
+// blank image, as a fresh partition
+static void image_create(void)
+{
+    static const uint8_t ff[TLOG_SECTOR_SIZE] = { [0 ... TLOG_SECTOR_SIZE - 1] = 0xff };
+
+    if (image.f != NULL) {
+        fclose(image.f);
+    }
+    image.f = fopen(IMAGE_PATH, "w+b");
+    CHECK(image.f != NULL);
+    for (int i = 0; i < IMAGE_SECTORS; i++) {
+        fwrite(ff, 1, sizeof(ff), image.f);
+    }
+    image.cut_in = -1;
+}
+
+static void reboot(tlog_t* log)
+{
+    fclose(image.f);
+    image.f = fopen(IMAGE_PATH, "r+b");
+    CHECK(image.f != NULL);
+    image.cut_in = -1;
+    CHECK_EQ(tlog_open(log, &flash), ESP_OK);
+}
+
+// record n: its number, then a pattern derived from it
+static void record(uint32_t n, uint8_t* buf)
+{
+    memcpy(buf, &n, sizeof(n));
+    for (int i = sizeof(n); i < RECORD_LEN; i++) {
+        buf[i] = (uint8_t) (n * 31 + i);
+    }
+}
+
+static void append(tlog_t* log, uint32_t n)
+{
+    uint8_t buf[RECORD_LEN];
+
+    record(n, buf);
+    CHECK_EQ(tlog_append(log, buf, RECORD_LEN), ESP_OK);
+}
+
+// number of the oldest record, checked against its pattern; -1 when empty
+static long long peek(tlog_t* log)
+{
+    uint8_t buf[TLOG_RECORD_MAX];
+    uint8_t want[RECORD_LEN];
+    uint16_t len = 0;
+    uint32_t n;
+
+    if (tlog_peek(log, buf, sizeof(buf), &len) != ESP_OK) {
+        return -1;
+    }
+    CHECK_EQ(len, RECORD_LEN);
+    memcpy(&n, buf, sizeof(n));
+    record(n, want);
+    CHECK_EQ(memcmp(buf, want, RECORD_LEN), 0);
+    return n;
+}
+
+static void test_fifo(void)
+{
+    tlog_t log;
+    uint8_t small[8];
+    uint16_t len;
+
+    image_create();
+    CHECK_EQ(tlog_open(&log, &flash), ESP_OK);
+    CHECK_EQ(peek(&log), -1);
+    CHECK_EQ(tlog_consume(&log), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(tlog_append(&log, small, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(tlog_append(&log, small, TLOG_RECORD_MAX + 1), ESP_ERR_INVALID_ARG);
+
+    for (uint32_t n = 0; n < 5; n++) {
+        append(&log, n);
+    }
+    CHECK_EQ(tlog_pending(&log), 5);
+    CHECK_EQ(tlog_peek(&log, small, sizeof(small), &len), ESP_ERR_INVALID_SIZE);
+    // peek does not consume
+    CHECK_EQ(peek(&log), 0);
+    CHECK_EQ(peek(&log), 0);
+    for (uint32_t n = 0; n < 5; n++) {
+        CHECK_EQ(peek(&log), n);
+        CHECK_EQ(tlog_consume(&log), ESP_OK);
+    }
+    CHECK_EQ(tlog_pending(&log), 0);
+    CHECK_EQ(peek(&log), -1);
+
+    // across a sector boundary
+    for (uint32_t n = 5; n < 5 + PER_SECTOR + 3; n++) {
+        append(&log, n);
+    }
+    for (uint32_t n = 5; n < 5 + PER_SECTOR + 3; n++) {
+        CHECK_EQ(peek(&log), n);
+        CHECK_EQ(tlog_consume(&log), ESP_OK);
+    }
+    CHECK_EQ(peek(&log), -1);
+    CHECK_EQ(log.dropped, 0);
+}
+
+static void test_wrap(void)
+{
+    const uint32_t total = IMAGE_SECTORS * PER_SECTOR + 1;
+    tlog_t log;
+
+    image_create();
+    CHECK_EQ(tlog_open(&log, &flash), ESP_OK);
+    // nothing sent: the first sector is recycled for the last record
+    for (uint32_t n = 0; n < total; n++) {
+        append(&log, n);
+    }
+    CHECK_EQ(log.dropped, PER_SECTOR);
+    CHECK_EQ(tlog_pending(&log), total - PER_SECTOR);
+    CHECK_EQ(peek(&log), PER_SECTOR);
+
+    // the same after a reboot, the newest record included
+    reboot(&log);
+    CHECK_EQ(tlog_pending(&log), total - PER_SECTOR);
+    for (uint32_t n = PER_SECTOR; n < total; n++) {
+        CHECK_EQ(peek(&log), n);
+        CHECK_EQ(tlog_consume(&log), ESP_OK);
+    }
+    CHECK_EQ(peek(&log), -1);
+    append(&log, total);
+    CHECK_EQ(peek(&log), total);
+}
+
+static void test_torn(void)
+{
+    uint8_t buf[RECORD_LEN];
+    tlog_t log;
+
+    image_create();
+    CHECK_EQ(tlog_open(&log, &flash), ESP_OK);
+    append(&log, 0);
+    append(&log, 1);
+    // header, then the cut half way through the data: state stays erased
+    record(2, buf);
+    image.cut_in = 2;
+    CHECK(tlog_append(&log, buf, RECORD_LEN) != ESP_OK);
+    image.cut_in = -1;
+    append(&log, 3);
+
+    CHECK_EQ(peek(&log), 0);
+    CHECK_EQ(tlog_consume(&log), ESP_OK);
+    CHECK_EQ(peek(&log), 1);
+    CHECK_EQ(tlog_consume(&log), ESP_OK);
+    CHECK_EQ(peek(&log), 3);
+
+    // the reset right after the cut: the torn slot is skipped and not counted
+    reboot(&log);
+    CHECK_EQ(tlog_pending(&log), 1);
+    CHECK_EQ(peek(&log), 3);
+    CHECK_EQ(tlog_consume(&log), ESP_OK);
+    CHECK_EQ(peek(&log), -1);
+
+    // cut before the state word: data complete but never marked written
+    record(4, buf);
+    image.cut_in = 3;
+    CHECK(tlog_append(&log, buf, RECORD_LEN) != ESP_OK);
+    reboot(&log);
+    CHECK_EQ(tlog_pending(&log), 0);
+    CHECK_EQ(peek(&log), -1);
+}
+
+static void test_crc(void)
+{
+    const size_t rec = 16 + 16 + RECORD_LEN;  // sector header + record 0
+    uint8_t b;
+    tlog_t log;
+
+    image_create();
+    CHECK_EQ(tlog_open(&log, &flash), ESP_OK);
+    append(&log, 0);
+    append(&log, 1);
+    append(&log, 2);
+    // clear one data bit of record 1 (its lowest set bit, byte 40 is 71)
+    CHECK_EQ(image_read(NULL, rec + 16 + 40, &b, 1), ESP_OK);
+    CHECK(b != 0);
+    b &= (uint8_t) (b - 1);
+    CHECK_EQ(image_write(NULL, rec + 16 + 40, &b, 1), ESP_OK);
+
+    CHECK_EQ(peek(&log), 0);
+    CHECK_EQ(tlog_consume(&log), ESP_OK);
+    CHECK_EQ(peek(&log), 2);
+    CHECK_EQ(tlog_pending(&log), 1);
+
+    // it stays out after a reboot: it was marked consumed
+    reboot(&log);
+    CHECK_EQ(tlog_pending(&log), 1);
+    CHECK_EQ(peek(&log), 2);
+}
+
+static void test_recovery(void)
+{
+    tlog_t log;
+
+    // blank and foreign images are formatted
+    image_create();
+    reboot(&log);
+    CHECK_EQ(tlog_pending(&log), 0);
+    CHECK_EQ(peek(&log), -1);
+
+    for (uint32_t n = 0; n < PER_SECTOR + 10; n++) {
+        append(&log, n);
+    }
+    for (uint32_t n = 0; n < PER_SECTOR + 4; n++) {
+        CHECK_EQ(peek(&log), n);
+        CHECK_EQ(tlog_consume(&log), ESP_OK);
+    }
+    reboot(&log);
+    CHECK_EQ(tlog_pending(&log), 6);
+    CHECK_EQ(log.next_seq, PER_SECTOR + 10);
+    CHECK_EQ(peek(&log), PER_SECTOR + 4);
+
+    // a peeked but unconsumed record is sent again
+    reboot(&log);
+    CHECK_EQ(peek(&log), PER_SECTOR + 4);
+    CHECK_EQ(tlog_consume(&log), ESP_OK);
+
+    // appends continue after the recovered head
+    append(&log, 1000);
+    reboot(&log);
+    CHECK_EQ(tlog_pending(&log), 6);
+    for (uint32_t n = PER_SECTOR + 5; n < PER_SECTOR + 10; n++) {
+        CHECK_EQ(peek(&log), n);
+        CHECK_EQ(tlog_consume(&log), ESP_OK);
+    }
+    CHECK_EQ(peek(&log), 1000);
+    CHECK_EQ(tlog_consume(&log), ESP_OK);
+    reboot(&log);
+    CHECK_EQ(tlog_pending(&log), 0);
+    CHECK_EQ(peek(&log), -1);
+}
+
+int main(void)
+{
+    test_fifo();
+    test_wrap();
+    test_torn();
+    test_crc();
+    test_recovery();
+    fclose(image.f);
+    remove(IMAGE_PATH);
+    TEST_EXIT();
+}
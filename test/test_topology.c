@@ -0,0 +1,69 @@
+/*
+ * topology host test
+ *
+ * layout -> roles to cores for one and two cores, pinned or not
+ * create -> tasks start on the host shim by role and on a given core, a
+ *           core the chip does not have is refused
+ */
+
+#include "topology.h"
+
+#include "test_util.h"
+
+#define WAIT_TICKS  2000
+
+static int started;
+
+static void task(void* arg)
+{
+    __atomic_fetch_add(&started, 1, __ATOMIC_RELEASE);
+    vTaskDelete(NULL);
+}
+
+static void test_layout(void)
+{
+    topology_t t;
+
+    topology_init(&t, 2, 1);
+    CHECK_EQ(t.pinned, 1);
+    CHECK_EQ(topology_core(&t, TOPO_ACQ), 1);
+    CHECK_EQ(topology_core(&t, TOPO_NET), 0);
+    CHECK_EQ(topology_core(&t, TOPO_ANY), TOPO_NO_AFFINITY);
+
+    topology_init(&t, 2, 0);
+    CHECK_EQ(topology_core(&t, TOPO_ACQ), TOPO_NO_AFFINITY);
+    CHECK_EQ(topology_core(&t, TOPO_NET), TOPO_NO_AFFINITY);
+
+    // single core chip: pinning asked for, not possible
+    topology_init(&t, 1, 1);
+    CHECK_EQ(t.pinned, 0);
+    CHECK_EQ(t.acq_core, 0);
+    CHECK_EQ(topology_core(&t, TOPO_ACQ), TOPO_NO_AFFINITY);
+}
+
+static void test_create(void)
+{
+    TaskHandle_t h = NULL;
+
+    topology_setup(1);
+    CHECK_EQ(topology_get()->pinned, 1);
+    CHECK_EQ(topology_task_create(TOPO_ACQ, task, "acq", 2048, NULL, 5, &h), ESP_OK);
+    CHECK(h != NULL);
+    CHECK_EQ(topology_task_create_pinned(0, task, "core0", 2048, NULL, 5, NULL), ESP_OK);
+    CHECK_EQ(topology_task_create_pinned(TOPO_NO_AFFINITY, task, "any", 2048, NULL, 5, NULL), ESP_OK);
+    CHECK_EQ(topology_task_create_pinned(portNUM_PROCESSORS, task, "none", 2048, NULL, 5, NULL),
+            ESP_ERR_INVALID_ARG);
+    CHECK_EQ(topology_task_create_pinned(-2, task, "none", 2048, NULL, 5, NULL), ESP_ERR_INVALID_ARG);
+
+    for (int t = 0; (t < WAIT_TICKS) && (__atomic_load_n(&started, __ATOMIC_ACQUIRE) < 3); t++) {
+        vTaskDelay(1);
+    }
+    CHECK_EQ(__atomic_load_n(&started, __ATOMIC_ACQUIRE), 3);
+}
+
+int main(void)
+{
+    test_layout();
+    test_create();
+    TEST_EXIT();
+}
@@ -0,0 +1,252 @@
+/*
+ * CBOR -> Iotera JSON round trip
+ *
+ * Every envelope is packed twice through wire.c, as WIRE_JSON and as
+ * WIRE_CBOR (plain, dict v1, dict v2), the CBOR goes through
+ * tools/wire_transcode.py and must come back as the JSON bytes:
+ *   batch    -> batch_pack of single samples (no ts) and of a whole batch
+ *               (with ts), CH2 not measured,
+ *               NaN / large / negative batteries, an ID with characters
+ *               JSON escapes, counters up to UINT64_MAX
+ *   summary  -> the pulse_stats item, ISR (9 members, rate as float) and
+ *               PCNT (edges and rate only) shapes
+ *   names    -> sensor/param/key names missing from the dictionary stay text
+ * and the transcoder refuses an unknown dict version, a truncated envelope
+ * and trailing bytes.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "batch.h"
+#include "wire.h"
+
+#include "test_util.h"
+
+#define PAYLOAD_MAX     4096
+#define CBOR_PATH       "test_wire_transcode.cbor"
+
+// wire_dict_v2 of main.c, v1 is its first 10 names
+static const char* const dict_v2[] = {
+    "sensor", "param", "value", "ts",
+    "wifi_node", "pulse_counter", "battery",
+    "ID", "CH1", "CH2",
+    "pulse_stats", "edges", "rate", "min_us", "max_us",
+    "p50_us", "p90_us", "p99_us", "bursts", "burst_max",
+};
+
+static const wire_config_t wire_json = { .format = WIRE_JSON };
+static const wire_config_t wire_cbor = { .format = WIRE_CBOR };
+static const wire_config_t wire_cbor_v1 = { .format = WIRE_CBOR, .dict = dict_v2, .dict_len = 10, .dict_version = 1 };
+static const wire_config_t wire_cbor_v2 = {
+    .format = WIRE_CBOR,
+    .dict = dict_v2,
+    .dict_len = sizeof(dict_v2) / sizeof(dict_v2[0]),
+    .dict_version = 2,
+};
+static const wire_config_t* const cbor_cfgs[] = { &wire_cbor, &wire_cbor_v1, &wire_cbor_v2 };
+
+static const char* id = "B8:27:EB:12:34:56";
+
+// pack_sample_items() of main.c
+static void pack_sample_items(wire_writer_t* w, const sample_t* s, int first, int with_ts)
+{
+    wire_item_begin(w, "wifi_node", "pulse_counter", first, with_ts);
+    int ch2 = (s->pulse2 != SAMPLE_NOT_MEASURED);
+    wire_map_begin(w, ch2 ? 3 : 2);
+    wire_key(w, "ID", 1);
+    wire_str(w, id);
+    wire_key(w, "CH1", 0);
+    wire_u64(w, s->pulse1);
+    if (ch2) {
+        wire_key(w, "CH2", 0);
+        wire_u64(w, s->pulse2);
+    }
+    wire_map_end(w);
+    if (with_ts) {
+        wire_item_ts(w, s->timestamp);
+    }
+    wire_item_end(w);
+
+    wire_item_begin(w, "wifi_node", "battery", 0, with_ts);
+    wire_float(w, s->battery, 6);
+    if (with_ts) {
+        wire_item_ts(w, s->timestamp);
+    }
+    wire_item_end(w);
+}
+
+/*
+ * The transcoder's output for buf, NUL terminated in out.
+ * return its exit status, -1 if it could not be run
+ */
+static int transcode(const void* buf, size_t len, char* out, size_t cap)
+{
+    FILE* f = fopen(CBOR_PATH, "wb");
+    size_t n;
+
+    if ((f == NULL) || (fwrite(buf, 1, len, f) != len)) {
+        return -1;
+    }
+    fclose(f);
+    FILE* p = popen("\"" PYTHON "\" \"" WIRE_TRANSCODE "\" " CBOR_PATH " 2>/dev/null", "r");
+    if (p == NULL) {
+        return -1;
+    }
+    n = fread(out, 1, cap - 1, p);
+    out[n] = '\0';
+    int status = pclose(p);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void check_round_trip(const char* what, const char* json, const void* cbor, int cbor_len)
+{
+    static char out[PAYLOAD_MAX * 2];
+
+    CHECK(cbor_len > 0);
+    CHECK_EQ(transcode(cbor, cbor_len, out, sizeof(out)), 0);
+    if (strcmp(out, json) != 0) {
+        fprintf(stderr, "%s\n  transcoded: %s\n  json:       %s\n", what, out, json);
+        CHECK(0);
+    }
+}
+
+// samples [first, first + n) as one envelope, single sample envelopes carry no ts
+static void batch_round_trip(const sample_t* s, int first, int n, int c)
+{
+    static char json[PAYLOAD_MAX], cbor[PAYLOAD_MAX];
+    batch_t b;
+    int packed, json_len, cbor_len;
+
+    batch_init(&b, BATCH_MAX_SAMPLES, 0, 0, &wire_json, pack_sample_items);
+    for (int i = first; i < first + n; i++) {
+        batch_add(&b, &s[i], 0);
+    }
+    json_len = batch_pack(&b, json, sizeof(json), &packed);
+    CHECK(json_len > 0);
+    CHECK_EQ(packed, n);
+    b.wire = cbor_cfgs[c];
+    cbor_len = batch_pack(&b, cbor, sizeof(cbor), &packed);
+    CHECK_EQ(packed, n);
+    CHECK(cbor_len < json_len);
+    check_round_trip("batch", json, cbor, cbor_len);
+}
+
+static void test_batch(void)
+{
+    const float batteries[] = { 3.7f, 4.2f, 3.3f, NAN, 0.0f, -1.25f, 3.1415927f, 1e19f };
+    enum { COUNT = sizeof(batteries) / sizeof(batteries[0]) };
+    sample_t s[COUNT];
+
+    for (int i = 0; i < COUNT; i++) {
+        s[i].timestamp = 1700000000u + i * 60;
+        s[i].battery = batteries[i];
+        s[i].pulse1 = (i == COUNT - 1) ? UINT64_MAX - 1 : 1000u + 17u * i;
+        s[i].pulse2 = (i % 3 == 1) ? SAMPLE_NOT_MEASURED : 1ULL << (8 * i);
+    }
+    for (int c = 0; c < 3; c++) {
+        id = (c == 1) ? "quote\" back\\slash\ttab" : "B8:27:EB:12:34:56";
+        for (int i = 0; i < COUNT; i++) {
+            batch_round_trip(s, i, 1, c);
+        }
+        batch_round_trip(s, 0, COUNT, c);
+    }
+    id = "B8:27:EB:12:34:56";
+}
+
+// send_pulse_summary() / pack_pulse_summary() of main.c
+static int pack_summary(const wire_config_t* cfg, int timed, char* buf, size_t cap)
+{
+    static const char* const keys[] = { "min_us", "max_us", "p50_us", "p90_us", "p99_us", "bursts", "burst_max" };
+    wire_writer_t w;
+
+    wire_init(&w, cfg, buf, cap);
+    wire_payload_begin(&w);
+    wire_item_begin(&w, "wifi_node", "pulse_stats", 1, 0);
+    wire_map_begin(&w, 2);
+    for (int ch = 0; ch < 2; ch++) {
+        wire_key(&w, (ch == 0) ? "CH1" : "CH2", ch == 0);
+        wire_map_begin(&w, timed ? 9 : 2);
+        wire_key(&w, "edges", 1);
+        wire_u64(&w, 12345u * (ch + 1));
+        wire_key(&w, "rate", 0);
+        wire_float(&w, 205.75f / (ch + 1), 3);
+        for (int k = 0; timed && (k < 7); k++) {
+            wire_key(&w, keys[k], 0);
+            wire_u64(&w, (uint64_t) (k + 1) * 1000 + ch);
+        }
+        wire_map_end(&w);
+    }
+    wire_map_end(&w);
+    wire_item_end(&w);
+    return wire_payload_end(&w);
+}
+
+static void test_summary(void)
+{
+    static char json[PAYLOAD_MAX], cbor[PAYLOAD_MAX];
+
+    for (int timed = 0; timed < 2; timed++) {
+        CHECK(pack_summary(&wire_json, timed, json, sizeof(json)) > 0);
+        for (int c = 0; c < 3; c++) {
+            int len = pack_summary(cbor_cfgs[c], timed, cbor, sizeof(cbor));
+            check_round_trip("summary", json, cbor, len);
+        }
+    }
+}
+
+static int pack_names(const wire_config_t* cfg, char* buf, size_t cap)
+{
+    wire_writer_t w;
+
+    wire_init(&w, cfg, buf, cap);
+    wire_payload_begin(&w);
+    wire_item_begin(&w, "gateway", "uptime", 1, 1);
+    wire_map_begin(&w, 3);
+    wire_key(&w, "rate", 1);
+    wire_float(&w, 0.0005f, 3);
+    wire_key(&w, "boots", 0);
+    wire_u64(&w, 0);
+    wire_key(&w, "ts", 0);
+    wire_str(&w, "");
+    wire_map_end(&w);
+    wire_item_ts(&w, 7);
+    wire_item_end(&w);
+    return wire_payload_end(&w);
+}
+
+static void test_names(void)
+{
+    static char json[PAYLOAD_MAX], cbor[PAYLOAD_MAX];
+
+    CHECK(pack_names(&wire_json, json, sizeof(json)) > 0);
+    for (int c = 0; c < 3; c++) {
+        check_round_trip("names", json, cbor, pack_names(cbor_cfgs[c], cbor, sizeof(cbor)));
+    }
+}
+
+static void test_refused(void)
+{
+    static char cbor[PAYLOAD_MAX], out[PAYLOAD_MAX];
+    const wire_config_t v9 = { .format = WIRE_CBOR, .dict = dict_v2, .dict_len = 10, .dict_version = 9 };
+    int len;
+
+    len = pack_names(&v9, cbor, sizeof(cbor));
+    CHECK_EQ(transcode(cbor, len, out, sizeof(out)), 1);
+
+    len = pack_names(&wire_cbor_v2, cbor, sizeof(cbor));
+    CHECK_EQ(transcode(cbor, len - 1, out, sizeof(out)), 1);
+    cbor[len] = 0;
+    CHECK_EQ(transcode(cbor, len + 1, out, sizeof(out)), 1);
+}
+
+int main(void)
+{
+    test_batch();
+    test_summary();
+    test_names();
+    test_refused();
+    remove(CBOR_PATH);
+    TEST_EXIT();
+}